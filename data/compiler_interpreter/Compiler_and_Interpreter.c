@@ -3,6 +3,7 @@
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
+#include <time.h>
 
 // =============================================================================
 // COMPILER AND INTERPRETER FUNDAMENTALS
@@ -133,6 +134,7 @@ typedef struct {
     int symbol_count;
     int running;
     int error;
+    long instructions_executed;
 } VirtualMachine;
 
 VirtualMachine vm;
@@ -266,7 +268,11 @@ int tokenize(const char* source, Token* tokens) {
             if (length < MAX_STRING_SIZE) {
                 strncpy(tokens[token_count].value, source + start, length);
                 tokens[token_count].value[length] = '\0';
-                tokens[token_count].type = isOperatorString(tokens[token_count].value) ? TOKEN_OPERATOR : TOKEN_ERROR;
+                if (strcmp(tokens[token_count].value, "=") == 0) {
+                    tokens[token_count].type = TOKEN_ASSIGN;
+                } else {
+                    tokens[token_count].type = isOperatorString(tokens[token_count].value) ? TOKEN_OPERATOR : TOKEN_ERROR;
+                }
                 tokens[token_count].line = line;
                 tokens[token_count].column = column;
                 token_count++;
@@ -376,8 +382,10 @@ int expectToken(TokenType type) {
     return 0;
 }
 
-// Parse expression (simplified)
-ASTNode* parseExpression() {
+ASTNode* parseExpression();
+
+// Parse primary expression (number, variable or parenthesized expression)
+ASTNode* parsePrimary() {
     Token* token = getCurrentToken();
     if (!token) return NULL;
     
@@ -414,6 +422,51 @@ ASTNode* parseExpression() {
     return NULL;
 }
 
+// Get binding strength of a single-character binary operator token, 0 if none
+int operatorPrecedence(Token* token) {
+    if (!token || token->type != TOKEN_OPERATOR || token->value[1] != '\0') return 0;
+    
+    switch (token->value[0]) {
+        case '*': case '/': case '%': return 3;
+        case '+': case '-': return 2;
+        case '<': case '>': return 1;
+        default: return 0;
+    }
+}
+
+// Parse binary operators with precedence climbing
+ASTNode* parseBinary(int min_precedence) {
+    ASTNode* left = parsePrimary();
+    
+    while (left) {
+        Token* token = getCurrentToken();
+        int precedence = operatorPrecedence(token);
+        if (precedence == 0 || precedence < min_precedence) break;
+        
+        char op = token->value[0];
+        getNextToken();
+        ASTNode* right = parseBinary(precedence + 1);
+        if (!right) return NULL;
+        
+        ASTNode* node = (ASTNode*)malloc(sizeof(ASTNode));
+        node->type = AST_BINARY_OP;
+        node->data.binary_op.op = op;
+        node->data.binary_op.left = left;
+        node->data.binary_op.right = right;
+        node->parent = NULL;
+        left->parent = node;
+        right->parent = node;
+        left = node;
+    }
+    
+    return left;
+}
+
+// Parse expression
+ASTNode* parseExpression() {
+    return parseBinary(1);
+}
+
 // Parse assignment
 ASTNode* parseAssignment() {
     Token* token = getCurrentToken();
@@ -441,6 +494,12 @@ ASTNode* parseAssignment() {
     return NULL;
 }
 
+ASTNode* parseIfStatement();
+ASTNode* parseWhileStatement();
+ASTNode* parseForStatement();
+ASTNode* parseReturnStatement();
+ASTNode* parseBlock();
+
 // Parse statement
 ASTNode* parseStatement() {
     Token* token = getCurrentToken();
@@ -606,6 +665,7 @@ ASTNode* parseBlock() {
                     statement->parent = node;
                     node->data.block.statement_count++;
                 }
+                expectToken(TOKEN_SEMICOLON);
             } else {
                 break;
             }
@@ -632,6 +692,7 @@ ASTNode* parseProgram() {
                 statement->parent = node;
                 node->data.program.statement_count++;
             }
+            expectToken(TOKEN_SEMICOLON);
         } else {
             break;
         }
@@ -650,6 +711,7 @@ void initVM() {
     vm.symbol_count = 0;
     vm.running = 1;
     vm.error = 0;
+    vm.instructions_executed = 0;
     
     for (int i = 0; i < 10; i++) {
         vm.registers[i] = 0;
@@ -795,6 +857,26 @@ int evaluateAST(ASTNode* node) {
 // COMPILER
 // =============================================================================
 
+// Bytecode opcodes
+#define OP_LOAD_CONST    0x01
+#define OP_LOAD_VAR      0x02
+#define OP_STORE_VAR     0x03
+#define OP_ADD           0x10
+#define OP_SUB           0x11
+#define OP_MUL           0x12
+#define OP_DIV           0x13
+#define OP_MOD           0x14
+#define OP_EQ            0x20
+#define OP_NEQ           0x21
+#define OP_LT            0x22
+#define OP_LTE           0x23
+#define OP_GT            0x24
+#define OP_GTE           0x25
+#define OP_AND           0x30
+#define OP_OR            0x31
+#define OP_JUMP_IF_FALSE 0x40
+#define OP_JUMP          0x50
+
 // Simple compiler that generates bytecodes
 typedef struct {
     unsigned char bytecodes[MAX_CODE_SIZE];
@@ -927,7 +1009,7 @@ void compileAST(ASTNode* node) {
         
         case AST_BLOCK: {
             for (int i = 0; i < node->data.block.statement_count; i++) {
-                compileAST(node->data.block.statement[i]);
+                compileAST(node->data.block.statements[i]);
             }
             break;
         }
@@ -954,6 +1036,7 @@ void executeBytecode() {
     
     while (pc < compiler.bytecode_count && vm.running) {
         unsigned char opcode = compiler.bytecodes[pc++];
+        vm.instructions_executed++;
         
         switch (opcode) {
             case 0x01: // LOAD_CONST
@@ -1032,6 +1115,14 @@ void executeBytecode() {
                 break;
             }
             
+            case 0x14: // MOD
+            {
+                int b = vm.stack[--vm.stack_top];
+                int a = vm.stack[--vm.stack_top];
+                vm.stack[vm.stack_top++] = b != 0 ? a % b : 0;
+                break;
+            }
+            
             case 0x20: // EQ
             {
                 int b = vm.stack[--vm.stack_top];
@@ -1040,6 +1131,62 @@ void executeBytecode() {
                 break;
             }
             
+            case 0x21: // NEQ
+            {
+                int b = vm.stack[--vm.stack_top];
+                int a = vm.stack[--vm.stack_top];
+                vm.stack[vm.stack_top++] = a != b;
+                break;
+            }
+            
+            case 0x22: // LT
+            {
+                int b = vm.stack[--vm.stack_top];
+                int a = vm.stack[--vm.stack_top];
+                vm.stack[vm.stack_top++] = a < b;
+                break;
+            }
+            
+            case 0x23: // LTE
+            {
+                int b = vm.stack[--vm.stack_top];
+                int a = vm.stack[--vm.stack_top];
+                vm.stack[vm.stack_top++] = a <= b;
+                break;
+            }
+            
+            case 0x24: // GT
+            {
+                int b = vm.stack[--vm.stack_top];
+                int a = vm.stack[--vm.stack_top];
+                vm.stack[vm.stack_top++] = a > b;
+                break;
+            }
+            
+            case 0x25: // GTE
+            {
+                int b = vm.stack[--vm.stack_top];
+                int a = vm.stack[--vm.stack_top];
+                vm.stack[vm.stack_top++] = a >= b;
+                break;
+            }
+            
+            case 0x30: // AND
+            {
+                int b = vm.stack[--vm.stack_top];
+                int a = vm.stack[--vm.stack_top];
+                vm.stack[vm.stack_top++] = a && b;
+                break;
+            }
+            
+            case 0x31: // OR
+            {
+                int b = vm.stack[--vm.stack_top];
+                int a = vm.stack[--vm.stack_top];
+                vm.stack[vm.stack_top++] = a || b;
+                break;
+            }
+            
             case 0x40: // JUMP_IF_FALSE
             {
                 int address = (compiler.bytecodes[pc] << 24) | 
@@ -1049,7 +1196,7 @@ void executeBytecode() {
                 pc += 4;
                 int condition = vm.stack[--vm.stack_top];
                 if (!condition) {
-                    pc = address;
+                    pc = compiler.labels[address]; // Operand is a label id
                 }
                 break;
             }
@@ -1060,7 +1207,7 @@ void executeBytecode() {
                              (compiler.bytecodes[pc + 1] << 16) | 
                              (compiler.bytecodes[pc + 2] << 8) | 
                              compiler.bytecodes[pc + 3];
-                pc = address;
+                pc = compiler.labels[address]; // Operand is a label id
                 break;
             }
             
@@ -1072,6 +1219,625 @@ void executeBytecode() {
     }
 }
 
+// =============================================================================
+// PRE-DECODED, DIRECT-THREADED EXECUTOR
+// =============================================================================
+
+// Internal opcode appended after the last decoded instruction
+#define OP_HALT 0x00
+
+// Labels-as-values ("computed goto") is a GCC/Clang extension
+#if defined(__GNUC__) || defined(__clang__)
+#define HAVE_COMPUTED_GOTO 1
+#endif
+
+// Instruction with its operand decoded to native width. Jump operands are
+// resolved from label ids to instruction indices at load time.
+typedef struct {
+    const void* handler; // Dispatch target, filled in by executeThreaded()
+    int opcode;
+    int operand;
+} DecodedInstruction;
+
+typedef struct {
+    DecodedInstruction code[MAX_CODE_SIZE + 1];
+    int count;
+} DecodedProgram;
+
+// Read a big-endian 32-bit operand from the bytecode stream
+int readInteger(int pc) {
+    return (compiler.bytecodes[pc] << 24) |
+           (compiler.bytecodes[pc + 1] << 16) |
+           (compiler.bytecodes[pc + 2] << 8) |
+           compiler.bytecodes[pc + 3];
+}
+
+// Get the operand size in bytes for an opcode, or -1 if it is unknown
+int operandSize(unsigned char opcode) {
+    switch (opcode) {
+        case OP_LOAD_CONST:
+        case OP_LOAD_VAR:
+        case OP_STORE_VAR:
+        case OP_JUMP_IF_FALSE:
+        case OP_JUMP:
+            return 4;
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+        case OP_EQ: case OP_NEQ: case OP_LT: case OP_LTE: case OP_GT: case OP_GTE:
+        case OP_AND: case OP_OR:
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+// Decode compiler.bytecodes into an instruction array. Returns 0 if the
+// bytecode is malformed (unknown opcode, truncated operand, bad jump target
+// or symbol index) so the caller can fall back to executeBytecode().
+int decodeBytecode(DecodedProgram* program) {
+    static int index_of[MAX_CODE_SIZE + 1]; // Byte offset -> instruction index
+    int pc = 0;
+    
+    program->count = 0;
+    for (int i = 0; i <= compiler.bytecode_count; i++) {
+        index_of[i] = -1;
+    }
+    
+    while (pc < compiler.bytecode_count) {
+        unsigned char opcode = compiler.bytecodes[pc];
+        int size = operandSize(opcode);
+        if (size < 0 || pc + 1 + size > compiler.bytecode_count) {
+            return 0;
+        }
+        
+        DecodedInstruction* instruction = &program->code[program->count];
+        index_of[pc] = program->count++;
+        instruction->handler = NULL;
+        instruction->opcode = opcode;
+        instruction->operand = size ? readInteger(pc + 1) : 0;
+        
+        if ((opcode == OP_LOAD_VAR || opcode == OP_STORE_VAR) &&
+            (instruction->operand < 0 || instruction->operand >= vm.symbol_count)) {
+            return 0;
+        }
+        
+        pc += 1 + size;
+    }
+    
+    // Falling off the end of the program halts
+    index_of[pc] = program->count;
+    program->code[program->count].handler = NULL;
+    program->code[program->count].opcode = OP_HALT;
+    program->code[program->count].operand = 0;
+    
+    // Resolve label ids to instruction indices
+    for (int i = 0; i < program->count; i++) {
+        DecodedInstruction* instruction = &program->code[i];
+        if (instruction->opcode == OP_JUMP || instruction->opcode == OP_JUMP_IF_FALSE) {
+            int label = instruction->operand;
+            if (label < 0 || label >= compiler.label_count) return 0;
+            
+            int address = compiler.labels[label];
+            if (address < 0 || address > compiler.bytecode_count || index_of[address] < 0) {
+                return 0;
+            }
+            instruction->operand = index_of[address];
+        }
+    }
+    
+    return 1;
+}
+
+#ifdef HAVE_COMPUTED_GOTO
+
+// Execute a decoded program. Each instruction carries the address of its
+// handler, so dispatch is a single indirect jump at the end of every handler
+// instead of a bounds-checked switch at the top of a shared loop.
+void executeThreaded(DecodedProgram* program) {
+    static const void* dispatch_table[256] = {
+        [OP_HALT]          = &&do_halt,
+        [OP_LOAD_CONST]    = &&do_load_const,
+        [OP_LOAD_VAR]      = &&do_load_var,
+        [OP_STORE_VAR]     = &&do_store_var,
+        [OP_ADD]           = &&do_add,
+        [OP_SUB]           = &&do_sub,
+        [OP_MUL]           = &&do_mul,
+        [OP_DIV]           = &&do_div,
+        [OP_MOD]           = &&do_mod,
+        [OP_EQ]            = &&do_eq,
+        [OP_NEQ]           = &&do_neq,
+        [OP_LT]            = &&do_lt,
+        [OP_LTE]           = &&do_lte,
+        [OP_GT]            = &&do_gt,
+        [OP_GTE]           = &&do_gte,
+        [OP_AND]           = &&do_and,
+        [OP_OR]            = &&do_or,
+        [OP_JUMP_IF_FALSE] = &&do_jump_if_false,
+        [OP_JUMP]          = &&do_jump,
+    };
+    
+    // Thread the code: replace opcodes with handler addresses
+    for (int i = 0; i <= program->count; i++) {
+        const void* handler = dispatch_table[program->code[i].opcode];
+        program->code[i].handler = handler ? handler : &&do_invalid;
+    }
+    
+    DecodedInstruction* code = program->code;
+    DecodedInstruction* ip = code;
+    int* stack = vm.stack;
+    int sp = vm.stack_top;
+    int a, b;
+    long executed = 0;
+    
+    if (!vm.running) return;
+    
+    // Counted as the switch loop counts them
+#define DISPATCH()   do { executed++; goto *ip->handler; } while (0)
+#define NEXT()       do { ip++; DISPATCH(); } while (0)
+#define BINARY(expr) do { b = stack[--sp]; a = stack[--sp]; stack[sp++] = (expr); NEXT(); } while (0)
+    
+    DISPATCH();
+    
+do_load_const:
+    stack[sp++] = ip->operand;
+    NEXT();
+    
+do_load_var:
+    if (!vm.symbols[ip->operand].is_initialized) goto do_invalid;
+    stack[sp++] = vm.symbols[ip->operand].value;
+    NEXT();
+    
+do_store_var:
+    vm.symbols[ip->operand].value = stack[--sp];
+    vm.symbols[ip->operand].is_initialized = 1;
+    NEXT();
+    
+do_add: BINARY(a + b);
+do_sub: BINARY(a - b);
+do_mul: BINARY(a * b);
+do_div: BINARY(b != 0 ? a / b : 0);
+do_mod: BINARY(b != 0 ? a % b : 0);
+do_eq:  BINARY(a == b);
+do_neq: BINARY(a != b);
+do_lt:  BINARY(a < b);
+do_lte: BINARY(a <= b);
+do_gt:  BINARY(a > b);
+do_gte: BINARY(a >= b);
+do_and: BINARY(a && b);
+do_or:  BINARY(a || b);
+    
+do_jump_if_false:
+    if (!stack[--sp]) {
+        ip = code + ip->operand;
+        DISPATCH();
+    }
+    NEXT();
+    
+do_jump:
+    ip = code + ip->operand;
+    DISPATCH();
+    
+do_invalid:
+    vm.error = 1;
+    vm.running = 0;
+    
+do_halt:
+    vm.stack_top = sp;
+    if (ip == code + program->count) {
+        executed--; // The halt appended by decodeBytecode() is not in the bytecode
+    }
+    vm.instructions_executed += executed;
+    
+#undef BINARY
+#undef NEXT
+#undef DISPATCH
+}
+
+#endif // HAVE_COMPUTED_GOTO
+
+// Run the compiled program with the fastest executor available. The switch
+// loop in executeBytecode() stays as the fallback for compilers without
+// computed goto and for bytecode the decoder rejects.
+void runBytecode() {
+#ifdef HAVE_COMPUTED_GOTO
+    static DecodedProgram program;
+    if (decodeBytecode(&program)) {
+        executeThreaded(&program);
+        return;
+    }
+#endif
+    executeBytecode();
+}
+
+// =============================================================================
+// REGISTER-BASED BACKEND
+// =============================================================================
+
+// Register file layout: [variables | constants | temporaries]. Variable
+// registers share indices with vm.symbols, so results can be copied back.
+#define MAX_REGISTERS 256
+#define REG_CONST_BASE MAX_SYMBOLS
+
+// Register opcodes (three-address: a = b op c)
+#define ROP_HALT          0x00
+#define ROP_MOVE          0x01 // a = b
+#define ROP_CHECK         0x02 // error if variable b is uninitialized
+#define ROP_INIT          0x03 // mark variable a initialized
+#define ROP_ADD           0x10
+#define ROP_SUB           0x11
+#define ROP_MUL           0x12
+#define ROP_DIV           0x13
+#define ROP_MOD           0x14
+#define ROP_EQ            0x20
+#define ROP_NEQ           0x21
+#define ROP_LT            0x22
+#define ROP_LTE           0x23
+#define ROP_GT            0x24
+#define ROP_GTE           0x25
+#define ROP_AND           0x30
+#define ROP_OR            0x31
+#define ROP_JUMP_IF_FALSE 0x40 // if (!b) goto a
+#define ROP_JUMP          0x50 // goto a
+#define ROP_JUMP_IF_TRUE  0x51 // if (b) goto a
+#define ROP_JUMP_IF_LT    0x52 // if (b < c) goto a
+#define ROP_JUMP_IF_GT    0x53 // if (b > c) goto a
+
+typedef struct {
+    unsigned char opcode;
+    int a;
+    int b;
+    int c;
+} RegInstruction;
+
+typedef struct {
+    RegInstruction code[MAX_CODE_SIZE];
+    int instruction_count;
+    int constants[MAX_REGISTERS - REG_CONST_BASE];
+    int constant_count;
+    int labels[MAX_SYMBOLS];
+    int label_count;
+    int temp_base;     // First temporary register, fixed once codegen ends
+    int temp_top;      // Next free temporary (relative to temp_base)
+    int temp_max;
+    unsigned char assigned[MAX_SYMBOLS]; // Definitely assigned at this point
+    int error;
+} RegisterCompiler;
+
+RegisterCompiler reg_compiler;
+
+// Initialize register compiler
+void initRegisterCompiler() {
+    memset(&reg_compiler, 0, sizeof(reg_compiler));
+}
+
+// Emit a three-address instruction
+void emitRegInstruction(unsigned char opcode, int a, int b, int c) {
+    if (reg_compiler.instruction_count < MAX_CODE_SIZE) {
+        RegInstruction* instruction = &reg_compiler.code[reg_compiler.instruction_count++];
+        instruction->opcode = opcode;
+        instruction->a = a;
+        instruction->b = b;
+        instruction->c = c;
+    } else {
+        reg_compiler.error = 1;
+    }
+}
+
+int createRegLabel() {
+    if (reg_compiler.label_count >= MAX_SYMBOLS) {
+        reg_compiler.error = 1;
+        return 0;
+    }
+    return reg_compiler.label_count++;
+}
+
+void setRegLabel(int label) {
+    reg_compiler.labels[label] = reg_compiler.instruction_count;
+}
+
+// Get the register holding a constant, adding it to the pool if needed
+int constantRegister(int value) {
+    for (int i = 0; i < reg_compiler.constant_count; i++) {
+        if (reg_compiler.constants[i] == value) {
+            return REG_CONST_BASE + i;
+        }
+    }
+    
+    if (reg_compiler.constant_count >= MAX_REGISTERS - REG_CONST_BASE) {
+        reg_compiler.error = 1;
+        return REG_CONST_BASE;
+    }
+    reg_compiler.constants[reg_compiler.constant_count] = value;
+    return REG_CONST_BASE + reg_compiler.constant_count++;
+}
+
+// Temporaries are numbered from 0 during codegen and relocated above the
+// constant pool once its size is known. Encoded as negative numbers here.
+int allocTemp() {
+    int temp = reg_compiler.temp_top++;
+    if (reg_compiler.temp_top > reg_compiler.temp_max) {
+        reg_compiler.temp_max = reg_compiler.temp_top;
+    }
+    return -1 - temp;
+}
+
+int variableRegister(const char* name) {
+    Symbol* symbol = getSymbol(name);
+    if (!symbol) {
+        reg_compiler.error = 1;
+        return 0;
+    }
+    return symbol - vm.symbols;
+}
+
+unsigned char registerOpcode(char op) {
+    switch (op) {
+        case '+': return ROP_ADD;
+        case '-': return ROP_SUB;
+        case '*': return ROP_MUL;
+        case '/': return ROP_DIV;
+        case '%': return ROP_MOD;
+        case '<': return ROP_LT;
+        case '>': return ROP_GT;
+        case '&': return ROP_AND;
+        case '|': return ROP_OR;
+        default:  return ROP_HALT;
+    }
+}
+
+// Compile an expression. If dst >= 0 the result is written there, otherwise
+// the register already holding it (variable, constant or temporary) is returned.
+int compileRegExpression(ASTNode* node, int dst) {
+    int result;
+    
+    switch (node ? node->type : AST_PROGRAM) {
+        case AST_NUMBER:
+            result = constantRegister(node->data.number);
+            break;
+            
+        case AST_VARIABLE:
+            result = variableRegister(node->data.variable);
+            if (!reg_compiler.assigned[result]) {
+                // Execution only continues past a passing check
+                emitRegInstruction(ROP_CHECK, 0, result, 0);
+                reg_compiler.assigned[result] = 1;
+            }
+            break;
+            
+        case AST_BINARY_OP: {
+            unsigned char opcode = registerOpcode(node->data.binary_op.op);
+            int saved_temp = reg_compiler.temp_top;
+            int left = compileRegExpression(node->data.binary_op.left, -1);
+            int right = compileRegExpression(node->data.binary_op.right, -1);
+            if (opcode == ROP_HALT) {
+                reg_compiler.error = 1;
+            }
+            
+            // Operand temporaries are dead once the operation has read them
+            reg_compiler.temp_top = saved_temp;
+            if (dst < 0) {
+                dst = allocTemp();
+            }
+            emitRegInstruction(opcode, dst, left, right);
+            return dst;
+        }
+        
+        default:
+            reg_compiler.error = 1;
+            return constantRegister(0);
+    }
+    
+    if (dst >= 0 && dst != result) {
+        emitRegInstruction(ROP_MOVE, dst, result, 0);
+        return dst;
+    }
+    return result;
+}
+
+// Compile a condition and jump to target when it evaluates to `when`
+void compileRegBranch(ASTNode* condition, int when, int target) {
+    if (when && condition && condition->type == AST_BINARY_OP &&
+        (condition->data.binary_op.op == '<' || condition->data.binary_op.op == '>')) {
+        int saved_temp = reg_compiler.temp_top;
+        int left = compileRegExpression(condition->data.binary_op.left, -1);
+        int right = compileRegExpression(condition->data.binary_op.right, -1);
+        reg_compiler.temp_top = saved_temp;
+        emitRegInstruction(condition->data.binary_op.op == '<' ? ROP_JUMP_IF_LT : ROP_JUMP_IF_GT,
+                           target, left, right);
+        return;
+    }
+    
+    int saved_temp = reg_compiler.temp_top;
+    int value = compileRegExpression(condition, -1);
+    reg_compiler.temp_top = saved_temp;
+    emitRegInstruction(when ? ROP_JUMP_IF_TRUE : ROP_JUMP_IF_FALSE, target, value, 0);
+}
+
+// Compile AST to register bytecode (counterpart of compileAST)
+void compileRegisterAST(ASTNode* node) {
+    if (!node) return;
+    
+    switch (node->type) {
+        case AST_ASSIGN: {
+            int variable = variableRegister(node->data.assignment.variable);
+            compileRegExpression(node->data.assignment.expression, variable);
+            if (!reg_compiler.assigned[variable]) {
+                emitRegInstruction(ROP_INIT, variable, 0, 0);
+                reg_compiler.assigned[variable] = 1;
+            }
+            reg_compiler.temp_top = 0;
+            break;
+        }
+        
+        case AST_IF: {
+            unsigned char saved[MAX_SYMBOLS];
+            int else_label = createRegLabel();
+            int end_label = createRegLabel();
+            
+            compileRegBranch(node->data.if_statement.condition, 0, else_label);
+            
+            // Assignments inside a branch may not run
+            memcpy(saved, reg_compiler.assigned, sizeof(saved));
+            compileRegisterAST(node->data.if_statement.then_block);
+            memcpy(reg_compiler.assigned, saved, sizeof(saved));
+            
+            emitRegInstruction(ROP_JUMP, end_label, 0, 0);
+            setRegLabel(else_label);
+            compileRegisterAST(node->data.if_statement.else_block);
+            memcpy(reg_compiler.assigned, saved, sizeof(saved));
+            
+            setRegLabel(end_label);
+            break;
+        }
+        
+        case AST_WHILE: {
+            // Rotated loop: one conditional branch per iteration
+            unsigned char saved[MAX_SYMBOLS];
+            int body_label = createRegLabel();
+            int condition_label = createRegLabel();
+            
+            emitRegInstruction(ROP_JUMP, condition_label, 0, 0);
+            setRegLabel(body_label);
+            memcpy(saved, reg_compiler.assigned, sizeof(saved));
+            compileRegisterAST(node->data.while_statement.body);
+            memcpy(reg_compiler.assigned, saved, sizeof(saved));
+            
+            setRegLabel(condition_label);
+            compileRegBranch(node->data.while_statement.condition, 1, body_label);
+            break;
+        }
+        
+        case AST_BLOCK:
+            for (int i = 0; i < node->data.block.statement_count; i++) {
+                compileRegisterAST(node->data.block.statements[i]);
+            }
+            break;
+            
+        case AST_PROGRAM:
+            for (int i = 0; i < node->data.program.statement_count; i++) {
+                compileRegisterAST(node->data.program.statements[i]);
+            }
+            break;
+            
+        default:
+            // Statements compileAST() skips are skipped here as well
+            break;
+    }
+}
+
+// Relocate temporaries above the constant pool and resolve jump labels
+void finishRegisterCode() {
+    reg_compiler.temp_base = REG_CONST_BASE + reg_compiler.constant_count;
+    if (reg_compiler.temp_base + reg_compiler.temp_max > MAX_REGISTERS) {
+        reg_compiler.error = 1;
+        return;
+    }
+    
+    for (int i = 0; i < reg_compiler.instruction_count; i++) {
+        RegInstruction* instruction = &reg_compiler.code[i];
+        switch (instruction->opcode) {
+            case ROP_JUMP:
+            case ROP_JUMP_IF_FALSE:
+            case ROP_JUMP_IF_TRUE:
+            case ROP_JUMP_IF_LT:
+            case ROP_JUMP_IF_GT:
+                instruction->a = reg_compiler.labels[instruction->a];
+                break;
+            default:
+                if (instruction->a < 0) instruction->a = reg_compiler.temp_base - 1 - instruction->a;
+                break;
+        }
+        if (instruction->b < 0) instruction->b = reg_compiler.temp_base - 1 - instruction->b;
+        if (instruction->c < 0) instruction->c = reg_compiler.temp_base - 1 - instruction->c;
+    }
+    
+    emitRegInstruction(ROP_HALT, 0, 0, 0);
+}
+
+// Compile a whole program for the register VM. Returns 0 on failure.
+int compileRegisterProgram(ASTNode* program) {
+    initRegisterCompiler();
+    compileRegisterAST(program);
+    finishRegisterCode();
+    return !reg_compiler.error;
+}
+
+// Execute register bytecode. Variables are loaded from and written back to
+// vm.symbols so the results are directly comparable with executeBytecode().
+void executeRegisterCode() {
+    int registers[MAX_REGISTERS];
+    unsigned char initialized[MAX_SYMBOLS];
+    const RegInstruction* code = reg_compiler.code;
+    long executed = 0;
+    int halted = 0;
+    int pc = 0;
+    
+    for (int i = 0; i < MAX_SYMBOLS; i++) {
+        registers[i] = i < vm.symbol_count ? vm.symbols[i].value : 0;
+        initialized[i] = i < vm.symbol_count ? vm.symbols[i].is_initialized : 0;
+    }
+    for (int i = 0; i < reg_compiler.constant_count; i++) {
+        registers[REG_CONST_BASE + i] = reg_compiler.constants[i];
+    }
+    
+    while (vm.running && !halted) {
+        const RegInstruction* instruction = &code[pc++];
+        int a = instruction->a;
+        int b = registers[instruction->b];
+        int c = registers[instruction->c];
+        executed++;
+        
+        switch (instruction->opcode) {
+            case ROP_MOVE: registers[a] = b; break;
+            case ROP_ADD:  registers[a] = b + c; break;
+            case ROP_SUB:  registers[a] = b - c; break;
+            case ROP_MUL:  registers[a] = b * c; break;
+            case ROP_DIV:  registers[a] = c != 0 ? b / c : 0; break;
+            case ROP_MOD:  registers[a] = c != 0 ? b % c : 0; break;
+            case ROP_EQ:   registers[a] = b == c; break;
+            case ROP_NEQ:  registers[a] = b != c; break;
+            case ROP_LT:   registers[a] = b < c; break;
+            case ROP_LTE:  registers[a] = b <= c; break;
+            case ROP_GT:   registers[a] = b > c; break;
+            case ROP_GTE:  registers[a] = b >= c; break;
+            case ROP_AND:  registers[a] = b && c; break;
+            case ROP_OR:   registers[a] = b || c; break;
+            
+            case ROP_JUMP:          pc = a; break;
+            case ROP_JUMP_IF_FALSE: if (!b) pc = a; break;
+            case ROP_JUMP_IF_TRUE:  if (b) pc = a; break;
+            case ROP_JUMP_IF_LT:    if (b < c) pc = a; break;
+            case ROP_JUMP_IF_GT:    if (b > c) pc = a; break;
+            
+            case ROP_CHECK:
+                if (!initialized[instruction->b]) {
+                    vm.error = 1;
+                    vm.running = 0;
+                }
+                break;
+                
+            case ROP_INIT:
+                initialized[a] = 1;
+                break;
+                
+            case ROP_HALT:
+                executed--;
+                halted = 1;
+                break;
+                
+            default:
+                vm.error = 1;
+                vm.running = 0;
+                break;
+        }
+    }
+    
+    for (int i = 0; i < vm.symbol_count; i++) {
+        vm.symbols[i].value = registers[i];
+        vm.symbols[i].is_initialized = initialized[i];
+    }
+    vm.instructions_executed = executed;
+}
+
 // =============================================================================
 // DEMONSTRATION FUNCTIONS
 // =============================================================================
@@ -1187,6 +1953,7 @@ void demonstrateCompiler() {
     ASTNode* ast = parseProgram();
     
     if (ast) {
+        initVM(); // compileAST() registers symbols in the VM
         initCompiler();
         compileAST(ast);
         
@@ -1200,8 +1967,7 @@ void demonstrateCompiler() {
         }
         
         // Execute bytecode
-        initVM();
-        executeBytecode();
+        runBytecode();
         
         printf("\nExecution completed!\n");
         printf("Error: %s\n", vm.error ? "Yes" : "No");
@@ -1298,6 +2064,337 @@ void demonstrateErrorHandling() {
     printf("\n");
 }
 
+// =============================================================================
+// DISPATCH BENCHMARK
+// =============================================================================
+
+// The simplified parser only handles primary expressions, so the benchmark
+// programs are built directly as ASTs.
+ASTNode* newNode(ASTNodeType type) {
+    ASTNode* node = (ASTNode*)calloc(1, sizeof(ASTNode));
+    node->type = type;
+    return node;
+}
+
+ASTNode* numberNode(int value) {
+    ASTNode* node = newNode(AST_NUMBER);
+    node->data.number = value;
+    return node;
+}
+
+ASTNode* variableNode(const char* name) {
+    ASTNode* node = newNode(AST_VARIABLE);
+    strcpy(node->data.variable, name);
+    return node;
+}
+
+ASTNode* binaryNode(char op, ASTNode* left, ASTNode* right) {
+    ASTNode* node = newNode(AST_BINARY_OP);
+    node->data.binary_op.op = op;
+    node->data.binary_op.left = left;
+    node->data.binary_op.right = right;
+    return node;
+}
+
+ASTNode* assignNode(const char* name, ASTNode* expression) {
+    ASTNode* node = newNode(AST_ASSIGN);
+    strcpy(node->data.assignment.variable, name);
+    node->data.assignment.expression = expression;
+    return node;
+}
+
+ASTNode* whileNode(ASTNode* condition, ASTNode* body) {
+    ASTNode* node = newNode(AST_WHILE);
+    node->data.while_statement.condition = condition;
+    node->data.while_statement.body = body;
+    return node;
+}
+
+void appendStatement(ASTNode* node, ASTNode* statement) {
+    if (node->type == AST_PROGRAM) {
+        node->data.program.statements[node->data.program.statement_count++] = statement;
+    } else {
+        node->data.block.statements[node->data.block.statement_count++] = statement;
+    }
+}
+
+// Free an AST built by the helpers above
+void freeAST(ASTNode* node) {
+    if (!node) return;
+    
+    switch (node->type) {
+        case AST_BINARY_OP:
+            freeAST(node->data.binary_op.left);
+            freeAST(node->data.binary_op.right);
+            break;
+        case AST_ASSIGN:
+            freeAST(node->data.assignment.expression);
+            break;
+        case AST_IF:
+            freeAST(node->data.if_statement.condition);
+            freeAST(node->data.if_statement.then_block);
+            freeAST(node->data.if_statement.else_block);
+            break;
+        case AST_WHILE:
+            freeAST(node->data.while_statement.condition);
+            freeAST(node->data.while_statement.body);
+            break;
+        case AST_BLOCK:
+            for (int i = 0; i < node->data.block.statement_count; i++) {
+                freeAST(node->data.block.statements[i]);
+            }
+            break;
+        case AST_PROGRAM:
+            for (int i = 0; i < node->data.program.statement_count; i++) {
+                freeAST(node->data.program.statements[i]);
+            }
+            break;
+        default:
+            break;
+    }
+    
+    free(node);
+}
+
+// sum = 0; i = 0; while (i < n) { sum = (sum + i) % 1000003; i = i + 1; }
+ASTNode* buildSumLoop(int n) {
+    ASTNode* program = newNode(AST_PROGRAM);
+    ASTNode* body = newNode(AST_BLOCK);
+    
+    appendStatement(program, assignNode("sum", numberNode(0)));
+    appendStatement(program, assignNode("i", numberNode(0)));
+    appendStatement(body, assignNode("sum",
+        binaryNode('%', binaryNode('+', variableNode("sum"), variableNode("i")), numberNode(1000003))));
+    appendStatement(body, assignNode("i", binaryNode('+', variableNode("i"), numberNode(1))));
+    appendStatement(program, whileNode(binaryNode('<', variableNode("i"), numberNode(n)), body));
+    
+    return program;
+}
+
+// acc = 0; i = 0;
+// while (i < n) { j = 0; while (j < n) { acc = (acc + i * j) % 9973; j = j + 1; } i = i + 1; }
+ASTNode* buildNestedLoop(int n) {
+    ASTNode* program = newNode(AST_PROGRAM);
+    ASTNode* outer = newNode(AST_BLOCK);
+    ASTNode* inner = newNode(AST_BLOCK);
+    
+    appendStatement(program, assignNode("acc", numberNode(0)));
+    appendStatement(program, assignNode("i", numberNode(0)));
+    appendStatement(inner, assignNode("acc",
+        binaryNode('%', binaryNode('+', variableNode("acc"),
+                                   binaryNode('*', variableNode("i"), variableNode("j"))),
+                   numberNode(9973))));
+    appendStatement(inner, assignNode("j", binaryNode('+', variableNode("j"), numberNode(1))));
+    appendStatement(outer, assignNode("j", numberNode(0)));
+    appendStatement(outer, whileNode(binaryNode('<', variableNode("j"), numberNode(n)), inner));
+    appendStatement(outer, assignNode("i", binaryNode('+', variableNode("i"), numberNode(1))));
+    appendStatement(program, whileNode(binaryNode('<', variableNode("i"), numberNode(n)), outer));
+    
+    return program;
+}
+
+// hits = 0; k = 0; while (k < n) { hits = hits + (k % 7 < 1); k = k + 1; }
+ASTNode* buildCountLoop(int n) {
+    ASTNode* program = newNode(AST_PROGRAM);
+    ASTNode* body = newNode(AST_BLOCK);
+    
+    appendStatement(program, assignNode("hits", numberNode(0)));
+    appendStatement(program, assignNode("k", numberNode(0)));
+    appendStatement(body, assignNode("hits",
+        binaryNode('+', variableNode("hits"),
+                   binaryNode('<', binaryNode('%', variableNode("k"), numberNode(7)), numberNode(1)))));
+    appendStatement(body, assignNode("k", binaryNode('+', variableNode("k"), numberNode(1))));
+    appendStatement(program, whileNode(binaryNode('<', variableNode("k"), numberNode(n)), body));
+    
+    return program;
+}
+
+// Clear runtime state but keep the symbols registered by compileAST()
+void resetVMState() {
+    vm.stack_top = 0;
+    vm.running = 1;
+    vm.error = 0;
+    vm.instructions_executed = 0;
+    
+    for (int i = 0; i < vm.symbol_count; i++) {
+        vm.symbols[i].value = 0;
+        vm.symbols[i].is_initialized = 0;
+    }
+}
+
+void benchmarkDispatch(const char* name, ASTNode* program, const char* result_symbol) {
+    static DecodedProgram decoded;
+    
+    initVM();
+    initCompiler();
+    compileAST(program);
+    
+    // Switch-based interpreter over the raw byte stream, called directly
+    // as the baseline; everything else runs through runBytecode()
+    resetVMState();
+    clock_t start = clock();
+    executeBytecode();
+    double switch_time = ((double)(clock() - start)) / CLOCKS_PER_SEC;
+    int switch_result = getSymbol(result_symbol)->value;
+    int switch_error = vm.error;
+    
+    // Load-time decode, then direct-threaded dispatch
+    start = clock();
+    int decoded_ok = decodeBytecode(&decoded);
+    double decode_time = ((double)(clock() - start)) / CLOCKS_PER_SEC;
+    
+    resetVMState();
+    start = clock();
+#ifdef HAVE_COMPUTED_GOTO
+    if (decoded_ok) {
+        executeThreaded(&decoded);
+    } else {
+        executeBytecode();
+    }
+#else
+    executeBytecode();
+#endif
+    double threaded_time = ((double)(clock() - start)) / CLOCKS_PER_SEC;
+    int threaded_result = getSymbol(result_symbol)->value;
+    int threaded_error = vm.error;
+    
+    printf("%-12s %6d bytes -> %5d instrs  switch %8.4fs  threaded %8.4fs (decode %.6fs)  speedup %5.2fx  %s=%d %s\n",
+           name, compiler.bytecode_count, decoded.count, switch_time, threaded_time, decode_time,
+           threaded_time > 0 ? switch_time / threaded_time : 0.0,
+           result_symbol, threaded_result,
+           (switch_result == threaded_result && switch_error == threaded_error) ? "(match)" : "(MISMATCH)");
+}
+
+void demonstrateDispatchBenchmark() {
+    printf("=== DISPATCH BENCHMARK (switch vs. direct-threaded) ===\n");
+#ifndef HAVE_COMPUTED_GOTO
+    printf("Computed goto unavailable: both runs use the switch loop\n");
+#endif
+    
+    ASTNode* programs[3];
+    programs[0] = buildSumLoop(5000000);
+    programs[1] = buildNestedLoop(2000);
+    programs[2] = buildCountLoop(5000000);
+    
+    benchmarkDispatch("sum loop", programs[0], "sum");
+    benchmarkDispatch("nested loop", programs[1], "acc");
+    benchmarkDispatch("count loop", programs[2], "hits");
+    
+    for (int i = 0; i < 3; i++) {
+        freeAST(programs[i]);
+    }
+    
+    printf("\n");
+}
+
+// =============================================================================
+// STACK VS. REGISTER BACKEND
+// =============================================================================
+
+typedef struct {
+    int values[MAX_SYMBOLS];
+    int initialized[MAX_SYMBOLS];
+    int error;
+    long instructions;
+    double seconds;
+} RunResult;
+
+void captureRunResult(RunResult* result, double seconds) {
+    for (int i = 0; i < vm.symbol_count; i++) {
+        result->values[i] = vm.symbols[i].value;
+        result->initialized[i] = vm.symbols[i].is_initialized;
+    }
+    result->error = vm.error;
+    result->instructions = vm.instructions_executed;
+    result->seconds = seconds;
+}
+
+int sameRunResult(const RunResult* a, const RunResult* b) {
+    if (a->error != b->error) return 0;
+    for (int i = 0; i < vm.symbol_count; i++) {
+        if (a->initialized[i] != b->initialized[i]) return 0;
+        if (a->initialized[i] && a->values[i] != b->values[i]) return 0;
+    }
+    return 1;
+}
+
+// Compile a program with both backends and run each from a clean state.
+// Returns 1 if they agree on every variable and on the error flag.
+int runBothBackends(ASTNode* program, RunResult* stack_run, RunResult* register_run) {
+    initVM();
+    initCompiler();
+    compileAST(program);
+    int register_ok = compileRegisterProgram(program);
+    
+    resetVMState();
+    clock_t start = clock();
+    runBytecode();
+    captureRunResult(stack_run, ((double)(clock() - start)) / CLOCKS_PER_SEC);
+    
+    resetVMState();
+    start = clock();
+    if (register_ok) {
+        executeRegisterCode();
+    } else {
+        vm.error = 1;
+    }
+    captureRunResult(register_run, ((double)(clock() - start)) / CLOCKS_PER_SEC);
+    
+    return sameRunResult(stack_run, register_run);
+}
+
+void demonstrateRegisterVM() {
+    printf("=== STACK VS. REGISTER BACKEND ===\n");
+    
+    // Sources used by the other demonstrations
+    const char* sources[] = {
+        "var x = 10;\nvar y = 20;\nif (x < y) {\n    x = x + 1;\n}\n",
+        "var x = 10 + 5;",
+        "var x = 10;\nvar y = 20;\nvar z = x + y;\n",
+        "var i = 0;\nvar sum = 0;\nwhile (i < 10) {\n    sum = sum + i;\n    i = i + 1;\n}\n",
+        "var x = ;"
+    };
+    int source_count = sizeof(sources) / sizeof(sources[0]);
+    RunResult stack_run, register_run;
+    
+    printf("Demonstration programs:\n");
+    for (int i = 0; i < source_count; i++) {
+        Token tokens[MAX_TOKENS];
+        int token_count = tokenize(sources[i], tokens);
+        initParser(tokens, token_count);
+        ASTNode* ast = parseProgram();
+        
+        int match = runBothBackends(ast, &stack_run, &register_run);
+        printf("  program %d: stack %ld instrs, register %ld instrs, %d bytecodes vs %d instructions %s\n",
+               i + 1, stack_run.instructions, register_run.instructions,
+               compiler.bytecode_count, reg_compiler.instruction_count,
+               match ? "(match)" : "(MISMATCH)");
+        freeAST(ast);
+    }
+    
+    printf("\nLoop programs:\n");
+    ASTNode* programs[3];
+    const char* names[3] = { "sum loop", "nested loop", "count loop" };
+    programs[0] = buildSumLoop(5000000);
+    programs[1] = buildNestedLoop(2000);
+    programs[2] = buildCountLoop(5000000);
+    
+    for (int i = 0; i < 3; i++) {
+        int match = runBothBackends(programs[i], &stack_run, &register_run);
+        double reduction = stack_run.instructions > 0 ?
+            100.0 * (stack_run.instructions - register_run.instructions) / stack_run.instructions : 0.0;
+        
+        printf("  %-12s stack %10ld instrs %7.4fs | register %10ld instrs %7.4fs | %4.1f%% fewer, speedup %4.2fx %s\n",
+               names[i], stack_run.instructions, stack_run.seconds,
+               register_run.instructions, register_run.seconds, reduction,
+               register_run.seconds > 0 ? stack_run.seconds / register_run.seconds : 0.0,
+               match ? "(match)" : "(MISMATCH)");
+        freeAST(programs[i]);
+    }
+    
+    printf("\n");
+}
+
 // =============================================================================
 // MAIN FUNCTION
 // =============================================================================
@@ -1314,6 +2411,8 @@ int main() {
     demonstrateControlFlow();
     demonstrateFunctions();
     demonstrateErrorHandling();
+    demonstrateDispatchBenchmark();
+    demonstrateRegisterVM();
     
     printf("All compiler and interpreter examples demonstrated!\n");
     printf("Note: These are simplified implementations for educational purposes.\n");
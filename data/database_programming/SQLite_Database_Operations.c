@@ -3,6 +3,7 @@
 #include <string.h>
 #include <sqlite3.h>
 #include <time.h>
+#include <math.h>
 
 // =============================================================================
 // DATABASE SCHEMA DEFINITIONS
@@ -41,14 +42,31 @@ typedef struct {
     int created_at;
 } Order;
 
+// Statements run often enough to keep prepared
+#define INSERT_USER_SQL "INSERT INTO users (username, email, password_hash, created_at) VALUES (?, ?, ?, ?)"
+#define INSERT_PRODUCT_SQL "INSERT INTO products (name, description, price, stock_quantity, category_id, created_at) VALUES (?, ?, ?, ?, ?, ?)"
+#define INSERT_ORDER_SQL "INSERT INTO orders (user_id, product_id, quantity, unit_price, total_price, created_at) VALUES (?, ?, ?, ?, ?, ?)"
+#define BULK_ORDER_SQL "INSERT INTO orders (user_id, product_id, quantity, unit_price, total_price, status, created_at) VALUES (?, ?, ?, ?, ?, ?, ?)"
+
 // =============================================================================
 // DATABASE CONNECTION MANAGEMENT
 // =============================================================================
 
+#define MAX_CACHED_STATEMENTS 16
+
+// Prepared statement kept for reuse, keyed by its SQL text
+typedef struct {
+    const char* sql;
+    sqlite3_stmt* stmt;
+} CachedStatement;
+
 typedef struct {
     sqlite3* db;
     char* filename;
     int is_connected;
+    CachedStatement statements[MAX_CACHED_STATEMENTS];
+    int statement_count;
+    int next_eviction;
 } DatabaseConnection;
 
 DatabaseConnection db_conn;
@@ -72,6 +90,12 @@ int initDatabase(const char* filename) {
 // Close database connection
 void closeDatabase() {
     if (db_conn.is_connected && db_conn.db) {
+        for (int i = 0; i < db_conn.statement_count; i++) {
+            sqlite3_finalize(db_conn.statements[i].stmt);
+        }
+        db_conn.statement_count = 0;
+        db_conn.next_eviction = 0;
+        
         sqlite3_close(db_conn.db);
         db_conn.is_connected = 0;
         free(db_conn.filename);
@@ -93,10 +117,176 @@ int executeSQL(const char* sql) {
     return 1;
 }
 
+// Get a prepared statement for sql, preparing it on first use
+// The statement is reset with its bindings cleared, and stays owned by the
+// connection: reset it after stepping instead of finalizing it. When the
+// cache is full the statements are replaced in turn.
+sqlite3_stmt* getCachedStatement(const char* sql) {
+    for (int i = 0; i < db_conn.statement_count; i++) {
+        CachedStatement* cached = &db_conn.statements[i];
+        if (cached->sql == sql || strcmp(cached->sql, sql) == 0) {
+            sqlite3_reset(cached->stmt);
+            sqlite3_clear_bindings(cached->stmt);
+            return cached->stmt;
+        }
+    }
+    
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v3(db_conn.db, sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, NULL) != SQLITE_OK) {
+        printf("Failed to prepare statement: %s\n", sqlite3_errmsg(db_conn.db));
+        return NULL;
+    }
+    
+    CachedStatement* slot;
+    if (db_conn.statement_count < MAX_CACHED_STATEMENTS) {
+        slot = &db_conn.statements[db_conn.statement_count++];
+    } else {
+        slot = &db_conn.statements[db_conn.next_eviction];
+        db_conn.next_eviction = (db_conn.next_eviction + 1) % MAX_CACHED_STATEMENTS;
+        sqlite3_finalize(slot->stmt);
+    }
+    
+    slot->sql = sql;
+    slot->stmt = stmt;
+    return stmt;
+}
+
 // =============================================================================
 // TABLE CREATION
 // =============================================================================
 
+// Summary tables behind the sales and inventory reports
+// Triggers keep them current inside the transaction of every write to
+// orders and products, so the reports read a few precomputed rows instead
+// of aggregating the whole orders table.
+const char* report_summary_schema =
+    "CREATE TABLE IF NOT EXISTS sales_summary ("
+    "id INTEGER PRIMARY KEY CHECK (id = 1),"
+    "total_orders INTEGER NOT NULL,"
+    "total_revenue REAL NOT NULL,"
+    "unique_customers INTEGER NOT NULL"
+    ");"
+    // Completed orders per customer; a row exists while the count is positive
+    "CREATE TABLE IF NOT EXISTS sales_customers ("
+    "user_id INTEGER PRIMARY KEY,"
+    "order_count INTEGER NOT NULL"
+    ");"
+    "CREATE TABLE IF NOT EXISTS inventory_summary ("
+    "product_id INTEGER PRIMARY KEY,"
+    "name TEXT,"
+    "stock_quantity INTEGER,"
+    "price REAL,"
+    "total_value REAL NOT NULL"
+    ");"
+    "CREATE INDEX IF NOT EXISTS inventory_summary_value ON inventory_summary (total_value DESC);"
+    "CREATE TABLE IF NOT EXISTS inventory_totals ("
+    "id INTEGER PRIMARY KEY CHECK (id = 1),"
+    "total_value REAL NOT NULL,"
+    "product_count INTEGER NOT NULL"
+    ");"
+    
+    // Completed orders feed the sales summary
+    "CREATE TRIGGER IF NOT EXISTS sales_order_insert AFTER INSERT ON orders "
+    "WHEN NEW.status = 'completed' BEGIN "
+    "UPDATE sales_summary SET total_orders = total_orders + 1, "
+    "total_revenue = total_revenue + NEW.total_price WHERE id = 1;"
+    "INSERT INTO sales_customers (user_id, order_count) VALUES (NEW.user_id, 1) "
+    "ON CONFLICT (user_id) DO UPDATE SET order_count = order_count + 1;"
+    "END;"
+    "CREATE TRIGGER IF NOT EXISTS sales_order_delete AFTER DELETE ON orders "
+    "WHEN OLD.status = 'completed' BEGIN "
+    "UPDATE sales_summary SET total_orders = total_orders - 1, "
+    "total_revenue = total_revenue - OLD.total_price WHERE id = 1;"
+    "UPDATE sales_customers SET order_count = order_count - 1 WHERE user_id = OLD.user_id;"
+    "END;"
+    "CREATE TRIGGER IF NOT EXISTS sales_order_update AFTER UPDATE OF status, total_price, user_id ON orders "
+    "WHEN OLD.status = 'completed' OR NEW.status = 'completed' BEGIN "
+    "UPDATE sales_summary SET "
+    "total_orders = total_orders - (OLD.status = 'completed') + (NEW.status = 'completed'), "
+    "total_revenue = total_revenue "
+    "- CASE WHEN OLD.status = 'completed' THEN OLD.total_price ELSE 0 END "
+    "+ CASE WHEN NEW.status = 'completed' THEN NEW.total_price ELSE 0 END WHERE id = 1;"
+    "UPDATE sales_customers SET order_count = order_count - 1 "
+    "WHERE OLD.status = 'completed' AND user_id = OLD.user_id;"
+    "INSERT INTO sales_customers (user_id, order_count) SELECT NEW.user_id, 1 WHERE NEW.status = 'completed' "
+    "ON CONFLICT (user_id) DO UPDATE SET order_count = order_count + 1;"
+    "END;"
+    
+    // Customers enter and leave the distinct count with their first and last completed order
+    "CREATE TRIGGER IF NOT EXISTS sales_customer_insert AFTER INSERT ON sales_customers BEGIN "
+    "UPDATE sales_summary SET unique_customers = unique_customers + 1 WHERE id = 1;"
+    "END;"
+    "CREATE TRIGGER IF NOT EXISTS sales_customer_update AFTER UPDATE OF order_count ON sales_customers "
+    "WHEN NEW.order_count <= 0 BEGIN "
+    "DELETE FROM sales_customers WHERE user_id = NEW.user_id;"
+    "UPDATE sales_summary SET unique_customers = unique_customers - 1 WHERE id = 1;"
+    "END;"
+    
+    // Every product has an inventory row, and the rows feed the inventory total
+    "CREATE TRIGGER IF NOT EXISTS inventory_product_insert AFTER INSERT ON products BEGIN "
+    "INSERT INTO inventory_summary (product_id, name, stock_quantity, price, total_value) "
+    "VALUES (NEW.id, NEW.name, NEW.stock_quantity, NEW.price, IFNULL(NEW.stock_quantity * NEW.price, 0));"
+    "END;"
+    "CREATE TRIGGER IF NOT EXISTS inventory_product_update AFTER UPDATE OF id, name, stock_quantity, price ON products BEGIN "
+    "UPDATE inventory_summary SET product_id = NEW.id, name = NEW.name, stock_quantity = NEW.stock_quantity, "
+    "price = NEW.price, total_value = IFNULL(NEW.stock_quantity * NEW.price, 0) WHERE product_id = OLD.id;"
+    "END;"
+    "CREATE TRIGGER IF NOT EXISTS inventory_product_delete AFTER DELETE ON products BEGIN "
+    "DELETE FROM inventory_summary WHERE product_id = OLD.id;"
+    "END;"
+    "CREATE TRIGGER IF NOT EXISTS inventory_summary_insert AFTER INSERT ON inventory_summary BEGIN "
+    "UPDATE inventory_totals SET total_value = total_value + NEW.total_value, "
+    "product_count = product_count + 1 WHERE id = 1;"
+    "END;"
+    "CREATE TRIGGER IF NOT EXISTS inventory_summary_update AFTER UPDATE OF total_value ON inventory_summary BEGIN "
+    "UPDATE inventory_totals SET total_value = total_value - OLD.total_value + NEW.total_value WHERE id = 1;"
+    "END;"
+    "CREATE TRIGGER IF NOT EXISTS inventory_summary_delete AFTER DELETE ON inventory_summary BEGIN "
+    "UPDATE inventory_totals SET total_value = total_value - OLD.total_value, "
+    "product_count = product_count - 1 WHERE id = 1;"
+    "END;";
+
+// Recompute the summary tables from orders and products
+// Used when the summaries are first created over existing data, and to
+// repair them after the consistency check finds a difference.
+int rebuildReportSummaries() {
+    const char* sql =
+        "BEGIN TRANSACTION;"
+        "DELETE FROM sales_customers;"
+        "INSERT OR REPLACE INTO sales_summary (id, total_orders, total_revenue, unique_customers) "
+        "SELECT 1, COUNT(*), IFNULL(SUM(total_price), 0), 0 FROM orders WHERE status = 'completed';"
+        "INSERT INTO sales_customers (user_id, order_count) "
+        "SELECT user_id, COUNT(*) FROM orders WHERE status = 'completed' GROUP BY user_id;"
+        "DELETE FROM inventory_summary;"
+        "INSERT OR REPLACE INTO inventory_totals (id, total_value, product_count) VALUES (1, 0, 0);"
+        "INSERT INTO inventory_summary (product_id, name, stock_quantity, price, total_value) "
+        "SELECT id, name, stock_quantity, price, IFNULL(stock_quantity * price, 0) FROM products;"
+        "COMMIT;";
+    
+    if (!executeSQL(sql)) {
+        executeSQL("ROLLBACK");
+        return 0;
+    }
+    return 1;
+}
+
+// Create the report summary tables and their triggers
+// Summaries created over existing orders and products are filled in once.
+int createReportSummaries() {
+    if (!executeSQL(report_summary_schema)) return 0;
+    
+    sqlite3_stmt* stmt;
+    int populated = 0;
+    if (sqlite3_prepare_v2(db_conn.db, "SELECT COUNT(*) FROM sales_summary", -1, &stmt, NULL) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            populated = sqlite3_column_int(stmt, 0) > 0;
+        }
+        sqlite3_finalize(stmt);
+    }
+    
+    return populated || rebuildReportSummaries();
+}
+
 int createTables() {
     const char* create_users_table = 
         "CREATE TABLE IF NOT EXISTS users ("
@@ -146,6 +336,7 @@ int createTables() {
     if (!executeSQL(create_categories_table)) return 0;
     if (!executeSQL(create_products_table)) return 0;
     if (!executeSQL(create_orders_table)) return 0;
+    if (!createReportSummaries()) return 0;
     
     printf("All tables created successfully\n");
     return 1;
@@ -157,11 +348,8 @@ int createTables() {
 
 // Insert new user
 int insertUser(const char* username, const char* email, const char* password_hash) {
-    sqlite3_stmt* stmt;
-    const char* sql = "INSERT INTO users (username, email, password_hash, created_at) VALUES (?, ?, ?, ?)";
-    
-    if (sqlite3_prepare_v2(db_conn.db, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        printf("Failed to prepare statement: %s\n", sqlite3_errmsg(db_conn.db));
+    sqlite3_stmt* stmt = getCachedStatement(INSERT_USER_SQL);
+    if (!stmt) {
         return 0;
     }
     
@@ -173,7 +361,7 @@ int insertUser(const char* username, const char* email, const char* password_has
     sqlite3_bind_int(stmt, 4, (int)now);
     
     int result = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
     
     if (result != SQLITE_DONE) {
         printf("Failed to insert user: %s\n", sqlite3_errmsg(db_conn.db));
@@ -266,11 +454,8 @@ int deleteUser(int user_id) {
 
 // Insert new product
 int insertProduct(const char* name, const char* description, double price, int stock_quantity, int category_id) {
-    sqlite3_stmt* stmt;
-    const char* sql = "INSERT INTO products (name, description, price, stock_quantity, category_id, created_at) VALUES (?, ?, ?, ?, ?, ?)";
-    
-    if (sqlite3_prepare_v2(db_conn.db, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        printf("Failed to prepare statement: %s\n", sqlite3_errmsg(db_conn.db));
+    sqlite3_stmt* stmt = getCachedStatement(INSERT_PRODUCT_SQL);
+    if (!stmt) {
         return 0;
     }
     
@@ -284,7 +469,7 @@ int insertProduct(const char* name, const char* description, double price, int s
     sqlite3_bind_int(stmt, 6, (int)now);
     
     int result = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
     
     if (result != SQLITE_DONE) {
         printf("Failed to insert product: %s\n", sqlite3_errmsg(db_conn.db));
@@ -355,11 +540,8 @@ int updateProductStock(int product_id, int new_quantity) {
 
 // Create new order
 int createOrder(int user_id, int product_id, int quantity, double unit_price) {
-    sqlite3_stmt* stmt;
-    const char* sql = "INSERT INTO orders (user_id, product_id, quantity, unit_price, total_price, created_at) VALUES (?, ?, ?, ?, ?, ?)";
-    
-    if (sqlite3_prepare_v2(db_conn.db, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        printf("Failed to prepare statement: %s\n", sqlite3_errmsg(db_conn.db));
+    sqlite3_stmt* stmt = getCachedStatement(INSERT_ORDER_SQL);
+    if (!stmt) {
         return 0;
     }
     
@@ -374,7 +556,7 @@ int createOrder(int user_id, int product_id, int quantity, double unit_price) {
     sqlite3_bind_int(stmt, 6, (int)now);
     
     int result = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
     
     if (result != SQLITE_DONE) {
         printf("Failed to create order: %s\n", sqlite3_errmsg(db_conn.db));
@@ -409,10 +591,10 @@ void getUserOrders(int user_id) {
         double unit_price = sqlite3_column_double(stmt, 3);
         double total_price = sqlite3_column_double(stmt, 4);
         const char* status = (const char*)sqlite3_column_text(stmt, 5);
-        int created_at = sqlite3_column_int(stmt, 6);
+        time_t created_at = (time_t)sqlite3_column_int64(stmt, 6);
         
         char date_str[20];
-        strftime(date_str, sizeof(date_str), "%Y-%m-%d", localtime((time_t*)&created_at));
+        strftime(date_str, sizeof(date_str), "%Y-%m-%d", localtime(&created_at));
         
         printf("%-5d %-20s %-8d $%-9.2f $%-9.2f %-10s %-20s\n", 
                id, product_name, quantity, unit_price, total_price, status, date_str);
@@ -506,41 +688,59 @@ int processOrderWithTransaction(int user_id, int product_id, int quantity) {
     return 1;
 }
 
-// Reporting functions
-void generateSalesReport() {
-    sqlite3_stmt* stmt;
-    const char* sql = "SELECT COUNT(*) as total_orders, "
-                      "SUM(total_price) as total_revenue, "
-                      "COUNT(DISTINCT user_id) as unique_customers "
-                      "FROM orders WHERE status = 'completed'";
+// Sales report figures over completed orders
+typedef struct {
+    int total_orders;
+    double total_revenue;
+    int unique_customers;
+} SalesTotals;
+
+// Fill totals from the first row of a query with the three figures
+int readSalesTotals(const char* sql, SalesTotals* totals) {
+    sqlite3_stmt* stmt = getCachedStatement(sql);
+    if (!stmt) {
+        return 0;
+    }
     
-    if (sqlite3_prepare_v2(db_conn.db, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        printf("Failed to prepare statement: %s\n", sqlite3_errmsg(db_conn.db));
-        return;
+    int found = sqlite3_step(stmt) == SQLITE_ROW;
+    if (found) {
+        totals->total_orders = sqlite3_column_int(stmt, 0);
+        totals->total_revenue = sqlite3_column_double(stmt, 1);
+        totals->unique_customers = sqlite3_column_int(stmt, 2);
     }
     
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        int total_orders = sqlite3_column_int(stmt, 0);
-        double total_revenue = sqlite3_column_double(stmt, 1);
-        int unique_customers = sqlite3_column_int(stmt, 2);
-        
+    sqlite3_reset(stmt);
+    return found;
+}
+
+// Aggregate the sales figures over the whole orders table
+int computeSalesTotals(SalesTotals* totals) {
+    return readSalesTotals("SELECT COUNT(*), SUM(total_price), COUNT(DISTINCT user_id) "
+                           "FROM orders WHERE status = 'completed'", totals);
+}
+
+// Read the precomputed sales figures
+int readSalesSummary(SalesTotals* totals) {
+    return readSalesTotals("SELECT total_orders, total_revenue, unique_customers FROM sales_summary WHERE id = 1",
+                           totals);
+}
+
+// Reporting functions
+void generateSalesReport() {
+    SalesTotals totals;
+    
+    if (readSalesSummary(&totals)) {
         printf("=== SALES REPORT ===\n");
-        printf("Total Orders: %d\n", total_orders);
-        printf("Total Revenue: $%.2f\n", total_revenue);
-        printf("Unique Customers: %d\n", unique_customers);
+        printf("Total Orders: %d\n", totals.total_orders);
+        printf("Total Revenue: $%.2f\n", totals.total_revenue);
+        printf("Unique Customers: %d\n", totals.unique_customers);
     }
-    
-    sqlite3_finalize(stmt);
 }
 
 void generateInventoryReport() {
-    sqlite3_stmt* stmt;
-    const char* sql = "SELECT p.name, p.stock_quantity, p.price, "
-                      "(p.stock_quantity * p.price) as total_value "
-                      "FROM products p ORDER BY total_value DESC";
-    
-    if (sqlite3_prepare_v2(db_conn.db, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        printf("Failed to prepare statement: %s\n", sqlite3_errmsg(db_conn.db));
+    sqlite3_stmt* stmt = getCachedStatement("SELECT name, stock_quantity, price, total_value "
+                                            "FROM inventory_summary ORDER BY total_value DESC");
+    if (!stmt) {
         return;
     }
     
@@ -548,8 +748,6 @@ void generateInventoryReport() {
     printf("%-20s %-10s %-10s %-12s\n", "Product", "Stock", "Price", "Total Value");
     printf("------------------------------------------------\n");
     
-    double total_inventory_value = 0;
-    
     while (sqlite3_step(stmt) == SQLITE_ROW) {
         const char* name = (const char*)sqlite3_column_text(stmt, 0);
         int stock = sqlite3_column_int(stmt, 1);
@@ -557,13 +755,332 @@ void generateInventoryReport() {
         double total_value = sqlite3_column_double(stmt, 3);
         
         printf("%-20s %-10d $%-9.2f $%-11.2f\n", name, stock, price, total_value);
-        total_inventory_value += total_value;
     }
+    sqlite3_reset(stmt);
     
-    printf("------------------------------------------------\n");
-    printf("Total Inventory Value: $%.2f\n", total_inventory_value);
+    stmt = getCachedStatement("SELECT total_value FROM inventory_totals WHERE id = 1");
+    if (stmt && sqlite3_step(stmt) == SQLITE_ROW) {
+        printf("------------------------------------------------\n");
+        printf("Total Inventory Value: $%.2f\n", sqlite3_column_double(stmt, 0));
+    }
+    if (stmt) sqlite3_reset(stmt);
+}
+
+// Do two money totals agree? Summaries add and subtract each order, so
+// they may drift from a fresh SUM() by rounding error.
+int sameAmount(double a, double b) {
+    double scale = fabs(a) > fabs(b) ? fabs(a) : fabs(b);
+    return fabs(a - b) <= 0.005 + scale * 1e-12;
+}
+
+// Count the rows a mismatch query returns
+int countMismatches(const char* sql) {
+    sqlite3_stmt* stmt;
+    int count = 0;
+    
+    if (sqlite3_prepare_v2(db_conn.db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        printf("Failed to prepare statement: %s\n", sqlite3_errmsg(db_conn.db));
+        return 1;
+    }
+    
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        count++;
+    }
     
     sqlite3_finalize(stmt);
+    return count;
+}
+
+// Compare the report summaries with a full recompute
+// Prints each difference and returns how many were found; 0 means the
+// reports match what the full aggregate queries would show.
+int checkReportConsistency() {
+    int mismatches = 0;
+    SalesTotals live, summary;
+    
+    if (!computeSalesTotals(&live) || !readSalesSummary(&summary)) {
+        printf("Sales summary missing\n");
+        return 1;
+    }
+    
+    if (live.total_orders != summary.total_orders) {
+        printf("Completed orders: summary %d, recomputed %d\n", summary.total_orders, live.total_orders);
+        mismatches++;
+    }
+    if (!sameAmount(live.total_revenue, summary.total_revenue)) {
+        printf("Revenue: summary $%.2f, recomputed $%.2f\n", summary.total_revenue, live.total_revenue);
+        mismatches++;
+    }
+    if (live.unique_customers != summary.unique_customers) {
+        printf("Unique customers: summary %d, recomputed %d\n", summary.unique_customers, live.unique_customers);
+        mismatches++;
+    }
+    
+    // Per-customer counts, in both directions
+    int customers = countMismatches(
+        "SELECT * FROM (SELECT user_id, COUNT(*) FROM orders WHERE status = 'completed' GROUP BY user_id "
+        "EXCEPT SELECT user_id, order_count FROM sales_customers) "
+        "UNION ALL SELECT * FROM (SELECT user_id, order_count FROM sales_customers "
+        "EXCEPT SELECT user_id, COUNT(*) FROM orders WHERE status = 'completed' GROUP BY user_id)");
+    if (customers > 0) {
+        printf("Customer order counts: %d rows differ\n", customers);
+        mismatches += customers;
+    }
+    
+    // Product rows missing on either side or differing
+    int products = countMismatches(
+        "SELECT p.id FROM products p LEFT JOIN inventory_summary s ON s.product_id = p.id "
+        "WHERE s.product_id IS NULL OR s.name IS NOT p.name OR s.stock_quantity IS NOT p.stock_quantity "
+        "OR s.price IS NOT p.price OR abs(s.total_value - IFNULL(p.stock_quantity * p.price, 0)) > 0.005 "
+        "UNION ALL SELECT s.product_id FROM inventory_summary s LEFT JOIN products p ON p.id = s.product_id "
+        "WHERE p.id IS NULL");
+    if (products > 0) {
+        printf("Inventory rows: %d products differ\n", products);
+        mismatches += products;
+    }
+    
+    int totals = countMismatches(
+        "SELECT 1 FROM inventory_totals t WHERE t.id = 1 AND (t.product_count != (SELECT COUNT(*) FROM products) "
+        "OR abs(t.total_value - (SELECT IFNULL(SUM(stock_quantity * price), 0) FROM products)) > "
+        "0.005 + abs(t.total_value) * 1e-12)");
+    if (totals > 0) {
+        printf("Inventory total differs\n");
+        mismatches += totals;
+    }
+    
+    return mismatches;
+}
+
+// =============================================================================
+// BULK INGEST
+// =============================================================================
+
+// Journal, sync and batching settings for a bulk load
+typedef struct {
+    int use_wal;             // journal_mode=WAL instead of the rollback journal
+    const char* synchronous; // "OFF", "NORMAL" or "FULL"
+    int batch_size;          // Rows per transaction; 1 commits every row
+} IngestOptions;
+
+// Counts from a bulk load
+typedef struct {
+    long rows_inserted;
+    long rows_rejected;      // Malformed lines and rows the database refused
+    int transactions;
+    double seconds;
+} IngestStats;
+
+// Bulk load in progress
+typedef struct {
+    IngestOptions options;
+    IngestStats stats;
+    int rows_in_batch;       // Rows in the open transaction
+    struct timespec started;
+} BulkIngest;
+
+// Set the journal mode and sync level of the connection
+// WAL appends commits to a log instead of rewriting pages through a
+// rollback journal, and synchronous=NORMAL then syncs only at checkpoints.
+int configureJournal(int use_wal, const char* synchronous) {
+    const char* modes[] = {"OFF", "NORMAL", "FULL"};
+    const char* mode = NULL;
+    
+    for (int i = 0; i < 3; i++) {
+        if (synchronous && strcmp(synchronous, modes[i]) == 0) {
+            mode = modes[i];
+        }
+    }
+    if (!mode) {
+        printf("Unknown synchronous mode: %s\n", synchronous ? synchronous : "(null)");
+        return 0;
+    }
+    
+    char sql[64];
+    snprintf(sql, sizeof(sql), "PRAGMA synchronous = %s", mode);
+    
+    if (!executeSQL(use_wal ? "PRAGMA journal_mode = WAL" : "PRAGMA journal_mode = DELETE")) return 0;
+    if (!executeSQL(sql)) return 0;
+    return 1;
+}
+
+// Start a bulk load with the given options
+int beginBulkIngest(BulkIngest* ingest, const IngestOptions* options) {
+    memset(ingest, 0, sizeof(BulkIngest));
+    ingest->options = *options;
+    if (ingest->options.batch_size < 1) {
+        ingest->options.batch_size = 1;
+    }
+    
+    if (!configureJournal(options->use_wal, options->synchronous)) {
+        return 0;
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &ingest->started);
+    return 1;
+}
+
+// Commit the open batch, if any
+int commitBulkBatch(BulkIngest* ingest) {
+    if (ingest->rows_in_batch == 0) {
+        return 1;
+    }
+    
+    if (!executeSQL("COMMIT")) {
+        executeSQL("ROLLBACK");
+        ingest->stats.rows_inserted -= ingest->rows_in_batch;
+        ingest->stats.rows_rejected += ingest->rows_in_batch;
+        ingest->rows_in_batch = 0;
+        return 0;
+    }
+    
+    ingest->stats.transactions++;
+    ingest->rows_in_batch = 0;
+    return 1;
+}
+
+// Add one order to a bulk load
+// Rows join the open transaction, which commits every batch_size rows. A
+// refused row is counted and skipped; if the error also ended the
+// transaction, the rows of the batch before it are counted as rejected too.
+int bulkInsertOrder(BulkIngest* ingest, int user_id, int product_id, int quantity, double unit_price,
+                    const char* status, int created_at) {
+    sqlite3_stmt* stmt = getCachedStatement(BULK_ORDER_SQL);
+    if (!stmt) {
+        ingest->stats.rows_rejected++;
+        return 0;
+    }
+    
+    if (ingest->rows_in_batch == 0 && !executeSQL("BEGIN TRANSACTION")) {
+        ingest->stats.rows_rejected++;
+        return 0;
+    }
+    
+    sqlite3_bind_int(stmt, 1, user_id);
+    sqlite3_bind_int(stmt, 2, product_id);
+    sqlite3_bind_int(stmt, 3, quantity);
+    sqlite3_bind_double(stmt, 4, unit_price);
+    sqlite3_bind_double(stmt, 5, quantity * unit_price);
+    sqlite3_bind_text(stmt, 6, status, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 7, created_at);
+    
+    int result = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    
+    if (result != SQLITE_DONE) {
+        ingest->stats.rows_rejected++;
+        if (sqlite3_get_autocommit(db_conn.db)) {
+            ingest->stats.rows_inserted -= ingest->rows_in_batch;
+            ingest->stats.rows_rejected += ingest->rows_in_batch;
+            ingest->rows_in_batch = 0;
+        } else if (ingest->rows_in_batch == 0) {
+            executeSQL("ROLLBACK"); // Nothing else is in the transaction
+        }
+        return 0;
+    }
+    
+    ingest->stats.rows_inserted++;
+    if (++ingest->rows_in_batch >= ingest->options.batch_size) {
+        return commitBulkBatch(ingest);
+    }
+    return 1;
+}
+
+// Commit the last batch and fill in the load's statistics
+int endBulkIngest(BulkIngest* ingest, IngestStats* stats) {
+    int result = commitBulkBatch(ingest);
+    
+    struct timespec finished;
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+    ingest->stats.seconds = (finished.tv_sec - ingest->started.tv_sec) +
+                            (finished.tv_nsec - ingest->started.tv_nsec) / 1e9;
+    
+    if (stats) {
+        *stats = ingest->stats;
+    }
+    return result;
+}
+
+// Parse one CSV line of an order: user_id,product_id,quantity,unit_price
+// with optional status and created_at fields after them
+int parseOrderLine(char* line, int* user_id, int* product_id, int* quantity, double* unit_price,
+                   const char** status, int* created_at) {
+    char* fields[6];
+    int count = 0;
+    
+    line[strcspn(line, "\r\n")] = '\0';
+    for (char* field = line; count < 6; count++) {
+        fields[count] = field;
+        char* comma = strchr(field, ',');
+        if (!comma) {
+            count++;
+            break;
+        }
+        *comma = '\0';
+        field = comma + 1;
+    }
+    
+    if (count < 4) {
+        return 0;
+    }
+    
+    char* end;
+    long values[3];
+    for (int i = 0; i < 3; i++) {
+        values[i] = strtol(fields[i], &end, 10);
+        if (end == fields[i] || *end != '\0') return 0;
+    }
+    *user_id = (int)values[0];
+    *product_id = (int)values[1];
+    *quantity = (int)values[2];
+    
+    *unit_price = strtod(fields[3], &end);
+    if (end == fields[3] || *end != '\0') return 0;
+    
+    *status = count > 4 && fields[4][0] ? fields[4] : "pending";
+    *created_at = (int)time(NULL);
+    if (count > 5) {
+        *created_at = (int)strtol(fields[5], &end, 10);
+        if (end == fields[5] || *end != '\0') return 0;
+    }
+    
+    return 1;
+}
+
+// Stream orders from a CSV source into the orders table
+// Lines are read one at a time, so memory use does not depend on the size
+// of the source. A first line that does not parse is taken as a header.
+// Returns the number of rows inserted, or -1 if the load could not start.
+long importOrdersCSV(FILE* source, const IngestOptions* options, IngestStats* stats) {
+    BulkIngest ingest;
+    if (!beginBulkIngest(&ingest, options)) {
+        return -1;
+    }
+    
+    char line[1024];
+    long line_number = 0;
+    
+    while (fgets(line, sizeof(line), source)) {
+        line_number++;
+        if (line[strspn(line, "\r\n")] == '\0') {
+            continue; // Blank line
+        }
+        
+        int user_id, product_id, quantity, created_at;
+        double unit_price;
+        const char* status;
+        
+        if (!parseOrderLine(line, &user_id, &product_id, &quantity, &unit_price, &status, &created_at)) {
+            if (line_number > 1) {
+                ingest.stats.rows_rejected++;
+            }
+            continue;
+        }
+        
+        bulkInsertOrder(&ingest, user_id, product_id, quantity, unit_price, status, created_at);
+    }
+    
+    endBulkIngest(&ingest, stats);
+    return ingest.stats.rows_inserted;
 }
 
 // =============================================================================
@@ -645,6 +1162,186 @@ void demonstrateReporting() {
     generateSalesReport();
     printf("\n");
     generateInventoryReport();
+    printf("\n");
+    
+    int mismatches = checkReportConsistency();
+    printf("Summary check: %s (%d differences)\n", mismatches == 0 ? "consistent" : "INCONSISTENT", mismatches);
+    
+    printf("\n");
+}
+
+// Write a CSV of random orders: a header, then one order per line
+int writeSampleOrdersCSV(const char* path, int rows) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        printf("Cannot create %s\n", path);
+        return 0;
+    }
+    
+    const char* statuses[] = {"pending", "shipped", "completed"};
+    fprintf(file, "user_id,product_id,quantity,unit_price,status,created_at\n");
+    for (int i = 0; i < rows; i++) {
+        fprintf(file, "%d,%d,%d,%.2f,%s,%d\n", 1 + rand() % 1000, 1 + rand() % 200, 1 + rand() % 5,
+                (rand() % 100000) / 100.0, statuses[rand() % 3], 1700000000 + i);
+    }
+    
+    fclose(file);
+    return 1;
+}
+
+void demonstrateBulkIngest() {
+    printf("=== BULK INGEST DEMO ===\n");
+    
+    // Load into a scratch database so the demo data above stays as it is
+    const char* files[] = {"bulk_ingest.db", "bulk_ingest.db-wal", "bulk_ingest.db-shm", "orders_import.csv"};
+    closeDatabase();
+    for (int i = 0; i < 4; i++) {
+        remove(files[i]);
+    }
+    
+    if (!initDatabase("bulk_ingest.db") || !createTables()) {
+        closeDatabase();
+        initDatabase("ecommerce.db");
+        return;
+    }
+    
+    struct {
+        const char* label;
+        int use_wal;
+        const char* synchronous;
+    } modes[] = {
+        {"rollback journal, FULL", 0, "FULL"},
+        {"WAL, NORMAL", 1, "NORMAL"}
+    };
+    const int batch_sizes[] = {1, 10, 100, 1000, 10000};
+    
+    printf("%-24s %8s %8s %8s %10s %12s\n", "Journal, synchronous", "Batch", "Rows", "Commits", "Seconds", "Rows/sec");
+    printf("--------------------------------------------------------------------------\n");
+    
+    for (int m = 0; m < 2; m++) {
+        for (int b = 0; b < 5; b++) {
+            // Small batches commit (and sync) so often that fewer rows suffice
+            int rows = batch_sizes[b] < 100 ? 2000 : 50000;
+            if (!writeSampleOrdersCSV(files[3], rows)) break;
+            executeSQL("DELETE FROM orders");
+            
+            IngestOptions options = {modes[m].use_wal, modes[m].synchronous, batch_sizes[b]};
+            IngestStats stats;
+            FILE* source = fopen(files[3], "r");
+            if (!source || importOrdersCSV(source, &options, &stats) < 0) {
+                if (source) fclose(source);
+                break;
+            }
+            fclose(source);
+            
+            printf("%-24s %8d %8ld %8d %10.3f %12.0f\n", modes[m].label, batch_sizes[b], stats.rows_inserted,
+                   stats.transactions, stats.seconds, stats.rows_inserted / stats.seconds);
+            if (stats.rows_rejected > 0) {
+                printf("  %ld rows rejected\n", stats.rows_rejected);
+            }
+        }
+    }
+    
+    closeDatabase();
+    for (int i = 0; i < 4; i++) {
+        remove(files[i]);
+    }
+    initDatabase("ecommerce.db");
+    
+    printf("\n");
+}
+
+// Average milliseconds to run a query and read all of its rows
+double timeReportQuery(const char* sql, int repeats) {
+    sqlite3_stmt* stmt;
+    struct timespec started, finished;
+    
+    if (sqlite3_prepare_v2(db_conn.db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        printf("Failed to prepare statement: %s\n", sqlite3_errmsg(db_conn.db));
+        return -1;
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    for (int i = 0; i < repeats; i++) {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+        }
+        sqlite3_reset(stmt);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+    
+    sqlite3_finalize(stmt);
+    return ((finished.tv_sec - started.tv_sec) * 1e3 + (finished.tv_nsec - started.tv_nsec) / 1e6) / repeats;
+}
+
+void demonstrateReportBenchmark() {
+    printf("=== REPORT BENCHMARK ===\n");
+    
+    // The reports as full aggregate queries, for comparison with the summaries
+    const char* full_sales = "SELECT COUNT(*), SUM(total_price), COUNT(DISTINCT user_id) "
+                             "FROM orders WHERE status = 'completed'";
+    const char* full_inventory = "SELECT name, stock_quantity, price, stock_quantity * price AS total_value "
+                                 "FROM products ORDER BY total_value DESC";
+    const char* summary_sales = "SELECT total_orders, total_revenue, unique_customers FROM sales_summary WHERE id = 1";
+    const char* summary_inventory = "SELECT name, stock_quantity, price, total_value "
+                                    "FROM inventory_summary ORDER BY total_value DESC";
+    
+    const char* files[] = {"report_bench.db", "report_bench.db-wal", "report_bench.db-shm"};
+    closeDatabase();
+    for (int i = 0; i < 3; i++) {
+        remove(files[i]);
+    }
+    
+    if (!initDatabase("report_bench.db") || !createTables() ||
+        !executeSQL("WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 200) "
+                    "INSERT INTO products (name, price, stock_quantity, created_at) "
+                    "SELECT 'Product ' || i, (i * 37 % 1000) + 0.99, i * 13 % 500, 1700000000 FROM n")) {
+        closeDatabase();
+        initDatabase("ecommerce.db");
+        return;
+    }
+    
+    const int stages[] = {1000, 10000, 100000, 500000};
+    const char* statuses[] = {"pending", "shipped", "completed"};
+    IngestOptions options = {1, "NORMAL", 10000};
+    int orders = 0;
+    
+    printf("%8s %12s %12s %12s %12s %12s %8s\n", "Orders", "Ingest/sec", "Sales full", "Sales sum",
+           "Stock full", "Stock sum", "Diffs");
+    printf("----------------------------------------------------------------------------------\n");
+    
+    for (int s = 0; s < 4; s++) {
+        BulkIngest ingest;
+        IngestStats stats;
+        
+        if (!beginBulkIngest(&ingest, &options)) break;
+        while (orders < stages[s]) {
+            bulkInsertOrder(&ingest, 1 + rand() % 1000, 1 + rand() % 200, 1 + rand() % 5,
+                            (rand() % 100000) / 100.0, statuses[rand() % 3], 1700000000 + orders);
+            orders++;
+        }
+        if (!endBulkIngest(&ingest, &stats)) break;
+        
+        // Status changes, cancellations and restocks go through the triggers too
+        executeSQL("BEGIN TRANSACTION");
+        executeSQL("UPDATE orders SET status = 'completed' WHERE id % 97 = 0");
+        executeSQL("UPDATE orders SET status = 'cancelled' WHERE id % 89 = 0");
+        executeSQL("UPDATE orders SET total_price = total_price + 1 WHERE id % 83 = 0");
+        executeSQL("DELETE FROM orders WHERE id % 101 = 0");
+        executeSQL("UPDATE products SET stock_quantity = stock_quantity + 5 WHERE id % 7 = 0");
+        executeSQL("COMMIT");
+        
+        int repeats = orders < 100000 ? 50 : 5;
+        printf("%8d %12.0f %10.3fms %10.3fms %10.3fms %10.3fms %8d\n", orders, stats.rows_inserted / stats.seconds,
+               timeReportQuery(full_sales, repeats), timeReportQuery(summary_sales, repeats),
+               timeReportQuery(full_inventory, repeats), timeReportQuery(summary_inventory, repeats),
+               checkReportConsistency());
+    }
+    
+    closeDatabase();
+    for (int i = 0; i < 3; i++) {
+        remove(files[i]);
+    }
+    initDatabase("ecommerce.db");
     
     printf("\n");
 }
@@ -674,6 +1371,8 @@ int main() {
     demonstrateOrderManagement();
     demonstrateTransactions();
     demonstrateReporting();
+    demonstrateBulkIngest();
+    demonstrateReportBenchmark();
     
     // Close database
     closeDatabase();
@@ -1,13 +1,23 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
+#include <strings.h>
+#include <limits.h>
+#include <math.h>
+#include <stdarg.h>
 #include <time.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <pthread.h>
+#include <sched.h>
 #include <sqlite3.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 // =============================================================================
 // ADVANCED DATABASE PROGRAMMING
 // =============================================================================
@@ -18,7 +28,11 @@
 #define MAX_QUERY_SIZE 2048
 #define MAX_FIELD_SIZE 256
 #define MAX_INDEXES 20
-#define MAX_TRANSACTIONS 10
+#define MAX_TRANSACTIONS 64
+#define MAX_CONNECTIONS 100
+#define PAGE_DATA_SIZE 4096
+#define HISTOGRAM_BUCKETS 32
+#define VECTOR_SIZE 1024
 
 // =============================================================================
 // DATABASE ENGINE CORE
@@ -46,6 +60,90 @@ typedef struct {
     char default_value[MAX_FIELD_SIZE];
 } Column;
 
+// Column statistics collected by analyzeTable()
+typedef struct {
+    int distinct_count;
+    int has_histogram;
+    double histogram[HISTOGRAM_BUCKETS + 1]; // Equi-depth bucket bounds
+    double correlation; // Value order vs physical row order, -1..1
+} ColumnStatistics;
+
+// Table statistics used by the query planner
+typedef struct {
+    int analyzed;
+    int row_count;
+    int page_count;
+    ColumnStatistics columns[MAX_COLUMNS];
+} TableStatistics;
+
+// Row identifier: ordinal position of a row in its table's heap pages
+typedef int RowId;
+
+// Commit timestamps order row versions. A version written by a transaction
+// that has not committed yet carries TIMESTAMP_TRANSACTION_FLAG plus the
+// writer's transaction id in place of its begin timestamp.
+typedef unsigned long long Timestamp;
+#define TIMESTAMP_FROZEN 0ULL                 // begin: visible to every snapshot
+#define TIMESTAMP_DEAD 0ULL                   // end: visible to no snapshot
+#define TIMESTAMP_INFINITY ((1ULL << 63) - 1) // end: not superseded yet
+#define TIMESTAMP_TRANSACTION_FLAG (1ULL << 63)
+
+// Lifetime of one row version: visible to snapshots in [begin, end)
+// Each heap row is one version; an UPDATE appends a new version and ends the
+// old one. Both fields are read without locks.
+typedef struct {
+    Timestamp begin;
+    Timestamp end;
+} RowVersion;
+
+// Row versions live in fixed-size chunks that never move
+#define VERSION_CHUNK_ROWS 65536
+#define MAX_VERSION_CHUNKS 1024
+
+// Version chunk plus a flag per VECTOR_SIZE batch, set once any version in
+// the batch is stamped as anything but frozen and live. Untouched batches,
+// such as bulk-loaded ones, are visible to every snapshot as a whole.
+typedef struct {
+    RowVersion versions[VERSION_CHUNK_ROWS];
+    int modified[VERSION_CHUNK_ROWS / VECTOR_SIZE];
+} VersionChunk;
+
+// One column of a column store: fixed-width values in row id order
+typedef struct {
+    int width;                 // Bytes per value (columnStorageSize)
+    unsigned char* values;     // capacity * width bytes
+    unsigned long long* nulls; // Bit set when the row's value is NULL
+} ColumnVector;
+
+// Optional columnar copy of a table, kept in step with its heap
+typedef struct ColumnStore {
+    ColumnVector columns[MAX_COLUMNS];
+    int* record_ids;
+    int row_count;
+    int capacity;
+    pthread_rwlock_t latch; // Readers hold it per batch, appends exclusively
+} ColumnStore;
+
+// Rows of one column-store batch that passed the WHERE conditions
+typedef struct {
+    unsigned short positions[VECTOR_SIZE]; // Offsets from the batch start
+    int count;
+} SelectionVector;
+
+// Index structure: a B+tree whose nodes are index pages in the storage file
+typedef struct {
+    char name[MAX_FIELD_SIZE];
+    int column_index;
+    int is_unique;
+    DataType key_type;
+    int key_size;
+    int root_page_id;
+    int height;
+    int key_count;
+    int page_count;
+    struct StorageManager* storage;
+} Index;
+
 // Table definition
 typedef struct {
     char name[MAX_FIELD_SIZE];
@@ -54,8 +152,26 @@ typedef struct {
     int record_count;
     int next_record_id;
     int primary_key_column;
-    int indexes[MAX_INDEXES];
+    int table_id;              // Position in Database.tables; log records use it
+    Index indexes[MAX_INDEXES];
     int index_count;
+    struct StorageManager* storage;
+    int column_offsets[MAX_COLUMNS];
+    int row_size;
+    int rows_per_page;
+    int* heap_pages;           // Replaced, never resized, while readers run
+    int heap_page_count;
+    int heap_page_capacity;
+    int heap_row_count;        // Rows visible to scans; published last
+    int* retired_heap_pages[32]; // Outgrown directories, freed with the table
+    int retired_count;
+    VersionChunk* version_chunks[MAX_VERSION_CHUNKS];
+    RowId* free_rows;          // Reclaimed row slots reused by new versions
+    int free_row_count;
+    int free_row_capacity;
+    TableStatistics statistics;
+    ColumnStore* column_store; // NULL unless enableColumnStore() was called
+    int schema_version;        // Bumped by createIndex(), enableColumnStore() and analyzeTable()
 } Table;
 
 // Record structure
@@ -67,16 +183,6 @@ typedef struct {
     time_t updated_at;
 } Record;
 
-// Index structure
-typedef struct {
-    char name[MAX_FIELD_SIZE];
-    int column_index;
-    int is_unique;
-    char* keys[MAX_RECORDS];
-    int record_ids[MAX_RECORDS];
-    int key_count;
-} Index;
-
 // =============================================================================
 // QUERY PROCESSOR
 // =============================================================================
@@ -115,8 +221,19 @@ typedef struct {
     int is_field_reference;
     int left_condition;
     int right_condition;
+    char column_name[MAX_FIELD_SIZE];
+    DataType value_type;
+    int value_size;
+    unsigned char encoded_value[MAX_FIELD_SIZE];
+    int join_side; // JOIN: 1 if column_index is a column of the joined table
 } WhereCondition;
 
+// Consistent view of the database a statement reads
+typedef struct {
+    Timestamp read_ts;               // Sees versions committed at or before this
+    struct Transaction* transaction; // Also sees this transaction's own writes
+} Snapshot;
+
 // Query structure
 typedef struct {
     QueryType type;
@@ -129,8 +246,28 @@ typedef struct {
     int offset;
     char sort_column[MAX_FIELD_SIZE];
     int sort_ascending;
+    int use_indexes; // USE_INDEXES_NEVER, USE_INDEXES_COST or USE_INDEXES_ALWAYS
+    int use_column_store; // Let the planner scan the table's column store
+    int transaction_id; // 0 runs the statement as its own transaction
+    Snapshot snapshot;  // Taken when the statement starts
+    char join_table[MAX_FIELD_SIZE];      // JOIN: the second table; empty for one table
+    char join_columns[2][MAX_FIELD_SIZE]; // JOIN ... ON join_columns[0] = join_columns[1]
+    int join_method;    // JOIN_METHOD_COST, JOIN_METHOD_HASH or JOIN_METHOD_MERGE
+    size_t work_memory; // Bytes a hash join or sort may hold before it spills to disk
 } Query;
 
+// Index usage hints for Query.use_indexes
+#define USE_INDEXES_NEVER 0   // Always scan the heap
+#define USE_INDEXES_COST 1    // Let the planner choose by cost
+#define USE_INDEXES_ALWAYS 2  // Prefer any usable index
+
+// Join algorithm hints for Query.join_method
+#define JOIN_METHOD_COST 0  // Let the planner choose by cost
+#define JOIN_METHOD_HASH 1
+#define JOIN_METHOD_MERGE 2
+
+#define DEFAULT_WORK_MEMORY (4 * 1024 * 1024)
+
 // =============================================================================
 // TRANSACTION MANAGEMENT
 // =============================================================================
@@ -143,23 +280,54 @@ typedef enum {
     TRANSACTION_ABORTED = 3
 } TransactionState;
 
-// Transaction structure
+// One row version created or ended by a transaction
 typedef struct {
+    Table* table;
+    RowId row_id;
+    int superseded; // 1 = an existing version this transaction ends
+} WriteEntry;
+
+// Transaction structure
+// The write set is all a transaction keeps: commit stamps its versions and
+// rollback marks the ones it created dead.
+typedef struct Transaction {
     int transaction_id;
     TransactionState state;
     time_t start_time;
-    Table* modified_tables[MAX_TABLES];
-    int modified_table_count;
-    char* before_images[MAX_TABLES][MAX_RECORDS];
-    char* after_images[MAX_TABLES][MAX_RECORDS];
-    int record_counts[MAX_TABLES];
+    Timestamp read_ts;
+    WriteEntry* writes;
+    int write_count;
+    int write_capacity;
+    WriteEntry* superseded;    // Open-addressing set of the versions it ended
+    int superseded_count;
+    int superseded_capacity;
 } Transaction;
 
+// Ended row version waiting for garbage collection
+typedef struct {
+    Table* table;
+    RowId row_id;
+    Timestamp end;
+} GarbageVersion;
+
+// Garbage is collected after this many commits
+#define GC_COMMIT_INTERVAL 64
+
 // Transaction manager
 typedef struct {
     Transaction transactions[MAX_TRANSACTIONS];
     int transaction_count;
     int next_transaction_id;
+    Timestamp clock;           // Last commit timestamp; new snapshots read at it
+    GarbageVersion* garbage;   // Queue in end timestamp order
+    int garbage_head;
+    int garbage_count;
+    int garbage_capacity;
+    int commits_since_gc;
+    long long commits;
+    long long conflicts;
+    long long rollbacks;
+    long long reclaimed;
     pthread_mutex_t mutex;
 } TransactionManager;
 
@@ -167,32 +335,229 @@ typedef struct {
 // STORAGE ENGINE
 // =============================================================================
 
-// Storage manager
+// Page types
+#define PAGE_TYPE_DATA 0
+#define PAGE_TYPE_INDEX 1
+#define PAGE_TYPE_METADATA 2
+
+// Page structure
+typedef struct {
+    int page_id;
+    int page_type; // 0=data, 1=index, 2=metadata
+    char data[PAGE_DATA_SIZE];
+    int record_count;
+    int next_page_id;
+    int prev_page_id;
+} Page;
+
+// Buffer pool eviction policies
+typedef enum {
+    EVICTION_CLOCK = 0,
+    EVICTION_LRU_K = 1
+} EvictionPolicy;
+
+// LRU-K remembers the last K accesses of each frame
+#define LRU_K 2
+
+// Buffer frame: one cached page
+typedef struct {
+    Page page;
+    int page_id;      // -1 while the frame is empty
+    int pin_count;
+    int dirty;
+    int reference;    // Clock reference bit
+    long long history[LRU_K]; // Most recent access first
+    int next_in_bucket;
+} BufferFrame;
+
+// Buffer pool: fixed set of frames with a page table and background writer
+typedef struct BufferPool {
+    BufferFrame* frames;
+    int frame_count;
+    int used_frames;
+    int* buckets;
+    int bucket_mask;
+    int clock_hand;
+    EvictionPolicy policy;
+    long long access_clock;
+    int dirty_count;
+    long long hits;
+    long long misses;
+    long long evictions;
+    long long dirty_evictions;
+    long long background_writes;
+    struct StorageManager* storage;
+    pthread_mutex_t mutex;
+    pthread_cond_t writer_cond;
+    pthread_t writer_thread;
+    int writer_interval_ms;
+    int writer_running;
+    int stop_writer;
+} BufferPool;
+
+// Write-ahead log record types
+#define WAL_ROWS 1          // Row images stored from row_id on, with begin stamp `timestamp`
+#define WAL_SUPERSEDE 2     // The transaction ends the version at row_id when it commits
+#define WAL_COMMIT 3        // The transaction committed at `timestamp`
+#define WAL_ABORT 4         // The transaction rolled back
+#define WAL_CREATE_TABLE 5  // Payload: table name, then `count` column definitions
+#define WAL_CREATE_INDEX 6  // Payload: LogIndexDefinition
+#define WAL_COLUMN_STORE 7  // enableColumnStore() on the table
+
+#define WAL_MAGIC 0x214C4157U        // "WAL!"
+#define CHECKPOINT_MAGIC 0x21544B43U // "CKT!"
+#define WAL_CHECKPOINT_BYTES (16LL * 1024 * 1024) // Log size that triggers a checkpoint
+#define WAL_ROWS_PER_RECORD VECTOR_SIZE           // Bulk loads are logged in chunks
+
+// Log sequence number: byte position of a record in the log's history
+typedef unsigned long long Lsn;
+
+// Header at the start of the log file
+typedef struct {
+    unsigned int magic;
+    unsigned int reserved;
+    Lsn start_lsn;          // LSN of the first record in the file
+} LogFileHeader;
+
+// Log record header; `size - sizeof(LogRecordHeader)` payload bytes follow
+typedef struct {
+    unsigned int size;      // Header and payload bytes
+    unsigned int checksum;  // FNV-1a of the record with this field zero
+    Lsn lsn;
+    int type;
+    int transaction_id;
+    int table_id;
+    RowId row_id;           // First row of WAL_ROWS, or the row of WAL_SUPERSEDE
+    int count;              // Rows of WAL_ROWS, or columns of WAL_CREATE_TABLE
+    int reserved;
+    Timestamp timestamp;    // Begin stamp of WAL_ROWS, commit time of WAL_COMMIT
+} LogRecordHeader;
+
+// Index definition carried by WAL_CREATE_INDEX and by checkpoints
+typedef struct {
+    char name[MAX_FIELD_SIZE];
+    int column_index;
+    int is_unique;
+} LogIndexDefinition;
+
+// Checkpoint file header; the tables and then the open transactions follow
+typedef struct {
+    unsigned int magic;
+    int table_count;
+    Lsn lsn;                // Log records from this LSN on are not in the checkpoint
+    Timestamp clock;
+    int next_transaction_id;
+    int active_count;
+} CheckpointHeader;
+
+// One table of a checkpoint; its columns, heap page ids, index definitions
+// and row versions follow
 typedef struct {
+    char name[MAX_FIELD_SIZE];
+    int column_count;
+    int next_record_id;
+    int record_count;
+    int heap_row_count;
+    int heap_page_count;
+    int index_count;
+    int has_column_store;
+} CheckpointTable;
+
+// One write set entry of a transaction open at the checkpoint
+typedef struct {
+    int table_id;
+    RowId row_id;
+    int superseded;
+} CheckpointWrite;
+
+// Definitions recovery rebuilds once the heap is back in shape
+typedef struct {
+    LogIndexDefinition indexes[MAX_TABLES][MAX_INDEXES];
+    int index_counts[MAX_TABLES];
+    int column_stores[MAX_TABLES];
+} RecoveryCatalog;
+
+// Write-ahead log: append-only record file made durable by group commit
+typedef struct WriteAheadLog {
+    int fd;
+    unsigned char* buffer;        // Records appended since the last flush
+    size_t buffer_used;
+    size_t buffer_capacity;
+    unsigned char* flush_buffer;  // Batch the flushing leader is writing
+    size_t flush_capacity;
+    Lsn start_lsn;                // LSN of the first record in the file
+    Lsn next_lsn;                 // LSN the next record gets
+    Lsn flushed_lsn;              // Every record below this is on disk
+    int group_commit;             // 0: each commit syncs the log on its own
+    int flushing;                 // A leader is writing a batch
+    int recovering;               // Replay in progress: nothing is logged
+    long long checkpoint_bytes;   // Log size that triggers a checkpoint; 0 = never
+    long long syncs;
+    long long commit_records;
+    long long checkpoints;
+    int replayed_records;         // Set by the last recovery
+    int redone_transactions;
+    int undone_transactions;
+    pthread_mutex_t mutex;
+    pthread_cond_t flushed;
+} WriteAheadLog;
+
+// Storage manager
+typedef struct StorageManager {
     char database_path[256];
     FILE* data_file;
     FILE* index_file;
     FILE* metadata_file;
     int page_size;
     int cache_size;
-    void* page_cache;
+    BufferPool* page_cache;
     int cache_enabled;
+    int page_count;
+    WriteAheadLog* wal;     // NULL until enableWriteAheadLog(), or a log found on open
 } StorageManager;
 
-// Page structure
+// Heap rows start with the record id, a deleted flag and a NULL bitmap
+// (bit i set when column i is NULL)
+#define ROW_HEADER_SIZE (2 * (int)sizeof(int) + (int)sizeof(unsigned long long))
+#define ROW_NULLS_OFFSET (2 * (int)sizeof(int))
+
+// B+tree node layout inside Page.data: is_leaf, first_child, then entries.
+// Leaf entries are (key, row id); internal entries are (key, row id, child).
+// The row id makes every entry unique, so duplicate keys split cleanly.
+#define BTREE_NODE_HEADER_SIZE (2 * (int)sizeof(int))
+#define BTREE_MAX_KEY_SIZE MAX_FIELD_SIZE
+#define BTREE_BULK_FILL_PERCENT 90
+
+// Cursor over a key range of a B+tree index
 typedef struct {
-    int page_id;
-    int page_type; // 0=data, 1=index, 2=metadata
-    char data[4096];
-    int record_count;
-    int next_page_id;
-    int prev_page_id;
-} Page;
+    Index* index;
+    Page leaf;
+    int slot;
+    int has_high;
+    int high_inclusive;
+    unsigned char high_key[BTREE_MAX_KEY_SIZE];
+    int exhausted;
+} IndexCursor;
+
+// Index range chosen for a query
+typedef struct {
+    Index* index;
+    const unsigned char* low;
+    int low_inclusive;
+    const unsigned char* high;
+    int high_inclusive;
+} IndexRange;
 
 // =============================================================================
 // CONNECTION POOL
 // =============================================================================
 
+// Connection slot states
+#define CONNECTION_CLOSED 0  // No open connection; reopened when next taken
+#define CONNECTION_IDLE 1    // Open and on the free list
+#define CONNECTION_IN_USE 2
+#define CONNECTION_CLOSING 3 // Being closed by reapIdleConnections()
+
 // Database connection
 typedef struct {
     int connection_id;
@@ -200,33 +565,162 @@ typedef struct {
     int is_connected;
     int transaction_id;
     time_t connect_time;
-    time_t last_activity;
+    time_t last_activity; // Set when taken and when returned; read by the reaper
     int auto_commit;
+    int state;            // CONNECTION_*, changed by compare-and-swap
+    int next_free;        // Free list link: next slot + 1, or 0
 } DatabaseConnection;
 
 // Connection pool
+// Slots that are not in use form a lock-free stack, so taking and returning
+// a connection is one compare-and-swap on free_head. The mutex and condition
+// are used only by threads that wait for an empty pool to refill.
 typedef struct {
     DatabaseConnection connections[MAX_CONNECTIONS];
-    int connection_count;
+    unsigned long long free_head __attribute__((aligned(64))); // Tag << 32 | (top slot + 1)
+    int waiters __attribute__((aligned(64))); // Threads blocked in acquireConnection()
     int max_connections;
+    int open_count;  // Connections open, idle or in use
+    long long waits;
+    long long timeouts;
+    long long opened;
+    long long reaped;
     pthread_mutex_t mutex;
+    pthread_cond_t available;
 } ConnectionPool;
 
 // =============================================================================
 // QUERY OPTIMIZER
 // =============================================================================
 
-// Query plan node
-typedef struct {
-    int node_type; // 0=scan, 1=index_scan, 2=filter, 3=sort, 4=limit
+// Plan node types
+#define PLAN_SCAN 0
+#define PLAN_INDEX_SCAN 1
+#define PLAN_FILTER 2
+#define PLAN_SORT 3
+#define PLAN_LIMIT 4
+#define PLAN_COLUMN_SCAN 5
+#define PLAN_HASH_JOIN 6
+#define PLAN_MERGE_JOIN 7
+
+// Query plan node: planner estimates plus pull-based iterator state
+typedef struct QueryPlanNode {
+    int node_type; // 0=scan, 1=index_scan, 2=filter, 3=sort, 4=limit, 5=column_scan, 6/7=join
     int table_id;
     int index_id;
     int estimated_cost;
     int estimated_rows;
     struct QueryPlanNode* children[2];
     int child_count;
+    Table* table;
+    Query* query;
+    int conditions[MAX_COLUMNS]; // WHERE conditions checked at this node
+    int condition_count;
+    IndexRange range;            // Key range of an index scan
+    int sort_column;
+    // Iterator state
+    Page page;
+    int page_position;
+    int slot;
+    int loaded_page;
+    IndexCursor cursor;
+    RowId row_limit;           // Scans: rows published when the node opened
+    RowId row_id;              // Access nodes: row id of the last row returned
+    int batch_start;           // Column scan: first row id of the batch
+    SelectionVector selection; // Column scan: matching rows of the batch
+    struct SortState* sort;    // Sort nodes: buffered rows, heap or run files
+    int produced;
+    int skipped;
+    int actual_rows;
+    struct JoinState* join;    // Join nodes: inputs, output layout and iterator state
 } QueryPlanNode;
 
+// Hash join spill partitions
+#define JOIN_MIN_PARTITIONS 8
+#define JOIN_MAX_PARTITIONS 128
+
+// Hash join phases
+#define JOIN_PHASE_BUILD 0     // Nothing read yet
+#define JOIN_PHASE_PROBE 1     // Probing the in-memory table with the probe input
+#define JOIN_PHASE_PARTITION 2 // Joining spilled partitions one at a time
+
+// State of a hash or merge join node
+// A join runs each input as its own single-table query and returns rows
+// laid out as the left table's row followed by the right table's, described
+// by output so that SORT, LIMIT and result sets above it need not know.
+typedef struct JoinState {
+    Query inputs[2];          // WHERE conditions of each table, bound to it
+    Table output;             // Layout of joined rows; not a stored table
+    int key_columns[2];       // ON column of each input's table
+    int build_input;          // Hash join: input loaded into the hash table
+    size_t memory_budget;
+    unsigned char* row;       // Joined row the node returns
+    // Hash table over the build input
+    unsigned char* build_rows;
+    unsigned long long* hashes;
+    int* next;                // Chain of entries sharing a bucket, -1 ends it
+    int* buckets;
+    int bucket_mask;
+    int build_count;
+    int build_capacity;
+    // Probing
+    int phase;                // JOIN_PHASE_*
+    const unsigned char* probe_row;
+    unsigned char* probe_buffer; // Probe row read back from a partition
+    unsigned long long probe_hash;
+    int match;                // Next hash table entry to check, -1 when none
+    // Spilling
+    FILE* build_files[JOIN_MAX_PARTITIONS];
+    FILE* probe_files[JOIN_MAX_PARTITIONS];
+    int partition_count;      // 0 while the build input fits the budget
+    int partition;            // Partition being joined
+    long long spilled_rows;
+    // Merge join
+    const unsigned char* left_row;
+    const unsigned char* lookahead; // First right row past the current group
+    unsigned char* group;     // Right rows whose key equals the current left key
+    int group_count;
+    int group_capacity;
+    int group_position;
+    int started;
+} JoinState;
+
+// Sort methods, reported by EXPLAIN ANALYZE
+#define SORT_METHOD_QUICKSORT 0 // Every row fit the memory budget
+#define SORT_METHOD_TOP_N 1     // ORDER BY ... LIMIT k: a heap of the best k rows
+#define SORT_METHOD_EXTERNAL 2  // Sorted runs on disk, merged as rows are returned
+
+// Runs merged at once; more runs take extra merge passes
+#define SORT_MERGE_FAN_IN 64
+#define SORT_MAX_RUNS (2 * SORT_MERGE_FAN_IN) // Open run files before the oldest are merged
+
+// State of a sort node
+// Rows are buffered up to the query's work_memory. Past it each full buffer
+// is sorted and written out as a run, and the runs are merged one row per
+// pull, so memory stays flat however many rows are sorted.
+typedef struct SortState {
+    int method;               // SORT_METHOD_*
+    int ready;                // Input consumed; rows can be returned
+    int limit;                // Top-N: rows the heap keeps
+    unsigned char* buffer;    // Rows in memory: a run being formed, or the heap
+    unsigned char** rows;     // Pointers into buffer; sorted before rows are returned
+    int count;
+    int allocated;            // Rows buffer has room for
+    int capacity;             // Rows buffer may hold within the budget
+    int position;             // Next of rows to return
+    // External merge
+    FILE** runs;              // Sorted runs not merged yet, oldest first
+    int run_count;
+    int run_capacity;
+    unsigned char* heads;     // Current row of each run being merged
+    int* heap;                // Runs being merged, smallest head first
+    int heap_count;
+    int returned;             // Run whose head was returned last, -1 if none
+    long long spilled_rows;   // Rows written to runs, counting every pass
+    int runs_written;
+    size_t memory_used;       // Peak bytes of rows, pointers and merge heads
+} SortState;
+
 // Query optimizer
 typedef struct {
     QueryPlanNode* plan;
@@ -234,6 +728,20 @@ typedef struct {
     int plan_steps;
 } QueryOptimizer;
 
+// Cost model in units of one sequential page read
+// Calibrated for data files that sit in the OS page cache: a pool miss is a
+// 4 KB pread either way, so random reads only lose read-ahead, and checking
+// a row costs about 1/30 of reading a page.
+#define COST_SEQ_PAGE 1.0
+#define COST_RANDOM_PAGE 1.5
+#define COST_CPU_ROW 0.03
+#define COST_VECTOR_VALUE 0.0005 // One value of a column-store batch compare
+
+// Selectivities used when a column has no statistics
+#define DEFAULT_EQ_SELECTIVITY 0.005
+#define DEFAULT_RANGE_SELECTIVITY (1.0 / 3.0)
+#define DEFAULT_LIKE_SELECTIVITY 0.1
+
 // =============================================================================
 // DATABASE ENGINE
 // =============================================================================
@@ -247,7 +755,9 @@ typedef struct {
     TransactionManager* transaction_manager;
     ConnectionPool* connection_pool;
     QueryOptimizer* optimizer;
-    pthread_mutex_t mutex;
+    pthread_mutex_t mutex; // Writer latch: heap and index writes, their log records, GC
+    struct PlanCache* plan_cache;
+    unsigned long long schema_version; // Bumped by createTable(); cached plans compare it
     int is_open;
 } Database;
 
@@ -261,9 +771,9 @@ typedef enum {
     TOKEN_IDENTIFIER = 1,
     TOKEN_STRING = 2,
     TOKEN_NUMBER = 3,
-    TOKEN_OPERATOR = 3,
-    TOKEN_PUNCTUATION = 4,
-    TOKEN_EOF = 5
+    TOKEN_OPERATOR = 4,
+    TOKEN_PUNCTUATION = 5,
+    TOKEN_EOF = 6
 } TokenType;
 
 // SQL token
@@ -283,6 +793,8 @@ typedef struct {
     SQLToken current_token;
 } SQLLexer;
 
+#define SQL_ERROR_LEXEME_LENGTH 64 // Token text quoted in a syntax error
+
 // SQL parser
 typedef struct {
     SQLLexer lexer;
@@ -292,6 +804,82 @@ typedef struct {
     char error_message[256];
 } SQLParser;
 
+// =============================================================================
+// PREPARED STATEMENTS
+// =============================================================================
+
+#define MAX_PARAMETERS 32
+#define PLAN_CACHE_BUCKETS 256  // Power of two
+#define PLAN_CACHE_CAPACITY 128 // Statements kept before the least recently used is evicted
+
+// Where the value of a ? placeholder goes
+#define PARAMETER_WHERE 0  // Literal of WHERE condition `index`
+#define PARAMETER_VALUE 1  // INSERT value `index`, or the SET value of an UPDATE
+#define PARAMETER_LIMIT 2
+#define PARAMETER_OFFSET 3
+
+// A ? placeholder
+typedef struct {
+    int kind;
+    int index;
+} StatementParameter;
+
+// Parsed statement: the query plus what Query cannot express
+typedef struct {
+    Query query;
+    int table_id;
+    int join_table_id;             // SELECT with JOIN: the joined table
+    int projection[MAX_COLUMNS];   // SELECT: output column of each result column
+    int projection_count;
+    int value_columns[MAX_COLUMNS]; // INSERT: column of each value; UPDATE: the SET column
+    char values[MAX_COLUMNS][MAX_FIELD_SIZE];
+    int value_is_null[MAX_COLUMNS];
+    int value_count;
+    StatementParameter parameters[MAX_PARAMETERS];
+    int parameter_count;
+} ParsedStatement;
+
+// Plan cache entry, shared by every handle prepared from the same text
+typedef struct CachedStatement {
+    char sql[MAX_QUERY_SIZE];          // Normalized text: the cache key
+    unsigned long long hash;
+    ParsedStatement statement;
+    unsigned long long schema_version; // Database.schema_version when parsed
+    int table_version;                 // Table.schema_version when parsed
+    int join_table_version;            // The same for a joined table
+    QueryPlanNode* plan;               // Plan of the first execution; handles clone it
+    int references;                    // Handles using the entry, plus one while cached
+    unsigned long long last_used;
+    struct CachedStatement* next;      // Bucket chain
+} CachedStatement;
+
+// Plan cache keyed on normalized SQL text
+typedef struct PlanCache {
+    CachedStatement* buckets[PLAN_CACHE_BUCKETS];
+    int entry_count;
+    unsigned long long clock; // Ticks on every lookup
+    long long hits;
+    long long misses;
+    long long invalidations;  // Entries dropped because DDL changed the schema
+    long long evictions;
+    pthread_mutex_t mutex;
+} PlanCache;
+
+// Prepared statement handle; one thread uses it at a time
+typedef struct {
+    Database* db;
+    CachedStatement* cached;       // Holds a reference
+    ParsedStatement statement;     // Private copy that parameters are bound into
+    char parameter_values[MAX_PARAMETERS][MAX_FIELD_SIZE];
+    int parameter_is_null[MAX_PARAMETERS]; // Parameters start out NULL
+    int transaction_id;            // 0: each execution is its own transaction
+    QueryPlanNode* plan;           // Cloned or built on the first execution
+    int running;                   // A SELECT is open for stepStatement()
+    int implicit_id;               // Its implicit transaction, if any
+    const unsigned char* row;      // Current row of the SELECT
+    int last_insert_id;
+} PreparedStatement;
+
 // =============================================================================
 // RESULT SET
 // =============================================================================
@@ -307,571 +895,902 @@ typedef struct {
     int has_more_rows;
 } ResultSet;
 
+// Streaming cursor over a SELECT
+// Rows are pulled from the plan one at a time, so an open cursor holds only
+// what its plan nodes buffer, however many rows the query returns.
+typedef struct {
+    Database* db;
+    Query query;                 // Private copy; the plan reads it
+    QueryPlanNode* plan;
+    Column columns[MAX_COLUMNS]; // Select-list columns
+    int projection[MAX_COLUMNS]; // Row column of each select-list column
+    int column_count;
+    int implicit_id;             // From beginStatement()
+    int running;                 // Statement still open
+    const unsigned char* row;    // Current row; valid until the next fetch
+} ResultCursor;
+
+// Aggregates over the rows matching a query
+typedef struct {
+    long long rows;  // COUNT(*)
+    long long count; // COUNT(column): non-NULL values
+    double sum;
+    double min;
+    double max;
+} AggregateResult;
+
 // =============================================================================
 // STORAGE ENGINE IMPLEMENTATION
 // =============================================================================
 
-// Initialize storage manager
-StorageManager* initStorageManager(const char* database_path, int page_size, int cache_size) {
-    StorageManager* storage = malloc(sizeof(StorageManager));
-    if (!storage) return NULL;
-    
-    memset(storage, 0, sizeof(StorageManager));
-    strncpy(storage->database_path, database_path, sizeof(storage->database_path) - 1);
-    storage->page_size = page_size;
-    storage->cache_size = cache_size;
+// Read a page frame straight from the data file
+// pread/pwrite keep the file offset out of shared state, so the background
+// writer and foreground misses can do I/O at the same time.
+int diskReadPage(StorageManager* storage, int page_id, Page* page) {
+    off_t offset = (off_t)page_id * (off_t)sizeof(Page);
+    ssize_t bytes_read = pread(fileno(storage->data_file), page, sizeof(Page), offset);
+    return bytes_read == (ssize_t)sizeof(Page) ? 0 : -1;
+}
+
+// Write a page frame straight to the data file
+int diskWritePage(StorageManager* storage, int page_id, const Page* page) {
+    off_t offset = (off_t)page_id * (off_t)sizeof(Page);
+    ssize_t bytes_written = pwrite(fileno(storage->data_file), page, sizeof(Page), offset);
+    return bytes_written == (ssize_t)sizeof(Page) ? 0 : -1;
+}
+
+// =============================================================================
+// BUFFER POOL
+// =============================================================================
+
+// Wake the background writer once this share of frames is dirty
+#define BUFFER_POOL_DIRTY_PERCENT 25
+#define BUFFER_POOL_WRITER_INTERVAL_MS 100
+
+// Find the frame caching a page (caller holds the pool mutex)
+int lookupFrame(BufferPool* pool, int page_id) {
+    int frame = pool->buckets[page_id & pool->bucket_mask];
     
-    // Create database directory if it doesn't exist
-    struct stat st = {0};
-    if (stat(database_path, &st) == -1) {
-        #ifdef _WIN32
-        _mkdir(database_path);
-        #else
-        mkdir(database_path, 0755);
-        #endif
+    while (frame != -1 && pool->frames[frame].page_id != page_id) {
+        frame = pool->frames[frame].next_in_bucket;
     }
     
-    // Open data file
-    char data_file_path[512];
-    snprintf(data_file_path, sizeof(data_file_path), "%s/data.db", database_path);
-    storage->data_file = fopen(data_file_path, "rb+");
-    if (!storage->data_file) {
-        storage->data_file = fopen(data_file_path, "wb+");
-    }
+    return frame;
+}
+
+// Remove a frame from its page table bucket
+void unlinkFrame(BufferPool* pool, int frame) {
+    int* link = &pool->buckets[pool->frames[frame].page_id & pool->bucket_mask];
     
-    // Open index file
-    char index_file_path[512];
-    snprintf(index_file_path, sizeof(index_file_path), "%s/index.db", database_path);
-    storage->index_file = fopen(index_file_path, "rb+");
-    if (!storage->index_file) {
-        storage->index_file = fopen(index_file_path, "wb+");
+    while (*link != frame) {
+        link = &pool->frames[*link].next_in_bucket;
     }
+    *link = pool->frames[frame].next_in_bucket;
+}
+
+// Record an access for both the clock bit and the LRU-K history
+void recordFrameAccess(BufferPool* pool, BufferFrame* frame, int is_new) {
+    long long now = ++pool->access_clock;
     
-    // Open metadata file
-    char metadata_file_path[512];
-    snprintf(metadata_file_path, sizeof(metadata_file_path), "%s/metadata.db", database_path);
-    storage->metadata_file = fopen(metadata_file_path, "rb+");
-    if (!storage->metadata_file) {
-        storage->metadata_file = fopen(metadata_file_path, "wb+");
+    if (is_new) {
+        memset(frame->history, 0, sizeof(frame->history));
+    } else {
+        memmove(&frame->history[1], &frame->history[0], (LRU_K - 1) * sizeof(long long));
     }
     
-    // Initialize page cache
-    if (cache_size > 0) {
-        storage->page_cache = malloc(page_size * cache_size);
-        storage->cache_enabled = 1;
+    frame->history[0] = now;
+    frame->reference = 1;
+}
+
+// Clock: sweep the hand, giving referenced frames a second chance
+int chooseClockVictim(BufferPool* pool) {
+    for (int step = 0; step < 2 * pool->frame_count; step++) {
+        int frame = pool->clock_hand;
+        pool->clock_hand = (pool->clock_hand + 1) % pool->frame_count;
+        
+        if (pool->frames[frame].pin_count > 0) continue;
+        if (pool->frames[frame].reference) {
+            pool->frames[frame].reference = 0;
+            continue;
+        }
+        return frame;
     }
     
-    return storage;
+    return -1; // Every frame is pinned
 }
 
-// Read page from storage
-int readPage(StorageManager* storage, int page_id, Page* page) {
-    if (!storage || !page || !storage->data_file) {
-        return -1;
+// LRU-K: evict the frame whose K-th most recent access is oldest
+// Frames seen fewer than K times have infinite distance and go first, in LRU
+// order, so a one-off scan cannot push out pages that are used repeatedly.
+int chooseLRUKVictim(BufferPool* pool) {
+    int victim = -1;
+    
+    for (int i = 0; i < pool->frame_count; i++) {
+        BufferFrame* frame = &pool->frames[i];
+        if (frame->pin_count > 0) continue;
+        
+        if (victim == -1) {
+            victim = i;
+            continue;
+        }
+        
+        BufferFrame* best = &pool->frames[victim];
+        long long kth = frame->history[LRU_K - 1];
+        long long best_kth = best->history[LRU_K - 1];
+        
+        if (kth < best_kth || (kth == best_kth && frame->history[0] < best->history[0])) {
+            victim = i;
+        }
     }
     
-    // Check cache first
-    if (storage->cache_enabled && storage->page_cache) {
-        // Simple cache implementation
-        // In a real implementation, this would be more sophisticated
+    return victim;
+}
+
+// Get a frame for a page, reading it from disk on a miss when load is set
+// Returns the frame pinned; the caller holds the pool mutex.
+BufferFrame* fetchFrame(BufferPool* pool, int page_id, int load) {
+    int index = lookupFrame(pool, page_id);
+    
+    if (index != -1) {
+        BufferFrame* frame = &pool->frames[index];
+        frame->pin_count++;
+        recordFrameAccess(pool, frame, 0);
+        pool->hits++;
+        return frame;
     }
     
-    // Seek to page position
-    long offset = page_id * storage->page_size;
-    if (fseek(storage->data_file, offset, SEEK_SET) != 0) {
-        return -1;
+    // Use an empty frame first, then evict
+    if (pool->used_frames < pool->frame_count) {
+        index = pool->used_frames++;
+    } else {
+        index = pool->policy == EVICTION_LRU_K ? chooseLRUKVictim(pool) : chooseClockVictim(pool);
+        if (index == -1) {
+            return NULL;
+        }
+        
+        // A frame left empty by a failed read has nothing to write or unlink
+        BufferFrame* victim = &pool->frames[index];
+        if (victim->page_id != -1) {
+            if (victim->dirty) {
+                if (diskWritePage(pool->storage, victim->page_id, &victim->page) != 0) {
+                    return NULL;
+                }
+                victim->dirty = 0;
+                pool->dirty_count--;
+                pool->dirty_evictions++;
+            }
+            
+            unlinkFrame(pool, index);
+            pool->evictions++;
+        }
     }
     
-    // Read page data
-    size_t bytes_read = fread(page, 1, storage->page_size, storage->data_file);
-    if (bytes_read != storage->page_size) {
-        return -1;
+    BufferFrame* frame = &pool->frames[index];
+    frame->page_id = -1;
+    
+    if (load) {
+        if (diskReadPage(pool->storage, page_id, &frame->page) != 0) {
+            return NULL; // Frame stays empty and unlinked
+        }
+        pool->misses++;
     }
     
-    return 0;
+    frame->page_id = page_id;
+    frame->pin_count = 1;
+    frame->dirty = 0;
+    frame->next_in_bucket = pool->buckets[page_id & pool->bucket_mask];
+    pool->buckets[page_id & pool->bucket_mask] = index;
+    recordFrameAccess(pool, frame, 1);
+    
+    return frame;
 }
 
-// Write page to storage
-int writePage(StorageManager* storage, int page_id, Page* page) {
-    if (!storage || !page || !storage->data_file) {
-        return -1;
-    }
+// Mark a pinned frame dirty and nudge the writer when many frames are
+void markFrameDirty(BufferPool* pool, BufferFrame* frame) {
+    if (frame->dirty) return;
     
-    // Seek to page position
-    long offset = page_id * storage->page_size;
-    if (fseek(storage->data_file, offset, SEEK_SET) != 0) {
-        return -1;
-    }
+    frame->dirty = 1;
+    pool->dirty_count++;
     
-    // Write page data
-    size_t bytes_written = fwrite(page, 1, storage->page_size, storage->data_file);
-    if (bytes_written != storage->page_size) {
-        return -1;
+    if (pool->writer_running &&
+        pool->dirty_count * 100 >= pool->frame_count * BUFFER_POOL_DIRTY_PERCENT) {
+        pthread_cond_signal(&pool->writer_cond);
+    }
+}
+
+// Pin a page in the pool
+// The page stays resident until unpinPage(); concurrent writers to the same
+// page must coordinate themselves, the pool only guards residency.
+Page* pinPage(BufferPool* pool, int page_id) {
+    if (!pool || page_id < 0) {
+        return NULL;
     }
     
-    // Flush to ensure data is written
-    fflush(storage->data_file);
+    pthread_mutex_lock(&pool->mutex);
+    BufferFrame* frame = fetchFrame(pool, page_id, 1);
+    pthread_mutex_unlock(&pool->mutex);
     
-    return 0;
+    return frame ? &frame->page : NULL;
 }
 
-// =============================================================================
-// TABLE MANAGEMENT
-// =============================================================================
-
-// Create table
-int createTable(Database* db, const char* table_name, Column* columns, int column_count) {
-    if (!db || !table_name || !columns || column_count <= 0) {
+// Unpin a page, marking it dirty when the caller modified it
+int unpinPage(BufferPool* pool, int page_id, int is_dirty) {
+    if (!pool) {
         return -1;
     }
     
-    pthread_mutex_lock(&db->mutex);
+    pthread_mutex_lock(&pool->mutex);
     
-    // Check if table already exists
-    for (int i = 0; i < db->table_count; i++) {
-        if (strcmp(db->tables[i].name, table_name) == 0) {
-            pthread_mutex_unlock(&db->mutex);
-            return -1; // Table already exists
-        }
+    int index = lookupFrame(pool, page_id);
+    if (index == -1 || pool->frames[index].pin_count <= 0) {
+        pthread_mutex_unlock(&pool->mutex);
+        return -1;
     }
     
-    if (db->table_count >= MAX_TABLES) {
-        pthread_mutex_unlock(&db->mutex);
-        return -1; // Maximum tables reached
+    BufferFrame* frame = &pool->frames[index];
+    if (is_dirty) {
+        markFrameDirty(pool, frame);
     }
+    frame->pin_count--;
     
-    // Create new table
-    Table* table = &db->tables[db->table_count];
-    strncpy(table->name, table_name, sizeof(table->name) - 1);
-    table->column_count = column_count;
-    table->record_count = 0;
-    table->next_record_id = 1;
-    table->primary_key_column = -1;
-    table->index_count = 0;
+    pthread_mutex_unlock(&pool->mutex);
+    return 0;
+}
+
+// Write dirty, unpinned frames back to disk
+// Each frame is pinned and copied so the disk write runs without the mutex.
+int writeBackFrames(BufferPool* pool) {
+    int written = 0;
+    Page copy;
     
-    // Copy columns
-    for (int i = 0; i < column_count; i++) {
-        table->columns[i] = columns[i];
+    pthread_mutex_lock(&pool->mutex);
+    for (int i = 0; i < pool->used_frames; i++) {
+        BufferFrame* frame = &pool->frames[i];
+        if (!frame->dirty || frame->pin_count > 0) continue;
         
-        // Find primary key column
-        if (columns[i].is_primary_key) {
-            if (table->primary_key_column != -1) {
-                pthread_mutex_unlock(&db->mutex);
-                return -1; // Multiple primary keys
-            }
-            table->primary_key_column = i;
+        int page_id = frame->page_id;
+        copy = frame->page;
+        frame->dirty = 0;
+        frame->pin_count++;
+        pool->dirty_count--;
+        pthread_mutex_unlock(&pool->mutex);
+        
+        int result = diskWritePage(pool->storage, page_id, &copy);
+        
+        pthread_mutex_lock(&pool->mutex);
+        frame->pin_count--;
+        if (result != 0) {
+            markFrameDirty(pool, frame); // Retry on the next pass
+        } else {
+            written++;
         }
     }
+    pthread_mutex_unlock(&pool->mutex);
     
-    db->table_count++;
-    
-    // Save metadata
-    saveMetadata(db);
-    
-    pthread_mutex_unlock(&db->mutex);
-    
-    return 0;
+    return written;
 }
 
-// Find table by name
-Table* findTable(Database* db, const char* table_name) {
-    if (!db || !table_name) {
-        return NULL;
-    }
+// Background writer: flush dirty frames periodically or when signalled
+void* bufferPoolWriter(void* arg) {
+    BufferPool* pool = (BufferPool*)arg;
     
-    for (int i = 0; i < db->table_count; i++) {
-        if (strcmp(db->tables[i].name, table_name) == 0) {
-            return &db->tables[i];
-        }
+    pthread_mutex_lock(&pool->mutex);
+    while (!pool->stop_writer) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += (long)pool->writer_interval_ms * 1000000L;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        
+        pthread_cond_timedwait(&pool->writer_cond, &pool->mutex, &deadline);
+        if (pool->stop_writer || pool->dirty_count == 0) continue;
+        
+        pthread_mutex_unlock(&pool->mutex);
+        int written = writeBackFrames(pool);
+        pthread_mutex_lock(&pool->mutex);
+        pool->background_writes += written;
     }
+    pthread_mutex_unlock(&pool->mutex);
     
     return NULL;
 }
 
-// Find column by name
-int findColumn(Table* table, const char* column_name) {
-    if (!table || !column_name) {
-        return -1;
+// Initialize buffer pool; writer_interval_ms of 0 disables the writer thread
+BufferPool* initBufferPool(StorageManager* storage, int frame_count, EvictionPolicy policy,
+                           int writer_interval_ms) {
+    if (!storage || frame_count <= 0) {
+        return NULL;
     }
     
-    for (int i = 0; i < table->column_count; i++) {
-        if (strcmp(table->columns[i].name, column_name) == 0) {
-            return i;
-        }
+    BufferPool* pool = malloc(sizeof(BufferPool));
+    if (!pool) return NULL;
+    
+    memset(pool, 0, sizeof(BufferPool));
+    
+    // Page table: power-of-two buckets, about two per frame
+    int bucket_count = 1;
+    while (bucket_count < 2 * frame_count) {
+        bucket_count *= 2;
     }
     
-    return -1;
-}
-
-// =============================================================================
-// RECORD MANAGEMENT
-// =============================================================================
-
-// Create record
-Record* createRecord(Table* table) {
-    if (!table) {
+    pool->frames = malloc(frame_count * sizeof(BufferFrame));
+    pool->buckets = malloc(bucket_count * sizeof(int));
+    if (!pool->frames || !pool->buckets) {
+        free(pool->frames);
+        free(pool->buckets);
+        free(pool);
         return NULL;
     }
     
-    Record* record = malloc(sizeof(Record));
-    if (!record) {
-        return NULL;
+    memset(pool->frames, 0, frame_count * sizeof(BufferFrame));
+    for (int i = 0; i < frame_count; i++) {
+        pool->frames[i].page_id = -1;
+        pool->frames[i].next_in_bucket = -1;
+    }
+    for (int i = 0; i < bucket_count; i++) {
+        pool->buckets[i] = -1;
     }
     
-    memset(record, 0, sizeof(Record));
-    record->id = table->next_record_id++;
-    record->created_at = time(NULL);
-    record->updated_at = time(NULL);
+    pool->frame_count = frame_count;
+    pool->bucket_mask = bucket_count - 1;
+    pool->policy = policy;
+    pool->storage = storage;
+    pool->writer_interval_ms = writer_interval_ms;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->writer_cond, NULL);
     
-    // Allocate memory for fields
-    for (int i = 0; i < table->column_count; i++) {
-        switch (table->columns[i].type) {
-            case DATA_TYPE_INTEGER:
-                record->fields[i] = malloc(sizeof(int));
-                *(int*)record->fields[i] = 0;
-                break;
-            case DATA_TYPE_FLOAT:
-                record->fields[i] = malloc(sizeof(double));
-                *(double*)record->fields[i] = 0.0;
-                break;
-            case DATA_TYPE_TEXT:
-                record->fields[i] = malloc(table->columns[i].size);
-                memset(record->fields[i], 0, table->columns[i].size);
-                break;
-            case DATA_TYPE_BOOLEAN:
-                record->fields[i] = malloc(sizeof(int));
-                *(int*)record->fields[i] = 0;
-                break;
-            case DATA_TYPE_DATE:
-            case DATA_TYPE_TIMESTAMP:
-                record->fields[i] = malloc(sizeof(time_t));
-                *(time_t*)record->fields[i] = time(NULL);
-                break;
-            default:
-                record->fields[i] = NULL;
-                break;
-        }
+    if (writer_interval_ms > 0 &&
+        pthread_create(&pool->writer_thread, NULL, bufferPoolWriter, pool) == 0) {
+        pool->writer_running = 1;
     }
     
-    return record;
+    return pool;
 }
 
-// Free record
-void freeRecord(Table* table, Record* record) {
-    if (!table || !record) {
-        return;
+// Write every dirty frame back to disk
+int flushBufferPool(BufferPool* pool) {
+    if (!pool) {
+        return -1;
     }
     
-    // Free field memory
-    for (int i = 0; i < table->column_count; i++) {
-        if (record->fields[i]) {
-            free(record->fields[i]);
+    int result = 0;
+    pthread_mutex_lock(&pool->mutex);
+    for (int i = 0; i < pool->used_frames; i++) {
+        BufferFrame* frame = &pool->frames[i];
+        if (!frame->dirty) continue;
+        
+        if (diskWritePage(pool->storage, frame->page_id, &frame->page) != 0) {
+            result = -1;
+            continue;
         }
+        frame->dirty = 0;
+        pool->dirty_count--;
     }
+    pthread_mutex_unlock(&pool->mutex);
     
-    free(record);
+    return result;
 }
 
-// Set field value
-int setFieldValue(Record* record, Table* table, const char* column_name, const void* value) {
-    if (!record || !table || !column_name || !value) {
-        return -1;
-    }
-    
-    int column_index = findColumn(table, column_name);
-    if (column_index < 0) {
-        return -1; // Column not found
+// Stop the writer, flush dirty frames and free the pool
+void freeBufferPool(BufferPool* pool) {
+    if (!pool) return;
+    
+    if (pool->writer_running) {
+        pthread_mutex_lock(&pool->mutex);
+        pool->stop_writer = 1;
+        pthread_cond_signal(&pool->writer_cond);
+        pthread_mutex_unlock(&pool->mutex);
+        pthread_join(pool->writer_thread, NULL);
     }
     
-    Column* column = &table->columns[column_index];
+    flushBufferPool(pool);
     
-    switch (column->type) {
-        case DATA_TYPE_INTEGER:
-            *(int*)record->fields[column_index] = *(int*)value;
-            break;
-        case DATA_TYPE_FLOAT:
-            *(double*)record->fields[column_index] = *(double*)value;
-            break;
-        case DATA_TYPE_TEXT:
-            strncpy((char*)record->fields[column_index], (char*)value, column->size - 1);
-            ((char*)record->fields[column_index])[column->size - 1] = '\0';
-            break;
-        case DATA_TYPE_BOOLEAN:
-            *(int*)record->fields[column_index] = *(int*)value;
-            break;
-        case DATA_TYPE_DATE:
-        case DATA_TYPE_TIMESTAMP:
-            *(time_t*)record->fields[column_index] = *(time_t*)value;
-            break;
-        default:
+    pthread_cond_destroy(&pool->writer_cond);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool->frames);
+    free(pool->buckets);
+    free(pool);
+}
+
+// Reset hit, miss and write-back counters
+void resetBufferPoolStats(BufferPool* pool) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->hits = 0;
+    pool->misses = 0;
+    pool->evictions = 0;
+    pool->dirty_evictions = 0;
+    pool->background_writes = 0;
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+// Hit rate of page reads since the last reset
+double bufferPoolHitRate(BufferPool* pool) {
+    long long lookups = pool->hits + pool->misses;
+    return lookups > 0 ? (double)pool->hits / lookups : 0.0;
+}
+
+// =============================================================================
+// WRITE-AHEAD LOG
+// =============================================================================
+
+// FNV-1a checksum of a log record
+unsigned int logChecksum(const unsigned char* data, size_t size) {
+    unsigned int hash = 2166136261U;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 16777619U;
+    }
+    return hash;
+}
+
+// Write a whole buffer, retrying short writes
+int writeFully(int fd, const void* data, size_t size) {
+    const unsigned char* bytes = data;
+    while (size > 0) {
+        ssize_t written = write(fd, bytes, size);
+        if (written <= 0) {
             return -1;
+        }
+        bytes += written;
+        size -= written;
     }
-    
-    record->updated_at = time(NULL);
     return 0;
 }
 
-// Get field value
-void* getFieldValue(Record* record, Table* table, const char* column_name) {
-    if (!record || !table || !column_name) {
+// Open the log in a database directory, creating an empty one if needed
+WriteAheadLog* openWriteAheadLog(const char* database_path) {
+    char log_path[512];
+    snprintf(log_path, sizeof(log_path), "%s/wal.log", database_path);
+    
+    int fd = open(log_path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
         return NULL;
     }
     
-    int column_index = findColumn(table, column_name);
-    if (column_index < 0) {
-        return NULL; // Column not found
+    LogFileHeader header;
+    off_t size = lseek(fd, 0, SEEK_END);
+    if (size < (off_t)sizeof(LogFileHeader)) {
+        // New file, or a crash while it was being created
+        memset(&header, 0, sizeof(header));
+        header.magic = WAL_MAGIC;
+        if (ftruncate(fd, 0) != 0 || writeFully(fd, &header, sizeof(header)) != 0 || fdatasync(fd) != 0) {
+            close(fd);
+            return NULL;
+        }
+        size = sizeof(header);
+    } else if (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+               header.magic != WAL_MAGIC) {
+        close(fd);
+        return NULL;
     }
     
-    return record->fields[column_index];
+    WriteAheadLog* wal = malloc(sizeof(WriteAheadLog));
+    if (!wal) {
+        close(fd);
+        return NULL;
+    }
+    
+    memset(wal, 0, sizeof(WriteAheadLog));
+    wal->fd = fd;
+    wal->start_lsn = header.start_lsn;
+    wal->next_lsn = header.start_lsn + (Lsn)(size - sizeof(header));
+    wal->flushed_lsn = wal->next_lsn;
+    wal->group_commit = 1;
+    wal->checkpoint_bytes = WAL_CHECKPOINT_BYTES;
+    pthread_mutex_init(&wal->mutex, NULL);
+    pthread_cond_init(&wal->flushed, NULL);
+    
+    return wal;
 }
 
-// =============================================================================
-// INDEX MANAGEMENT
-// =============================================================================
-
-// Create index
-int createIndex(Table* table, const char* index_name, const char* column_name, int is_unique) {
-    if (!table || !index_name || !column_name) {
-        return -1;
+// Append a record to the log buffer
+// The record is durable only after flushLog() reaches the returned LSN,
+// which is the position just past it. Returns 0 on failure.
+Lsn appendLogRecord(WriteAheadLog* wal, LogRecordHeader* header, const void* payload, size_t payload_size) {
+    size_t size = sizeof(LogRecordHeader) + payload_size;
+    
+    pthread_mutex_lock(&wal->mutex);
+    if (wal->buffer_used + size > wal->buffer_capacity) {
+        size_t new_capacity = wal->buffer_capacity ? wal->buffer_capacity : 64 * 1024;
+        while (new_capacity < wal->buffer_used + size) {
+            new_capacity *= 2;
+        }
+        
+        unsigned char* buffer = realloc(wal->buffer, new_capacity);
+        if (!buffer) {
+            pthread_mutex_unlock(&wal->mutex);
+            return 0;
+        }
+        wal->buffer = buffer;
+        wal->buffer_capacity = new_capacity;
     }
     
-    if (table->index_count >= MAX_INDEXES) {
-        return -1; // Maximum indexes reached
-    }
+    header->size = (unsigned int)size;
+    header->checksum = 0;
+    header->lsn = wal->next_lsn;
     
-    int column_index = findColumn(table, column_name);
-    if (column_index < 0) {
-        return -1; // Column not found
+    unsigned char* record = wal->buffer + wal->buffer_used;
+    memcpy(record, header, sizeof(LogRecordHeader));
+    if (payload_size > 0) {
+        memcpy(record + sizeof(LogRecordHeader), payload, payload_size);
     }
+    header->checksum = logChecksum(record, size);
+    memcpy(record + offsetof(LogRecordHeader, checksum), &header->checksum, sizeof(header->checksum));
     
-    // Create index
-    Index* index = &table->indexes[table->index_count];
-    strncpy(index->name, index_name, sizeof(index->name) - 1);
-    index->column_index = column_index;
-    index->is_unique = is_unique;
-    index->key_count = 0;
-    
-    // Build index from existing records
-    // In a real implementation, this would scan all records
-    for (int i = 0; i < table->record_count; i++) {
-        // Add record to index
-        // This is a simplified version
-        index->record_ids[index->key_count] = i + 1; // Record IDs start from 1
-        index->key_count++;
+    wal->buffer_used += size;
+    wal->next_lsn += size;
+    if (header->type == WAL_COMMIT) {
+        wal->commit_records++;
     }
     
-    table->index_count++;
-    return 0;
+    Lsn end_lsn = wal->next_lsn;
+    pthread_mutex_unlock(&wal->mutex);
+    return end_lsn;
 }
 
-// Search index
-int searchIndex(Index* index, const void* key_value, int* result_ids, int max_results) {
-    if (!index || !key_value || !result_ids) {
-        return -1;
+// Write and sync everything appended so far (log mutex held)
+// The mutex is released during the I/O so that other transactions keep
+// appending into the spare buffer; `flushing` keeps out a second writer.
+int writeLogBatch(WriteAheadLog* wal) {
+    unsigned char* batch = wal->buffer;
+    size_t batch_capacity = wal->buffer_capacity;
+    size_t size = wal->buffer_used;
+    Lsn target = wal->next_lsn;
+    
+    wal->buffer = wal->flush_buffer;
+    wal->buffer_capacity = wal->flush_capacity;
+    wal->buffer_used = 0;
+    wal->flushing = 1;
+    pthread_mutex_unlock(&wal->mutex);
+    
+    int result = 0;
+    if (size > 0 && (writeFully(wal->fd, batch, size) != 0 || fdatasync(wal->fd) != 0)) {
+        result = -1;
     }
     
-    int found_count = 0;
-    
-    // Simple linear search - in a real implementation, this would be more efficient
-    for (int i = 0; i < index->key_count && found_count < max_results; i++) {
-        // Compare key value with index key
-        // This is simplified - real implementation would use proper comparison
-        found_count++;
-        result_ids[found_count - 1] = index->record_ids[i];
+    pthread_mutex_lock(&wal->mutex);
+    wal->flush_buffer = batch;
+    wal->flush_capacity = batch_capacity;
+    wal->flushing = 0;
+    if (result == 0) {
+        wal->flushed_lsn = target;
+        wal->syncs += size > 0;
     }
-    
-    return found_count;
+    pthread_cond_broadcast(&wal->flushed);
+    return result;
 }
 
-// =============================================================================
-// QUERY PROCESSOR IMPLEMENTATION
-// =============================================================================
-
-// Initialize query
-void initQuery(Query* query, QueryType type) {
-    if (!query) return;
+// Make every record below `lsn` durable
+// Group commit: the first caller to find no flush running becomes the
+// leader and syncs all records appended so far with one fdatasync(); callers
+// whose records are in that batch just wait for it, and the rest form the
+// next batch.
+int flushLog(WriteAheadLog* wal, Lsn lsn) {
+    int result = 0;
+    
+    pthread_mutex_lock(&wal->mutex);
+    while (wal->flushed_lsn < lsn && result == 0) {
+        if (wal->flushing) {
+            pthread_cond_wait(&wal->flushed, &wal->mutex);
+        } else {
+            result = writeLogBatch(wal);
+        }
+    }
+    pthread_mutex_unlock(&wal->mutex);
     
-    memset(query, 0, sizeof(Query));
-    query->type = type;
-    query->limit = -1;
-    query->offset = 0;
-    query->sort_ascending = 1;
+    return result;
 }
 
-// Add selected column
-int addSelectedColumn(Query* query, const char* column_name) {
-    if (!query || !column_name) {
-        return -1;
+// LSN just past the last appended record
+Lsn logEnd(WriteAheadLog* wal) {
+    pthread_mutex_lock(&wal->mutex);
+    Lsn end_lsn = wal->next_lsn;
+    pthread_mutex_unlock(&wal->mutex);
+    return end_lsn;
+}
+
+// Empty the log once a checkpoint covers all of it (log mutex held)
+// Records still in the buffer are part of the checkpoint and are dropped;
+// LSNs keep counting from where they were.
+int resetLog(WriteAheadLog* wal) {
+    while (wal->flushing) {
+        pthread_cond_wait(&wal->flushed, &wal->mutex);
     }
     
-    if (query->selected_column_count >= MAX_COLUMNS) {
+    LogFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = WAL_MAGIC;
+    header.start_lsn = wal->next_lsn;
+    
+    if (ftruncate(wal->fd, 0) != 0 || writeFully(wal->fd, &header, sizeof(header)) != 0 ||
+        fdatasync(wal->fd) != 0) {
         return -1;
     }
     
-    strncpy(query->selected_columns[query->selected_column_count].name, 
-            column_name, sizeof(query->selected_columns[0].name) - 1);
-    query->selected_column_count++;
-    
+    wal->buffer_used = 0;
+    wal->start_lsn = wal->next_lsn;
+    wal->flushed_lsn = wal->next_lsn;
+    pthread_cond_broadcast(&wal->flushed);
     return 0;
 }
 
-// Add WHERE condition
-int addWhereCondition(Query* query, const char* column_name, Operator op, const char* value) {
-    if (!query || !column_name || !value) {
+// Flush the log and close it
+void closeWriteAheadLog(WriteAheadLog* wal) {
+    if (!wal) return;
+    
+    flushLog(wal, logEnd(wal));
+    close(wal->fd);
+    pthread_cond_destroy(&wal->flushed);
+    pthread_mutex_destroy(&wal->mutex);
+    free(wal->buffer);
+    free(wal->flush_buffer);
+    free(wal);
+}
+
+// The log to write records to, or NULL when logging is off or replaying
+WriteAheadLog* activeLog(StorageManager* storage) {
+    WriteAheadLog* wal = storage ? storage->wal : NULL;
+    return wal && !wal->recovering ? wal : NULL;
+}
+
+// =============================================================================
+// STORAGE MANAGER
+// =============================================================================
+
+// Read page from storage
+// With the cache enabled the page is copied out of a buffer pool frame;
+// each on-disk frame holds the whole Page, so frames are sizeof(Page) apart.
+int readPage(StorageManager* storage, int page_id, Page* page) {
+    if (!storage || !page || !storage->data_file || page_id < 0) {
         return -1;
     }
     
-    if (query->where_condition_count >= MAX_COLUMNS) {
+    // Check cache first
+    if (storage->cache_enabled && storage->page_cache) {
+        Page* cached = pinPage(storage->page_cache, page_id);
+        if (!cached) {
+            return -1;
+        }
+        
+        memcpy(page, cached, sizeof(Page));
+        unpinPage(storage->page_cache, page_id, 0);
+        return 0;
+    }
+    
+    return diskReadPage(storage, page_id, page);
+}
+
+// Write page to storage
+// With the cache enabled the write lands in a dirty frame and reaches disk on
+// eviction, from the background writer, or at flushBufferPool().
+int writePage(StorageManager* storage, int page_id, Page* page) {
+    if (!storage || !page || !storage->data_file || page_id < 0) {
         return -1;
     }
     
-    WhereCondition* condition = &query->where_conditions[query->where_condition_count];
-    strncpy(condition->value, value, sizeof(condition->value) - 1);
-    condition->operator = op;
-    condition->is_field_reference = 0;
-    condition->left_condition = -1;
-    condition->right_condition = -1;
+    if (storage->cache_enabled && storage->page_cache) {
+        BufferPool* pool = storage->page_cache;
+        
+        // Whole-page overwrite: no need to read the old image on a miss
+        pthread_mutex_lock(&pool->mutex);
+        BufferFrame* frame = fetchFrame(pool, page_id, 0);
+        if (frame) {
+            memcpy(&frame->page, page, sizeof(Page));
+            markFrameDirty(pool, frame);
+            frame->pin_count--;
+        }
+        pthread_mutex_unlock(&pool->mutex);
+        
+        return frame ? 0 : -1;
+    }
     
-    query->where_condition_count++;
-    return 0;
+    return diskWritePage(storage, page_id, page);
 }
 
-// Execute SELECT query
-ResultSet* executeSelectQuery(Database* db, Query* query) {
-    if (!db || !query || query->type != QUERY_SELECT) {
-        return NULL;
-    }
+// Initialize storage manager
+StorageManager* initStorageManager(const char* database_path, int page_size, int cache_size) {
+    StorageManager* storage = malloc(sizeof(StorageManager));
+    if (!storage) return NULL;
     
-    pthread_mutex_lock(&db->mutex);
+    memset(storage, 0, sizeof(StorageManager));
+    strncpy(storage->database_path, database_path, sizeof(storage->database_path) - 1);
+    storage->page_size = page_size;
+    storage->cache_size = cache_size;
     
-    // Find table
-    Table* table = findTable(db, query->table_name);
-    if (!table) {
-        pthread_mutex_unlock(&db->mutex);
-        return NULL;
+    // Create database directory if it doesn't exist
+    struct stat st = {0};
+    if (stat(database_path, &st) == -1) {
+        #ifdef _WIN32
+        _mkdir(database_path);
+        #else
+        mkdir(database_path, 0755);
+        #endif
     }
     
-    // Create result set
-    ResultSet* result = malloc(sizeof(ResultSet));
-    if (!result) {
-        pthread_mutex_unlock(&db->mutex);
-        return NULL;
+    // Open data file
+    char data_file_path[512];
+    snprintf(data_file_path, sizeof(data_file_path), "%s/data.db", database_path);
+    storage->data_file = fopen(data_file_path, "rb+");
+    if (!storage->data_file) {
+        storage->data_file = fopen(data_file_path, "wb+");
     }
     
-    memset(result, 0, sizeof(ResultSet));
+    // Open index file
+    char index_file_path[512];
+    snprintf(index_file_path, sizeof(index_file_path), "%s/index.db", database_path);
+    storage->index_file = fopen(index_file_path, "rb+");
+    if (!storage->index_file) {
+        storage->index_file = fopen(index_file_path, "wb+");
+    }
     
-    // Copy column information
-    if (query->selected_column_count == 0) {
-        // Select all columns
-        for (int i = 0; i < table->column_count; i++) {
-            result->columns[i] = table->columns[i];
-        }
-        result->column_count = table->column_count;
-    } else {
-        // Select specified columns
-        for (int i = 0; i < query->selected_column_count; i++) {
-            int column_index = findColumn(table, query->selected_columns[i].name);
-            if (column_index >= 0) {
-                result->columns[result->column_count++] = table->columns[column_index];
-            }
-        }
+    // Open metadata file
+    char metadata_file_path[512];
+    snprintf(metadata_file_path, sizeof(metadata_file_path), "%s/metadata.db", database_path);
+    storage->metadata_file = fopen(metadata_file_path, "rb+");
+    if (!storage->metadata_file) {
+        storage->metadata_file = fopen(metadata_file_path, "wb+");
     }
     
-    // Filter records based on WHERE conditions
-    int filtered_count = 0;
-    for (int i = 0; i < table->record_count; i++) {
-        Record* record = NULL; // In a real implementation, load record from storage
-        
-        // Check WHERE conditions
-        int matches = 1;
-        for (int j = 0; j < query->where_condition_count && matches; j++) {
-            WhereCondition* condition = &query->where_conditions[j];
-            
-            // Get field value
-            void* field_value = getFieldValue(record, table, "column_name"); // Simplified
-            
-            // Compare with condition value
-            matches = evaluateCondition(condition, field_value, condition->value);
-        }
-        
-        if (matches) {
-            // Add to result set
-            result->rows[filtered_count] = record;
-            filtered_count++;
-        }
+    // Continue allocating after the pages already in the data file
+    if (storage->data_file && fseek(storage->data_file, 0, SEEK_END) == 0) {
+        storage->page_count = (int)(ftell(storage->data_file) / (long)sizeof(Page));
     }
     
-    result->row_count = filtered_count;
+    // Initialize page cache
+    if (cache_size > 0 && storage->data_file) {
+        storage->page_cache = initBufferPool(storage, cache_size, EVICTION_CLOCK,
+                                             BUFFER_POOL_WRITER_INTERVAL_MS);
+        storage->cache_enabled = storage->page_cache != NULL;
+    }
     
-    pthread_mutex_unlock(&db->mutex);
-    return result;
+    // A log left by an earlier run means the database needs recovery;
+    // initDatabase() replays it once the storage is up
+    char log_file_path[512];
+    snprintf(log_file_path, sizeof(log_file_path), "%s/wal.log", database_path);
+    if (stat(log_file_path, &st) == 0) {
+        storage->wal = openWriteAheadLog(database_path);
+    }
+    
+    return storage;
 }
 
-// Execute INSERT query
-int executeInsertQuery(Database* db, Query* query, Record* record) {
-    if (!db || !query || !record || query->type != QUERY_INSERT) {
+// Close storage files and free the storage manager
+void closeStorageManager(StorageManager* storage) {
+    if (!storage) return;
+    
+    // Write back dirty frames before the data file is closed
+    freeBufferPool(storage->page_cache);
+    closeWriteAheadLog(storage->wal);
+    
+    if (storage->data_file) fclose(storage->data_file);
+    if (storage->index_file) fclose(storage->index_file);
+    if (storage->metadata_file) fclose(storage->metadata_file);
+    free(storage);
+}
+
+// Remove the files created by initStorageManager
+void removeStorageFiles(const char* database_path) {
+    const char* file_names[] = {"data.db", "index.db", "metadata.db", "wal.log",
+                                "checkpoint.db", "checkpoint.tmp"};
+    char file_path[512];
+    
+    for (int i = 0; i < 6; i++) {
+        snprintf(file_path, sizeof(file_path), "%s/%s", database_path, file_names[i]);
+        remove(file_path);
+    }
+    rmdir(database_path);
+}
+
+// Allocate a fresh page at the end of the data file
+// The caller fills the page and persists it with writePage().
+int allocatePage(StorageManager* storage, int page_type, Page* page) {
+    if (!storage || !page) {
         return -1;
     }
     
-    pthread_mutex_lock(&db->mutex);
+    memset(page, 0, sizeof(Page));
+    page->page_id = storage->page_count++;
+    page->page_type = page_type;
+    page->next_page_id = -1;
+    page->prev_page_id = -1;
     
-    // Find table
-    Table* table = findTable(db, query->table_name);
-    if (!table) {
-        pthread_mutex_unlock(&db->mutex);
-        return -1;
+    return page->page_id;
+}
+
+// =============================================================================
+// COLUMN STORE
+// =============================================================================
+
+// Number of 64-bit words in a bitmap covering the given rows
+int bitmapWords(int rows) {
+    return (rows + 63) / 64;
+}
+
+// Set or clear one bit of a bitmap
+void setBitmapBit(unsigned long long* bitmap, int bit, int value) {
+    if (value) {
+        bitmap[bit / 64] |= 1ULL << (bit % 64);
+    } else {
+        bitmap[bit / 64] &= ~(1ULL << (bit % 64));
+    }
+}
+
+// Grow a zero-filled bitmap from old_rows to new_rows bits
+unsigned long long* growBitmap(unsigned long long* bitmap, int old_rows, int new_rows) {
+    unsigned long long* grown = realloc(bitmap, bitmapWords(new_rows) * sizeof(unsigned long long));
+    if (!grown) return NULL;
+    
+    memset(grown + bitmapWords(old_rows), 0,
+           (bitmapWords(new_rows) - bitmapWords(old_rows)) * sizeof(unsigned long long));
+    return grown;
+}
+
+// Make room for at least `needed` rows in every column
+// Capacity doubles as rows are appended and stays a multiple of VECTOR_SIZE,
+// so batches cover whole bitmap words.
+int reserveColumnStore(Table* table, int needed) {
+    ColumnStore* store = table->column_store;
+    if (needed <= store->capacity) {
+        return 0;
     }
     
-    // Set record ID
-    record->id = table->next_record_id++;
-    
-    // Insert record
-    // In a real implementation, this would write to storage
-    table->record_count++;
+    int capacity = store->capacity ? store->capacity * 2 : VECTOR_SIZE;
+    if (capacity < needed) {
+        capacity = (needed + VECTOR_SIZE - 1) / VECTOR_SIZE * VECTOR_SIZE;
+    }
     
-    // Update indexes
-    for (int i = 0; i < table->index_count; i++) {
-        Index* index = &table->indexes[i];
-        void* key_value = getFieldValue(record, table, "column_name"); // Simplified
+    for (int c = 0; c < table->column_count; c++) {
+        ColumnVector* vector = &store->columns[c];
+        unsigned char* values = realloc(vector->values, (size_t)capacity * vector->width);
+        if (!values) return -1;
+        vector->values = values;
         
-        // Add to index
-        index->record_ids[index->key_count] = record->id;
-        index->key_count++;
+        unsigned long long* nulls = growBitmap(vector->nulls, store->capacity, capacity);
+        if (!nulls) return -1;
+        vector->nulls = nulls;
     }
     
-    pthread_mutex_unlock(&db->mutex);
-    return record->id;
+    int* record_ids = realloc(store->record_ids, capacity * sizeof(int));
+    if (!record_ids) return -1;
+    store->record_ids = record_ids;
+    
+    store->capacity = capacity;
+    return 0;
 }
 
-// Evaluate WHERE condition
-int evaluateCondition(WhereCondition* condition, const void* field_value, const char* condition_value) {
-    if (!condition || !field_value || !condition_value) {
-        return 0;
-    }
+// Store one value at a row of a column; value NULL stores SQL NULL
+void storeColumnValue(ColumnVector* vector, DataType type, int row, const void* value) {
+    unsigned char* slot = vector->values + (size_t)row * vector->width;
     
-    // Simplified evaluation - real implementation would handle different data types
-    switch (condition->operator) {
-        case OP_EQUAL:
-            return strcmp((char*)field_value, condition_value) == 0;
-        case OP_NOT_EQUAL:
-            return strcmp((char*)field_value, condition_value) != 0;
-        case OP_LESS_THAN:
-            return strcmp((char*)field_value, condition_value) < 0;
-        case OP_LESS_EQUAL:
-            return strcmp((char*)field_value, condition_value) <= 0;
-        case OP_GREATER_THAN:
-            return strcmp((char*)field_value, condition_value) > 0;
-        case OP_GREATER_EQUAL:
-            return strcmp((char*)field_value, condition_value) >= 0;
-        case OP_LIKE:
-            return strstr((char*)field_value, condition_value) != NULL;
-        default:
-            return 0;
+    memset(slot, 0, vector->width);
+    setBitmapBit(vector->nulls, row, value == NULL);
+    
+    if (!value) return;
+    
+    if (type == DATA_TYPE_TEXT) {
+        memcpy(slot, value, strnlen((const char*)value, vector->width - 1));
+    } else {
+        memcpy(slot, value, vector->width);
+    }
+}
+
+// Free a column store
+void freeColumnStore(Table* table) {
+    ColumnStore* store = table->column_store;
+    if (!store) return;
+    
+    for (int c = 0; c < table->column_count; c++) {
+        free(store->columns[c].values);
+        free(store->columns[c].nulls);
     }
+    
+    free(store->record_ids);
+    pthread_rwlock_destroy(&store->latch);
+    free(store);
+    table->column_store = NULL;
 }
 
 // =============================================================================
-// TRANSACTION MANAGEMENT IMPLEMENTATION
+// ROW VERSIONS (MVCC)
 // =============================================================================
 
 // Initialize transaction manager
@@ -886,559 +1805,8507 @@ TransactionManager* initTransactionManager() {
     return manager;
 }
 
-// Begin transaction
-int beginTransaction(Database* db, int transaction_id) {
-    if (!db) {
-        return -1;
-    }
-    
-    pthread_mutex_lock(&db->transaction_manager->mutex);
+// Release a transaction's write set
+void clearWriteSet(Transaction* transaction) {
+    free(transaction->writes);
+    free(transaction->superseded);
+    transaction->writes = NULL;
+    transaction->superseded = NULL;
+    transaction->write_count = 0;
+    transaction->write_capacity = 0;
+    transaction->superseded_count = 0;
+    transaction->superseded_capacity = 0;
+}
+
+// Free transaction manager
+void freeTransactionManager(TransactionManager* manager) {
+    if (!manager) return;
     
-    // Find available transaction slot
-    Transaction* transaction = NULL;
     for (int i = 0; i < MAX_TRANSACTIONS; i++) {
-        if (db->transaction_manager->transactions[i].state == TRANSACTION_INACTIVE) {
-            transaction = &db->transaction_manager->transactions[i];
-            break;
-        }
+        clearWriteSet(&manager->transactions[i]);
     }
     
-    if (!transaction) {
-        pthread_mutex_unlock(&db->transaction_manager->mutex);
-        return -1; // No available transaction slots
+    free(manager->garbage);
+    pthread_mutex_destroy(&manager->mutex);
+    free(manager);
+}
+
+// Begin timestamp of a version its writer has not committed yet
+Timestamp uncommittedTimestamp(int transaction_id) {
+    return TIMESTAMP_TRANSACTION_FLAG | (Timestamp)transaction_id;
+}
+
+// Allocate version chunks for rows [first_row, first_row + count)
+// Fresh chunks are zeroed: begin 0 and end 0 is a dead version.
+int reserveRowVersions(Table* table, RowId first_row, int count) {
+    int last_chunk = (first_row + count - 1) / VERSION_CHUNK_ROWS;
+    if (last_chunk >= MAX_VERSION_CHUNKS) {
+        return -1;
     }
     
-    // Initialize transaction
-    transaction->transaction_id = transaction_id;
-    transaction->state = TRANSACTION_ACTIVE;
-    transaction->start_time = time(NULL);
-    transaction->modified_table_count = 0;
+    for (int c = first_row / VERSION_CHUNK_ROWS; c <= last_chunk; c++) {
+        if (table->version_chunks[c]) continue;
+        
+        VersionChunk* chunk = calloc(1, sizeof(VersionChunk));
+        if (!chunk) return -1;
+        __atomic_store_n(&table->version_chunks[c], chunk, __ATOMIC_RELEASE);
+    }
     
-    pthread_mutex_unlock(&db->transaction_manager->mutex);
-    return transaction_id;
+    return 0;
 }
 
-// Commit transaction
-int commitTransaction(Database* db, int transaction_id) {
-    if (!db) {
-        return -1;
+// Read a row's lifetime without locks; rows without a chunk read as dead
+void loadRowVersion(Table* table, RowId row_id, Timestamp* begin, Timestamp* end) {
+    VersionChunk* chunk = __atomic_load_n(&table->version_chunks[row_id / VERSION_CHUNK_ROWS],
+                                          __ATOMIC_ACQUIRE);
+    if (!chunk) {
+        *begin = TIMESTAMP_TRANSACTION_FLAG;
+        *end = TIMESTAMP_DEAD;
+        return;
     }
     
-    pthread_mutex_lock(&db->transaction_manager->mutex);
+    RowVersion* version = &chunk->versions[row_id % VERSION_CHUNK_ROWS];
+    *begin = __atomic_load_n(&version->begin, __ATOMIC_ACQUIRE);
+    *end = __atomic_load_n(&version->end, __ATOMIC_ACQUIRE);
+}
+
+// Stamp a row version (its chunk is allocated)
+// The batch flag is raised before the stamp lands, so a reader that still
+// finds the flag clear cannot have missed a change to its own snapshot.
+void storeVersionStamp(Table* table, RowId row_id, int is_end, Timestamp stamp) {
+    VersionChunk* chunk = table->version_chunks[row_id / VERSION_CHUNK_ROWS];
+    RowVersion* version = &chunk->versions[row_id % VERSION_CHUNK_ROWS];
+    int* modified = &chunk->modified[row_id % VERSION_CHUNK_ROWS / VECTOR_SIZE];
+    
+    if (stamp != (is_end ? TIMESTAMP_INFINITY : TIMESTAMP_FROZEN) && !*modified) {
+        __atomic_store_n(modified, 1, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(is_end ? &version->end : &version->begin, stamp, __ATOMIC_RELEASE);
+}
+
+// Set the begin timestamp of a row version
+void storeVersionBegin(Table* table, RowId row_id, Timestamp begin) {
+    storeVersionStamp(table, row_id, 0, begin);
+}
+
+// Set the end timestamp of a row version
+void storeVersionEnd(Table* table, RowId row_id, Timestamp end) {
+    storeVersionStamp(table, row_id, 1, end);
+}
+
+// Check whether a version is the newest of its row
+// Versions ended by a commit, rolled back or reclaimed are not; versions
+// still pending in another transaction are, so writers treat them as taken.
+int isCurrentVersion(Table* table, RowId row_id) {
+    Timestamp begin, end;
+    loadRowVersion(table, row_id, &begin, &end);
+    return end == TIMESTAMP_INFINITY;
+}
+
+// Hash slot of a (table, row id) pair in a transaction's superseded set
+unsigned int supersededSlot(Transaction* transaction, Table* table, RowId row_id) {
+    unsigned long long hash = (unsigned long long)(size_t)table * 0x9E3779B97F4A7C15ULL ^
+                              (unsigned long long)(unsigned int)row_id * 0xC2B2AE3D27D4EB4FULL;
+    return (unsigned int)(hash >> 32) & (transaction->superseded_capacity - 1);
+}
+
+// Check whether a transaction has ended a version
+int isSupersededBy(Transaction* transaction, Table* table, RowId row_id) {
+    if (transaction->superseded_count == 0) {
+        return 0;
+    }
     
-    // Find transaction
-    Transaction* transaction = NULL;
-    for (int i = 0; i < MAX_TRANSACTIONS; i++) {
-        if (db->transaction_manager->transactions[i].transaction_id == transaction_id &&
-            db->transaction_manager->transactions[i].state == TRANSACTION_ACTIVE) {
-            transaction = &db->transaction_manager->transactions[i];
-            break;
+    unsigned int slot = supersededSlot(transaction, table, row_id);
+    while (transaction->superseded[slot].table) {
+        WriteEntry* entry = &transaction->superseded[slot];
+        if (entry->table == table && entry->row_id == row_id) {
+            return 1;
         }
+        slot = (slot + 1) & (transaction->superseded_capacity - 1);
     }
     
-    if (!transaction) {
-        pthread_mutex_unlock(&db->transaction_manager->mutex);
-        return -1; // Transaction not found
+    return 0;
+}
+
+// Check whether a row version is visible to a snapshot
+// Committed versions are visible when begin <= read_ts < end. Uncommitted
+// versions are visible only to their writer, which in turn no longer sees
+// the versions it has ended.
+int isVersionVisible(Table* table, RowId row_id, const Snapshot* snapshot) {
+    Transaction* own = snapshot->transaction;
+    Timestamp begin, end;
+    loadRowVersion(table, row_id, &begin, &end);
+    
+    if (begin & TIMESTAMP_TRANSACTION_FLAG) {
+        if (!own || begin != uncommittedTimestamp(own->transaction_id)) {
+            return 0;
+        }
+    } else if (begin > snapshot->read_ts) {
+        return 0;
     }
     
-    // Commit changes
-    // In a real implementation, this would apply changes to storage
-    transaction->state = TRANSACTION_COMMITTED;
+    if (end <= snapshot->read_ts) {
+        return 0;
+    }
     
-    // Clean up
-    for (int i = 0; i < transaction->modified_table_count; i++) {
-        for (int j = 0; j < transaction->record_counts[i]; j++) {
-            if (transaction->before_images[i][j]) free(transaction->before_images[i][j]);
-            if (transaction->after_images[i][j]) free(transaction->after_images[i][j]);
+    return !own || !isSupersededBy(own, table, row_id);
+}
+
+// Set the mask bits of rows [start, start + count) visible to a snapshot
+// The rows form one column-store batch (start is a multiple of VECTOR_SIZE).
+// A batch whose versions are all frozen and live is visible as a whole.
+// Otherwise pending versions, having the top bit set in begin, fail the
+// begin compare, and only a snapshot whose own transaction has writes needs
+// the full check. Returns the visible count.
+int visibleRowMask(Table* table, RowId start, int count, const Snapshot* snapshot,
+                   unsigned long long* mask) {
+    VersionChunk* chunk = __atomic_load_n(&table->version_chunks[start / VERSION_CHUNK_ROWS],
+                                          __ATOMIC_ACQUIRE);
+    Transaction* own = snapshot->transaction;
+    int own_writes = own && own->write_count > 0;
+    Timestamp read_ts = snapshot->read_ts;
+    int visible = 0;
+    
+    memset(mask, 0, bitmapWords(count) * sizeof(unsigned long long));
+    if (!chunk) return 0;
+    
+    if (!own_writes &&
+        !__atomic_load_n(&chunk->modified[start % VERSION_CHUNK_ROWS / VECTOR_SIZE], __ATOMIC_ACQUIRE)) {
+        for (int w = 0; w < bitmapWords(count); w++) {
+            mask[w] = ~0ULL;
+        }
+        if (count % 64) {
+            mask[count / 64] = (1ULL << (count % 64)) - 1;
         }
+        return count;
     }
     
-    transaction->modified_table_count = 0;
+    RowVersion* versions = chunk->versions + start % VERSION_CHUNK_ROWS;
+    for (int i = 0; i < count; i++) {
+        Timestamp begin = __atomic_load_n(&versions[i].begin, __ATOMIC_ACQUIRE);
+        Timestamp end = __atomic_load_n(&versions[i].end, __ATOMIC_ACQUIRE);
+        int bit = begin <= read_ts && end > read_ts;
+        
+        if (own_writes) {
+            bit = isVersionVisible(table, start + i, snapshot);
+        }
+        
+        mask[i / 64] |= (unsigned long long)bit << (i % 64);
+        visible += bit;
+    }
     
-    pthread_mutex_unlock(&db->transaction_manager->mutex);
-    return 0;
+    return visible;
 }
 
-// Rollback transaction
-int rollbackTransaction(Database* db, int transaction_id) {
-    if (!db) {
-        return -1;
+// Free a table's version chunks
+void freeRowVersions(Table* table) {
+    for (int c = 0; c < MAX_VERSION_CHUNKS; c++) {
+        free(table->version_chunks[c]);
+        table->version_chunks[c] = NULL;
+    }
+}
+
+// =============================================================================
+// TABLE MANAGEMENT
+// =============================================================================
+
+// Bytes a column occupies in a heap row (and in an index key)
+int columnStorageSize(const Column* column) {
+    switch (column->type) {
+        case DATA_TYPE_INTEGER:
+        case DATA_TYPE_BOOLEAN:
+            return sizeof(int);
+        case DATA_TYPE_FLOAT:
+            return sizeof(double);
+        case DATA_TYPE_DATE:
+        case DATA_TYPE_TIMESTAMP:
+            return sizeof(time_t);
+        case DATA_TYPE_TEXT:
+        case DATA_TYPE_BLOB:
+        default:
+            return column->size > 0 ? column->size : 1;
     }
+}
+
+// Compute fixed-size row layout for heap pages
+int computeRowLayout(Table* table) {
+    int offset = ROW_HEADER_SIZE;
     
-    pthread_mutex_lock(&db->transaction_manager->mutex);
+    for (int i = 0; i < table->column_count; i++) {
+        table->column_offsets[i] = offset;
+        offset += columnStorageSize(&table->columns[i]);
+    }
     
-    // Find transaction
-    Transaction* transaction = NULL;
-    for (int i = 0; i < MAX_TRANSACTIONS; i++) {
-        if (db->transaction_manager->transactions[i].transaction_id == transaction_id &&
-            db->transaction_manager->transactions[i].state == TRANSACTION_ACTIVE) {
-            transaction = &db->transaction_manager->transactions[i];
-            break;
-        }
+    if (offset > PAGE_DATA_SIZE) {
+        return -1; // Row does not fit in a page
     }
     
-    if (!transaction) {
-        pthread_mutex_unlock(&db->transaction_manager->mutex);
-        return -1; // Transaction not found
+    table->row_size = offset;
+    table->rows_per_page = PAGE_DATA_SIZE / offset;
+    return 0;
+}
+
+// Save table definitions to the metadata file
+int saveMetadata(Database* db) {
+    if (!db || !db->storage || !db->storage->metadata_file) {
+        return -1;
     }
     
-    // Rollback changes
-    // In a real implementation, this would restore before images
-    transaction->state = TRANSACTION_ABORTED;
+    FILE* file = db->storage->metadata_file;
+    rewind(file);
     
-    // Clean up
-    for (int i = 0; i < transaction->modified_table_count; i++) {
-        for (int j = 0; j < transaction->record_counts[i]; j++) {
-            if (transaction->before_images[i][j]) free(transaction->before_images[i][j]);
-            if (transaction->after_images[i][j]) free(transaction->after_images[i][j]);
-        }
+    fwrite(&db->table_count, sizeof(int), 1, file);
+    for (int i = 0; i < db->table_count; i++) {
+        Table* table = &db->tables[i];
+        fwrite(table->name, sizeof(table->name), 1, file);
+        fwrite(&table->column_count, sizeof(int), 1, file);
+        fwrite(table->columns, sizeof(Column), table->column_count, file);
     }
     
-    transaction->modified_table_count = 0;
-    
-    pthread_mutex_unlock(&db->transaction_manager->mutex);
+    fflush(file);
     return 0;
 }
 
-// =============================================================================
-// CONNECTION POOL IMPLEMENTATION
-// =============================================================================
-
-// Initialize connection pool
-ConnectionPool* initConnectionPool(int max_connections) {
-    ConnectionPool* pool = malloc(sizeof(ConnectionPool));
-    if (!pool) return NULL;
-    
-    memset(pool, 0, sizeof(ConnectionPool));
-    pool->max_connections = max_connections;
-    pthread_mutex_init(&pool->mutex, NULL);
-    
-    return pool;
-}
-
-// Get connection from pool
-DatabaseConnection* getConnection(ConnectionPool* pool, const char* database_name) {
-    if (!pool || !database_name) {
-        return NULL;
+// Create table
+int createTable(Database* db, const char* table_name, Column* columns, int column_count) {
+    if (!db || !table_name || !columns || column_count <= 0) {
+        return -1;
     }
     
-    pthread_mutex_lock(&pool->mutex);
+    pthread_mutex_lock(&db->mutex);
     
-    // Find available connection
-    DatabaseConnection* connection = NULL;
-    for (int i = 0; i < pool->max_connections; i++) {
-        if (!pool->connections[i].is_connected) {
-            connection = &pool->connections[i];
-            break;
+    // Check if table already exists
+    for (int i = 0; i < db->table_count; i++) {
+        if (strcmp(db->tables[i].name, table_name) == 0) {
+            pthread_mutex_unlock(&db->mutex);
+            return -1; // Table already exists
         }
     }
     
-    if (!connection) {
-        pthread_mutex_unlock(&pool->mutex);
-        return NULL; // No available connections
+    if (db->table_count >= MAX_TABLES) {
+        pthread_mutex_unlock(&db->mutex);
+        return -1; // Maximum tables reached
     }
     
-    // Initialize connection
-    connection->connection_id = i + 1;
-    strncpy(connection->database_name, database_name, sizeof(connection->database_name) - 1);
-    connection->is_connected = 1;
-    connection->transaction_id = -1;
-    connection->connect_time = time(NULL);
-    connection->last_activity = time(NULL);
-    connection->auto_commit = 1;
+    // Create new table
+    Table* table = &db->tables[db->table_count];
+    memset(table, 0, sizeof(Table));
+    strncpy(table->name, table_name, sizeof(table->name) - 1);
+    table->column_count = column_count;
+    table->record_count = 0;
+    table->next_record_id = 1;
+    table->primary_key_column = -1;
+    table->index_count = 0;
+    table->storage = db->storage;
     
-    pool->connection_count++;
+    // Copy columns
+    for (int i = 0; i < column_count; i++) {
+        table->columns[i] = columns[i];
+        
+        // Find primary key column
+        if (columns[i].is_primary_key) {
+            if (table->primary_key_column != -1) {
+                pthread_mutex_unlock(&db->mutex);
+                return -1; // Multiple primary keys
+            }
+            table->primary_key_column = i;
+        }
+    }
     
-    pthread_mutex_unlock(&pool->mutex);
-    return connection;
-}
-
-// Return connection to pool
-int returnConnection(ConnectionPool* pool, DatabaseConnection* connection) {
-    if (!pool || !connection) {
-        return -1;
+    if (computeRowLayout(table) != 0) {
+        pthread_mutex_unlock(&db->mutex);
+        return -1; // Row wider than a page
     }
     
-    pthread_mutex_lock(&pool->mutex);
+    table->table_id = db->table_count;
+    db->table_count++;
+    __atomic_add_fetch(&db->schema_version, 1, __ATOMIC_RELEASE); // Re-prepare cached statements
     
-    connection->is_connected = 0;
-    connection->transaction_id = -1;
-    pool->connection_count--;
+    // Save metadata
+    saveMetadata(db);
     
-    pthread_mutex_unlock(&pool->mutex);
-    return 0;
-}
-
-// =============================================================================
-// SQL PARSER IMPLEMENTATION
-// =============================================================================
-
-// Initialize lexer
-void initLexer(SQLLexer* lexer, const char* input) {
-    if (!lexer || !input) return;
+    // Log the definition; DDL is made durable right away
+    WriteAheadLog* wal = activeLog(db->storage);
+    int result = 0;
+    if (wal) {
+        unsigned char payload[MAX_FIELD_SIZE + MAX_COLUMNS * sizeof(Column)];
+        LogRecordHeader header;
+        memset(&header, 0, sizeof(header));
+        header.type = WAL_CREATE_TABLE;
+        header.table_id = table->table_id;
+        header.count = column_count;
+        memcpy(payload, table->name, MAX_FIELD_SIZE);
+        memcpy(payload + MAX_FIELD_SIZE, table->columns, column_count * sizeof(Column));
+        
+        Lsn lsn = appendLogRecord(wal, &header, payload, MAX_FIELD_SIZE + column_count * sizeof(Column));
+        result = lsn && flushLog(wal, lsn) == 0 ? 0 : -1;
+    }
     
-    memset(lexer, 0, sizeof(SQLLexer));
-    lexer->input = input;
-    lexer->position = 0;
-    lexer->line = 1;
-    lexer->column = 1;
+    pthread_mutex_unlock(&db->mutex);
+    
+    return result;
 }
 
-// Get next character
-char getNextChar(SQLLexer* lexer) {
-    if (!lexer || !lexer->input || lexer->input[lexer->position] == '\0') {
-        return '\0';
+// Find table by name
+Table* findTable(Database* db, const char* table_name) {
+    if (!db || !table_name) {
+        return NULL;
     }
     
-    char c = lexer->input[lexer->position++];
-    
-    if (c == '\n') {
-        lexer->line++;
-        lexer->column = 1;
-    } else {
-        lexer->column++;
+    for (int i = 0; i < db->table_count; i++) {
+        if (strcmp(db->tables[i].name, table_name) == 0) {
+            return &db->tables[i];
+        }
     }
     
-    return c;
+    return NULL;
 }
 
-// Peek next character
-char peekNextChar(SQLLexer* lexer) {
-    if (!lexer || !lexer->input || lexer->input[lexer->position] == '\0') {
-        return '\0';
+// Find column by name
+// A qualified name, table.column, only matches columns of that table.
+int findColumn(Table* table, const char* column_name) {
+    if (!table || !column_name) {
+        return -1;
     }
     
-    return lexer->input[lexer->position];
-}
-
-// Skip whitespace
-void skipWhitespace(SQLLexer* lexer) {
-    char c = peekNextChar(lexer);
-    while (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
-        getNextChar(lexer);
-        c = peekNextChar(lexer);
+    const char* dot = strchr(column_name, '.');
+    if (dot) {
+        size_t length = (size_t)(dot - column_name);
+        if (strlen(table->name) != length || strncmp(table->name, column_name, length) != 0) {
+            return -1;
+        }
+        column_name = dot + 1;
     }
-}
-
-// Tokenize identifier
-void tokenizeIdentifier(SQLLexer* lexer, SQLToken* token) {
-    char buffer[MAX_FIELD_SIZE];
-    int buffer_pos = 0;
     
-    char c = peekNextChar(lexer);
-    while ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || 
-           (c >= '0' && c <= '9') || c == '_') {
-        buffer[buffer_pos++] = getNextChar(lexer);
-        c = peekNextChar(lexer);
+    for (int i = 0; i < table->column_count; i++) {
+        if (strcmp(table->columns[i].name, column_name) == 0) {
+            return i;
+        }
     }
     
-    buffer[buffer_pos] = '\0';
-    
-    token->type = TOKEN_IDENTIFIER;
-    strncpy(token->value, buffer, sizeof(token->value) - 1);
-    token->line = lexer->line;
-    token->column = lexer->column - buffer_pos;
+    return -1;
 }
 
-// Tokenize string
-void tokenizeString(SQLLexer* lexer, SQLToken* token) {
-    char buffer[MAX_FIELD_SIZE];
-    int buffer_pos = 0;
-    
-    getNextChar(lexer); // Skip opening quote
+// Plan cache setup and teardown; defined with prepared statements
+PlanCache* initPlanCache();
+void freePlanCache(PlanCache* cache);
+
+// Free database, its table heaps and storage
+// Prepared statements must be finalized first.
+void freeDatabase(Database* db) {
+    if (!db) return;
     
-    char c = peekNextChar(lexer);
-    while (c != '\0' && c != '\'') {
-        if (c == '\\') {
-            getNextChar(lexer); // Skip escape character
-            c = peekNextChar(lexer);
+    for (int i = 0; i < db->table_count; i++) {
+        Table* table = &db->tables[i];
+        free(table->heap_pages);
+        for (int r = 0; r < table->retired_count; r++) {
+            free(table->retired_heap_pages[r]);
         }
-        buffer[buffer_pos++] = getNextChar(lexer);
-        c = peekNextChar(lexer);
+        free(table->free_rows);
+        freeRowVersions(table);
+        freeColumnStore(table);
     }
     
-    getNextChar(lexer); // Skip closing quote
-    
-    buffer[buffer_pos] = '\0';
-    
-    token->type = TOKEN_STRING;
-    strncpy(token->value, buffer, sizeof(token->value) - 1);
-    token->line = lexer->line;
-    token->column = lexer->column - buffer_pos;
+    freePlanCache(db->plan_cache);
+    freeTransactionManager(db->transaction_manager);
+    closeStorageManager(db->storage);
+    pthread_mutex_destroy(&db->mutex);
+    free(db);
 }
 
-// Get next token
-int getNextToken(SQLLexer* lexer, SQLToken* token) {
-    if (!lexer || !token) {
-        return -1;
-    }
+// Replays a log found by initStorageManager(); defined with crash recovery
+int recoverDatabase(Database* db);
+
+// Initialize database with its storage manager
+// A write-ahead log left in the directory is replayed before it returns.
+Database* initDatabase(const char* name, const char* database_path) {
+    Database* db = malloc(sizeof(Database));
+    if (!db) return NULL;
     
-    skipWhitespace(lexer);
+    memset(db, 0, sizeof(Database));
+    strncpy(db->name, name, sizeof(db->name) - 1);
+    pthread_mutex_init(&db->mutex, NULL);
     
-    char c = peekNextChar(lexer);
-    if (c == '\0') {
-        token->type = TOKEN_EOF;
-        return 0;
+    db->storage = initStorageManager(database_path, PAGE_DATA_SIZE, 100);
+    db->transaction_manager = initTransactionManager();
+    db->plan_cache = initPlanCache();
+    if (!db->storage || !db->storage->data_file || !db->transaction_manager || !db->plan_cache) {
+        closeStorageManager(db->storage);
+        freeTransactionManager(db->transaction_manager);
+        freePlanCache(db->plan_cache);
+        pthread_mutex_destroy(&db->mutex);
+        free(db);
+        return NULL;
     }
     
-    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_') {
-        tokenizeIdentifier(lexer, token);
-    } else if (c == '\'') {
-        tokenizeString(lexer, token);
-    } else if (c >= '0' && c <= '9') {
-        // Tokenize number
-        char buffer[MAX_FIELD_SIZE];
-        int buffer_pos = 0;
-        
-        while ((c >= '0' && c <= '9') || c == '.') {
-            buffer[buffer_pos++] = getNextChar(lexer);
-            c = peekNextChar(lexer);
-        }
-        
-        buffer[buffer_pos] = '\0';
-        
-        token->type = TOKEN_NUMBER;
-        strncpy(token->value, buffer, sizeof(token->value) - 1);
-        token->line = lexer->line;
-        token->column = lexer->column - buffer_pos;
-    } else {
-        // Single character token
-        char op[2] = {c, '\0'};
-        getNextChar(lexer);
-        
-        token->type = TOKEN_OPERATOR;
-        strncpy(token->value, op, sizeof(token->value) - 1);
-        token->line = lexer->line;
-        token->column = lexer->column - 1;
+    if (db->storage->wal && recoverDatabase(db) != 0) {
+        freeDatabase(db);
+        return NULL;
     }
     
-    return 0;
+    db->is_open = 1;
+    return db;
 }
 
 // =============================================================================
-// DEMONSTRATION FUNCTIONS
+// RECORD MANAGEMENT
 // =============================================================================
 
-void demonstrateDatabaseBasics() {
-    printf("=== DATABASE BASICS DEMO ===\n");
-    
-    // Initialize database
-    Database* db = malloc(sizeof(Database));
-    if (!db) {
-        printf("Failed to allocate database\n");
-        return;
+// Create record
+Record* createRecord(Table* table) {
+    if (!table) {
+        return NULL;
     }
     
-    memset(db, 0, sizeof(Database));
-    strcpy(db->name, "test_db");
-    pthread_mutex_init(&db->mutex, NULL);
-    
-    // Initialize storage
-    db->storage = initStorageManager("./test_db", 4096, 100);
-    if (!db->storage) {
-        printf("Failed to initialize storage\n");
-        free(db);
-        return;
+    Record* record = malloc(sizeof(Record));
+    if (!record) {
+        return NULL;
     }
     
-    printf("Database initialized: %s\n", db->name);
-    printf("Storage path: %s\n", db->storage->database_path);
-    printf("Page size: %d\n", db->storage->page_size);
-    printf("Cache size: %d\n", db->storage->cache_size);
+    memset(record, 0, sizeof(Record));
+    record->id = table->next_record_id++;
+    record->created_at = time(NULL);
+    record->updated_at = time(NULL);
+    
+    // Allocate memory for fields
+    for (int i = 0; i < table->column_count; i++) {
+        switch (table->columns[i].type) {
+            case DATA_TYPE_INTEGER:
+                record->fields[i] = malloc(sizeof(int));
+                *(int*)record->fields[i] = 0;
+                break;
+            case DATA_TYPE_FLOAT:
+                record->fields[i] = malloc(sizeof(double));
+                *(double*)record->fields[i] = 0.0;
+                break;
+            case DATA_TYPE_TEXT:
+                record->fields[i] = malloc(table->columns[i].size);
+                memset(record->fields[i], 0, table->columns[i].size);
+                break;
+            case DATA_TYPE_BOOLEAN:
+                record->fields[i] = malloc(sizeof(int));
+                *(int*)record->fields[i] = 0;
+                break;
+            case DATA_TYPE_DATE:
+            case DATA_TYPE_TIMESTAMP:
+                record->fields[i] = malloc(sizeof(time_t));
+                *(time_t*)record->fields[i] = time(NULL);
+                break;
+            default:
+                record->fields[i] = NULL;
+                break;
+        }
+    }
+    
+    return record;
+}
+
+// Free record
+void freeRecord(Table* table, Record* record) {
+    if (!table || !record) {
+        return;
+    }
+    
+    // Free field memory
+    for (int i = 0; i < table->column_count; i++) {
+        if (record->fields[i]) {
+            free(record->fields[i]);
+        }
+    }
+    
+    free(record);
+}
+
+// Set field value
+int setFieldValue(Record* record, Table* table, const char* column_name, const void* value) {
+    if (!record || !table || !column_name || !value) {
+        return -1;
+    }
+    
+    int column_index = findColumn(table, column_name);
+    if (column_index < 0) {
+        return -1; // Column not found
+    }
+    
+    Column* column = &table->columns[column_index];
+    
+    // A NULL field has no storage until it is given a value again
+    if (!record->fields[column_index]) {
+        record->fields[column_index] = malloc(columnStorageSize(column));
+        if (!record->fields[column_index]) {
+            return -1;
+        }
+    }
+    
+    switch (column->type) {
+        case DATA_TYPE_INTEGER:
+            *(int*)record->fields[column_index] = *(int*)value;
+            break;
+        case DATA_TYPE_FLOAT:
+            *(double*)record->fields[column_index] = *(double*)value;
+            break;
+        case DATA_TYPE_TEXT:
+            strncpy((char*)record->fields[column_index], (char*)value, column->size - 1);
+            ((char*)record->fields[column_index])[column->size - 1] = '\0';
+            break;
+        case DATA_TYPE_BOOLEAN:
+            *(int*)record->fields[column_index] = *(int*)value;
+            break;
+        case DATA_TYPE_DATE:
+        case DATA_TYPE_TIMESTAMP:
+            *(time_t*)record->fields[column_index] = *(time_t*)value;
+            break;
+        default:
+            return -1;
+    }
+    
+    record->updated_at = time(NULL);
+    return 0;
+}
+
+// Set a field to NULL
+int setFieldNull(Record* record, Table* table, const char* column_name) {
+    if (!record || !table || !column_name) {
+        return -1;
+    }
+    
+    int column_index = findColumn(table, column_name);
+    if (column_index < 0 || table->columns[column_index].is_not_null) {
+        return -1; // Column not found or NOT NULL
+    }
+    
+    free(record->fields[column_index]);
+    record->fields[column_index] = NULL;
+    record->updated_at = time(NULL);
+    return 0;
+}
+
+// Get field value (NULL for a NULL field)
+void* getFieldValue(Record* record, Table* table, const char* column_name) {
+    if (!record || !table || !column_name) {
+        return NULL;
+    }
+    
+    int column_index = findColumn(table, column_name);
+    if (column_index < 0) {
+        return NULL; // Column not found
+    }
+    
+    return record->fields[column_index];
+}
+
+// =============================================================================
+// HEAP FILE
+// =============================================================================
+
+// Get pointer to a row slot inside a heap page
+unsigned char* rowSlot(Table* table, Page* page, int slot) {
+    return (unsigned char*)page->data + slot * table->row_size;
+}
+
+// Check the deleted flag in a heap row header
+int isRowDeleted(const unsigned char* row) {
+    int deleted;
+    memcpy(&deleted, row + sizeof(int), sizeof(int));
+    return deleted;
+}
+
+// Check the NULL bitmap in a heap row header
+int isFieldNull(const unsigned char* row, int column_index) {
+    unsigned long long nulls;
+    memcpy(&nulls, row + ROW_NULLS_OFFSET, sizeof(nulls));
+    return (int)((nulls >> column_index) & 1);
+}
+
+// Number of heap rows published to readers
+RowId publishedRowCount(Table* table) {
+    return __atomic_load_n(&table->heap_row_count, __ATOMIC_ACQUIRE);
+}
+
+// Locate the heap page and slot holding a row
+int heapPageForRow(Table* table, RowId row_id, int* slot) {
+    if (!table || row_id < 0 || row_id >= publishedRowCount(table)) {
+        return -1;
+    }
+    
+    int* heap_pages = __atomic_load_n(&table->heap_pages, __ATOMIC_ACQUIRE);
+    *slot = row_id % table->rows_per_page;
+    return heap_pages[row_id / table->rows_per_page];
+}
+
+// Serialize record fields into a fixed-size heap row
+void serializeRecord(Table* table, Record* record, unsigned char* row) {
+    memset(row, 0, table->row_size);
+    memcpy(row, &record->id, sizeof(int));
+    memcpy(row + sizeof(int), &record->deleted, sizeof(int));
+    
+    unsigned long long nulls = 0;
+    for (int i = 0; i < table->column_count; i++) {
+        if (!record->fields[i]) {
+            nulls |= 1ULL << i;
+            continue;
+        }
+        
+        int size = columnStorageSize(&table->columns[i]);
+        unsigned char* field = row + table->column_offsets[i];
+        
+        if (table->columns[i].type == DATA_TYPE_TEXT) {
+            // Keep text NUL-terminated and zero-padded so keys compare cleanly
+            memcpy(field, record->fields[i], strnlen((char*)record->fields[i], size - 1));
+        } else {
+            memcpy(field, record->fields[i], size);
+        }
+    }
+    
+    memcpy(row + ROW_NULLS_OFFSET, &nulls, sizeof(nulls));
+}
+
+// Add a page to the table's heap directory
+// A full directory is copied rather than resized in place because readers
+// may still be using it; the old copy is retired until the table is freed.
+int addHeapPage(Table* table, int page_id) {
+    if (table->heap_page_count >= table->heap_page_capacity) {
+        int new_capacity = table->heap_page_capacity ? table->heap_page_capacity * 2 : 16;
+        int* new_pages = malloc(new_capacity * sizeof(int));
+        if (!new_pages) return -1;
+        
+        if (table->heap_pages) {
+            memcpy(new_pages, table->heap_pages, table->heap_page_count * sizeof(int));
+            table->retired_heap_pages[table->retired_count++] = table->heap_pages;
+        }
+        
+        __atomic_store_n(&table->heap_pages, new_pages, __ATOMIC_RELEASE);
+        table->heap_page_capacity = new_capacity;
+    }
+    
+    table->heap_pages[table->heap_page_count++] = page_id;
+    return 0;
+}
+
+// Copy a heap-format row into the column store
+// Callers hold the store's latch exclusively.
+int storeColumnRow(Table* table, RowId row_id, const unsigned char* row) {
+    ColumnStore* store = table->column_store;
+    if (reserveColumnStore(table, row_id + 1) != 0) {
+        return -1;
+    }
+    
+    for (int c = 0; c < table->column_count; c++) {
+        const unsigned char* field = row + table->column_offsets[c];
+        storeColumnValue(&store->columns[c], table->columns[c].type, row_id,
+                         isFieldNull(row, c) ? NULL : field);
+    }
+    memcpy(&store->record_ids[row_id], row, sizeof(int));
+    
+    if (row_id >= store->row_count) {
+        store->row_count = row_id + 1;
+    }
+    return 0;
+}
+
+// Log rows just written to the heap, at most WAL_ROWS_PER_RECORD per record
+// The records hold whole row images, so replay can rewrite the slots
+// without reading the pages first.
+int logRowImages(Table* table, RowId first_row, const unsigned char* rows, int count, Timestamp begin) {
+    WriteAheadLog* wal = activeLog(table->storage);
+    
+    for (int done = 0; wal && done < count; done += WAL_ROWS_PER_RECORD) {
+        int chunk = count - done < WAL_ROWS_PER_RECORD ? count - done : WAL_ROWS_PER_RECORD;
+        LogRecordHeader header;
+        memset(&header, 0, sizeof(header));
+        header.type = WAL_ROWS;
+        header.transaction_id = (begin & TIMESTAMP_TRANSACTION_FLAG) ?
+                                (int)(begin & ~TIMESTAMP_TRANSACTION_FLAG) : 0;
+        header.table_id = table->table_id;
+        header.row_id = first_row + done;
+        header.count = chunk;
+        header.timestamp = begin;
+        
+        if (!appendLogRecord(wal, &header, rows + (size_t)done * table->row_size,
+                             (size_t)chunk * table->row_size)) {
+            return -1;
+        }
+    }
+    
+    return 0;
+}
+
+// Append serialized rows to the heap as versions that begin at `begin`,
+// writing each touched page once
+// Pages, version stamps and the column store are all written before the new
+// row count is published, so a concurrent scan never meets a partial row.
+// Callers hold the database's writer latch. Returns the first row's id.
+RowId appendRowImages(Table* table, const unsigned char* rows, int count, Timestamp begin) {
+    if (!table || !table->storage || !rows || count <= 0) {
+        return -1;
+    }
+    
+    RowId first_row = table->heap_row_count;
+    Page page;
+    int page_loaded = 0;
+    
+    if (reserveRowVersions(table, first_row, count) != 0) {
+        return -1;
+    }
+    
+    // Continue filling the tail page if it has room
+    if (table->heap_page_count > 0 && first_row % table->rows_per_page != 0) {
+        int tail_page = table->heap_pages[table->heap_page_count - 1];
+        if (readPage(table->storage, tail_page, &page) != 0) {
+            return -1;
+        }
+        page_loaded = 1;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        if (!page_loaded || page.record_count >= table->rows_per_page) {
+            Page new_page;
+            if (allocatePage(table->storage, PAGE_TYPE_DATA, &new_page) < 0) {
+                return -1;
+            }
+            
+            // Chain the full page to the new tail before writing it out
+            if (page_loaded) {
+                page.next_page_id = new_page.page_id;
+                new_page.prev_page_id = page.page_id;
+                if (writePage(table->storage, page.page_id, &page) != 0) {
+                    return -1;
+                }
+            }
+            
+            if (addHeapPage(table, new_page.page_id) != 0) {
+                return -1;
+            }
+            
+            page = new_page;
+            page_loaded = 1;
+        }
+        
+        memcpy(rowSlot(table, &page, page.record_count), rows + (size_t)i * table->row_size,
+               table->row_size);
+        page.record_count++;
+    }
+    
+    if (writePage(table->storage, page.page_id, &page) != 0) {
+        return -1;
+    }
+    
+    // Rows stored with the deleted flag set start out dead
+    for (int i = 0; i < count; i++) {
+        const unsigned char* row = rows + (size_t)i * table->row_size;
+        storeVersionBegin(table, first_row + i, begin);
+        storeVersionEnd(table, first_row + i, isRowDeleted(row) ? TIMESTAMP_DEAD : TIMESTAMP_INFINITY);
+    }
+    
+    // Column scans see rows up to the store's row count, so versions go first
+    if (table->column_store) {
+        int failed = 0;
+        pthread_rwlock_wrlock(&table->column_store->latch);
+        for (int i = 0; i < count && !failed; i++) {
+            failed = storeColumnRow(table, first_row + i, rows + (size_t)i * table->row_size) != 0;
+        }
+        pthread_rwlock_unlock(&table->column_store->latch);
+        if (failed) return -1;
+    }
+    
+    table->record_count += count;
+    __atomic_store_n(&table->heap_row_count, first_row + count, __ATOMIC_RELEASE);
+    return first_row;
+}
+
+// Append records to the table heap
+// Bulk loads bypass transactions: the rows are visible to every snapshot.
+// Returns the row id of the first appended record.
+RowId appendRows(Table* table, Record** records, int count) {
+    if (!table || !records || count <= 0) {
+        return -1;
+    }
+    
+    unsigned char* rows = malloc((size_t)count * table->row_size);
+    if (!rows) {
+        return -1;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        serializeRecord(table, records[i], rows + (size_t)i * table->row_size);
+    }
+    
+    RowId first_row = appendRowImages(table, rows, count, TIMESTAMP_FROZEN);
+    if (first_row >= 0 && logRowImages(table, first_row, rows, count, TIMESTAMP_FROZEN) != 0) {
+        first_row = -1;
+    }
+    free(rows);
+    return first_row;
+}
+
+// Store one new row version, reusing a slot reclaimed by collectGarbage()
+// when there is one. Callers hold the database's writer latch.
+RowId writeRowVersion(Table* table, const unsigned char* row, Timestamp begin) {
+    if (table->free_row_count == 0) {
+        RowId row_id = appendRowImages(table, row, 1, begin);
+        return row_id >= 0 && logRowImages(table, row_id, row, 1, begin) == 0 ? row_id : -1;
+    }
+    
+    RowId row_id = table->free_rows[table->free_row_count - 1];
+    Page page;
+    int slot;
+    int page_id = heapPageForRow(table, row_id, &slot);
+    
+    if (page_id < 0 || readPage(table->storage, page_id, &page) != 0) {
+        return -1;
+    }
+    
+    memcpy(rowSlot(table, &page, slot), row, table->row_size);
+    if (writePage(table->storage, page_id, &page) != 0) {
+        return -1;
+    }
+    
+    if (table->column_store) {
+        pthread_rwlock_wrlock(&table->column_store->latch);
+        int failed = storeColumnRow(table, row_id, row) != 0;
+        pthread_rwlock_unlock(&table->column_store->latch);
+        if (failed) return -1;
+    }
+    
+    // A reclaimed slot stays invisible until both stamps are in place
+    storeVersionBegin(table, row_id, begin);
+    storeVersionEnd(table, row_id, TIMESTAMP_INFINITY);
+    table->free_row_count--;
+    return logRowImages(table, row_id, row, 1, begin) == 0 ? row_id : -1;
+}
+
+// Log that a transaction ends a version once it commits
+int logSupersede(Table* table, Transaction* transaction, RowId row_id) {
+    WriteAheadLog* wal = activeLog(table->storage);
+    if (!wal) {
+        return 0;
+    }
+    
+    LogRecordHeader header;
+    memset(&header, 0, sizeof(header));
+    header.type = WAL_SUPERSEDE;
+    header.transaction_id = transaction->transaction_id;
+    header.table_id = table->table_id;
+    header.row_id = row_id;
+    return appendLogRecord(wal, &header, NULL, 0) ? 0 : -1;
+}
+
+// =============================================================================
+// VALUE ENCODING
+// =============================================================================
+
+// Compare two values stored in a column's storage format
+int compareValues(DataType type, const void* a, const void* b, int size) {
+    switch (type) {
+        case DATA_TYPE_INTEGER:
+        case DATA_TYPE_BOOLEAN: {
+            int x, y;
+            memcpy(&x, a, sizeof(int));
+            memcpy(&y, b, sizeof(int));
+            return (x > y) - (x < y);
+        }
+        case DATA_TYPE_FLOAT: {
+            double x, y;
+            memcpy(&x, a, sizeof(double));
+            memcpy(&y, b, sizeof(double));
+            return (x > y) - (x < y);
+        }
+        case DATA_TYPE_DATE:
+        case DATA_TYPE_TIMESTAMP: {
+            time_t x, y;
+            memcpy(&x, a, sizeof(time_t));
+            memcpy(&y, b, sizeof(time_t));
+            return (x > y) - (x < y);
+        }
+        case DATA_TYPE_TEXT:
+            return strncmp((const char*)a, (const char*)b, size);
+        default:
+            return memcmp(a, b, size);
+    }
+}
+
+// Encode a query literal into the column's storage format
+int encodeLiteral(const Column* column, const char* literal, unsigned char* out) {
+    int size = columnStorageSize(column);
+    if (size > MAX_FIELD_SIZE) {
+        size = MAX_FIELD_SIZE;
+    }
+    
+    memset(out, 0, size);
+    
+    switch (column->type) {
+        case DATA_TYPE_INTEGER:
+        case DATA_TYPE_BOOLEAN: {
+            int value = atoi(literal);
+            memcpy(out, &value, sizeof(int));
+            break;
+        }
+        case DATA_TYPE_FLOAT: {
+            double value = atof(literal);
+            memcpy(out, &value, sizeof(double));
+            break;
+        }
+        case DATA_TYPE_DATE:
+        case DATA_TYPE_TIMESTAMP: {
+            time_t value = (time_t)atoll(literal);
+            memcpy(out, &value, sizeof(time_t));
+            break;
+        }
+        default:
+            strncpy((char*)out, literal, size - 1);
+            break;
+    }
+    
+    return size;
+}
+
+// =============================================================================
+// INDEX MANAGEMENT (B+TREE)
+// =============================================================================
+
+// Size of a leaf entry: key followed by row id
+int leafEntrySize(Index* index) {
+    return index->key_size + (int)sizeof(RowId);
+}
+
+// Size of an internal entry: key, row id, then right child page
+int internalEntrySize(Index* index) {
+    return index->key_size + (int)sizeof(RowId) + (int)sizeof(int);
+}
+
+// Number of entries that fit in one node page
+int nodeCapacity(int entry_size) {
+    return (PAGE_DATA_SIZE - BTREE_NODE_HEADER_SIZE) / entry_size;
+}
+
+// Read the leaf flag from a node header
+int nodeIsLeaf(const Page* page) {
+    int is_leaf;
+    memcpy(&is_leaf, page->data, sizeof(int));
+    return is_leaf;
+}
+
+// Read the leftmost child from an internal node header
+int nodeFirstChild(const Page* page) {
+    int first_child;
+    memcpy(&first_child, page->data + sizeof(int), sizeof(int));
+    return first_child;
+}
+
+// Write a node header
+void setNodeHeader(Page* page, int is_leaf, int first_child) {
+    memcpy(page->data, &is_leaf, sizeof(int));
+    memcpy(page->data + sizeof(int), &first_child, sizeof(int));
+}
+
+// Get pointer to the i-th entry of a node
+unsigned char* nodeEntry(Page* page, int entry_size, int i) {
+    return (unsigned char*)page->data + BTREE_NODE_HEADER_SIZE + i * entry_size;
+}
+
+// Row id stored after an entry's key
+RowId entryRowId(Index* index, const unsigned char* entry) {
+    RowId row_id;
+    memcpy(&row_id, entry + index->key_size, sizeof(RowId));
+    return row_id;
+}
+
+// Child page stored in an internal entry
+int entryChild(Index* index, const unsigned char* entry) {
+    int child;
+    memcpy(&child, entry + index->key_size + sizeof(RowId), sizeof(int));
+    return child;
+}
+
+// Compare an entry against a (key, row id) pair
+int compareEntry(Index* index, const unsigned char* entry, const unsigned char* key, RowId row_id) {
+    int result = compareValues(index->key_type, entry, key, index->key_size);
+    if (result != 0) {
+        return result;
+    }
+    
+    RowId entry_row = entryRowId(index, entry);
+    return (entry_row > row_id) - (entry_row < row_id);
+}
+
+// Binary search a node for the first entry >= (key, row id),
+// or the first entry > (key, row id) when upper is set
+int searchNode(Index* index, Page* page, int entry_size, const unsigned char* key, RowId row_id, int upper) {
+    int low = 0;
+    int high = page->record_count;
+    
+    while (low < high) {
+        int mid = (low + high) / 2;
+        int result = compareEntry(index, nodeEntry(page, entry_size, mid), key, row_id);
+        
+        if (result < 0 || (upper && result == 0)) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    
+    return low;
+}
+
+// Child page to follow from an internal node (NULL key means leftmost)
+int childForKey(Index* index, Page* page, const unsigned char* key, RowId row_id) {
+    if (!key) {
+        return nodeFirstChild(page);
+    }
+    
+    int entry_size = internalEntrySize(index);
+    int position = searchNode(index, page, entry_size, key, row_id, 1);
+    if (position == 0) {
+        return nodeFirstChild(page);
+    }
+    
+    return entryChild(index, nodeEntry(page, entry_size, position - 1));
+}
+
+// Descend from the root to the leaf that would hold (key, row id)
+// Readers take no latches: splits write the new right sibling before the
+// node that links to it, and a stale parent only sends a cursor to a leaf
+// whose sibling chain still reaches the key.
+int findLeaf(Index* index, const unsigned char* key, RowId row_id, Page* leaf) {
+    int page_id = __atomic_load_n(&index->root_page_id, __ATOMIC_ACQUIRE);
+    
+    while (1) {
+        if (readPage(index->storage, page_id, leaf) != 0) {
+            return -1;
+        }
+        if (nodeIsLeaf(leaf)) {
+            return 0;
+        }
+        page_id = childForKey(index, leaf, key, row_id);
+    }
+}
+
+// Insert (key, row id) below page_id
+// Returns 1 and fills the separator and new right page when the node split.
+int insertIntoNode(Index* index, int page_id, const unsigned char* key, RowId row_id,
+                   unsigned char* split_key, RowId* split_row, int* split_page) {
+    Page page;
+    if (readPage(index->storage, page_id, &page) != 0) {
+        return -1;
+    }
+    
+    int is_leaf = nodeIsLeaf(&page);
+    int entry_size = is_leaf ? leafEntrySize(index) : internalEntrySize(index);
+    unsigned char entry[BTREE_MAX_KEY_SIZE + 2 * sizeof(int)];
+    
+    if (is_leaf) {
+        memcpy(entry, key, index->key_size);
+        memcpy(entry + index->key_size, &row_id, sizeof(RowId));
+    } else {
+        // Insert into the child first; only a child split adds an entry here
+        unsigned char child_key[BTREE_MAX_KEY_SIZE];
+        RowId child_row;
+        int child_page;
+        
+        int result = insertIntoNode(index, childForKey(index, &page, key, row_id), key, row_id,
+                                    child_key, &child_row, &child_page);
+        if (result <= 0) {
+            return result;
+        }
+        
+        memcpy(entry, child_key, index->key_size);
+        memcpy(entry + index->key_size, &child_row, sizeof(RowId));
+        memcpy(entry + index->key_size + sizeof(RowId), &child_page, sizeof(int));
+    }
+    
+    int position = searchNode(index, &page, entry_size, entry, entryRowId(index, entry), 0);
+    int count = page.record_count;
+    
+    if (count < nodeCapacity(entry_size)) {
+        unsigned char* slot = nodeEntry(&page, entry_size, position);
+        memmove(slot + entry_size, slot, (count - position) * entry_size);
+        memcpy(slot, entry, entry_size);
+        page.record_count++;
+        return writePage(index->storage, page_id, &page) == 0 ? 0 : -1;
+    }
+    
+    // Node is full: merge the new entry into a scratch buffer and split it
+    int total = count + 1;
+    int left_count = total / 2;
+    unsigned char* buffer = malloc(total * entry_size);
+    if (!buffer) {
+        return -1;
+    }
+    
+    memcpy(buffer, nodeEntry(&page, entry_size, 0), position * entry_size);
+    memcpy(buffer + position * entry_size, entry, entry_size);
+    memcpy(buffer + (position + 1) * entry_size, nodeEntry(&page, entry_size, position),
+           (count - position) * entry_size);
+    
+    Page right;
+    if (allocatePage(index->storage, PAGE_TYPE_INDEX, &right) < 0) {
+        free(buffer);
+        return -1;
+    }
+    index->page_count++;
+    
+    unsigned char* middle = buffer + left_count * entry_size;
+    memcpy(split_key, middle, index->key_size);
+    *split_row = entryRowId(index, middle);
+    *split_page = right.page_id;
+    
+    if (is_leaf) {
+        // Right leaf starts at the middle entry and joins the sibling chain
+        setNodeHeader(&right, 1, -1);
+        memcpy(nodeEntry(&right, entry_size, 0), middle, (total - left_count) * entry_size);
+        right.record_count = total - left_count;
+        right.prev_page_id = page_id;
+        right.next_page_id = page.next_page_id;
+        
+        if (page.next_page_id != -1) {
+            Page next;
+            if (readPage(index->storage, page.next_page_id, &next) != 0) {
+                free(buffer);
+                return -1;
+            }
+            next.prev_page_id = right.page_id;
+            writePage(index->storage, next.page_id, &next);
+        }
+        page.next_page_id = right.page_id;
+    } else {
+        // The middle entry moves up; its child becomes the right node's first child
+        setNodeHeader(&right, 0, entryChild(index, middle));
+        memcpy(nodeEntry(&right, entry_size, 0), middle + entry_size,
+               (total - left_count - 1) * entry_size);
+        right.record_count = total - left_count - 1;
+    }
+    
+    memcpy(nodeEntry(&page, entry_size, 0), buffer, left_count * entry_size);
+    page.record_count = left_count;
+    free(buffer);
+    
+    if (writePage(index->storage, right.page_id, &right) != 0 ||
+        writePage(index->storage, page_id, &page) != 0) {
+        return -1;
+    }
+    
+    return 1;
+}
+
+// Open a cursor on the key range [low, high]
+// Keys are in the index's storage format; a NULL bound leaves that side open.
+int openIndexCursor(Index* index, IndexCursor* cursor, const unsigned char* low, int low_inclusive,
+                    const unsigned char* high, int high_inclusive) {
+    if (!index || !cursor) {
+        return -1;
+    }
+    
+    memset(cursor, 0, sizeof(IndexCursor));
+    cursor->index = index;
+    
+    if (high) {
+        cursor->has_high = 1;
+        cursor->high_inclusive = high_inclusive;
+        memcpy(cursor->high_key, high, index->key_size);
+    }
+    
+    // Row ids are never negative or INT_MAX, so they bracket every duplicate
+    RowId low_row = low_inclusive ? INT_MIN : INT_MAX;
+    if (findLeaf(index, low, low_row, &cursor->leaf) != 0) {
+        cursor->exhausted = 1;
+        return -1;
+    }
+    
+    cursor->slot = low ? searchNode(index, &cursor->leaf, leafEntrySize(index), low, low_row, 0) : 0;
+    return 0;
+}
+
+// Fetch the next row id from a cursor
+// Returns 1 when a row id was produced and 0 once the range is exhausted.
+int nextIndexEntry(IndexCursor* cursor, RowId* row_id) {
+    Index* index = cursor->index;
+    
+    while (!cursor->exhausted) {
+        if (cursor->slot >= cursor->leaf.record_count) {
+            // Follow the leaf chain to the right sibling
+            if (cursor->leaf.next_page_id == -1 ||
+                readPage(index->storage, cursor->leaf.next_page_id, &cursor->leaf) != 0) {
+                cursor->exhausted = 1;
+                break;
+            }
+            cursor->slot = 0;
+            continue;
+        }
+        
+        unsigned char* entry = nodeEntry(&cursor->leaf, leafEntrySize(index), cursor->slot);
+        if (cursor->has_high) {
+            int result = compareValues(index->key_type, entry, cursor->high_key, index->key_size);
+            if (result > 0 || (result == 0 && !cursor->high_inclusive)) {
+                cursor->exhausted = 1;
+                break;
+            }
+        }
+        
+        *row_id = entryRowId(index, entry);
+        cursor->slot++;
+        return 1;
+    }
+    
+    return 0;
+}
+
+// Check whether a key is already present in the index
+int indexContainsKey(Index* index, const unsigned char* key) {
+    IndexCursor cursor;
+    RowId row_id;
+    
+    if (openIndexCursor(index, &cursor, key, 1, key, 1) != 0) {
+        return 0;
+    }
+    
+    return nextIndexEntry(&cursor, &row_id) == 1;
+}
+
+// Check whether a key belongs to a current row version
+// Versions the given transaction has already ended do not count, so an
+// UPDATE can keep a row's unique key.
+int currentVersionHasKey(Table* table, Index* index, const unsigned char* key, Transaction* transaction) {
+    IndexCursor cursor;
+    RowId row_id;
+    
+    if (openIndexCursor(index, &cursor, key, 1, key, 1) != 0) {
+        return 0;
+    }
+    
+    while (nextIndexEntry(&cursor, &row_id) == 1) {
+        if (isCurrentVersion(table, row_id) && !(transaction && isSupersededBy(transaction, table, row_id))) {
+            return 1;
+        }
+    }
+    
+    return 0;
+}
+
+// Encode a typed value (as passed to setFieldValue) into key format
+void encodeKeyValue(Index* index, const void* value, unsigned char* key) {
+    memset(key, 0, index->key_size);
+    if (!value) return;
+    
+    if (index->key_type == DATA_TYPE_TEXT) {
+        strncpy((char*)key, (const char*)value, index->key_size - 1);
+    } else {
+        memcpy(key, value, index->key_size);
+    }
+}
+
+// Insert a key into the index
+// Every row version gets its own entry, so a unique key may appear more than
+// once here; uniqueness is checked against current versions by the caller.
+int insertIndexEntry(Index* index, const unsigned char* key, RowId row_id) {
+    if (!index || !key) {
+        return -1;
+    }
+    
+    unsigned char split_key[BTREE_MAX_KEY_SIZE];
+    RowId split_row;
+    int split_page;
+    
+    int result = insertIntoNode(index, index->root_page_id, key, row_id,
+                                split_key, &split_row, &split_page);
+    if (result < 0) {
+        return -1;
+    }
+    
+    if (result == 1) {
+        // Root split: grow the tree by one level
+        Page root;
+        if (allocatePage(index->storage, PAGE_TYPE_INDEX, &root) < 0) {
+            return -1;
+        }
+        setNodeHeader(&root, 0, index->root_page_id);
+        
+        unsigned char* entry = nodeEntry(&root, internalEntrySize(index), 0);
+        memcpy(entry, split_key, index->key_size);
+        memcpy(entry + index->key_size, &split_row, sizeof(RowId));
+        memcpy(entry + index->key_size + sizeof(RowId), &split_page, sizeof(int));
+        root.record_count = 1;
+        
+        if (writePage(index->storage, root.page_id, &root) != 0) {
+            return -1;
+        }
+        
+        __atomic_store_n(&index->root_page_id, root.page_id, __ATOMIC_RELEASE);
+        __atomic_store_n(&index->height, index->height + 1, __ATOMIC_RELAXED);
+        index->page_count++;
+    }
+    
+    index->key_count++;
+    return 0;
+}
+
+// Remove one (key, row id) entry from its leaf
+// Leaves are not merged when they empty out: cursors step over empty
+// leaves, and later inserts refill them.
+int deleteIndexEntry(Index* index, const unsigned char* key, RowId row_id) {
+    Page leaf;
+    if (!index || !key || findLeaf(index, key, row_id, &leaf) != 0) {
+        return -1;
+    }
+    
+    int entry_size = leafEntrySize(index);
+    int position = searchNode(index, &leaf, entry_size, key, row_id, 0);
+    unsigned char* entry = nodeEntry(&leaf, entry_size, position);
+    
+    if (position >= leaf.record_count || compareEntry(index, entry, key, row_id) != 0) {
+        return -1; // Not in the index
+    }
+    
+    memmove(entry, entry + entry_size, (leaf.record_count - position - 1) * entry_size);
+    leaf.record_count--;
+    index->key_count--;
+    return writePage(index->storage, leaf.page_id, &leaf) == 0 ? 0 : -1;
+}
+
+// Index used by compareBulkEntries (qsort has no context parameter)
+Index* bulk_sort_index = NULL;
+
+// Order bulk-build entries by (key, row id)
+int compareBulkEntries(const void* a, const void* b) {
+    const unsigned char* entry = (const unsigned char*)b;
+    return compareEntry(bulk_sort_index, (const unsigned char*)a, entry,
+                        entryRowId(bulk_sort_index, entry));
+}
+
+// Bulk-build an index from the table heap
+// Sorts every (key, row id) pair once, packs leaves left to right and then
+// stacks internal levels on top, instead of inserting keys one at a time.
+int buildIndex(Table* table, Index* index) {
+    int leaf_size = leafEntrySize(index);
+    int key_offset = table->column_offsets[index->column_index];
+    
+    unsigned char* entries = malloc((size_t)(table->heap_row_count + 1) * leaf_size);
+    if (!entries) {
+        return -1;
+    }
+    
+    // Collect keys of every version some snapshot may still read
+    int entry_count = 0;
+    Page page;
+    for (int p = 0; p < table->heap_page_count; p++) {
+        if (readPage(index->storage, table->heap_pages[p], &page) != 0) {
+            free(entries);
+            return -1;
+        }
+        
+        for (int slot = 0; slot < page.record_count; slot++) {
+            unsigned char* row = rowSlot(table, &page, slot);
+            RowId row_id = p * table->rows_per_page + slot;
+            Timestamp begin, end;
+            loadRowVersion(table, row_id, &begin, &end);
+            if (end == TIMESTAMP_DEAD) continue;
+            
+            unsigned char* entry = entries + (size_t)entry_count * leaf_size;
+            memcpy(entry, row + key_offset, index->key_size);
+            memcpy(entry + index->key_size, &row_id, sizeof(RowId));
+            entry_count++;
+        }
+    }
+    
+    bulk_sort_index = index;
+    qsort(entries, entry_count, leaf_size, compareBulkEntries);
+    bulk_sort_index = NULL;
+    
+    // Unique indexes reject equal keys among current versions; older
+    // versions of a row share its key
+    if (index->is_unique) {
+        const unsigned char* previous = NULL;
+        
+        for (int i = 0; i < entry_count; i++) {
+            const unsigned char* entry = entries + (size_t)i * leaf_size;
+            if (!isCurrentVersion(table, entryRowId(index, entry))) continue;
+            
+            if (previous && compareValues(index->key_type, previous, entry, index->key_size) == 0) {
+                free(entries);
+                return -1;
+            }
+            previous = entry;
+        }
+    }
+    
+    // Leaf level: leave some room in each leaf for later inserts
+    int per_leaf = nodeCapacity(leaf_size) * BTREE_BULK_FILL_PERCENT / 100;
+    if (per_leaf < 1) per_leaf = 1;
+    
+    int level_count = entry_count > 0 ? (entry_count + per_leaf - 1) / per_leaf : 1;
+    int* level_pages = malloc(level_count * sizeof(int));
+    unsigned char* level_keys = malloc((size_t)level_count * leaf_size);
+    if (!level_pages || !level_keys) {
+        free(entries);
+        free(level_pages);
+        free(level_keys);
+        return -1;
+    }
+    
+    Page leaf;
+    Page previous;
+    for (int n = 0; n < level_count; n++) {
+        int first = n * per_leaf;
+        int count = entry_count - first < per_leaf ? entry_count - first : per_leaf;
+        
+        if (allocatePage(index->storage, PAGE_TYPE_INDEX, &leaf) < 0) {
+            free(entries);
+            free(level_pages);
+            free(level_keys);
+            return -1;
+        }
+        setNodeHeader(&leaf, 1, -1);
+        memcpy(nodeEntry(&leaf, leaf_size, 0), entries + (size_t)first * leaf_size, count * leaf_size);
+        leaf.record_count = count;
+        
+        // Each leaf is written once its right sibling is known
+        if (n > 0) {
+            previous.next_page_id = leaf.page_id;
+            leaf.prev_page_id = previous.page_id;
+            writePage(index->storage, previous.page_id, &previous);
+        }
+        
+        level_pages[n] = leaf.page_id;
+        memcpy(level_keys + (size_t)n * leaf_size, entries + (size_t)first * leaf_size, leaf_size);
+        previous = leaf;
+    }
+    writePage(index->storage, previous.page_id, &previous);
+    
+    index->page_count = level_count;
+    index->height = 1;
+    
+    // Internal levels: one separator per child after the first
+    int internal_size = internalEntrySize(index);
+    int per_node = nodeCapacity(internal_size) * BTREE_BULK_FILL_PERCENT / 100 + 1;
+    
+    while (level_count > 1) {
+        int parent_count = (level_count + per_node - 1) / per_node;
+        
+        for (int n = 0; n < parent_count; n++) {
+            int first = n * per_node;
+            int count = level_count - first < per_node ? level_count - first : per_node;
+            Page node;
+            
+            if (allocatePage(index->storage, PAGE_TYPE_INDEX, &node) < 0) {
+                free(entries);
+                free(level_pages);
+                free(level_keys);
+                return -1;
+            }
+            setNodeHeader(&node, 0, level_pages[first]);
+            
+            for (int c = 1; c < count; c++) {
+                unsigned char* entry = nodeEntry(&node, internal_size, c - 1);
+                memcpy(entry, level_keys + (size_t)(first + c) * leaf_size, leaf_size);
+                memcpy(entry + leaf_size, &level_pages[first + c], sizeof(int));
+            }
+            node.record_count = count - 1;
+            writePage(index->storage, node.page_id, &node);
+            
+            level_pages[n] = node.page_id;
+            memmove(level_keys + (size_t)n * leaf_size, level_keys + (size_t)first * leaf_size, leaf_size);
+        }
+        
+        index->page_count += parent_count;
+        index->height++;
+        level_count = parent_count;
+    }
+    
+    index->root_page_id = level_pages[0];
+    index->key_count = entry_count;
+    
+    free(entries);
+    free(level_pages);
+    free(level_keys);
+    return 0;
+}
+
+// Create index and bulk-build it from the table's existing rows
+int createIndex(Table* table, const char* index_name, const char* column_name, int is_unique) {
+    if (!table || !index_name || !column_name || !table->storage) {
+        return -1;
+    }
+    
+    if (table->index_count >= MAX_INDEXES) {
+        return -1; // Maximum indexes reached
+    }
+    
+    int column_index = findColumn(table, column_name);
+    if (column_index < 0) {
+        return -1; // Column not found
+    }
+    
+    int key_size = columnStorageSize(&table->columns[column_index]);
+    if (key_size > BTREE_MAX_KEY_SIZE) {
+        return -1; // Key too wide for a node page
+    }
+    
+    // Create index
+    Index* index = &table->indexes[table->index_count];
+    memset(index, 0, sizeof(Index));
+    strncpy(index->name, index_name, sizeof(index->name) - 1);
+    index->column_index = column_index;
+    index->is_unique = is_unique;
+    index->key_type = table->columns[column_index].type;
+    index->key_size = key_size;
+    index->storage = table->storage;
+    
+    // Build index from existing records
+    if (buildIndex(table, index) != 0) {
+        return -1; // Duplicate key in a unique index, or I/O failure
+    }
+    
+    table->index_count++;
+    __atomic_add_fetch(&table->schema_version, 1, __ATOMIC_RELEASE); // Cached plans may now use it
+    
+    // Only the definition is logged; recovery rebuilds the tree
+    WriteAheadLog* wal = activeLog(table->storage);
+    if (wal) {
+        LogIndexDefinition definition;
+        LogRecordHeader header;
+        memset(&definition, 0, sizeof(definition));
+        memset(&header, 0, sizeof(header));
+        memcpy(definition.name, index->name, sizeof(definition.name));
+        definition.column_index = column_index;
+        definition.is_unique = is_unique;
+        header.type = WAL_CREATE_INDEX;
+        header.table_id = table->table_id;
+        
+        Lsn lsn = appendLogRecord(wal, &header, &definition, sizeof(definition));
+        if (!lsn || flushLog(wal, lsn) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Find an index by name
+Index* findIndex(Table* table, const char* index_name) {
+    if (!table || !index_name) {
+        return NULL;
+    }
+    
+    for (int i = 0; i < table->index_count; i++) {
+        if (strcmp(table->indexes[i].name, index_name) == 0) {
+            return &table->indexes[i];
+        }
+    }
+    
+    return NULL;
+}
+
+// Search index for rows whose key lies between low and high (NULL = open)
+int searchIndexRange(Index* index, const void* low, int low_inclusive,
+                     const void* high, int high_inclusive, RowId* result_ids, int max_results) {
+    if (!index || !result_ids) {
+        return -1;
+    }
+    
+    unsigned char low_key[BTREE_MAX_KEY_SIZE];
+    unsigned char high_key[BTREE_MAX_KEY_SIZE];
+    if (low) encodeKeyValue(index, low, low_key);
+    if (high) encodeKeyValue(index, high, high_key);
+    
+    IndexCursor cursor;
+    if (openIndexCursor(index, &cursor, low ? low_key : NULL, low_inclusive,
+                        high ? high_key : NULL, high_inclusive) != 0) {
+        return -1;
+    }
+    
+    int found_count = 0;
+    while (found_count < max_results && nextIndexEntry(&cursor, &result_ids[found_count]) == 1) {
+        found_count++;
+    }
+    
+    return found_count;
+}
+
+// Search index for rows whose key equals key_value
+// key_value points at a value of the column's type, as for setFieldValue.
+int searchIndex(Index* index, const void* key_value, RowId* result_ids, int max_results) {
+    return searchIndexRange(index, key_value, 1, key_value, 1, result_ids, max_results);
+}
+
+// =============================================================================
+// QUERY PROCESSOR IMPLEMENTATION
+// =============================================================================
+
+// Initialize query
+void initQuery(Query* query, QueryType type) {
+    if (!query) return;
+    
+    memset(query, 0, sizeof(Query));
+    query->type = type;
+    query->limit = -1;
+    query->offset = 0;
+    query->sort_ascending = 1;
+    query->use_indexes = USE_INDEXES_COST;
+    query->use_column_store = 1;
+    query->join_method = JOIN_METHOD_COST;
+    query->work_memory = DEFAULT_WORK_MEMORY;
+}
+
+// Add selected column
+int addSelectedColumn(Query* query, const char* column_name) {
+    if (!query || !column_name) {
+        return -1;
+    }
+    
+    if (query->selected_column_count >= MAX_COLUMNS) {
+        return -1;
+    }
+    
+    strncpy(query->selected_columns[query->selected_column_count].name, 
+            column_name, sizeof(query->selected_columns[0].name) - 1);
+    query->selected_column_count++;
+    
+    return 0;
+}
+
+// Add WHERE condition
+int addWhereCondition(Query* query, const char* column_name, Operator op, const char* value) {
+    if (!query || !column_name || !value) {
+        return -1;
+    }
+    
+    if (query->where_condition_count >= MAX_COLUMNS) {
+        return -1;
+    }
+    
+    WhereCondition* condition = &query->where_conditions[query->where_condition_count];
+    strncpy(condition->column_name, column_name, sizeof(condition->column_name) - 1);
+    strncpy(condition->value, value, sizeof(condition->value) - 1);
+    condition->column_index = -1; // Resolved against the table at execution
+    condition->operator = op;
+    condition->is_field_reference = 0;
+    condition->left_condition = -1;
+    condition->right_condition = -1;
+    
+    query->where_condition_count++;
+    return 0;
+}
+
+// Join a second table on left_column = right_column
+// Either column may be qualified as table.column and may name a column of
+// either table; WHERE conditions then apply to the joined rows.
+int setJoin(Query* query, const char* table_name, const char* left_column, const char* right_column) {
+    if (!query || !table_name || !left_column || !right_column) {
+        return -1;
+    }
+    
+    strncpy(query->join_table, table_name, sizeof(query->join_table) - 1);
+    strncpy(query->join_columns[0], left_column, sizeof(query->join_columns[0]) - 1);
+    strncpy(query->join_columns[1], right_column, sizeof(query->join_columns[1]) - 1);
+    return 0;
+}
+
+// Evaluate WHERE condition against a stored field value
+int evaluateCondition(WhereCondition* condition, const void* field_value, const char* condition_value) {
+    if (!condition || !field_value || !condition_value) {
+        return 0;
+    }
+    
+    if (condition->operator == OP_LIKE) {
+        return condition->value_type == DATA_TYPE_TEXT &&
+               strstr((char*)field_value, condition_value) != NULL;
+    }
+    
+    // Compare in the column's type using the literal encoded at bind time
+    int result = compareValues(condition->value_type, field_value,
+                               condition->encoded_value, condition->value_size);
+    
+    switch (condition->operator) {
+        case OP_EQUAL:
+            return result == 0;
+        case OP_NOT_EQUAL:
+            return result != 0;
+        case OP_LESS_THAN:
+            return result < 0;
+        case OP_LESS_EQUAL:
+            return result <= 0;
+        case OP_GREATER_THAN:
+            return result > 0;
+        case OP_GREATER_EQUAL:
+            return result >= 0;
+        default:
+            return 0;
+    }
+}
+
+// Resolve WHERE columns and encode literals in the column's storage format
+int bindWhereConditions(Table* table, Query* query) {
+    for (int i = 0; i < query->where_condition_count; i++) {
+        WhereCondition* condition = &query->where_conditions[i];
+        
+        condition->column_index = findColumn(table, condition->column_name);
+        condition->join_side = 0;
+        if (condition->column_index < 0) {
+            return -1; // Column not found
+        }
+        
+        Column* column = &table->columns[condition->column_index];
+        condition->value_type = column->type;
+        condition->value_size = encodeLiteral(column, condition->value, condition->encoded_value);
+    }
+    
+    return 0;
+}
+
+// Find a column of the rows a SELECT produces
+// For a JOIN these are the first table's columns followed by the joined
+// table's; an unqualified name found in both is ambiguous. Returns -1 if
+// the column is missing or ambiguous.
+int findOutputColumn(Database* db, Query* query, const char* column_name) {
+    Table* table = findTable(db, query->table_name);
+    int column_index = findColumn(table, column_name);
+    if (!query->join_table[0]) {
+        return column_index;
+    }
+    
+    Table* joined = findTable(db, query->join_table);
+    int joined_index = findColumn(joined, column_name);
+    if (!table || !joined || (column_index >= 0) == (joined_index >= 0)) {
+        return -1;
+    }
+    
+    return column_index >= 0 ? column_index : table->column_count + joined_index;
+}
+
+// Resolve the ON columns and WHERE conditions of a JOIN
+// Each condition is bound to the table its column belongs to. The ON
+// columns must come one from each table with the same type, and the joined
+// row must fit the column limit.
+int bindJoinConditions(Database* db, Table* table, Table* joined, Query* query) {
+    if (table->column_count + joined->column_count > MAX_COLUMNS) {
+        return -1;
+    }
+    
+    int first = findOutputColumn(db, query, query->join_columns[0]);
+    int second = findOutputColumn(db, query, query->join_columns[1]);
+    if (first < 0 || second < 0 || (first < table->column_count) == (second < table->column_count)) {
+        return -1;
+    }
+    
+    int left = first < second ? first : second;
+    int right = (first < second ? second : first) - table->column_count;
+    if (table->columns[left].type != joined->columns[right].type) {
+        return -1;
+    }
+    
+    for (int i = 0; i < query->where_condition_count; i++) {
+        WhereCondition* condition = &query->where_conditions[i];
+        int column_index = findOutputColumn(db, query, condition->column_name);
+        if (column_index < 0) {
+            return -1;
+        }
+        
+        condition->join_side = column_index >= table->column_count;
+        condition->column_index = condition->join_side ? column_index - table->column_count : column_index;
+        
+        Column* column = condition->join_side ? &joined->columns[condition->column_index] :
+                                                &table->columns[condition->column_index];
+        condition->value_type = column->type;
+        condition->value_size = encodeLiteral(column, condition->value, condition->encoded_value);
+    }
+    
+    return 0;
+}
+
+// Check a heap row against every WHERE condition (conditions are ANDed)
+int rowMatchesQuery(Table* table, Query* query, const unsigned char* row) {
+    if (isRowDeleted(row)) {
+        return 0;
+    }
+    
+    for (int i = 0; i < query->where_condition_count; i++) {
+        WhereCondition* condition = &query->where_conditions[i];
+        const unsigned char* field = row + table->column_offsets[condition->column_index];
+        
+        // NULL never satisfies a comparison
+        if (isFieldNull(row, condition->column_index) ||
+            !evaluateCondition(condition, field, condition->value)) {
+            return 0;
+        }
+    }
+    
+    return 1;
+}
+
+// Check whether an operator can be answered by a B+tree range
+int isRangeOperator(Operator op) {
+    return op == OP_EQUAL || op == OP_LESS_THAN || op == OP_LESS_EQUAL ||
+           op == OP_GREATER_THAN || op == OP_GREATER_EQUAL;
+}
+
+// Intersect the range conditions on one column into a single key range
+// Returns how many conditions contributed a bound.
+int buildColumnRange(Query* query, int column_index, IndexRange* range) {
+    int used = 0;
+    
+    for (int i = 0; i < query->where_condition_count; i++) {
+        WhereCondition* condition = &query->where_conditions[i];
+        if (condition->column_index != column_index || !isRangeOperator(condition->operator)) {
+            continue;
+        }
+        
+        const unsigned char* value = condition->encoded_value;
+        Operator op = condition->operator;
+        DataType type = condition->value_type;
+        int size = condition->value_size;
+        used++;
+        
+        if (op == OP_EQUAL || op == OP_GREATER_THAN || op == OP_GREATER_EQUAL) {
+            int inclusive = op != OP_GREATER_THAN;
+            int result = range->low ? compareValues(type, value, range->low, size) : 1;
+            if (result > 0 || (result == 0 && !inclusive)) {
+                range->low = value;
+                range->low_inclusive = inclusive;
+            }
+        }
+        
+        if (op == OP_EQUAL || op == OP_LESS_THAN || op == OP_LESS_EQUAL) {
+            int inclusive = op != OP_LESS_THAN;
+            int result = range->high ? compareValues(type, value, range->high, size) : -1;
+            if (result < 0 || (result == 0 && !inclusive)) {
+                range->high = value;
+                range->high_inclusive = inclusive;
+            }
+        }
+    }
+    
+    return used;
+}
+
+// Copy the projected columns of a heap row into the result set
+int addResultRow(ResultSet* result, Table* table, const int* projection, const unsigned char* row) {
+    if (result->row_count >= MAX_RECORDS) {
+        result->has_more_rows = 1;
+        return -1;
+    }
+    
+    // One allocation per row: value pointers followed by 8-byte aligned values
+    size_t payload = 0;
+    for (int i = 0; i < result->column_count; i++) {
+        payload += (columnStorageSize(&result->columns[i]) + 7) & ~7;
+    }
+    
+    void** values = malloc(result->column_count * sizeof(void*) + payload);
+    if (!values) {
+        return -1;
+    }
+    
+    unsigned char* data = (unsigned char*)(values + result->column_count);
+    for (int i = 0; i < result->column_count; i++) {
+        int size = columnStorageSize(&result->columns[i]);
+        memcpy(data, row + table->column_offsets[projection[i]], size);
+        values[i] = isFieldNull(row, projection[i]) ? NULL : data;
+        data += (size + 7) & ~7;
+    }
+    
+    result->rows[result->row_count++] = values;
+    return 0;
+}
+
+// =============================================================================
+// STATISTICS
+// =============================================================================
+
+// Check whether a type has a numeric order usable for histograms
+int isNumericType(DataType type) {
+    return type == DATA_TYPE_INTEGER || type == DATA_TYPE_FLOAT || type == DATA_TYPE_BOOLEAN ||
+           type == DATA_TYPE_DATE || type == DATA_TYPE_TIMESTAMP;
+}
+
+// Read a stored numeric value as a double
+double numericValue(DataType type, const void* value) {
+    switch (type) {
+        case DATA_TYPE_INTEGER:
+        case DATA_TYPE_BOOLEAN: {
+            int number;
+            memcpy(&number, value, sizeof(int));
+            return number;
+        }
+        case DATA_TYPE_FLOAT: {
+            double number;
+            memcpy(&number, value, sizeof(double));
+            return number;
+        }
+        case DATA_TYPE_DATE:
+        case DATA_TYPE_TIMESTAMP: {
+            time_t number;
+            memcpy(&number, value, sizeof(time_t));
+            return (double)number;
+        }
+        default:
+            return 0.0;
+    }
+}
+
+// Hash a stored text value (FNV-1a) for distinct counting
+unsigned long long hashText(const unsigned char* text, int size) {
+    unsigned long long hash = 1469598103934665603ULL;
+    
+    for (int i = 0; i < size && text[i]; i++) {
+        hash ^= text[i];
+        hash *= 1099511628211ULL;
+    }
+    
+    return hash;
+}
+
+// Order doubles for qsort
+int compareDoubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Order hashes for qsort
+int compareHashes(const void* a, const void* b) {
+    unsigned long long x = *(const unsigned long long*)a;
+    unsigned long long y = *(const unsigned long long*)b;
+    return (x > y) - (x < y);
+}
+
+// Pearson correlation between physical position and value
+// 1 means the heap is stored in value order, 0 means no relation.
+double physicalCorrelation(const double* values, int count) {
+    if (count < 2) {
+        return 1.0;
+    }
+    
+    double mean_position = (count - 1) / 2.0;
+    double mean_value = 0.0;
+    for (int i = 0; i < count; i++) {
+        mean_value += values[i];
+    }
+    mean_value /= count;
+    
+    double covariance = 0.0, position_variance = 0.0, value_variance = 0.0;
+    for (int i = 0; i < count; i++) {
+        double dp = i - mean_position;
+        double dv = values[i] - mean_value;
+        covariance += dp * dv;
+        position_variance += dp * dp;
+        value_variance += dv * dv;
+    }
+    
+    if (value_variance == 0.0) {
+        return 1.0; // A constant column is trivially in order
+    }
+    
+    return covariance / sqrt(position_variance * value_variance);
+}
+
+// Collect planner statistics with one pass over the heap
+// Numeric columns get a distinct count, an equi-depth histogram and their
+// physical correlation; text columns get a distinct count of value hashes.
+int analyzeTable(Table* table) {
+    if (!table || !table->storage) {
+        return -1;
+    }
+    
+    int column_count = table->column_count;
+    int capacity = table->heap_row_count > 0 ? table->heap_row_count : 1;
+    double* numbers[MAX_COLUMNS] = {0};
+    unsigned long long* hashes[MAX_COLUMNS] = {0};
+    int failed = 0;
+    
+    for (int c = 0; c < column_count; c++) {
+        if (isNumericType(table->columns[c].type)) {
+            numbers[c] = malloc(capacity * sizeof(double));
+            failed |= numbers[c] == NULL;
+        } else {
+            hashes[c] = malloc(capacity * sizeof(unsigned long long));
+            failed |= hashes[c] == NULL;
+        }
+    }
+    
+    // Gather the current version of every row in physical order
+    int row_count = 0;
+    Page page;
+    for (int p = 0; p < table->heap_page_count && !failed; p++) {
+        if (readPage(table->storage, table->heap_pages[p], &page) != 0) {
+            failed = 1;
+            break;
+        }
+        
+        for (int slot = 0; slot < page.record_count; slot++) {
+            unsigned char* row = rowSlot(table, &page, slot);
+            if (!isCurrentVersion(table, p * table->rows_per_page + slot)) continue;
+            
+            for (int c = 0; c < column_count; c++) {
+                unsigned char* field = row + table->column_offsets[c];
+                if (numbers[c]) {
+                    numbers[c][row_count] = numericValue(table->columns[c].type, field);
+                } else {
+                    hashes[c][row_count] = hashText(field, columnStorageSize(&table->columns[c]));
+                }
+            }
+            row_count++;
+        }
+    }
+    
+    TableStatistics* statistics = &table->statistics;
+    if (!failed) {
+        memset(statistics, 0, sizeof(TableStatistics));
+        statistics->row_count = row_count;
+        statistics->page_count = table->heap_page_count;
+        
+        for (int c = 0; c < column_count; c++) {
+            ColumnStatistics* column = &statistics->columns[c];
+            int distinct = row_count > 0 ? 1 : 0;
+            
+            if (numbers[c]) {
+                column->correlation = physicalCorrelation(numbers[c], row_count);
+                qsort(numbers[c], row_count, sizeof(double), compareDoubles);
+                for (int i = 1; i < row_count; i++) {
+                    distinct += numbers[c][i] != numbers[c][i - 1];
+                }
+                
+                // Bucket bounds at every 1/HISTOGRAM_BUCKETS of the sorted values
+                if (row_count > 0) {
+                    column->has_histogram = 1;
+                    for (int b = 0; b <= HISTOGRAM_BUCKETS; b++) {
+                        column->histogram[b] = numbers[c][(long long)b * (row_count - 1) / HISTOGRAM_BUCKETS];
+                    }
+                }
+            } else {
+                qsort(hashes[c], row_count, sizeof(unsigned long long), compareHashes);
+                for (int i = 1; i < row_count; i++) {
+                    distinct += hashes[c][i] != hashes[c][i - 1];
+                }
+            }
+            
+            column->distinct_count = distinct;
+        }
+        
+        statistics->analyzed = 1;
+    }
+    
+    for (int c = 0; c < column_count; c++) {
+        free(numbers[c]);
+        free(hashes[c]);
+    }
+    
+    // Plans were costed with the old statistics
+    __atomic_add_fetch(&table->schema_version, 1, __ATOMIC_RELEASE);
+    return failed ? -1 : 0;
+}
+
+// Estimated fraction of rows with a value below the given one
+// equal is the fraction of rows holding any one value. Bucket bounds are
+// sampled rows, so a bound falls on average halfway through the rows equal
+// to it, and interpolating up to a value counts half of those rows. For
+// columns with few distinct values that half is taken back out.
+double fractionBelow(ColumnStatistics* column, double value, double equal) {
+    const double* bounds = column->histogram;
+    
+    if (value <= bounds[0]) return 0.0;
+    if (value > bounds[HISTOGRAM_BUCKETS]) return 1.0;
+    
+    // Interpolate linearly inside the bucket holding the value
+    for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+        if (value <= bounds[b + 1]) {
+            double width = bounds[b + 1] - bounds[b];
+            double within = width > 0.0 ? (value - bounds[b]) / width : 0.0;
+            double fraction = (b + within) / HISTOGRAM_BUCKETS - equal / 2.0;
+            return fraction > 0.0 ? fraction : 0.0;
+        }
+    }
+    
+    return 1.0;
+}
+
+// Estimated fraction of rows equal to one value of a column
+double equalitySelectivity(Table* table, int column_index) {
+    int distinct = table->statistics.columns[column_index].distinct_count;
+    
+    if (!table->statistics.analyzed || distinct <= 0) {
+        return DEFAULT_EQ_SELECTIVITY;
+    }
+    
+    return 1.0 / distinct;
+}
+
+// Estimated fraction of rows inside a key range of a column
+double rangeSelectivity(Table* table, int column_index, IndexRange* range) {
+    Column* column = &table->columns[column_index];
+    ColumnStatistics* statistics = &table->statistics.columns[column_index];
+    double equal = equalitySelectivity(table, column_index);
+    
+    // Point lookup
+    if (range->low && range->high && range->low_inclusive && range->high_inclusive &&
+        compareValues(column->type, range->low, range->high, columnStorageSize(column)) == 0) {
+        return equal;
+    }
+    
+    if (!table->statistics.analyzed || !statistics->has_histogram) {
+        double selectivity = 1.0;
+        if (range->low) selectivity *= DEFAULT_RANGE_SELECTIVITY;
+        if (range->high) selectivity *= DEFAULT_RANGE_SELECTIVITY;
+        return selectivity;
+    }
+    
+    double start = 0.0;
+    double end = 1.0;
+    
+    if (range->low) {
+        start = fractionBelow(statistics, numericValue(column->type, range->low), equal);
+        if (!range->low_inclusive) start += equal;
+    }
+    if (range->high) {
+        end = fractionBelow(statistics, numericValue(column->type, range->high), equal);
+        if (range->high_inclusive) end += equal;
+    }
+    
+    double selectivity = end - start;
+    return selectivity < 0.0 ? 0.0 : (selectivity > 1.0 ? 1.0 : selectivity);
+}
+
+// Estimated fraction of rows passing every WHERE condition
+// Range conditions on one column are merged into a single range first;
+// different columns are assumed to be independent.
+double estimateSelectivity(Table* table, Query* query) {
+    double selectivity = 1.0;
+    int seen[MAX_COLUMNS] = {0};
+    
+    for (int i = 0; i < query->where_condition_count; i++) {
+        WhereCondition* condition = &query->where_conditions[i];
+        int column_index = condition->column_index;
+        
+        if (isRangeOperator(condition->operator)) {
+            if (seen[column_index]) continue;
+            seen[column_index] = 1;
+            
+            IndexRange range;
+            memset(&range, 0, sizeof(IndexRange));
+            buildColumnRange(query, column_index, &range);
+            selectivity *= rangeSelectivity(table, column_index, &range);
+        } else if (condition->operator == OP_NOT_EQUAL) {
+            selectivity *= 1.0 - equalitySelectivity(table, column_index);
+        } else if (condition->operator == OP_LIKE) {
+            selectivity *= DEFAULT_LIKE_SELECTIVITY;
+        } else {
+            selectivity *= DEFAULT_RANGE_SELECTIVITY;
+        }
+    }
+    
+    return selectivity;
+}
+
+// =============================================================================
+// VECTORIZED SCANS
+// =============================================================================
+
+// Build a column store from the table's heap rows
+// Later heap writes keep it in step, so row id i is the same row version in
+// both layouts and shares its visibility.
+int enableColumnStore(Table* table) {
+    if (!table || table->column_store) {
+        return -1;
+    }
+    
+    ColumnStore* store = malloc(sizeof(ColumnStore));
+    if (!store) return -1;
+    
+    memset(store, 0, sizeof(ColumnStore));
+    for (int c = 0; c < table->column_count; c++) {
+        store->columns[c].width = columnStorageSize(&table->columns[c]);
+    }
+    pthread_rwlock_init(&store->latch, NULL);
+    table->column_store = store;
+    
+    if (reserveColumnStore(table, table->heap_row_count) != 0) {
+        freeColumnStore(table);
+        return -1;
+    }
+    
+    Page page;
+    for (int p = 0; p < table->heap_page_count; p++) {
+        if (readPage(table->storage, table->heap_pages[p], &page) != 0) {
+            freeColumnStore(table);
+            return -1;
+        }
+        
+        for (int slot = 0; slot < page.record_count; slot++) {
+            storeColumnRow(table, p * table->rows_per_page + slot, rowSlot(table, &page, slot));
+        }
+    }
+    __atomic_add_fetch(&table->schema_version, 1, __ATOMIC_RELEASE); // Cached plans may now use it
+    
+    // Recovery rebuilds the store from the heap, so the log only notes it
+    WriteAheadLog* wal = activeLog(table->storage);
+    if (wal) {
+        LogRecordHeader header;
+        memset(&header, 0, sizeof(header));
+        header.type = WAL_COLUMN_STORE;
+        header.table_id = table->table_id;
+        
+        Lsn lsn = appendLogRecord(wal, &header, NULL, 0);
+        if (!lsn || flushLog(wal, lsn) != 0) {
+            return -1;
+        }
+    }
+    
+    return 0;
+}
+
+// Comparison outcomes that satisfy an operator: 1 = less, 2 = equal, 4 = greater
+int operatorOutcomes(Operator op) {
+    switch (op) {
+        case OP_EQUAL: return 2;
+        case OP_NOT_EQUAL: return 1 | 4;
+        case OP_LESS_THAN: return 1;
+        case OP_LESS_EQUAL: return 1 | 2;
+        case OP_GREATER_THAN: return 4;
+        case OP_GREATER_EQUAL: return 2 | 4;
+        default: return 0;
+    }
+}
+
+// Set bit i of bits for each values[i] whose comparison with the literal
+// has one of the wanted outcomes (bits must start zeroed)
+void compareIntBatch(const int* values, int count, int literal, int outcomes, unsigned long long* bits) {
+    int i = 0;
+    
+#if defined(__SSE2__)
+    // Four values per compare; the wanted outcomes select lanes branch-free
+    __m128i key = _mm_set1_epi32(literal);
+    __m128i want_less = _mm_set1_epi32(outcomes & 1 ? -1 : 0);
+    __m128i want_equal = _mm_set1_epi32(outcomes & 2 ? -1 : 0);
+    __m128i want_greater = _mm_set1_epi32(outcomes & 4 ? -1 : 0);
+    
+    for (; i + 4 <= count; i += 4) {
+        __m128i value = _mm_loadu_si128((const __m128i*)(values + i));
+        __m128i hit = _mm_or_si128(
+            _mm_and_si128(_mm_cmplt_epi32(value, key), want_less),
+            _mm_or_si128(_mm_and_si128(_mm_cmpeq_epi32(value, key), want_equal),
+                         _mm_and_si128(_mm_cmpgt_epi32(value, key), want_greater)));
+        bits[i / 64] |= (unsigned long long)_mm_movemask_ps(_mm_castsi128_ps(hit)) << (i % 64);
+    }
+#endif
+    
+    for (; i < count; i++) {
+        int outcome = values[i] < literal ? 1 : (values[i] == literal ? 2 : 4);
+        bits[i / 64] |= (unsigned long long)((outcomes & outcome) != 0) << (i % 64);
+    }
+}
+
+// Double version of compareIntBatch(); NaN matches no outcome
+void compareDoubleBatch(const double* values, int count, double literal, int outcomes,
+                        unsigned long long* bits) {
+    int i = 0;
+    
+#if defined(__SSE2__)
+    __m128d key = _mm_set1_pd(literal);
+    __m128d want_less = _mm_castsi128_pd(_mm_set1_epi32(outcomes & 1 ? -1 : 0));
+    __m128d want_equal = _mm_castsi128_pd(_mm_set1_epi32(outcomes & 2 ? -1 : 0));
+    __m128d want_greater = _mm_castsi128_pd(_mm_set1_epi32(outcomes & 4 ? -1 : 0));
+    
+    for (; i + 2 <= count; i += 2) {
+        __m128d value = _mm_loadu_pd(values + i);
+        __m128d hit = _mm_or_pd(
+            _mm_and_pd(_mm_cmplt_pd(value, key), want_less),
+            _mm_or_pd(_mm_and_pd(_mm_cmpeq_pd(value, key), want_equal),
+                      _mm_and_pd(_mm_cmpgt_pd(value, key), want_greater)));
+        bits[i / 64] |= (unsigned long long)_mm_movemask_pd(hit) << (i % 64);
+    }
+#endif
+    
+    for (; i < count; i++) {
+        int outcome = values[i] < literal ? 1 : (values[i] > literal ? 4 : (values[i] == literal ? 2 : 0));
+        bits[i / 64] |= (unsigned long long)((outcomes & outcome) != 0) << (i % 64);
+    }
+}
+
+// Check whether a condition has a SIMD compare kernel
+int isVectorizedCondition(WhereCondition* condition) {
+    return condition->value_type == DATA_TYPE_INTEGER || condition->value_type == DATA_TYPE_BOOLEAN ||
+           condition->value_type == DATA_TYPE_FLOAT;
+}
+
+// Evaluate a vectorized condition over a batch of column values into a bitmask
+void compareColumnBatch(ColumnVector* vector, WhereCondition* condition, int start, int count,
+                        unsigned long long* bits) {
+    const unsigned char* values = vector->values + (size_t)start * vector->width;
+    int outcomes = operatorOutcomes(condition->operator);
+    
+    memset(bits, 0, bitmapWords(count) * sizeof(unsigned long long));
+    
+    if (condition->value_type == DATA_TYPE_FLOAT) {
+        double literal;
+        memcpy(&literal, condition->encoded_value, sizeof(double));
+        compareDoubleBatch((const double*)values, count, literal, outcomes, bits);
+    } else {
+        int literal;
+        memcpy(&literal, condition->encoded_value, sizeof(int));
+        compareIntBatch((const int*)values, count, literal, outcomes, bits);
+    }
+}
+
+// Clear the mask bits of selected rows that fail a condition, checking
+// them one at a time with evaluateCondition()
+void refineColumnBatch(ColumnVector* vector, WhereCondition* condition, int start, int words,
+                       unsigned long long* mask) {
+    for (int w = 0; w < words; w++) {
+        unsigned long long word = mask[w];
+        
+        while (word) {
+            int bit = __builtin_ctzll(word);
+            int row = start + w * 64 + bit;
+            word &= word - 1;
+            
+            if (((vector->nulls[row / 64] >> (row % 64)) & 1) ||
+                !evaluateCondition(condition, vector->values + (size_t)row * vector->width, condition->value)) {
+                mask[w] &= ~(1ULL << bit);
+            }
+        }
+    }
+}
+
+// Evaluate WHERE conditions over rows [start, start + count) of the column
+// store (start is a multiple of VECTOR_SIZE, count at most VECTOR_SIZE)
+// The mask starts with the row versions visible to the query's snapshot.
+// SIMD conditions run first over the whole batch, each yielding a bitmask
+// that is ANDed with the non-NULL rows. Text and other conditions then
+// visit only the rows still selected, and the surviving bits become the
+// selection vector. Callers hold the store's latch shared.
+int filterColumnBatch(Table* table, Query* query, const int* conditions, int condition_count,
+                      int start, int count, SelectionVector* selection) {
+    ColumnStore* store = table->column_store;
+    unsigned long long mask[VECTOR_SIZE / 64];
+    unsigned long long bits[VECTOR_SIZE / 64];
+    int words = bitmapWords(count);
+    int first_word = start / 64;
+    unsigned long long any = visibleRowMask(table, start, count, &query->snapshot, mask) > 0;
+    
+    // Stop as soon as no row is left for later conditions to reject
+    for (int pass = 0; pass < 2 && any; pass++) {
+        for (int c = 0; c < condition_count && any; c++) {
+            WhereCondition* condition = &query->where_conditions[conditions[c]];
+            ColumnVector* vector = &store->columns[condition->column_index];
+            
+            if (isVectorizedCondition(condition) != (pass == 0)) continue;
+            
+            if (pass == 0) {
+                compareColumnBatch(vector, condition, start, count, bits);
+                for (int w = 0; w < words; w++) {
+                    mask[w] &= bits[w] & ~vector->nulls[first_word + w];
+                }
+            } else {
+                refineColumnBatch(vector, condition, start, words, mask);
+            }
+            
+            any = 0;
+            for (int w = 0; w < words; w++) {
+                any |= mask[w];
+            }
+        }
+    }
+    
+    selection->count = 0;
+    for (int w = 0; w < words; w++) {
+        unsigned long long word = mask[w];
+        while (word) {
+            selection->positions[selection->count++] = (unsigned short)(w * 64 + __builtin_ctzll(word));
+            word &= word - 1;
+        }
+    }
+    
+    return selection->count;
+}
+
+// Rebuild a heap-format row from the column store
+void materializeColumnRow(Table* table, RowId row_id, unsigned char* row) {
+    ColumnStore* store = table->column_store;
+    unsigned long long nulls = 0;
+    int deleted = 0;
+    
+    memcpy(row, &store->record_ids[row_id], sizeof(int));
+    memcpy(row + sizeof(int), &deleted, sizeof(int));
+    
+    for (int c = 0; c < table->column_count; c++) {
+        ColumnVector* vector = &store->columns[c];
+        memcpy(row + table->column_offsets[c], vector->values + (size_t)row_id * vector->width, vector->width);
+        nulls |= ((vector->nulls[row_id / 64] >> (row_id % 64)) & 1) << c;
+    }
+    
+    memcpy(row + ROW_NULLS_OFFSET, &nulls, sizeof(nulls));
+}
+
+// Start an empty aggregate
+void initAggregateResult(AggregateResult* result) {
+    memset(result, 0, sizeof(AggregateResult));
+    result->min = INFINITY;
+    result->max = -INFINITY;
+}
+
+// Add one non-NULL value to an aggregate
+void accumulateValue(AggregateResult* result, double value) {
+    result->count++;
+    result->sum += value;
+    if (value < result->min) result->min = value;
+    if (value > result->max) result->max = value;
+}
+
+// Aggregate the selected rows of one batch of a column
+// Integer sums are kept exact in 64 bits within the batch.
+void aggregateColumnBatch(ColumnVector* vector, DataType type, int start, SelectionVector* selection,
+                          AggregateResult* result) {
+    const unsigned long long* nulls = vector->nulls;
+    
+    if (type == DATA_TYPE_INTEGER || type == DATA_TYPE_BOOLEAN) {
+        const int* values = (const int*)vector->values + start;
+        long long sum = 0;
+        int low = INT_MAX, high = INT_MIN, count = 0;
+        
+        for (int i = 0; i < selection->count; i++) {
+            int row = start + selection->positions[i];
+            if ((nulls[row / 64] >> (row % 64)) & 1) continue;
+            
+            int value = values[selection->positions[i]];
+            sum += value;
+            low = value < low ? value : low;
+            high = value > high ? value : high;
+            count++;
+        }
+        
+        if (count > 0) {
+            result->count += count;
+            result->sum += (double)sum;
+            if (low < result->min) result->min = low;
+            if (high > result->max) result->max = high;
+        }
+        return;
+    }
+    
+    if (type == DATA_TYPE_FLOAT) {
+        const double* values = (const double*)vector->values + start;
+        
+        for (int i = 0; i < selection->count; i++) {
+            int row = start + selection->positions[i];
+            if ((nulls[row / 64] >> (row % 64)) & 1) continue;
+            
+            double value = values[selection->positions[i]];
+            result->count++;
+            result->sum += value;
+            result->min = value < result->min ? value : result->min;
+            result->max = value > result->max ? value : result->max;
+        }
+        return;
+    }
+    
+    for (int i = 0; i < selection->count; i++) {
+        int row = start + selection->positions[i];
+        if ((nulls[row / 64] >> (row % 64)) & 1) continue;
+        
+        accumulateValue(result, numericValue(type, vector->values + (size_t)row * vector->width));
+    }
+}
+
+// =============================================================================
+// QUERY PLANNER
+// =============================================================================
+
+// Allocate a plan node
+QueryPlanNode* createPlanNode(int node_type, Table* table, Query* query) {
+    QueryPlanNode* node = malloc(sizeof(QueryPlanNode));
+    if (!node) return NULL;
+    
+    memset(node, 0, sizeof(QueryPlanNode));
+    node->node_type = node_type;
+    node->table = table;
+    node->query = query;
+    node->table_id = -1;
+    node->index_id = -1;
+    node->sort_column = -1;
+    node->loaded_page = -1;
+    
+    return node;
+}
+
+// Drop a join's hash table, spill files and merge group; the plan stays
+void resetJoinState(JoinState* join) {
+    free(join->build_rows);
+    free(join->hashes);
+    free(join->next);
+    free(join->buckets);
+    free(join->probe_buffer);
+    free(join->group);
+    
+    for (int i = 0; i < join->partition_count; i++) {
+        if (join->build_files[i]) fclose(join->build_files[i]);
+        if (join->probe_files[i]) fclose(join->probe_files[i]);
+    }
+    
+    join->build_rows = NULL;
+    join->hashes = NULL;
+    join->next = NULL;
+    join->buckets = NULL;
+    join->probe_buffer = NULL;
+    join->group = NULL;
+    join->build_count = 0;
+    join->build_capacity = 0;
+    join->phase = JOIN_PHASE_BUILD;
+    join->probe_row = NULL;
+    join->match = -1;
+    join->partition_count = 0;
+    join->partition = -1;
+    join->spilled_rows = 0;
+    join->left_row = NULL;
+    join->lookahead = NULL;
+    join->group_count = 0;
+    join->group_capacity = 0;
+    join->group_position = 0;
+    join->started = 0;
+}
+
+// Free a sort node's rows and close its run files
+void resetSortState(SortState* sort) {
+    free(sort->buffer);
+    free(sort->rows);
+    free(sort->heads);
+    free(sort->heap);
+    
+    for (int i = 0; i < sort->run_count; i++) {
+        fclose(sort->runs[i]);
+    }
+    free(sort->runs);
+    
+    memset(sort, 0, sizeof(SortState));
+    sort->returned = -1;
+}
+
+// Free a plan tree and any buffers its iterators hold
+void freeQueryPlan(QueryPlanNode* node) {
+    if (!node) return;
+    
+    for (int i = 0; i < node->child_count; i++) {
+        freeQueryPlan(node->children[i]);
+    }
+    
+    if (node->join) {
+        resetJoinState(node->join);
+        free(node->join->row);
+        free(node->join);
+    }
+    
+    if (node->sort) {
+        resetSortState(node->sort);
+        free(node->sort);
+    }
+    
+    free(node);
+}
+
+// Put a node on top of a plan subtree
+QueryPlanNode* stackPlanNode(QueryPlanNode* node, QueryPlanNode* child) {
+    if (!node) {
+        freeQueryPlan(child);
+        return NULL;
+    }
+    
+    node->children[0] = child;
+    node->child_count = 1;
+    return node;
+}
+
+// Move FILTER conditions into the scan below them
+// Rows are then rejected while their page is in hand instead of being
+// passed up the tree first.
+QueryPlanNode* pushDownFilters(QueryPlanNode* node) {
+    for (int i = 0; i < node->child_count; i++) {
+        node->children[i] = pushDownFilters(node->children[i]);
+    }
+    
+    if (node->node_type == PLAN_FILTER && node->children[0]->node_type == PLAN_SCAN) {
+        QueryPlanNode* scan = node->children[0];
+        
+        for (int i = 0; i < node->condition_count; i++) {
+            scan->conditions[scan->condition_count++] = node->conditions[i];
+        }
+        
+        node->child_count = 0;
+        freeQueryPlan(node);
+        return scan;
+    }
+    
+    return node;
+}
+
+// Estimated cost of reading the whole heap
+double sequentialScanCost(Table* table) {
+    double rows = publishedRowCount(table);
+    return ceil(rows / table->rows_per_page) * COST_SEQ_PAGE + rows * COST_CPU_ROW;
+}
+
+// Estimated cost of an index range scan including its heap fetches
+// Fetches cost between one sequential read per heap page (rows stored in key
+// order) and one random read per row (no order), interpolated by the squared
+// correlation between key order and physical order.
+double indexScanCost(Table* table, Index* index, double matched_rows) {
+    double leaf_entries = nodeCapacity(leafEntrySize(index)) * BTREE_BULK_FILL_PERCENT / 100.0;
+    double descent = __atomic_load_n(&index->height, __ATOMIC_RELAXED) * COST_RANDOM_PAGE;
+    double leaves = ceil(matched_rows / leaf_entries) * COST_SEQ_PAGE;
+    
+    double correlation = table->statistics.analyzed ?
+                         table->statistics.columns[index->column_index].correlation : 0.0;
+    double best = ceil(matched_rows / table->rows_per_page) * COST_SEQ_PAGE;
+    double worst = matched_rows * COST_RANDOM_PAGE;
+    double fetch = worst + correlation * correlation * (best - worst);
+    
+    return descent + leaves + fetch + matched_rows * COST_CPU_ROW;
+}
+
+// Choose between the heap scan and each usable index for the access node
+void chooseAccessPath(Table* table, Query* query, QueryPlanNode* scan) {
+    double rows = publishedRowCount(table);
+    double best_cost = sequentialScanCost(table);
+    int best_index = -1;
+    IndexRange best_range;
+    memset(&best_range, 0, sizeof(IndexRange));
+    
+    if (query->use_indexes != USE_INDEXES_NEVER) {
+        for (int i = 0; i < table->index_count; i++) {
+            Index* index = &table->indexes[i];
+            IndexRange range;
+            memset(&range, 0, sizeof(IndexRange));
+            
+            if (buildColumnRange(query, index->column_index, &range) == 0) continue;
+            
+            double matched = rows * rangeSelectivity(table, index->column_index, &range);
+            double cost = indexScanCost(table, index, matched);
+            int forced = query->use_indexes == USE_INDEXES_ALWAYS && best_index == -1;
+            
+            if (forced || cost < best_cost) {
+                best_cost = cost;
+                best_index = i;
+                best_range = range;
+                best_range.index = index;
+            }
+        }
+    }
+    
+    // The column store compares only the condition columns in batches and
+    // rebuilds just the matching rows
+    double matched = rows * estimateSelectivity(table, query);
+    int column_scan = 0;
+    
+    if (table->column_store && query->use_column_store &&
+        !(query->use_indexes == USE_INDEXES_ALWAYS && best_index >= 0)) {
+        int compared = query->where_condition_count > 0 ? query->where_condition_count : 1;
+        double cost = rows * compared * COST_VECTOR_VALUE + matched * COST_CPU_ROW;
+        
+        if (cost < best_cost) {
+            best_cost = cost;
+            best_index = -1;
+            column_scan = 1;
+        }
+    }
+    
+    scan->estimated_rows = (int)ceil(matched);
+    scan->estimated_cost = (int)ceil(best_cost);
+    
+    if (column_scan) {
+        scan->node_type = PLAN_COLUMN_SCAN;
+    } else if (best_index >= 0) {
+        scan->node_type = PLAN_INDEX_SCAN;
+        scan->index_id = best_index;
+        scan->range = best_range;
+    }
+}
+
+// Drop a SORT whose input already comes from an ascending scan of the
+// sort column's index
+QueryPlanNode* eliminateSort(QueryPlanNode* node) {
+    for (int i = 0; i < node->child_count; i++) {
+        node->children[i] = eliminateSort(node->children[i]);
+    }
+    
+    if (node->node_type == PLAN_SORT && node->query->sort_ascending) {
+        QueryPlanNode* child = node->children[0];
+        
+        if (child->node_type == PLAN_INDEX_SCAN &&
+            child->table->indexes[child->index_id].column_index == node->sort_column) {
+            node->child_count = 0;
+            freeQueryPlan(node);
+            return child;
+        }
+    }
+    
+    return node;
+}
+
+// Join key of an input row, or NULL if the key is NULL
+const unsigned char* joinKey(QueryPlanNode* node, int input, const unsigned char* row) {
+    Table* table = node->children[input]->table;
+    int column_index = node->join->key_columns[input];
+    return isFieldNull(row, column_index) ? NULL : row + table->column_offsets[column_index];
+}
+
+// Compare join keys from either input
+// Text columns of different widths compare over the narrower one, which
+// always holds the terminator of its value.
+int compareJoinKeys(QueryPlanNode* node, const unsigned char* a, const unsigned char* b) {
+    JoinState* join = node->join;
+    Column* left = &node->children[0]->table->columns[join->key_columns[0]];
+    Column* right = &node->children[1]->table->columns[join->key_columns[1]];
+    int left_size = columnStorageSize(left);
+    int right_size = columnStorageSize(right);
+    
+    return compareValues(left->type, a, b, left_size < right_size ? left_size : right_size);
+}
+
+// Hash a join key so that keys comparing equal hash alike
+unsigned long long hashJoinKey(QueryPlanNode* node, int input, const unsigned char* key) {
+    Column* column = &node->children[input]->table->columns[node->join->key_columns[input]];
+    unsigned long long hash = 1469598103934665603ULL;
+    
+    if (column->type == DATA_TYPE_TEXT) {
+        hash = hashText(key, columnStorageSize(column));
+    } else {
+        unsigned char bytes[MAX_FIELD_SIZE];
+        int size = columnStorageSize(column);
+        size = size < MAX_FIELD_SIZE ? size : MAX_FIELD_SIZE;
+        memcpy(bytes, key, size);
+        
+        if (column->type == DATA_TYPE_FLOAT) {
+            double value;
+            memcpy(&value, bytes, sizeof(double));
+            if (value == 0.0) memset(bytes, 0, sizeof(double)); // -0.0 equals 0.0
+        }
+        
+        for (int i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+    }
+    
+    // Spread the bits: buckets use the low ones, partitions the high ones
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// Memory one build row takes in a hash table: the row, its hash, its chain
+// link and its share of the buckets
+size_t hashEntryBytes(int row_size) {
+    return (size_t)row_size + sizeof(unsigned long long) + 3 * sizeof(int);
+}
+
+// Estimated rows of an equi-join
+// Every key of the side with fewer distinct keys is assumed to find a match
+// (a foreign key join); a side without statistics counts its keys as unique.
+double estimateJoinRows(QueryPlanNode* node) {
+    double rows[2];
+    double distinct = 1.0;
+    
+    for (int i = 0; i < 2; i++) {
+        Table* table = node->children[i]->table;
+        ColumnStatistics* statistics = &table->statistics.columns[node->join->key_columns[i]];
+        double keys = table->statistics.analyzed && statistics->distinct_count > 0 ?
+                      statistics->distinct_count : publishedRowCount(table);
+        
+        rows[i] = node->children[i]->estimated_rows;
+        distinct = keys > distinct ? keys : distinct;
+    }
+    
+    return rows[0] * rows[1] / distinct;
+}
+
+// Estimated cost of writing a hash join's inputs to partitions and reading
+// them back; zero while the build input fits in memory
+double hashJoinSpillCost(QueryPlanNode* node) {
+    JoinState* join = node->join;
+    QueryPlanNode* build = node->children[join->build_input];
+    
+    if (build->estimated_rows * (double)hashEntryBytes(build->table->row_size) <= join->memory_budget) {
+        return 0.0;
+    }
+    
+    double bytes = 0.0;
+    for (int i = 0; i < 2; i++) {
+        bytes += (double)node->children[i]->estimated_rows * node->children[i]->table->row_size;
+    }
+    return 2.0 * ceil(bytes / PAGE_DATA_SIZE) * COST_SEQ_PAGE;
+}
+
+// Rows a sort node may buffer within the query's work_memory (at least two)
+int sortCapacity(QueryPlanNode* node) {
+    size_t rows = node->query->work_memory / (node->table->row_size + sizeof(unsigned char*));
+    return rows < 2 ? 2 : rows < INT_MAX ? (int)rows : INT_MAX;
+}
+
+// Estimated cost of sorting rows input rows
+// ORDER BY ... LIMIT k checks each row against a heap of k rows. A sort that
+// outgrows work_memory also writes and reads every row once per merge pass.
+double sortCost(QueryPlanNode* node, double rows) {
+    Query* query = node->query;
+    double capacity = sortCapacity(node);
+    double kept = query->limit >= 0 ? (double)query->offset + query->limit : rows;
+    
+    if (kept < rows && kept <= capacity) {
+        return rows * COST_CPU_ROW + (kept > 1 ? 2.0 * kept * log2(kept) * COST_CPU_ROW : 0.0);
+    }
+    
+    double cost = rows > 1 ? 2.0 * rows * log2(rows) * COST_CPU_ROW : 0.0;
+    double runs = ceil(rows / capacity);
+    if (runs > 1) {
+        double passes = ceil(log(runs) / log(SORT_MERGE_FAN_IN));
+        cost += 2.0 * passes * ceil(rows * node->table->row_size / PAGE_DATA_SIZE) * COST_SEQ_PAGE;
+    }
+    return cost;
+}
+
+// Fill in row and cost estimates from the leaves up; returns node count
+int estimatePlanNode(QueryPlanNode* node) {
+    int steps = 1;
+    for (int i = 0; i < node->child_count; i++) {
+        steps += estimatePlanNode(node->children[i]);
+    }
+    
+    if (node->child_count == 0) {
+        return steps; // Access paths are costed by chooseAccessPath()
+    }
+    
+    QueryPlanNode* child = node->children[0];
+    double rows = child->estimated_rows;
+    double cost = child->estimated_cost;
+    
+    switch (node->node_type) {
+        case PLAN_FILTER:
+            node->estimated_rows = child->estimated_rows;
+            cost += rows * COST_CPU_ROW;
+            break;
+        case PLAN_SORT:
+            node->estimated_rows = child->estimated_rows;
+            cost += sortCost(node, rows);
+            break;
+        case PLAN_HASH_JOIN:
+        case PLAN_MERGE_JOIN: {
+            QueryPlanNode* right = node->children[1];
+            double joined = estimateJoinRows(node);
+            node->estimated_rows = joined < INT_MAX ? (int)ceil(joined) : INT_MAX;
+            cost += right->estimated_cost + (rows + right->estimated_rows) * COST_CPU_ROW;
+            if (node->node_type == PLAN_HASH_JOIN) {
+                cost += hashJoinSpillCost(node);
+            }
+            break;
+        }
+        case PLAN_LIMIT: {
+            Query* query = node->query;
+            double wanted = query->limit >= 0 ? query->offset + query->limit : rows;
+            double output = (wanted < rows ? wanted : rows) - query->offset;
+            node->estimated_rows = output > 0 ? (int)output : 0;
+            
+            // Without a SORT below, the input stops as soon as LIMIT is met
+            if (child->node_type != PLAN_SORT && rows > 0 && wanted < rows) {
+                cost *= wanted / rows;
+            }
+            break;
+        }
+    }
+    
+    node->estimated_cost = (int)ceil(cost);
+    return steps;
+}
+
+// Build and optimize the plan for a SELECT
+// Starts from SCAN -> FILTER -> SORT -> LIMIT, pushes the filter into the
+// scan, picks the cheapest access path and drops a SORT that the chosen
+// index already satisfies.
+QueryPlanNode* optimizeQuery(Database* db, Table* table, Query* query, QueryOptimizer* optimizer) {
+    memset(optimizer, 0, sizeof(QueryOptimizer));
+    
+    QueryPlanNode* plan = createPlanNode(PLAN_SCAN, table, query);
+    if (!plan) return NULL;
+    plan->table_id = (int)(table - db->tables);
+    
+    if (query->where_condition_count > 0) {
+        plan = stackPlanNode(createPlanNode(PLAN_FILTER, table, query), plan);
+        if (!plan) return NULL;
+        
+        for (int i = 0; i < query->where_condition_count; i++) {
+            plan->conditions[plan->condition_count++] = i;
+        }
+    }
+    
+    int sort_column = query->sort_column[0] ? findColumn(table, query->sort_column) : -1;
+    if (sort_column >= 0) {
+        plan = stackPlanNode(createPlanNode(PLAN_SORT, table, query), plan);
+        if (!plan) return NULL;
+        plan->sort_column = sort_column;
+    }
+    
+    if (query->limit >= 0 || query->offset > 0) {
+        plan = stackPlanNode(createPlanNode(PLAN_LIMIT, table, query), plan);
+        if (!plan) return NULL;
+    }
+    
+    plan = pushDownFilters(plan);
+    
+    QueryPlanNode* access = plan;
+    while (access->child_count > 0) {
+        access = access->children[0];
+    }
+    chooseAccessPath(table, query, access);
+    
+    plan = eliminateSort(plan);
+    
+    optimizer->plan = plan;
+    optimizer->plan_steps = estimatePlanNode(plan);
+    optimizer->plan_cost = plan->estimated_cost;
+    return plan;
+}
+
+// Rebuild index scan key ranges from the query's current literals
+void refreshPlanRanges(QueryPlanNode* node) {
+    for (int i = 0; i < node->child_count; i++) {
+        refreshPlanRanges(node->children[i]);
+    }
+    
+    if (node->node_type == PLAN_INDEX_SCAN) {
+        Index* index = node->range.index;
+        memset(&node->range, 0, sizeof(IndexRange));
+        buildColumnRange(node->query, index->column_index, &node->range);
+        node->range.index = index;
+    }
+}
+
+// =============================================================================
+// JOIN PLANNING
+// =============================================================================
+
+// Copy the WHERE conditions on one table of a JOIN into that input's query
+// Conditions keep their order, so a plan built on the input stays valid
+// when it is derived again for new literals or a new snapshot.
+void deriveJoinInput(Query* query, Table* table, int side, Query* input) {
+    initQuery(input, QUERY_SELECT);
+    snprintf(input->table_name, sizeof(input->table_name), "%s", table->name);
+    input->use_indexes = query->use_indexes;
+    input->use_column_store = query->use_column_store;
+    input->transaction_id = query->transaction_id;
+    input->snapshot = query->snapshot;
+    input->work_memory = query->work_memory;
+    
+    for (int i = 0; i < query->where_condition_count; i++) {
+        if (query->where_conditions[i].join_side == side) {
+            input->where_conditions[input->where_condition_count++] = query->where_conditions[i];
+        }
+    }
+}
+
+// Describe joined rows: the left table's columns, then the right table's
+// Both tables' rows keep their column order and widths after one header.
+// Each table name is cut to half the name buffer so " JOIN " always fits.
+int initJoinOutput(Table* output, Table* left, Table* right) {
+    int side_length = (int)(sizeof(output->name) - sizeof(" JOIN ")) / 2;
+    memset(output, 0, sizeof(Table));
+    snprintf(output->name, sizeof(output->name), "%.*s JOIN %.*s",
+             side_length, left->name, side_length, right->name);
+    memcpy(output->columns, left->columns, left->column_count * sizeof(Column));
+    memcpy(output->columns + left->column_count, right->columns, right->column_count * sizeof(Column));
+    output->column_count = left->column_count + right->column_count;
+    output->primary_key_column = -1;
+    output->table_id = -1;
+    
+    return computeRowLayout(output);
+}
+
+// Allocate a join node with its input queries and output layout
+QueryPlanNode* createJoinNode(Database* db, int node_type, Table** tables, Query* query) {
+    QueryPlanNode* node = createPlanNode(node_type, NULL, query);
+    JoinState* join = node ? calloc(1, sizeof(JoinState)) : NULL;
+    if (!join) {
+        free(node);
+        return NULL;
+    }
+    
+    node->join = join;
+    node->table = &join->output;
+    resetJoinState(join);
+    
+    if (initJoinOutput(&join->output, tables[0], tables[1]) != 0 ||
+        !(join->row = malloc(join->output.row_size))) {
+        freeQueryPlan(node);
+        return NULL;
+    }
+    
+    // The ON columns may be written in either order
+    int first = findOutputColumn(db, query, query->join_columns[0]);
+    int second = findOutputColumn(db, query, query->join_columns[1]);
+    join->key_columns[0] = first < second ? first : second;
+    join->key_columns[1] = (first < second ? second : first) - tables[0]->column_count;
+    join->memory_budget = query->work_memory ? query->work_memory : DEFAULT_WORK_MEMORY;
+    
+    for (int i = 0; i < 2; i++) {
+        deriveJoinInput(query, tables[i], i, &join->inputs[i]);
+    }
+    
+    return node;
+}
+
+// Check whether an index returns a column's rows in value order
+// A text key cut short by the index is ordered only on its prefix.
+int indexOrdersColumn(Table* table, Index* index, int column_index) {
+    return index->column_index == column_index &&
+           index->key_size >= columnStorageSize(&table->columns[column_index]);
+}
+
+// Plan one input of a merge join so that it arrives ordered on its key
+// Either an index on the key column is read in key order, or the input's
+// best access path is sorted; the cheaper estimate wins.
+QueryPlanNode* planMergeInput(Database* db, Table* table, Query* input, int key_column) {
+    QueryOptimizer optimizer;
+    QueryPlanNode* access = optimizeQuery(db, table, input, &optimizer);
+    if (!access) return NULL;
+    
+    if (access->node_type == PLAN_INDEX_SCAN &&
+        indexOrdersColumn(table, &table->indexes[access->index_id], key_column)) {
+        return access; // Its conditions already chose the ordered index
+    }
+    
+    QueryPlanNode* sorted = stackPlanNode(createPlanNode(PLAN_SORT, table, input), access);
+    if (!sorted) return NULL;
+    sorted->sort_column = key_column;
+    estimatePlanNode(sorted);
+    
+    for (int i = 0; i < table->index_count && input->use_indexes != USE_INDEXES_NEVER; i++) {
+        Index* index = &table->indexes[i];
+        if (!indexOrdersColumn(table, index, key_column)) continue;
+        
+        // Full or range scan of the key index, checking every condition
+        QueryPlanNode* ordered = createPlanNode(PLAN_INDEX_SCAN, table, input);
+        if (!ordered) break;
+        
+        ordered->table_id = table->table_id;
+        ordered->index_id = i;
+        buildColumnRange(input, key_column, &ordered->range);
+        ordered->range.index = index;
+        for (int c = 0; c < input->where_condition_count; c++) {
+            ordered->conditions[ordered->condition_count++] = c;
+        }
+        
+        double rows = publishedRowCount(table);
+        double read = rows * rangeSelectivity(table, key_column, &ordered->range);
+        ordered->estimated_rows = (int)ceil(rows * estimateSelectivity(table, input));
+        ordered->estimated_cost = (int)ceil(indexScanCost(table, index, read));
+        
+        if (ordered->estimated_cost < sorted->estimated_cost) {
+            freeQueryPlan(sorted);
+            return ordered;
+        }
+        freeQueryPlan(ordered);
+        break;
+    }
+    
+    return sorted;
+}
+
+// Build and optimize the plan for a SELECT with a JOIN
+// Each table's conditions are planned as a single-table query below the
+// join. A hash join builds on the input with fewer estimated bytes; a merge
+// join reads both inputs in key order. The cheaper estimate wins unless
+// join_method asks for one. SORT and LIMIT go above the join.
+QueryPlanNode* optimizeJoinQuery(Database* db, Table* table, Table* joined, Query* query,
+                                 QueryOptimizer* optimizer) {
+    memset(optimizer, 0, sizeof(QueryOptimizer));
+    
+    Table* tables[2] = {table, joined};
+    QueryPlanNode* candidates[2] = {NULL, NULL};
+    const int node_types[2] = {PLAN_HASH_JOIN, PLAN_MERGE_JOIN};
+    const int methods[2] = {JOIN_METHOD_HASH, JOIN_METHOD_MERGE};
+    
+    for (int m = 0; m < 2; m++) {
+        if (query->join_method != JOIN_METHOD_COST && query->join_method != methods[m]) continue;
+        
+        QueryPlanNode* node = createJoinNode(db, node_types[m], tables, query);
+        if (!node) continue;
+        JoinState* join = node->join;
+        
+        for (int i = 0; i < 2 && node; i++) {
+            QueryOptimizer input_optimizer;
+            node->children[i] = node_types[m] == PLAN_HASH_JOIN ?
+                optimizeQuery(db, tables[i], &join->inputs[i], &input_optimizer) :
+                planMergeInput(db, tables[i], &join->inputs[i], join->key_columns[i]);
+            
+            if (!node->children[i]) {
+                freeQueryPlan(node);
+                node = NULL;
+            } else {
+                node->child_count = i + 1;
+            }
+        }
+        if (!node) continue;
+        
+        if (node_types[m] == PLAN_HASH_JOIN) {
+            double bytes[2];
+            for (int i = 0; i < 2; i++) {
+                bytes[i] = (double)node->children[i]->estimated_rows * tables[i]->row_size;
+            }
+            join->build_input = bytes[1] <= bytes[0] ? 1 : 0;
+        }
+        
+        estimatePlanNode(node);
+        candidates[m] = node;
+    }
+    
+    QueryPlanNode* plan = candidates[0];
+    if (!plan || (candidates[1] && candidates[1]->estimated_cost < plan->estimated_cost)) {
+        plan = candidates[1];
+    }
+    freeQueryPlan(plan == candidates[0] ? candidates[1] : candidates[0]);
+    if (!plan) return NULL;
+    
+    Table* output = plan->table;
+    int sort_column = query->sort_column[0] ? findOutputColumn(db, query, query->sort_column) : -1;
+    if (sort_column >= 0) {
+        plan = stackPlanNode(createPlanNode(PLAN_SORT, output, query), plan);
+        if (!plan) return NULL;
+        plan->sort_column = sort_column;
+    }
+    
+    if (query->limit >= 0 || query->offset > 0) {
+        plan = stackPlanNode(createPlanNode(PLAN_LIMIT, output, query), plan);
+        if (!plan) return NULL;
+    }
+    
+    optimizer->plan = plan;
+    optimizer->plan_steps = estimatePlanNode(plan);
+    optimizer->plan_cost = plan->estimated_cost;
+    return plan;
+}
+
+// Bind a SELECT against its table, or both tables of a JOIN, and plan it
+QueryPlanNode* planSelectQuery(Database* db, Query* query, QueryOptimizer* optimizer) {
+    Table* table = findTable(db, query->table_name);
+    if (!table) {
+        return NULL;
+    }
+    
+    if (!query->join_table[0]) {
+        return bindWhereConditions(table, query) == 0 ? optimizeQuery(db, table, query, optimizer) : NULL;
+    }
+    
+    Table* joined = findTable(db, query->join_table);
+    if (!joined || bindJoinConditions(db, table, joined, query) != 0) {
+        return NULL;
+    }
+    return optimizeJoinQuery(db, table, joined, query, optimizer);
+}
+
+// =============================================================================
+// PLAN EXECUTION (PULL-BASED ITERATORS)
+// =============================================================================
+
+// Check a row against the conditions attached to a plan node
+int planRowMatches(QueryPlanNode* node, const unsigned char* row) {
+    if (isRowDeleted(row)) {
+        return 0;
+    }
+    
+    for (int i = 0; i < node->condition_count; i++) {
+        WhereCondition* condition = &node->query->where_conditions[node->conditions[i]];
+        const unsigned char* field = row + node->table->column_offsets[condition->column_index];
+        
+        if (isFieldNull(row, condition->column_index) ||
+            !evaluateCondition(condition, field, condition->value)) {
+            return 0;
+        }
+    }
+    
+    return 1;
+}
+
+// Sort context for comparePlanRows (qsort has no context parameter)
+Table* plan_sort_table = NULL;
+int plan_sort_column = 0;
+int plan_sort_ascending = 1;
+
+// Order materialized rows on the sort column
+int comparePlanRows(const void* a, const void* b) {
+    const unsigned char* left = *(const unsigned char* const*)a;
+    const unsigned char* right = *(const unsigned char* const*)b;
+    Column* column = &plan_sort_table->columns[plan_sort_column];
+    int offset = plan_sort_table->column_offsets[plan_sort_column];
+    
+    int result = compareValues(column->type, left + offset, right + offset, columnStorageSize(column));
+    return plan_sort_ascending ? result : -result;
+}
+
+// Open a plan node and its children
+int openPlanNode(QueryPlanNode* node) {
+    // Join inputs pick up the query's current literals and snapshot
+    if (node->join) {
+        for (int i = 0; i < node->child_count; i++) {
+            deriveJoinInput(node->query, node->children[i]->table, i, &node->join->inputs[i]);
+            refreshPlanRanges(node->children[i]);
+        }
+        resetJoinState(node->join);
+    }
+    
+    for (int i = 0; i < node->child_count; i++) {
+        if (openPlanNode(node->children[i]) != 0) {
+            return -1;
+        }
+    }
+    
+    node->page.record_count = 0;
+    node->page_position = 0;
+    node->slot = 0;
+    node->loaded_page = -1;
+    node->produced = 0;
+    node->skipped = 0;
+    node->actual_rows = 0;
+    node->batch_start = 0;
+    node->selection.count = 0;
+    node->row_id = -1;
+    
+    // A reopened SORT sorts again
+    if (node->node_type == PLAN_SORT) {
+        if (!node->sort && !(node->sort = calloc(1, sizeof(SortState)))) {
+            return -1;
+        }
+        resetSortState(node->sort);
+    }
+    
+    // Rows appended after this point belong to later snapshots
+    node->row_limit = publishedRowCount(node->table);
+    
+    if (node->node_type == PLAN_INDEX_SCAN) {
+        IndexRange* range = &node->range;
+        return openIndexCursor(range->index, &node->cursor, range->low, range->low_inclusive,
+                               range->high, range->high_inclusive);
+    }
+    
+    return 0;
+}
+
+// SORT pulls its whole input through nextPlanRow() before returning rows
+const unsigned char* nextPlanRow(QueryPlanNode* node);
+
+// Order two rows on a sort node's column
+int compareSortRows(QueryPlanNode* node, const unsigned char* a, const unsigned char* b) {
+    Column* column = &node->table->columns[node->sort_column];
+    int offset = node->table->column_offsets[node->sort_column];
+    
+    int result = compareValues(column->type, a + offset, b + offset, columnStorageSize(column));
+    return node->query->sort_ascending ? result : -result;
+}
+
+// Record a sort's memory high-water mark
+void noteSortMemory(SortState* sort, size_t bytes) {
+    if (bytes > sort->memory_used) {
+        sort->memory_used = bytes;
+    }
+}
+
+// Sort the buffered row pointers in memory
+void sortBufferedRows(QueryPlanNode* node) {
+    plan_sort_table = node->table;
+    plan_sort_column = node->sort_column;
+    plan_sort_ascending = node->query->sort_ascending;
+    qsort(node->sort->rows, node->sort->count, sizeof(unsigned char*), comparePlanRows);
+}
+
+// Point rows at the rows stored one after another in buffer
+void pointSortRows(QueryPlanNode* node) {
+    SortState* sort = node->sort;
+    for (int i = 0; i < sort->count; i++) {
+        sort->rows[i] = sort->buffer + (size_t)i * node->table->row_size;
+    }
+}
+
+// Double the row buffer, up to the rows the budget allows
+int growSortBuffer(QueryPlanNode* node) {
+    SortState* sort = node->sort;
+    int row_size = node->table->row_size;
+    int allocated = sort->allocated ? sort->allocated * 2 : 256;
+    if (allocated > sort->capacity || allocated < sort->allocated) {
+        allocated = sort->capacity;
+    }
+    
+    unsigned char* buffer = realloc(sort->buffer, (size_t)allocated * row_size);
+    if (!buffer) return -1;
+    sort->buffer = buffer;
+    
+    unsigned char** rows = realloc(sort->rows, (size_t)allocated * sizeof(unsigned char*));
+    if (!rows) return -1;
+    sort->rows = rows;
+    
+    sort->allocated = allocated;
+    noteSortMemory(sort, (size_t)allocated * (row_size + sizeof(unsigned char*)));
+    return 0;
+}
+
+// Sort the buffered rows and write them to a new run file
+int spillSortRun(QueryPlanNode* node) {
+    SortState* sort = node->sort;
+    int row_size = node->table->row_size;
+    
+    if (sort->run_count == sort->run_capacity) {
+        int capacity = sort->run_capacity ? sort->run_capacity * 2 : 16;
+        FILE** runs = realloc(sort->runs, capacity * sizeof(FILE*));
+        if (!runs) return -1;
+        
+        sort->runs = runs;
+        sort->run_capacity = capacity;
+    }
+    
+    FILE* file = tmpfile();
+    if (!file) return -1;
+    
+    pointSortRows(node);
+    sortBufferedRows(node);
+    for (int i = 0; i < sort->count; i++) {
+        if (fwrite(sort->rows[i], row_size, 1, file) != 1) {
+            fclose(file);
+            return -1;
+        }
+    }
+    
+    sort->runs[sort->run_count++] = file;
+    sort->spilled_rows += sort->count;
+    sort->runs_written++;
+    sort->count = 0;
+    return 0;
+}
+
+// Does run a's head come before run b's? Ties go to the older run.
+int mergeHeadBefore(QueryPlanNode* node, int a, int b) {
+    SortState* sort = node->sort;
+    int row_size = node->table->row_size;
+    int result = compareSortRows(node, sort->heads + (size_t)a * row_size, sort->heads + (size_t)b * row_size);
+    return result < 0 || (result == 0 && a < b);
+}
+
+// Restore the merge heap below position
+void siftMergeHeap(QueryPlanNode* node, int position) {
+    SortState* sort = node->sort;
+    
+    for (;;) {
+        int smallest = position;
+        for (int child = 2 * position + 1; child <= 2 * position + 2 && child < sort->heap_count; child++) {
+            if (mergeHeadBefore(node, sort->heap[child], sort->heap[smallest])) {
+                smallest = child;
+            }
+        }
+        if (smallest == position) return;
+        
+        int run = sort->heap[position];
+        sort->heap[position] = sort->heap[smallest];
+        sort->heap[smallest] = run;
+        position = smallest;
+    }
+}
+
+// Start merging the oldest count runs: read each one's first row
+int startMerge(QueryPlanNode* node, int count) {
+    SortState* sort = node->sort;
+    int row_size = node->table->row_size;
+    
+    unsigned char* heads = realloc(sort->heads, (size_t)count * row_size);
+    if (!heads) return -1;
+    sort->heads = heads;
+    
+    int* heap = realloc(sort->heap, count * sizeof(int));
+    if (!heap) return -1;
+    sort->heap = heap;
+    
+    noteSortMemory(sort, (size_t)count * (row_size + sizeof(int)));
+    
+    sort->heap_count = 0;
+    for (int i = 0; i < count; i++) {
+        rewind(sort->runs[i]);
+        if (fread(sort->heads + (size_t)i * row_size, row_size, 1, sort->runs[i]) == 1) {
+            sort->heap[sort->heap_count++] = i;
+        }
+    }
+    
+    for (int i = sort->heap_count / 2 - 1; i >= 0; i--) {
+        siftMergeHeap(node, i);
+    }
+    
+    sort->returned = -1;
+    return 0;
+}
+
+// Next row of the runs being merged
+// The row stays valid until the next call, which reads the next row of its
+// run in its place.
+const unsigned char* nextMergedRow(QueryPlanNode* node) {
+    SortState* sort = node->sort;
+    int row_size = node->table->row_size;
+    
+    if (sort->returned >= 0) {
+        int run = sort->returned;
+        if (fread(sort->heads + (size_t)run * row_size, row_size, 1, sort->runs[run]) != 1) {
+            sort->heap[0] = sort->heap[--sort->heap_count];
+        }
+        if (sort->heap_count > 0) {
+            siftMergeHeap(node, 0);
+        }
+        sort->returned = -1;
+    }
+    
+    if (sort->heap_count == 0) {
+        return NULL;
+    }
+    
+    sort->returned = sort->heap[0];
+    return sort->heads + (size_t)sort->returned * row_size;
+}
+
+// Merge the oldest SORT_MERGE_FAN_IN runs into one new run
+int mergeSortRuns(QueryPlanNode* node) {
+    SortState* sort = node->sort;
+    int row_size = node->table->row_size;
+    
+    FILE* file = tmpfile();
+    if (!file) return -1;
+    
+    if (startMerge(node, SORT_MERGE_FAN_IN) != 0) {
+        fclose(file);
+        return -1;
+    }
+    
+    const unsigned char* row;
+    while ((row = nextMergedRow(node)) != NULL) {
+        if (fwrite(row, row_size, 1, file) != 1) {
+            fclose(file);
+            return -1;
+        }
+        sort->spilled_rows++;
+    }
+    
+    for (int i = 0; i < SORT_MERGE_FAN_IN; i++) {
+        fclose(sort->runs[i]);
+    }
+    sort->run_count -= SORT_MERGE_FAN_IN;
+    memmove(sort->runs, sort->runs + SORT_MERGE_FAN_IN, sort->run_count * sizeof(FILE*));
+    sort->runs[sort->run_count++] = file;
+    sort->runs_written++;
+    return 0;
+}
+
+// Restore the top-N heap below position; the worst row kept is on top
+void siftTopRows(QueryPlanNode* node, int position) {
+    SortState* sort = node->sort;
+    
+    for (;;) {
+        int worst = position;
+        for (int child = 2 * position + 1; child <= 2 * position + 2 && child < sort->count; child++) {
+            if (compareSortRows(node, sort->rows[child], sort->rows[worst]) > 0) {
+                worst = child;
+            }
+        }
+        if (worst == position) return;
+        
+        unsigned char* row = sort->rows[position];
+        sort->rows[position] = sort->rows[worst];
+        sort->rows[worst] = row;
+        position = worst;
+    }
+}
+
+// Keep the best limit rows of the input in a heap, then sort them
+int fillTopRows(QueryPlanNode* node) {
+    SortState* sort = node->sort;
+    int row_size = node->table->row_size;
+    
+    sort->method = SORT_METHOD_TOP_N;
+    sort->buffer = malloc((size_t)sort->limit * row_size);
+    sort->rows = malloc((size_t)sort->limit * sizeof(unsigned char*));
+    if (!sort->buffer || !sort->rows) return -1;
+    noteSortMemory(sort, (size_t)sort->limit * (row_size + sizeof(unsigned char*)));
+    
+    const unsigned char* row;
+    while ((row = nextPlanRow(node->children[0])) != NULL) {
+        if (sort->count < sort->limit) {
+            sort->rows[sort->count] = sort->buffer + (size_t)sort->count * row_size;
+            memcpy(sort->rows[sort->count++], row, row_size);
+            
+            if (sort->count == sort->limit) {
+                for (int i = sort->count / 2 - 1; i >= 0; i--) {
+                    siftTopRows(node, i);
+                }
+            }
+        } else if (compareSortRows(node, row, sort->rows[0]) < 0) {
+            memcpy(sort->rows[0], row, row_size);
+            siftTopRows(node, 0);
+        }
+    }
+    
+    sortBufferedRows(node);
+    return 0;
+}
+
+// Consume a SORT node's input (first pull)
+// ORDER BY ... LIMIT k keeps a heap of the best k rows when they fit the
+// budget. Other sorts buffer rows up to the budget and spill each full
+// buffer as a sorted run; runs beyond the merge fan-in are merged in passes
+// until the rest can be merged while rows are returned.
+int fillSortNode(QueryPlanNode* node) {
+    SortState* sort = node->sort;
+    Query* query = node->query;
+    
+    sort->capacity = sortCapacity(node);
+    sort->ready = 1;
+    
+    long long wanted = query->limit >= 0 ? (long long)query->offset + query->limit : -1;
+    if (wanted == 0) {
+        return 0;
+    }
+    if (wanted > 0 && wanted <= sort->capacity) {
+        sort->limit = (int)wanted;
+        return fillTopRows(node);
+    }
+    
+    sort->method = SORT_METHOD_QUICKSORT;
+    const unsigned char* row;
+    while ((row = nextPlanRow(node->children[0])) != NULL) {
+        if (sort->count == sort->allocated) {
+            int result = sort->allocated < sort->capacity ? growSortBuffer(node) : spillSortRun(node);
+            if (result != 0) return -1;
+            
+            // Bound the open files: merge the oldest runs into one as we go
+            if (sort->run_count == SORT_MAX_RUNS && mergeSortRuns(node) != 0) return -1;
+        }
+        
+        memcpy(sort->buffer + (size_t)sort->count * node->table->row_size, row, node->table->row_size);
+        sort->count++;
+    }
+    
+    if (sort->run_count == 0) {
+        pointSortRows(node);
+        sortBufferedRows(node);
+        return 0;
+    }
+    
+    // Spilled: the last rows become a run too, and the row buffer goes
+    sort->method = SORT_METHOD_EXTERNAL;
+    if (sort->count > 0 && spillSortRun(node) != 0) {
+        return -1;
+    }
+    
+    free(sort->buffer);
+    free(sort->rows);
+    sort->buffer = NULL;
+    sort->rows = NULL;
+    sort->allocated = 0;
+    
+    while (sort->run_count > SORT_MERGE_FAN_IN) {
+        if (mergeSortRuns(node) != 0) return -1;
+    }
+    return startMerge(node, sort->run_count);
+}
+
+// Next row of a sort node whose input has been consumed
+const unsigned char* nextSortedRow(QueryPlanNode* node) {
+    SortState* sort = node->sort;
+    
+    if (sort->method == SORT_METHOD_EXTERNAL) {
+        return nextMergedRow(node);
+    }
+    if (sort->position >= sort->count) {
+        return NULL;
+    }
+    return sort->rows[sort->position++];
+}
+
+// Build the joined row from one row of each input
+// NULL flags of the right row move up past the left table's columns.
+const unsigned char* joinRows(QueryPlanNode* node, const unsigned char* left_row,
+                              const unsigned char* right_row) {
+    JoinState* join = node->join;
+    Table* left = node->children[0]->table;
+    Table* right = node->children[1]->table;
+    unsigned long long left_nulls, right_nulls;
+    
+    memcpy(&left_nulls, left_row + ROW_NULLS_OFFSET, sizeof(left_nulls));
+    memcpy(&right_nulls, right_row + ROW_NULLS_OFFSET, sizeof(right_nulls));
+    unsigned long long nulls = left_nulls | right_nulls << left->column_count;
+    
+    memset(join->row, 0, ROW_HEADER_SIZE);
+    memcpy(join->row + ROW_NULLS_OFFSET, &nulls, sizeof(nulls));
+    memcpy(join->row + ROW_HEADER_SIZE, left_row + ROW_HEADER_SIZE, left->row_size - ROW_HEADER_SIZE);
+    memcpy(join->row + left->row_size, right_row + ROW_HEADER_SIZE, right->row_size - ROW_HEADER_SIZE);
+    return join->row;
+}
+
+// Append a row to the in-memory build table
+int addBuildRow(JoinState* join, int row_size, const unsigned char* row, unsigned long long hash) {
+    if (join->build_count >= join->build_capacity) {
+        int capacity = join->build_capacity ? join->build_capacity * 2 : 1024;
+        unsigned char* rows = realloc(join->build_rows, (size_t)capacity * row_size);
+        if (!rows) return -1;
+        join->build_rows = rows;
+        
+        unsigned long long* hashes = realloc(join->hashes, capacity * sizeof(unsigned long long));
+        if (!hashes) return -1;
+        join->hashes = hashes;
+        join->build_capacity = capacity;
+    }
+    
+    memcpy(join->build_rows + (size_t)join->build_count * row_size, row, row_size);
+    join->hashes[join->build_count++] = hash;
+    return 0;
+}
+
+// Chain the build rows into hash buckets
+int indexBuildRows(JoinState* join) {
+    int bucket_count = 1;
+    while (bucket_count < 2 * join->build_count) {
+        bucket_count *= 2;
+    }
+    
+    free(join->buckets);
+    free(join->next);
+    join->buckets = malloc(bucket_count * sizeof(int));
+    join->next = malloc((join->build_count + 1) * sizeof(int));
+    if (!join->buckets || !join->next) return -1;
+    
+    join->bucket_mask = bucket_count - 1;
+    for (int b = 0; b < bucket_count; b++) {
+        join->buckets[b] = -1;
+    }
+    for (int i = 0; i < join->build_count; i++) {
+        int bucket = (int)(join->hashes[i] & join->bucket_mask);
+        join->next[i] = join->buckets[bucket];
+        join->buckets[bucket] = i;
+    }
+    
+    join->match = -1;
+    return 0;
+}
+
+// Partition of a key hash; uses bits the buckets do not
+int joinPartition(JoinState* join, unsigned long long hash) {
+    return (int)(hash >> 40) & (join->partition_count - 1);
+}
+
+// Switch a hash join that outgrew its budget to partitions on disk
+// The partition count is sized from the larger of the planner's estimate
+// and twice what has been read, so that each build partition should fit
+// the budget. Rows already in memory move to their partitions.
+int startJoinSpill(QueryPlanNode* node, int row_size) {
+    JoinState* join = node->join;
+    double entry = hashEntryBytes(row_size);
+    double estimated = node->children[join->build_input]->estimated_rows * entry;
+    double seen = 2.0 * join->build_count * entry;
+    double bytes = estimated > seen ? estimated : seen;
+    
+    int count = JOIN_MIN_PARTITIONS;
+    while (count < JOIN_MAX_PARTITIONS && count * (double)join->memory_budget < bytes * 1.25) {
+        count *= 2;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        join->build_files[i] = tmpfile();
+        join->probe_files[i] = tmpfile();
+        join->partition_count = i + 1;
+        if (!join->build_files[i] || !join->probe_files[i]) return -1;
+    }
+    
+    for (int i = 0; i < join->build_count; i++) {
+        FILE* file = join->build_files[joinPartition(join, join->hashes[i])];
+        if (fwrite(join->build_rows + (size_t)i * row_size, row_size, 1, file) != 1) return -1;
+    }
+    join->spilled_rows += join->build_count;
+    join->build_count = 0;
+    return 0;
+}
+
+// Read the build input into the hash table
+// Past the memory budget both inputs are split into partitions on disk by
+// key hash, and the partitions are joined one at a time (Grace hash join).
+int buildHashTable(QueryPlanNode* node) {
+    JoinState* join = node->join;
+    int build = join->build_input;
+    QueryPlanNode* input = node->children[build];
+    int row_size = input->table->row_size;
+    size_t entry = hashEntryBytes(row_size);
+    const unsigned char* row;
+    
+    while ((row = nextPlanRow(input)) != NULL) {
+        const unsigned char* key = joinKey(node, build, row);
+        if (!key) continue; // NULL never equals anything
+        unsigned long long hash = hashJoinKey(node, build, key);
+        
+        if (join->partition_count == 0 && (join->build_count + 1) * entry > join->memory_budget &&
+            startJoinSpill(node, row_size) != 0) {
+            return -1;
+        }
+        
+        if (join->partition_count > 0) {
+            if (fwrite(row, row_size, 1, join->build_files[joinPartition(join, hash)]) != 1) return -1;
+            join->spilled_rows++;
+        } else if (addBuildRow(join, row_size, row, hash) != 0) {
+            return -1;
+        }
+    }
+    
+    if (join->partition_count == 0) {
+        join->phase = JOIN_PHASE_PROBE;
+        return indexBuildRows(join);
+    }
+    
+    // Partition the probe input the same way
+    int probe = 1 - build;
+    int probe_size = node->children[probe]->table->row_size;
+    while ((row = nextPlanRow(node->children[probe])) != NULL) {
+        const unsigned char* key = joinKey(node, probe, row);
+        if (!key) continue;
+        
+        FILE* file = join->probe_files[joinPartition(join, hashJoinKey(node, probe, key))];
+        if (fwrite(row, probe_size, 1, file) != 1) return -1;
+        join->spilled_rows++;
+    }
+    
+    join->probe_buffer = malloc(probe_size);
+    join->phase = JOIN_PHASE_PARTITION;
+    join->partition = -1;
+    return join->probe_buffer ? 0 : -1;
+}
+
+// Load the next spilled partition's build rows into the hash table
+// Returns 0 when one was loaded, 1 when none are left and -1 on error.
+int loadJoinPartition(QueryPlanNode* node) {
+    JoinState* join = node->join;
+    int build = join->build_input;
+    int row_size = node->children[build]->table->row_size;
+    unsigned char row[PAGE_DATA_SIZE];
+    
+    if (join->partition >= 0) {
+        fclose(join->probe_files[join->partition]);
+        join->probe_files[join->partition] = NULL;
+    }
+    if (++join->partition >= join->partition_count) {
+        return 1;
+    }
+    
+    FILE* file = join->build_files[join->partition];
+    rewind(file);
+    join->build_count = 0;
+    while (fread(row, row_size, 1, file) == 1) {
+        if (addBuildRow(join, row_size, row, hashJoinKey(node, build, joinKey(node, build, row))) != 0) {
+            return -1;
+        }
+    }
+    
+    // The build side of the partition is in memory now
+    fclose(file);
+    join->build_files[join->partition] = NULL;
+    rewind(join->probe_files[join->partition]);
+    return indexBuildRows(join);
+}
+
+// Pull the next joined row from a hash join
+// The first pull reads the whole build input. Each probe row then walks
+// its bucket chain; rows come from the probe input directly, or from the
+// probe file of the partition whose build rows are loaded.
+const unsigned char* nextHashJoinRow(QueryPlanNode* node) {
+    JoinState* join = node->join;
+    int build = join->build_input;
+    int probe = 1 - build;
+    int build_size = node->children[build]->table->row_size;
+    int probe_size = node->children[probe]->table->row_size;
+    
+    if (join->phase == JOIN_PHASE_BUILD && buildHashTable(node) != 0) {
+        return NULL;
+    }
+    
+    while (1) {
+        while (join->match >= 0) {
+            int entry = join->match;
+            const unsigned char* build_row = join->build_rows + (size_t)entry * build_size;
+            join->match = join->next[entry];
+            
+            if (join->hashes[entry] == join->probe_hash &&
+                compareJoinKeys(node, joinKey(node, build, build_row), joinKey(node, probe, join->probe_row)) == 0) {
+                return build == 0 ? joinRows(node, build_row, join->probe_row) :
+                                    joinRows(node, join->probe_row, build_row);
+            }
+        }
+        
+        if (join->phase == JOIN_PHASE_PROBE) {
+            if (join->build_count == 0) return NULL; // Nothing can match
+            join->probe_row = nextPlanRow(node->children[probe]);
+            if (!join->probe_row) return NULL;
+        } else {
+            while (join->partition < 0 ||
+                   fread(join->probe_buffer, probe_size, 1, join->probe_files[join->partition]) != 1) {
+                if (loadJoinPartition(node) != 0) return NULL;
+            }
+            join->probe_row = join->probe_buffer;
+        }
+        
+        const unsigned char* key = joinKey(node, probe, join->probe_row);
+        if (!key) continue;
+        
+        join->probe_hash = hashJoinKey(node, probe, key);
+        join->match = join->buckets[join->probe_hash & join->bucket_mask];
+    }
+}
+
+// Next row of a merge join input whose key is not NULL
+const unsigned char* nextMergeInputRow(QueryPlanNode* node, int input) {
+    const unsigned char* row;
+    
+    while ((row = nextPlanRow(node->children[input])) != NULL && !joinKey(node, input, row)) {
+    }
+    return row;
+}
+
+// Pull the next joined row from a merge join
+// Both inputs arrive in key order. The right rows sharing the current key
+// are copied into a group, and every left row with that key is paired with
+// each of them; the left row and the right lookahead are not copied, since
+// neither input is pulled while they are in use.
+const unsigned char* nextMergeJoinRow(QueryPlanNode* node) {
+    JoinState* join = node->join;
+    int right_size = node->children[1]->table->row_size;
+    
+    if (!join->started) {
+        join->started = 1;
+        join->lookahead = nextMergeInputRow(node, 1);
+    }
+    
+    while (1) {
+        if (join->group_position < join->group_count) {
+            const unsigned char* right_row = join->group + (size_t)join->group_position++ * right_size;
+            return joinRows(node, join->left_row, right_row);
+        }
+        
+        join->left_row = nextMergeInputRow(node, 0);
+        if (!join->left_row) return NULL;
+        const unsigned char* left_key = joinKey(node, 0, join->left_row);
+        
+        // A repeated left key pairs with the same group again
+        if (join->group_count > 0 && compareJoinKeys(node, left_key, joinKey(node, 1, join->group)) == 0) {
+            join->group_position = 0;
+            continue;
+        }
+        
+        join->group_count = 0;
+        join->group_position = 0;
+        while (join->lookahead && compareJoinKeys(node, left_key, joinKey(node, 1, join->lookahead)) > 0) {
+            join->lookahead = nextMergeInputRow(node, 1);
+        }
+        if (!join->lookahead) return NULL; // No right rows left to match
+        
+        while (join->lookahead && compareJoinKeys(node, left_key, joinKey(node, 1, join->lookahead)) == 0) {
+            if (join->group_count >= join->group_capacity) {
+                int capacity = join->group_capacity ? join->group_capacity * 2 : 16;
+                unsigned char* group = realloc(join->group, (size_t)capacity * right_size);
+                if (!group) return NULL;
+                join->group = group;
+                join->group_capacity = capacity;
+            }
+            
+            memcpy(join->group + (size_t)join->group_count++ * right_size, join->lookahead, right_size);
+            join->lookahead = nextMergeInputRow(node, 1);
+        }
+    }
+}
+
+// Pull the next row from a plan node; NULL once the node is exhausted
+// Returned rows stay valid until the next pull from the same node. Access
+// nodes return only row versions visible to the query's snapshot and leave
+// the row's id in node->row_id; filters and limits pass it through.
+const unsigned char* nextPlanRow(QueryPlanNode* node) {
+    Table* table = node->table;
+    Snapshot* snapshot = &node->query->snapshot;
+    const unsigned char* row;
+    
+    switch (node->node_type) {
+        case PLAN_SCAN:
+            while (1) {
+                RowId row_id = (node->page_position - 1) * table->rows_per_page + node->slot;
+                
+                if (node->slot >= node->page.record_count || row_id >= node->row_limit) {
+                    int* heap_pages = __atomic_load_n(&table->heap_pages, __ATOMIC_ACQUIRE);
+                    
+                    if ((RowId)node->page_position * table->rows_per_page >= node->row_limit ||
+                        readPage(table->storage, heap_pages[node->page_position], &node->page) != 0) {
+                        return NULL;
+                    }
+                    node->page_position++;
+                    node->slot = 0;
+                    continue;
+                }
+                
+                row = rowSlot(table, &node->page, node->slot++);
+                if (isVersionVisible(table, row_id, snapshot) && planRowMatches(node, row)) {
+                    node->row_id = row_id;
+                    node->actual_rows++;
+                    return row;
+                }
+            }
+            
+        case PLAN_INDEX_SCAN: {
+            RowId row_id;
+            
+            while (nextIndexEntry(&node->cursor, &row_id) == 1) {
+                // Entries of rows appended after the scan opened are not ours
+                int slot;
+                int page_id = row_id < node->row_limit ? heapPageForRow(table, row_id, &slot) : -1;
+                if (page_id < 0 || !isVersionVisible(table, row_id, snapshot)) continue;
+                
+                if (page_id != node->loaded_page) {
+                    if (readPage(table->storage, page_id, &node->page) != 0) return NULL;
+                    node->loaded_page = page_id;
+                }
+                
+                row = rowSlot(table, &node->page, slot);
+                if (planRowMatches(node, row)) {
+                    node->row_id = row_id;
+                    node->actual_rows++;
+                    return row;
+                }
+            }
+            return NULL;
+        }
+        
+        case PLAN_COLUMN_SCAN: {
+            ColumnStore* store = table->column_store;
+            pthread_rwlock_rdlock(&store->latch);
+            
+            // Filter the next batch once the current selection is used up;
+            // page_position is the next unfiltered row id
+            while (node->slot >= node->selection.count) {
+                if (node->page_position >= store->row_count) {
+                    pthread_rwlock_unlock(&store->latch);
+                    return NULL;
+                }
+                
+                int count = store->row_count - node->page_position;
+                count = count < VECTOR_SIZE ? count : VECTOR_SIZE;
+                
+                filterColumnBatch(table, node->query, node->conditions, node->condition_count,
+                                  node->page_position, count, &node->selection);
+                node->batch_start = node->page_position;
+                node->page_position += count;
+                node->slot = 0;
+            }
+            
+            // The matching row is rebuilt in the node's page buffer
+            node->row_id = node->batch_start + node->selection.positions[node->slot++];
+            materializeColumnRow(table, node->row_id, (unsigned char*)node->page.data);
+            pthread_rwlock_unlock(&store->latch);
+            
+            node->actual_rows++;
+            return (const unsigned char*)node->page.data;
+        }
+        
+        case PLAN_FILTER:
+            while ((row = nextPlanRow(node->children[0])) != NULL) {
+                if (planRowMatches(node, row)) {
+                    node->row_id = node->children[0]->row_id;
+                    node->actual_rows++;
+                    return row;
+                }
+            }
+            return NULL;
+            
+        case PLAN_SORT:
+            if (!node->sort->ready && fillSortNode(node) != 0) return NULL;
+            
+            row = nextSortedRow(node);
+            if (row) {
+                node->actual_rows++;
+            }
+            return row;
+            
+        case PLAN_LIMIT:
+            while (node->skipped < node->query->offset) {
+                if (!nextPlanRow(node->children[0])) return NULL;
+                node->skipped++;
+            }
+            
+            if (node->query->limit >= 0 && node->produced >= node->query->limit) return NULL;
+            
+            row = nextPlanRow(node->children[0]);
+            if (row) {
+                node->row_id = node->children[0]->row_id;
+                node->produced++;
+                node->actual_rows++;
+            }
+            return row;
+            
+        case PLAN_HASH_JOIN:
+        case PLAN_MERGE_JOIN:
+            // Joined rows have no row id; row_id stays -1
+            row = node->node_type == PLAN_HASH_JOIN ? nextHashJoinRow(node) : nextMergeJoinRow(node);
+            if (row) {
+                node->actual_rows++;
+            }
+            return row;
+    }
+    
+    return NULL;
+}
+
+// =============================================================================
+// TRANSACTION MANAGEMENT IMPLEMENTATION
+// =============================================================================
+
+// Find an active transaction by id (manager mutex held)
+Transaction* findActiveTransaction(TransactionManager* manager, int transaction_id) {
+    for (int i = 0; i < MAX_TRANSACTIONS; i++) {
+        Transaction* transaction = &manager->transactions[i];
+        if (transaction->state == TRANSACTION_ACTIVE && transaction->transaction_id == transaction_id) {
+            return transaction;
+        }
+    }
+    
+    return NULL;
+}
+
+// Claim a free transaction slot and take its snapshot (manager mutex held)
+Transaction* startTransaction(TransactionManager* manager) {
+    for (int i = 0; i < MAX_TRANSACTIONS; i++) {
+        Transaction* transaction = &manager->transactions[i];
+        if (transaction->state != TRANSACTION_ACTIVE) {
+            transaction->transaction_id = manager->next_transaction_id++;
+            transaction->state = TRANSACTION_ACTIVE;
+            transaction->start_time = time(NULL);
+            transaction->read_ts = manager->clock;
+            manager->transaction_count++;
+            return transaction;
+        }
+    }
+    
+    return NULL; // No available transaction slots
+}
+
+// Return a finished transaction's slot (manager mutex held)
+void releaseTransaction(TransactionManager* manager, Transaction* transaction, TransactionState state) {
+    clearWriteSet(transaction);
+    transaction->state = state;
+    manager->transaction_count--;
+}
+
+// Begin transaction
+// Its snapshot is taken now: every statement in the transaction reads the
+// database as of the last commit before this call. Returns the new id.
+int beginTransaction(Database* db) {
+    if (!db || !db->transaction_manager) {
+        return -1;
+    }
+    
+    TransactionManager* manager = db->transaction_manager;
+    pthread_mutex_lock(&manager->mutex);
+    Transaction* transaction = startTransaction(manager);
+    int transaction_id = transaction ? transaction->transaction_id : -1;
+    pthread_mutex_unlock(&manager->mutex);
+    
+    return transaction_id;
+}
+
+// Add a row version to a transaction's write set
+// superseded marks a version the transaction ends rather than creates; those
+// also go into a hash set so that its own reads skip them.
+int recordWrite(Transaction* transaction, Table* table, RowId row_id, int superseded) {
+    if (transaction->write_count >= transaction->write_capacity) {
+        int new_capacity = transaction->write_capacity ? transaction->write_capacity * 2 : 16;
+        WriteEntry* writes = realloc(transaction->writes, new_capacity * sizeof(WriteEntry));
+        if (!writes) return -1;
+        
+        transaction->writes = writes;
+        transaction->write_capacity = new_capacity;
+    }
+    
+    WriteEntry entry = {table, row_id, superseded};
+    transaction->writes[transaction->write_count++] = entry;
+    
+    if (!superseded) {
+        return 0;
+    }
+    
+    // Keep the set at most half full
+    if ((transaction->superseded_count + 1) * 2 > transaction->superseded_capacity) {
+        int old_capacity = transaction->superseded_capacity;
+        WriteEntry* old_set = transaction->superseded;
+        int new_capacity = old_capacity ? old_capacity * 2 : 16;
+        
+        WriteEntry* set = calloc(new_capacity, sizeof(WriteEntry));
+        if (!set) return -1;
+        
+        transaction->superseded = set;
+        transaction->superseded_capacity = new_capacity;
+        for (int i = 0; i < old_capacity; i++) {
+            if (!old_set[i].table) continue;
+            
+            unsigned int slot = supersededSlot(transaction, old_set[i].table, old_set[i].row_id);
+            while (set[slot].table) {
+                slot = (slot + 1) & (new_capacity - 1);
+            }
+            set[slot] = old_set[i];
+        }
+        free(old_set);
+    }
+    
+    unsigned int slot = supersededSlot(transaction, table, row_id);
+    while (transaction->superseded[slot].table) {
+        slot = (slot + 1) & (transaction->superseded_capacity - 1);
+    }
+    transaction->superseded[slot] = entry;
+    transaction->superseded_count++;
+    return 0;
+}
+
+// Queue an ended version for garbage collection (manager mutex held)
+// Versions arrive in end timestamp order, so the queue stays sorted.
+int enqueueGarbage(TransactionManager* manager, Table* table, RowId row_id, Timestamp end) {
+    if (manager->garbage_head + manager->garbage_count >= manager->garbage_capacity) {
+        if (manager->garbage_head > 0) {
+            memmove(manager->garbage, manager->garbage + manager->garbage_head,
+                    manager->garbage_count * sizeof(GarbageVersion));
+            manager->garbage_head = 0;
+        }
+        
+        if (manager->garbage_count >= manager->garbage_capacity) {
+            int new_capacity = manager->garbage_capacity ? manager->garbage_capacity * 2 : 256;
+            GarbageVersion* garbage = realloc(manager->garbage, new_capacity * sizeof(GarbageVersion));
+            if (!garbage) return -1;
+            
+            manager->garbage = garbage;
+            manager->garbage_capacity = new_capacity;
+        }
+    }
+    
+    GarbageVersion* version = &manager->garbage[manager->garbage_head + manager->garbage_count++];
+    version->table = table;
+    version->row_id = row_id;
+    version->end = end;
+    return 0;
+}
+
+// Oldest snapshot any active transaction reads (manager mutex held)
+Timestamp oldestActiveSnapshot(TransactionManager* manager) {
+    Timestamp oldest = manager->clock;
+    
+    for (int i = 0; i < MAX_TRANSACTIONS; i++) {
+        Transaction* transaction = &manager->transactions[i];
+        if (transaction->state == TRANSACTION_ACTIVE && transaction->read_ts < oldest) {
+            oldest = transaction->read_ts;
+        }
+    }
+    
+    return oldest;
+}
+
+// Mark a row slot dead and put it on the table's free list
+int addFreeRow(Table* table, RowId row_id) {
+    if (table->free_row_count >= table->free_row_capacity) {
+        int new_capacity = table->free_row_capacity ? table->free_row_capacity * 2 : 64;
+        RowId* free_rows = realloc(table->free_rows, new_capacity * sizeof(RowId));
+        if (!free_rows) return -1;
+        
+        table->free_rows = free_rows;
+        table->free_row_capacity = new_capacity;
+    }
+    
+    storeVersionEnd(table, row_id, TIMESTAMP_DEAD);
+    storeVersionBegin(table, row_id, TIMESTAMP_TRANSACTION_FLAG);
+    table->free_rows[table->free_row_count++] = row_id;
+    return 0;
+}
+
+// Reclaim a row version no snapshot can see any more
+// Its index entries are removed, the heap row is flagged deleted and the
+// slot joins the table's free list for the next transactional write.
+int reclaimRowVersion(Table* table, RowId row_id) {
+    Page page;
+    int slot;
+    int page_id = heapPageForRow(table, row_id, &slot);
+    
+    if (page_id < 0 || readPage(table->storage, page_id, &page) != 0) {
+        return -1;
+    }
+    
+    unsigned char* row = rowSlot(table, &page, slot);
+    for (int i = 0; i < table->index_count; i++) {
+        Index* index = &table->indexes[i];
+        deleteIndexEntry(index, row + table->column_offsets[index->column_index], row_id);
+    }
+    
+    int deleted = 1;
+    memcpy(row + sizeof(int), &deleted, sizeof(int));
+    if (writePage(table->storage, page_id, &page) != 0) {
+        return -1;
+    }
+    
+    return addFreeRow(table, row_id);
+}
+
+// Reclaim every queued version that ended before the oldest active snapshot
+// Runs under the writer latch, so it never races a statement's writes;
+// readers are unaffected because no snapshot can see these versions.
+// Returns the number of versions reclaimed.
+int collectGarbage(Database* db) {
+    if (!db || !db->transaction_manager) {
+        return -1;
+    }
+    
+    TransactionManager* manager = db->transaction_manager;
+    pthread_mutex_lock(&db->mutex);
+    pthread_mutex_lock(&manager->mutex);
+    
+    Timestamp oldest = oldestActiveSnapshot(manager);
+    int count = 0;
+    while (count < manager->garbage_count && manager->garbage[manager->garbage_head + count].end <= oldest) {
+        count++;
+    }
+    
+    GarbageVersion* batch = malloc((count + 1) * sizeof(GarbageVersion));
+    if (!batch) {
+        pthread_mutex_unlock(&manager->mutex);
+        pthread_mutex_unlock(&db->mutex);
+        return -1;
+    }
+    
+    if (count > 0) {
+        memcpy(batch, manager->garbage + manager->garbage_head, count * sizeof(GarbageVersion));
+    }
+    manager->garbage_head += count;
+    manager->garbage_count -= count;
+    pthread_mutex_unlock(&manager->mutex);
+    
+    // A reclaimed slot may be overwritten and reach disk at any time, so the
+    // commits that ended these versions must be durable first
+    WriteAheadLog* wal = activeLog(db->storage);
+    if (wal && count > 0 && flushLog(wal, logEnd(wal)) != 0) {
+        count = 0;
+    }
+    
+    int reclaimed = 0;
+    for (int i = 0; i < count; i++) {
+        reclaimed += reclaimRowVersion(batch[i].table, batch[i].row_id) == 0;
+    }
+    free(batch);
+    
+    pthread_mutex_lock(&manager->mutex);
+    manager->reclaimed += reclaimed;
+    pthread_mutex_unlock(&manager->mutex);
+    
+    pthread_mutex_unlock(&db->mutex);
+    return reclaimed;
+}
+
+// The log a transaction's records go to: the one of the tables it wrote
+WriteAheadLog* transactionLog(Transaction* transaction) {
+    return transaction->write_count > 0 ? activeLog(transaction->writes[0].table->storage) : NULL;
+}
+
+// Undo an active transaction (manager mutex held)
+// The versions it created are marked dead and queued for collection; the
+// versions it meant to end were never touched. The abort record is not
+// waited for: without it recovery rolls the transaction back anyway.
+void abortTransaction(TransactionManager* manager, Transaction* transaction) {
+    WriteAheadLog* wal = transactionLog(transaction);
+    if (wal) {
+        LogRecordHeader header;
+        memset(&header, 0, sizeof(header));
+        header.type = WAL_ABORT;
+        header.transaction_id = transaction->transaction_id;
+        appendLogRecord(wal, &header, NULL, 0);
+    }
+    
+    for (int i = 0; i < transaction->write_count; i++) {
+        WriteEntry* write = &transaction->writes[i];
+        if (write->superseded) continue;
+        
+        storeVersionEnd(write->table, write->row_id, TIMESTAMP_DEAD);
+        enqueueGarbage(manager, write->table, write->row_id, manager->clock);
+    }
+    
+    releaseTransaction(manager, transaction, TRANSACTION_ABORTED);
+}
+
+// Start every version a transaction created and end every version it
+// replaced at one commit timestamp (manager mutex held)
+void applyCommit(TransactionManager* manager, Transaction* transaction, Timestamp commit_ts) {
+    for (int i = 0; i < transaction->write_count; i++) {
+        WriteEntry* write = &transaction->writes[i];
+        if (write->superseded) {
+            storeVersionEnd(write->table, write->row_id, commit_ts);
+            enqueueGarbage(manager, write->table, write->row_id, commit_ts);
+        } else {
+            storeVersionBegin(write->table, write->row_id, commit_ts);
+        }
+    }
+    
+    // New snapshots see the commit only once every version is stamped
+    manager->clock = commit_ts;
+}
+
+// Save one table to a checkpoint
+int writeCheckpointTable(FILE* file, Table* table) {
+    CheckpointTable entry;
+    memset(&entry, 0, sizeof(entry));
+    memcpy(entry.name, table->name, sizeof(entry.name));
+    entry.column_count = table->column_count;
+    entry.next_record_id = table->next_record_id;
+    entry.record_count = table->record_count;
+    entry.heap_row_count = table->heap_row_count;
+    entry.heap_page_count = table->heap_page_count;
+    entry.index_count = table->index_count;
+    entry.has_column_store = table->column_store != NULL;
+    
+    fwrite(&entry, sizeof(entry), 1, file);
+    fwrite(table->columns, sizeof(Column), table->column_count, file);
+    fwrite(table->heap_pages, sizeof(int), table->heap_page_count, file);
+    
+    for (int i = 0; i < table->index_count; i++) {
+        LogIndexDefinition definition;
+        memset(&definition, 0, sizeof(definition));
+        memcpy(definition.name, table->indexes[i].name, sizeof(definition.name));
+        definition.column_index = table->indexes[i].column_index;
+        definition.is_unique = table->indexes[i].is_unique;
+        fwrite(&definition, sizeof(definition), 1, file);
+    }
+    
+    for (RowId row_id = 0; row_id < table->heap_row_count; row_id++) {
+        RowVersion version;
+        loadRowVersion(table, row_id, &version.begin, &version.end);
+        fwrite(&version, sizeof(version), 1, file);
+    }
+    
+    return ferror(file) ? -1 : 0;
+}
+
+// Save the open transactions' write sets to a checkpoint (manager mutex held)
+int writeCheckpointTransactions(FILE* file, TransactionManager* manager) {
+    for (int i = 0; i < MAX_TRANSACTIONS; i++) {
+        Transaction* transaction = &manager->transactions[i];
+        if (transaction->state != TRANSACTION_ACTIVE || transaction->write_count == 0) continue;
+        
+        fwrite(&transaction->transaction_id, sizeof(int), 1, file);
+        fwrite(&transaction->write_count, sizeof(int), 1, file);
+        for (int w = 0; w < transaction->write_count; w++) {
+            CheckpointWrite write;
+            write.table_id = transaction->writes[w].table->table_id;
+            write.row_id = transaction->writes[w].row_id;
+            write.superseded = transaction->writes[w].superseded;
+            fwrite(&write, sizeof(write), 1, file);
+        }
+    }
+    
+    return ferror(file) ? -1 : 0;
+}
+
+// Take a checkpoint and empty the log
+// The checkpoint is sharp: the writer latch and the manager mutex hold off
+// every write and commit while dirty pages are flushed and synced, and the
+// catalog, heap directories, version stamps and open write sets go to
+// checkpoint.db. The file is written aside and renamed into place, so a
+// crash leaves either the old checkpoint or the new one. Recovery then only
+// replays log records written after it.
+int checkpointDatabase(Database* db) {
+    WriteAheadLog* wal = db ? activeLog(db->storage) : NULL;
+    if (!wal) {
+        return -1;
+    }
+    
+    TransactionManager* manager = db->transaction_manager;
+    pthread_mutex_lock(&db->mutex);
+    pthread_mutex_lock(&manager->mutex);
+    
+    int result = 0;
+    if (db->storage->page_cache && flushBufferPool(db->storage->page_cache) != 0) {
+        result = -1;
+    }
+    if (result == 0 && fsync(fileno(db->storage->data_file)) != 0) {
+        result = -1;
+    }
+    
+    char path[512];
+    char temporary_path[512];
+    snprintf(path, sizeof(path), "%s/checkpoint.db", db->storage->database_path);
+    snprintf(temporary_path, sizeof(temporary_path), "%s/checkpoint.tmp", db->storage->database_path);
+    
+    FILE* file = result == 0 ? fopen(temporary_path, "wb") : NULL;
+    if (file) {
+        CheckpointHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = CHECKPOINT_MAGIC;
+        header.table_count = db->table_count;
+        header.lsn = logEnd(wal);
+        header.clock = manager->clock;
+        header.next_transaction_id = manager->next_transaction_id;
+        for (int i = 0; i < MAX_TRANSACTIONS; i++) {
+            header.active_count += manager->transactions[i].state == TRANSACTION_ACTIVE &&
+                                   manager->transactions[i].write_count > 0;
+        }
+        
+        fwrite(&header, sizeof(header), 1, file);
+        for (int i = 0; i < db->table_count && result == 0; i++) {
+            result = writeCheckpointTable(file, &db->tables[i]);
+        }
+        if (result == 0) {
+            result = writeCheckpointTransactions(file, manager);
+        }
+        if (fflush(file) != 0 || fsync(fileno(file)) != 0) {
+            result = -1;
+        }
+        fclose(file);
+    } else {
+        result = -1;
+    }
+    
+    if (result == 0 && rename(temporary_path, path) != 0) {
+        result = -1;
+    }
+    
+    // Make the rename itself durable before the log it replaces goes away
+    int directory = result == 0 ? open(db->storage->database_path, O_RDONLY) : -1;
+    if (directory >= 0) {
+        result = fsync(directory);
+        close(directory);
+    } else {
+        result = -1; // Keep the log if the rename cannot be made durable
+    }
+    
+    if (result == 0) {
+        pthread_mutex_lock(&wal->mutex);
+        result = resetLog(wal);
+        wal->checkpoints += result == 0;
+        pthread_mutex_unlock(&wal->mutex);
+    }
+    
+    pthread_mutex_unlock(&manager->mutex);
+    pthread_mutex_unlock(&db->mutex);
+    return result;
+}
+
+// Bytes logged since the last checkpoint
+long long logSize(WriteAheadLog* wal) {
+    pthread_mutex_lock(&wal->mutex);
+    long long size = (long long)(wal->next_lsn - wal->start_lsn);
+    pthread_mutex_unlock(&wal->mutex);
+    return size;
+}
+
+// Commit transaction
+// First committer wins: if a transaction that committed after this one's
+// snapshot already ended a version this one also ended, this one is rolled
+// back and -1 returned. Otherwise one commit timestamp starts every version
+// it created and ends every version it replaced or deleted.
+// With a write-ahead log the commit record is appended before any stamp.
+// Under group commit the call then waits, outside the manager mutex, for
+// the batch that makes the record durable; without it the record is synced
+// on its own while the mutex is still held.
+int commitTransaction(Database* db, int transaction_id) {
+    if (!db || !db->transaction_manager) {
+        return -1;
+    }
+    
+    TransactionManager* manager = db->transaction_manager;
+    pthread_mutex_lock(&manager->mutex);
+    
+    Transaction* transaction = findActiveTransaction(manager, transaction_id);
+    if (!transaction) {
+        pthread_mutex_unlock(&manager->mutex);
+        return -1; // Transaction not found
+    }
+    
+    // Write-write conflict check
+    for (int i = 0; i < transaction->write_count; i++) {
+        WriteEntry* write = &transaction->writes[i];
+        if (write->superseded && !isCurrentVersion(write->table, write->row_id)) {
+            abortTransaction(manager, transaction);
+            manager->conflicts++;
+            pthread_mutex_unlock(&manager->mutex);
+            return -1;
+        }
+    }
+    
+    int has_writes = transaction->write_count > 0;
+    WriteAheadLog* wal = transactionLog(transaction);
+    Lsn commit_lsn = 0;
+    
+    if (has_writes) {
+        Timestamp commit_ts = manager->clock + 1;
+        
+        if (wal) {
+            LogRecordHeader header;
+            memset(&header, 0, sizeof(header));
+            header.type = WAL_COMMIT;
+            header.transaction_id = transaction_id;
+            header.timestamp = commit_ts;
+            
+            commit_lsn = appendLogRecord(wal, &header, NULL, 0);
+            if (!commit_lsn || (!wal->group_commit && flushLog(wal, commit_lsn) != 0)) {
+                abortTransaction(manager, transaction);
+                pthread_mutex_unlock(&manager->mutex);
+                return -1; // The commit could not be made durable
+            }
+        }
+        
+        applyCommit(manager, transaction, commit_ts);
+    }
+    
+    releaseTransaction(manager, transaction, TRANSACTION_COMMITTED);
+    manager->commits++;
+    
+    int collect = has_writes && ++manager->commits_since_gc >= GC_COMMIT_INTERVAL;
+    if (collect) {
+        manager->commits_since_gc = 0;
+    }
+    
+    pthread_mutex_unlock(&manager->mutex);
+    
+    if (commit_lsn && flushLog(wal, commit_lsn) != 0) {
+        return -1;
+    }
+    if (wal && wal->checkpoint_bytes > 0 && logSize(wal) >= wal->checkpoint_bytes) {
+        checkpointDatabase(db);
+    }
+    if (collect) {
+        collectGarbage(db);
+    }
+    return 0;
+}
+
+// Rollback transaction
+int rollbackTransaction(Database* db, int transaction_id) {
+    if (!db || !db->transaction_manager) {
+        return -1;
+    }
+    
+    TransactionManager* manager = db->transaction_manager;
+    pthread_mutex_lock(&manager->mutex);
+    
+    Transaction* transaction = findActiveTransaction(manager, transaction_id);
+    if (!transaction) {
+        pthread_mutex_unlock(&manager->mutex);
+        return -1; // Transaction not found
+    }
+    
+    abortTransaction(manager, transaction);
+    manager->rollbacks++;
+    
+    pthread_mutex_unlock(&manager->mutex);
+    return 0;
+}
+
+// Attach a statement to its transaction and take its snapshot
+// A query without a transaction id runs in a transaction of its own.
+// Returns that implicit transaction's id, 0 for an explicit one, or -1.
+int beginStatement(Database* db, Query* query) {
+    TransactionManager* manager = db->transaction_manager;
+    if (!manager) {
+        return -1;
+    }
+    
+    pthread_mutex_lock(&manager->mutex);
+    Transaction* transaction = query->transaction_id ?
+                               findActiveTransaction(manager, query->transaction_id) :
+                               startTransaction(manager);
+    pthread_mutex_unlock(&manager->mutex);
+    
+    if (!transaction) {
+        return -1;
+    }
+    
+    query->snapshot.read_ts = transaction->read_ts;
+    query->snapshot.transaction = transaction;
+    return query->transaction_id ? 0 : transaction->transaction_id;
+}
+
+// Finish a statement started by beginStatement()
+// An implicit transaction commits on success. A failed statement rolls back
+// its transaction, explicit or not, since part of its writes may be in the
+// write set. Returns -1 on failure or a lost write conflict.
+int endStatement(Database* db, Query* query, int implicit_id, int failed) {
+    int transaction_id = implicit_id ? implicit_id : query->transaction_id;
+    query->snapshot.transaction = NULL;
+    
+    if (failed) {
+        rollbackTransaction(db, transaction_id);
+        return -1;
+    }
+    
+    return implicit_id ? commitTransaction(db, implicit_id) : 0;
+}
+
+// =============================================================================
+// CRASH RECOVERY
+// =============================================================================
+
+// Give a transaction id found in the checkpoint or log a slot of its own
+Transaction* adoptTransaction(TransactionManager* manager, int transaction_id) {
+    Transaction* transaction = findActiveTransaction(manager, transaction_id);
+    if (transaction) {
+        return transaction;
+    }
+    
+    for (int i = 0; i < MAX_TRANSACTIONS; i++) {
+        transaction = &manager->transactions[i];
+        if (transaction->state != TRANSACTION_ACTIVE) {
+            transaction->transaction_id = transaction_id;
+            transaction->state = TRANSACTION_ACTIVE;
+            transaction->start_time = time(NULL);
+            transaction->read_ts = manager->clock;
+            manager->transaction_count++;
+            if (transaction_id >= manager->next_transaction_id) {
+                manager->next_transaction_id = transaction_id + 1;
+            }
+            return transaction;
+        }
+    }
+    
+    return NULL;
+}
+
+// Restore one checkpointed table: definition, heap directory and versions
+int readCheckpointTable(Database* db, FILE* file, RecoveryCatalog* catalog) {
+    CheckpointTable entry;
+    Column columns[MAX_COLUMNS];
+    
+    if (fread(&entry, sizeof(entry), 1, file) != 1 || entry.column_count <= 0 ||
+        entry.column_count > MAX_COLUMNS || entry.index_count > MAX_INDEXES ||
+        fread(columns, sizeof(Column), entry.column_count, file) != (size_t)entry.column_count ||
+        createTable(db, entry.name, columns, entry.column_count) != 0) {
+        return -1;
+    }
+    
+    Table* table = &db->tables[db->table_count - 1];
+    table->next_record_id = entry.next_record_id;
+    table->record_count = entry.record_count;
+    
+    for (int p = 0; p < entry.heap_page_count; p++) {
+        int page_id;
+        if (fread(&page_id, sizeof(int), 1, file) != 1 || addHeapPage(table, page_id) != 0) {
+            return -1;
+        }
+    }
+    
+    int table_id = table->table_id;
+    catalog->index_counts[table_id] = entry.index_count;
+    catalog->column_stores[table_id] = entry.has_column_store;
+    if (fread(catalog->indexes[table_id], sizeof(LogIndexDefinition), entry.index_count, file) !=
+        (size_t)entry.index_count) {
+        return -1;
+    }
+    
+    if (entry.heap_row_count > 0 && reserveRowVersions(table, 0, entry.heap_row_count) != 0) {
+        return -1;
+    }
+    for (RowId row_id = 0; row_id < entry.heap_row_count; row_id++) {
+        RowVersion version;
+        if (fread(&version, sizeof(version), 1, file) != 1) {
+            return -1;
+        }
+        storeVersionBegin(table, row_id, version.begin);
+        storeVersionEnd(table, row_id, version.end);
+    }
+    
+    __atomic_store_n(&table->heap_row_count, entry.heap_row_count, __ATOMIC_RELEASE);
+    
+    // The tail page may have reached disk again with rows appended after the
+    // checkpoint; redo appends them again from the checkpoint's count
+    if (table->heap_page_count > 0) {
+        Page page;
+        int tail_page = table->heap_pages[table->heap_page_count - 1];
+        int tail_rows = entry.heap_row_count - (table->heap_page_count - 1) * table->rows_per_page;
+        
+        if (readPage(table->storage, tail_page, &page) != 0) {
+            return -1;
+        }
+        if (page.record_count != tail_rows) {
+            page.record_count = tail_rows;
+            page.next_page_id = -1;
+            if (writePage(table->storage, tail_page, &page) != 0) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Load the last checkpoint, if there is one
+// Sets *checkpoint_lsn to the first log record it does not cover.
+int loadCheckpoint(Database* db, RecoveryCatalog* catalog, Lsn* checkpoint_lsn) {
+    TransactionManager* manager = db->transaction_manager;
+    char path[512];
+    snprintf(path, sizeof(path), "%s/checkpoint.db", db->storage->database_path);
+    
+    *checkpoint_lsn = 0;
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return 0; // The log was enabled on an empty database
+    }
+    
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    int result = fread(&header, sizeof(header), 1, file) == 1 && header.magic == CHECKPOINT_MAGIC &&
+                 header.table_count <= MAX_TABLES ? 0 : -1;
+    
+    for (int i = 0; i < header.table_count && result == 0; i++) {
+        result = readCheckpointTable(db, file, catalog);
+    }
+    
+    if (result == 0) {
+        *checkpoint_lsn = header.lsn;
+        manager->clock = header.clock;
+        manager->next_transaction_id = header.next_transaction_id;
+    }
+    
+    // Write sets of the transactions that were open at the checkpoint
+    for (int t = 0; t < header.active_count && result == 0; t++) {
+        int transaction_id, write_count;
+        if (fread(&transaction_id, sizeof(int), 1, file) != 1 ||
+            fread(&write_count, sizeof(int), 1, file) != 1) {
+            result = -1;
+            break;
+        }
+        
+        Transaction* transaction = adoptTransaction(manager, transaction_id);
+        for (int w = 0; w < write_count && result == 0; w++) {
+            CheckpointWrite write;
+            if (!transaction || fread(&write, sizeof(write), 1, file) != 1 ||
+                write.table_id < 0 || write.table_id >= db->table_count) {
+                result = -1;
+                break;
+            }
+            result = recordWrite(transaction, &db->tables[write.table_id], write.row_id, write.superseded);
+        }
+    }
+    
+    fclose(file);
+    return result;
+}
+
+// Redo row images: reused slots are overwritten, new rows appended
+// Rewriting a whole slot is idempotent, so pages that did reach disk
+// before the crash are simply written again.
+int redoRowImages(Table* table, RowId first_row, const unsigned char* rows, int count, Timestamp begin) {
+    if (first_row == table->heap_row_count) {
+        return appendRowImages(table, rows, count, begin) == first_row ? 0 : -1;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        RowId row_id = first_row + i;
+        const unsigned char* row = rows + (size_t)i * table->row_size;
+        
+        if (row_id == table->heap_row_count) {
+            return redoRowImages(table, row_id, row, count - i, begin);
+        }
+        
+        Page page;
+        int slot;
+        int page_id = heapPageForRow(table, row_id, &slot);
+        if (page_id < 0 || readPage(table->storage, page_id, &page) != 0) {
+            return -1; // The log refers to a row the heap never had
+        }
+        
+        memcpy(rowSlot(table, &page, slot), row, table->row_size);
+        if (writePage(table->storage, page_id, &page) != 0) {
+            return -1;
+        }
+        storeVersionBegin(table, row_id, begin);
+        storeVersionEnd(table, row_id, TIMESTAMP_INFINITY);
+    }
+    
+    return 0;
+}
+
+// Apply one log record during recovery
+int redoLogRecord(Database* db, RecoveryCatalog* catalog, const LogRecordHeader* header,
+                  const unsigned char* payload) {
+    TransactionManager* manager = db->transaction_manager;
+    Table* table = header->table_id >= 0 && header->table_id < db->table_count ?
+                   &db->tables[header->table_id] : NULL;
+    Transaction* transaction = NULL;
+    
+    if (header->transaction_id > 0 && header->type != WAL_COMMIT && header->type != WAL_ABORT) {
+        transaction = adoptTransaction(manager, header->transaction_id);
+        if (!transaction) return -1;
+    }
+    
+    switch (header->type) {
+        case WAL_CREATE_TABLE: {
+            Column columns[MAX_COLUMNS];
+            if (header->count <= 0 || header->count > MAX_COLUMNS) return -1;
+            memcpy(columns, payload + MAX_FIELD_SIZE, header->count * sizeof(Column));
+            return createTable(db, (const char*)payload, columns, header->count);
+        }
+        
+        case WAL_CREATE_INDEX: {
+            if (!table || catalog->index_counts[header->table_id] >= MAX_INDEXES) return -1;
+            int n = catalog->index_counts[header->table_id]++;
+            memcpy(&catalog->indexes[header->table_id][n], payload, sizeof(LogIndexDefinition));
+            return 0;
+        }
+        
+        case WAL_COLUMN_STORE:
+            if (!table) return -1;
+            catalog->column_stores[header->table_id] = 1;
+            return 0;
+        
+        case WAL_ROWS:
+            if (!table || redoRowImages(table, header->row_id, payload, header->count, header->timestamp) != 0) {
+                return -1;
+            }
+            for (int i = 0; transaction && i < header->count; i++) {
+                if (recordWrite(transaction, table, header->row_id + i, 0) != 0) return -1;
+            }
+            return 0;
+        
+        case WAL_SUPERSEDE:
+            if (!table || !transaction) return -1;
+            return recordWrite(transaction, table, header->row_id, 1);
+        
+        case WAL_COMMIT:
+            transaction = findActiveTransaction(manager, header->transaction_id);
+            if (!transaction) return -1;
+            applyCommit(manager, transaction, header->timestamp);
+            releaseTransaction(manager, transaction, TRANSACTION_COMMITTED);
+            db->storage->wal->redone_transactions++;
+            return 0;
+        
+        case WAL_ABORT:
+            transaction = findActiveTransaction(manager, header->transaction_id);
+            if (transaction) {
+                abortTransaction(manager, transaction);
+            }
+            return 0;
+        
+        default:
+            return -1;
+    }
+}
+
+// Free every row version that is not current
+// After a restart no snapshot is older than the last commit, so replaced,
+// deleted and rolled-back versions are all garbage. Their heap rows get the
+// deleted flag, current rows lose it, and the free list is rebuilt.
+int reclaimDeadVersions(Table* table) {
+    table->free_row_count = 0;
+    
+    for (int p = 0; p < table->heap_page_count; p++) {
+        Page page;
+        if (readPage(table->storage, table->heap_pages[p], &page) != 0) {
+            return -1;
+        }
+        
+        int changed = 0;
+        for (int slot = 0; slot < page.record_count; slot++) {
+            RowId row_id = p * table->rows_per_page + slot;
+            if (row_id >= table->heap_row_count) break;
+            
+            unsigned char* row = rowSlot(table, &page, slot);
+            int dead = !isCurrentVersion(table, row_id);
+            if (isRowDeleted(row) != dead) {
+                memcpy(row + sizeof(int), &dead, sizeof(int));
+                changed = 1;
+            }
+            if (dead && addFreeRow(table, row_id) != 0) {
+                return -1;
+            }
+        }
+        
+        if (changed && writePage(table->storage, table->heap_pages[p], &page) != 0) {
+            return -1;
+        }
+    }
+    
+    return 0;
+}
+
+// Read the log file after its header
+unsigned char* readLogFile(WriteAheadLog* wal, size_t* size) {
+    off_t end = lseek(wal->fd, 0, SEEK_END);
+    *size = end > (off_t)sizeof(LogFileHeader) ? (size_t)(end - sizeof(LogFileHeader)) : 0;
+    
+    unsigned char* data = malloc(*size + 1);
+    if (data && *size > 0 &&
+        pread(wal->fd, data, *size, sizeof(LogFileHeader)) != (ssize_t)*size) {
+        free(data);
+        return NULL;
+    }
+    return data;
+}
+
+// Recover a database from its last checkpoint and the log after it
+// Redo replays every record in log order, committed or not, so the heap and
+// the open write sets look as they did at the crash. Undo then rolls back
+// the transactions left without a commit or abort record. The log ends at
+// the first torn or corrupt record. Indexes and column stores are rebuilt
+// from the recovered heap, and a fresh checkpoint empties the log.
+int recoverDatabase(Database* db) {
+    WriteAheadLog* wal = db->storage->wal;
+    TransactionManager* manager = db->transaction_manager;
+    RecoveryCatalog* catalog = calloc(1, sizeof(RecoveryCatalog));
+    if (!catalog) {
+        return -1;
+    }
+    
+    wal->recovering = 1;
+    wal->replayed_records = 0;
+    wal->redone_transactions = 0;
+    wal->undone_transactions = 0;
+    
+    Lsn checkpoint_lsn;
+    int result = loadCheckpoint(db, catalog, &checkpoint_lsn);
+    
+    // Redo
+    size_t size = 0;
+    unsigned char* log = result == 0 ? readLogFile(wal, &size) : NULL;
+    if (!log) {
+        result = -1;
+    }
+    
+    Lsn lsn = wal->start_lsn;
+    size_t offset = 0;
+    while (result == 0 && offset + sizeof(LogRecordHeader) <= size) {
+        unsigned char* record = log + offset;
+        LogRecordHeader header;
+        memcpy(&header, record, sizeof(header));
+        
+        if (header.size < sizeof(LogRecordHeader) || header.size > size - offset || header.lsn != lsn) {
+            break; // Torn tail
+        }
+        unsigned int zero = 0;
+        memcpy(record + offsetof(LogRecordHeader, checksum), &zero, sizeof(zero));
+        if (logChecksum(record, header.size) != header.checksum) {
+            break;
+        }
+        
+        if (header.lsn >= checkpoint_lsn) {
+            result = redoLogRecord(db, catalog, &header, record + sizeof(LogRecordHeader));
+            wal->replayed_records++;
+        }
+        offset += header.size;
+        lsn += header.size;
+    }
+    free(log);
+    
+    // The log continues after the last good record
+    wal->next_lsn = lsn > checkpoint_lsn ? lsn : checkpoint_lsn;
+    wal->flushed_lsn = wal->next_lsn;
+    
+    // Undo
+    for (int i = 0; i < MAX_TRANSACTIONS && result == 0; i++) {
+        Transaction* transaction = &manager->transactions[i];
+        if (transaction->state == TRANSACTION_ACTIVE) {
+            abortTransaction(manager, transaction);
+            wal->undone_transactions++;
+        }
+    }
+    manager->garbage_head = 0;
+    manager->garbage_count = 0;
+    
+    for (int t = 0; t < db->table_count && result == 0; t++) {
+        Table* table = &db->tables[t];
+        result = reclaimDeadVersions(table);
+        
+        for (int i = 0; i < catalog->index_counts[t] && result == 0; i++) {
+            LogIndexDefinition* definition = &catalog->indexes[t][i];
+            if (definition->column_index < 0 || definition->column_index >= table->column_count) {
+                result = -1;
+                break;
+            }
+            result = createIndex(table, definition->name, table->columns[definition->column_index].name,
+                                 definition->is_unique);
+        }
+        
+        if (result == 0 && catalog->column_stores[t]) {
+            result = enableColumnStore(table);
+        }
+    }
+    
+    free(catalog);
+    wal->recovering = 0;
+    
+    if (result == 0) {
+        result = checkpointDatabase(db);
+    }
+    return result;
+}
+
+// Start logging a database's changes
+// Creates wal.log and takes a first checkpoint, so everything already in the
+// database is durable before the first logged transaction. group_commit 0
+// makes every commit sync the log on its own.
+int enableWriteAheadLog(Database* db, int group_commit) {
+    if (!db || !db->storage) {
+        return -1;
+    }
+    
+    if (!db->storage->wal) {
+        db->storage->wal = openWriteAheadLog(db->storage->database_path);
+        if (!db->storage->wal) return -1;
+    }
+    
+    db->storage->wal->group_commit = group_commit;
+    return checkpointDatabase(db);
+}
+
+// =============================================================================
+// EXPLAIN
+// =============================================================================
+
+// Append formatted text to an EXPLAIN buffer
+void appendExplain(char* buffer, size_t size, const char* format, ...) {
+    size_t used = strlen(buffer);
+    if (used + 1 >= size) return;
+    
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buffer + used, size - used, format, args);
+    va_end(args);
+}
+
+// SQL spelling of a WHERE operator
+const char* operatorSymbol(Operator op) {
+    switch (op) {
+        case OP_EQUAL: return "=";
+        case OP_NOT_EQUAL: return "!=";
+        case OP_LESS_THAN: return "<";
+        case OP_LESS_EQUAL: return "<=";
+        case OP_GREATER_THAN: return ">";
+        case OP_GREATER_EQUAL: return ">=";
+        case OP_LIKE: return "LIKE";
+        case OP_IN: return "IN";
+        default: return "?";
+    }
+}
+
+// Append a node's conditions joined by AND
+// index_conditions selects the ones an index scan answers from its key range.
+void appendConditions(char* buffer, size_t size, QueryPlanNode* node, int index_conditions) {
+    int written = 0;
+    
+    for (int i = 0; i < node->condition_count; i++) {
+        WhereCondition* condition = &node->query->where_conditions[node->conditions[i]];
+        int is_index_condition = node->node_type == PLAN_INDEX_SCAN &&
+                                 condition->column_index == node->range.index->column_index &&
+                                 isRangeOperator(condition->operator);
+        if (is_index_condition != index_conditions) continue;
+        
+        const char* quote = condition->value_type == DATA_TYPE_TEXT ? "'" : "";
+        appendExplain(buffer, size, "%s%s %s %s%s%s", written ? " AND " : "", condition->column_name,
+                      operatorSymbol(condition->operator), quote, condition->value, quote);
+        written++;
+    }
+}
+
+// Check whether any of a node's conditions fall in one EXPLAIN group
+int hasConditions(QueryPlanNode* node, int index_conditions) {
+    char probe[8] = "";
+    appendConditions(probe, sizeof(probe), node, index_conditions);
+    return probe[0] != '\0';
+}
+
+// Render a plan node and its children as an indented tree
+void explainPlanNode(QueryPlanNode* node, int depth, int analyze, char* buffer, size_t size) {
+    Table* table = node->table;
+    int indent = depth * 4;
+    
+    appendExplain(buffer, size, "%*s%s", indent, "", depth > 0 ? "-> " : "");
+    
+    switch (node->node_type) {
+        case PLAN_SCAN:
+            appendExplain(buffer, size, "Seq Scan on %s", table->name);
+            break;
+        case PLAN_INDEX_SCAN:
+            appendExplain(buffer, size, "Index Scan using %s on %s",
+                          table->indexes[node->index_id].name, table->name);
+            break;
+        case PLAN_COLUMN_SCAN:
+            appendExplain(buffer, size, "Column Scan on %s (batches of %d)", table->name, VECTOR_SIZE);
+            break;
+        case PLAN_FILTER:
+            appendExplain(buffer, size, "Filter");
+            break;
+        case PLAN_SORT:
+            appendExplain(buffer, size, "Sort on %s%s", table->columns[node->sort_column].name,
+                          node->query->sort_ascending ? "" : " DESC");
+            break;
+        case PLAN_LIMIT:
+            appendExplain(buffer, size, "Limit %d offset %d", node->query->limit, node->query->offset);
+            break;
+        case PLAN_HASH_JOIN:
+            appendExplain(buffer, size, "Hash Join (build %s)",
+                          node->children[node->join->build_input]->table->name);
+            break;
+        case PLAN_MERGE_JOIN:
+            appendExplain(buffer, size, "Merge Join");
+            break;
+    }
+    
+    appendExplain(buffer, size, "  (cost=%d rows=%d", node->estimated_cost, node->estimated_rows);
+    if (analyze) {
+        appendExplain(buffer, size, " actual=%d", node->actual_rows);
+    }
+    appendExplain(buffer, size, ")\n");
+    
+    int detail = indent + (depth > 0 ? 7 : 4);
+    if (node->join) {
+        Table* left = node->children[0]->table;
+        Table* right = node->children[1]->table;
+        appendExplain(buffer, size, "%*s%s Cond: %s.%s = %s.%s\n", detail, "",
+                      node->node_type == PLAN_HASH_JOIN ? "Hash" : "Merge",
+                      left->name, left->columns[node->join->key_columns[0]].name,
+                      right->name, right->columns[node->join->key_columns[1]].name);
+        if (analyze && node->join->spilled_rows > 0) {
+            appendExplain(buffer, size, "%*sSpilled: %lld rows in %d partitions\n", detail, "",
+                          node->join->spilled_rows, node->join->partition_count);
+        }
+    }
+    if (analyze && node->sort && node->sort->ready) {
+        static const char* methods[] = {"quicksort", "top-N heapsort", "external merge"};
+        SortState* sort = node->sort;
+        appendExplain(buffer, size, "%*sSort Method: %s  Memory: %zu kB", detail, "",
+                      methods[sort->method], (sort->memory_used + 1023) / 1024);
+        if (sort->method == SORT_METHOD_EXTERNAL) {
+            appendExplain(buffer, size, "  Disk: %lld rows in %d runs", sort->spilled_rows, sort->runs_written);
+        }
+        appendExplain(buffer, size, "\n");
+    }
+    if (node->node_type == PLAN_INDEX_SCAN && hasConditions(node, 1)) {
+        appendExplain(buffer, size, "%*sIndex Cond: ", detail, "");
+        appendConditions(buffer, size, node, 1);
+        appendExplain(buffer, size, "\n");
+    }
+    if (hasConditions(node, 0)) {
+        appendExplain(buffer, size, "%*sFilter: ", detail, "");
+        appendConditions(buffer, size, node, 0);
+        appendExplain(buffer, size, "\n");
+    }
+    
+    for (int i = 0; i < node->child_count; i++) {
+        explainPlanNode(node->children[i], depth + 1, analyze, buffer, size);
+    }
+}
+
+// Describe the plan chosen for a SELECT
+// With analyze set the plan is also run, and each node reports the rows it
+// actually produced next to the estimate.
+int explainQuery(Database* db, Query* query, int analyze, char* buffer, size_t size) {
+    if (!db || !query || !buffer || size == 0) {
+        return -1;
+    }
+    
+    buffer[0] = '\0';
+    
+    QueryOptimizer optimizer;
+    QueryPlanNode* plan = planSelectQuery(db, query, &optimizer);
+    if (!plan) {
+        return -1;
+    }
+    
+    if (analyze) {
+        int implicit_id = beginStatement(db, query);
+        if (implicit_id >= 0 && openPlanNode(plan) == 0) {
+            while (nextPlanRow(plan) != NULL) {
+            }
+        }
+        if (implicit_id >= 0) {
+            endStatement(db, query, implicit_id, 0);
+        }
+    }
+    
+    explainPlanNode(plan, 0, analyze, buffer, size);
+    freeQueryPlan(plan);
+    return 0;
+}
+
+// =============================================================================
+// QUERY EXECUTION
+// =============================================================================
+
+// Open a streaming cursor over a SELECT
+// The query is copied, so the caller may reuse it while the cursor is open.
+// The cursor's statement, and its snapshot, lasts until the last row is
+// fetched or the cursor is closed.
+ResultCursor* openCursor(Database* db, Query* query) {
+    if (!db || !query || query->type != QUERY_SELECT) {
+        return NULL;
+    }
+    
+    ResultCursor* cursor = calloc(1, sizeof(ResultCursor));
+    if (!cursor) {
+        return NULL;
+    }
+    
+    cursor->db = db;
+    cursor->query = *query;
+    query = &cursor->query;
+    
+    // Plan the query; rows come from its table, or the joined tables
+    QueryOptimizer optimizer;
+    cursor->plan = planSelectQuery(db, query, &optimizer);
+    if (!cursor->plan) {
+        free(cursor);
+        return NULL;
+    }
+    Table* table = cursor->plan->table;
+    
+    if (query->selected_column_count == 0) {
+        for (int i = 0; i < table->column_count; i++) {
+            cursor->columns[i] = table->columns[i];
+            cursor->projection[i] = i;
+        }
+        cursor->column_count = table->column_count;
+    } else {
+        for (int i = 0; i < query->selected_column_count; i++) {
+            int column_index = findOutputColumn(db, query, query->selected_columns[i].name);
+            if (column_index >= 0) {
+                cursor->projection[cursor->column_count] = column_index;
+                cursor->columns[cursor->column_count++] = table->columns[column_index];
+            }
+        }
+    }
+    
+    cursor->implicit_id = beginStatement(db, query);
+    if (cursor->implicit_id < 0 || openPlanNode(cursor->plan) != 0) {
+        if (cursor->implicit_id >= 0) endStatement(db, query, cursor->implicit_id, 1);
+        freeQueryPlan(cursor->plan);
+        free(cursor);
+        return NULL;
+    }
+    
+    cursor->running = 1;
+    return cursor;
+}
+
+// Move a cursor to its next row
+// Returns 1 with a row, 0 when the rows are exhausted (the statement then
+// ends) and -1 if the cursor is not running.
+int fetchCursor(ResultCursor* cursor) {
+    if (!cursor || !cursor->running) {
+        return -1;
+    }
+    
+    cursor->row = nextPlanRow(cursor->plan);
+    if (cursor->row) {
+        return 1;
+    }
+    
+    cursor->running = 0;
+    endStatement(cursor->db, &cursor->query, cursor->implicit_id, 0);
+    return 0;
+}
+
+// Field of the current row in select-list order; NULL for SQL NULL
+// The pointer is valid until the next fetch and may be unaligned.
+const void* cursorColumn(ResultCursor* cursor, int column) {
+    if (!cursor || !cursor->row || column < 0 || column >= cursor->column_count) {
+        return NULL;
+    }
+    
+    int column_index = cursor->projection[column];
+    if (isFieldNull(cursor->row, column_index)) {
+        return NULL;
+    }
+    
+    return cursor->row + cursor->plan->table->column_offsets[column_index];
+}
+
+// Close a cursor, ending its statement if rows were left unread
+void closeCursor(ResultCursor* cursor) {
+    if (!cursor) return;
+    
+    if (cursor->running) {
+        endStatement(cursor->db, &cursor->query, cursor->implicit_id, 0);
+    }
+    
+    freeQueryPlan(cursor->plan);
+    free(cursor);
+}
+
+// Execute SELECT query
+// Reads run against the statement's snapshot and take no database latch,
+// so they neither block nor wait for writers. The rows are copied into the
+// result set, up to MAX_RECORDS; openCursor() streams any number of rows.
+ResultSet* executeSelectQuery(Database* db, Query* query) {
+    ResultCursor* cursor = openCursor(db, query);
+    if (!cursor) {
+        return NULL;
+    }
+    
+    ResultSet* result = malloc(sizeof(ResultSet));
+    if (!result) {
+        closeCursor(cursor);
+        return NULL;
+    }
+    
+    memset(result, 0, sizeof(ResultSet));
+    memcpy(result->columns, cursor->columns, cursor->column_count * sizeof(Column));
+    result->column_count = cursor->column_count;
+    
+    while (fetchCursor(cursor) == 1) {
+        if (addResultRow(result, cursor->plan->table, cursor->projection, cursor->row) != 0) {
+            break;
+        }
+    }
+    
+    closeCursor(cursor);
+    return result;
+}
+
+// Free result set rows
+void freeResultSet(ResultSet* result) {
+    if (!result) return;
+    
+    for (int i = 0; i < result->row_count; i++) {
+        free(result->rows[i]);
+    }
+    
+    free(result);
+}
+
+// Execute SELECT COUNT(*), COUNT(column), SUM, MIN and MAX in one pass
+// column_name NULL aggregates rows only. A plain column scan aggregates
+// straight from the batches' selection vectors; any other plan is pulled
+// row by row.
+int executeAggregateQuery(Database* db, Query* query, const char* column_name, AggregateResult* result) {
+    if (!db || !query || !result || query->type != QUERY_SELECT) {
+        return -1;
+    }
+    
+    initAggregateResult(result);
+    
+    int column_index = column_name ? findOutputColumn(db, query, column_name) : -1;
+    QueryOptimizer optimizer;
+    QueryPlanNode* plan = NULL;
+    
+    if (!column_name || column_index >= 0) {
+        plan = planSelectQuery(db, query, &optimizer);
+    }
+    Table* table = plan ? plan->table : NULL;
+    
+    int implicit_id = plan ? beginStatement(db, query) : -1;
+    if (implicit_id < 0 || openPlanNode(plan) != 0) {
+        if (implicit_id >= 0) endStatement(db, query, implicit_id, 1);
+        freeQueryPlan(plan);
+        return -1;
+    }
+    
+    if (plan->node_type == PLAN_COLUMN_SCAN) {
+        ColumnStore* store = table->column_store;
+        
+        for (int start = 0; ; start += VECTOR_SIZE) {
+            pthread_rwlock_rdlock(&store->latch);
+            if (start >= store->row_count) {
+                pthread_rwlock_unlock(&store->latch);
+                break;
+            }
+            
+            int count = store->row_count - start < VECTOR_SIZE ? store->row_count - start : VECTOR_SIZE;
+            result->rows += filterColumnBatch(table, query, plan->conditions, plan->condition_count,
+                                              start, count, &plan->selection);
+            if (column_index >= 0) {
+                aggregateColumnBatch(&store->columns[column_index], table->columns[column_index].type,
+                                     start, &plan->selection, result);
+            }
+            pthread_rwlock_unlock(&store->latch);
+        }
+    } else {
+        const unsigned char* row;
+        
+        while ((row = nextPlanRow(plan)) != NULL) {
+            result->rows++;
+            if (column_index >= 0 && !isFieldNull(row, column_index)) {
+                accumulateValue(result, numericValue(table->columns[column_index].type,
+                                                     row + table->column_offsets[column_index]));
+            }
+        }
+    }
+    
+    freeQueryPlan(plan);
+    endStatement(db, query, implicit_id, 0);
+    return 0;
+}
+
+// Execute SELECT COUNT(*): runs the plan without materializing rows
+int executeCountQuery(Database* db, Query* query) {
+    AggregateResult result;
+    
+    if (executeAggregateQuery(db, query, NULL, &result) != 0) {
+        return -1;
+    }
+    
+    return (int)result.rows;
+}
+
+// Execute INSERT query
+// The new row is a version only its transaction sees until commit. Unique
+// indexes are checked against current versions, including ones that other
+// transactions have not committed yet.
+int executeInsertQuery(Database* db, Query* query, Record* record) {
+    if (!db || !query || !record || query->type != QUERY_INSERT) {
+        return -1;
+    }
+    
+    // Find table
+    Table* table = findTable(db, query->table_name);
+    if (!table) {
+        return -1;
+    }
+    
+    int implicit_id = beginStatement(db, query);
+    if (implicit_id < 0) {
+        return -1;
+    }
+    
+    Transaction* transaction = query->snapshot.transaction;
+    int failed = 0;
+    pthread_mutex_lock(&db->mutex);
+    
+    // Check unique indexes before touching the heap
+    unsigned char keys[MAX_INDEXES][BTREE_MAX_KEY_SIZE];
+    for (int i = 0; i < table->index_count && !failed; i++) {
+        Index* index = &table->indexes[i];
+        encodeKeyValue(index, record->fields[index->column_index], keys[i]);
+        
+        if (index->is_unique && currentVersionHasKey(table, index, keys[i], transaction)) {
+            failed = 1; // Unique constraint violation
+        }
+    }
+    
+    // Set record ID and write the new version
+    if (!failed) {
+        unsigned char row[PAGE_DATA_SIZE];
+        record->id = table->next_record_id++;
+        serializeRecord(table, record, row);
+        
+        RowId row_id = writeRowVersion(table, row, uncommittedTimestamp(transaction->transaction_id));
+        failed = row_id < 0 || recordWrite(transaction, table, row_id, 0) != 0;
+        
+        // Update indexes
+        for (int i = 0; i < table->index_count && !failed; i++) {
+            insertIndexEntry(&table->indexes[i], keys[i], row_id);
+        }
+    }
+    
+    pthread_mutex_unlock(&db->mutex);
+    
+    if (endStatement(db, query, implicit_id, failed) != 0) {
+        return -1;
+    }
+    return record->id;
+}
+
+// Collect the row ids of the versions an UPDATE or DELETE affects
+// Matching rows are gathered before any is written, so a statement never
+// revisits the versions it creates. Returns the count, or -1.
+int collectPlanRows(QueryPlanNode* plan, RowId** row_ids) {
+    int count = 0;
+    int capacity = 64;
+    
+    *row_ids = malloc(capacity * sizeof(RowId));
+    if (!*row_ids || openPlanNode(plan) != 0) {
+        return -1;
+    }
+    
+    while (nextPlanRow(plan) != NULL) {
+        if (count >= capacity) {
+            RowId* grown = realloc(*row_ids, capacity * 2 * sizeof(RowId));
+            if (!grown) {
+                return -1;
+            }
+            *row_ids = grown;
+            capacity *= 2;
+        }
+        (*row_ids)[count++] = plan->row_id;
+    }
+    
+    return count;
+}
+
+// Replace a row version with a copy that has one column changed
+// value is in the column's storage format; NULL sets SQL NULL.
+int updateRowVersion(Table* table, RowId row_id, Transaction* transaction, int column_index,
+                     const unsigned char* value) {
+    Page page;
+    int slot;
+    int page_id = heapPageForRow(table, row_id, &slot);
+    if (page_id < 0 || readPage(table->storage, page_id, &page) != 0) {
+        return -1;
+    }
+    
+    unsigned char row[PAGE_DATA_SIZE];
+    unsigned char* field = row + table->column_offsets[column_index];
+    int size = columnStorageSize(&table->columns[column_index]);
+    unsigned long long nulls;
+    
+    memcpy(row, rowSlot(table, &page, slot), table->row_size);
+    memcpy(&nulls, row + ROW_NULLS_OFFSET, sizeof(nulls));
+    
+    int key_changed = isFieldNull(row, column_index) != (value == NULL) ||
+                      (value && memcmp(field, value, size) != 0);
+    
+    if (value) {
+        memcpy(field, value, size);
+        nulls &= ~(1ULL << column_index);
+    } else {
+        memset(field, 0, size);
+        nulls |= 1ULL << column_index;
+    }
+    memcpy(row + ROW_NULLS_OFFSET, &nulls, sizeof(nulls));
+    
+    // The old version still holds the old key, so only a new key can clash
+    for (int i = 0; i < table->index_count && key_changed; i++) {
+        Index* index = &table->indexes[i];
+        if (index->is_unique && index->column_index == column_index &&
+            currentVersionHasKey(table, index, field, transaction)) {
+            return -1; // Unique constraint violation
+        }
+    }
+    
+    RowId new_row = writeRowVersion(table, row, uncommittedTimestamp(transaction->transaction_id));
+    if (new_row < 0 || recordWrite(transaction, table, row_id, 1) != 0 ||
+        recordWrite(transaction, table, new_row, 0) != 0 || logSupersede(table, transaction, row_id) != 0) {
+        return -1;
+    }
+    
+    for (int i = 0; i < table->index_count; i++) {
+        Index* index = &table->indexes[i];
+        insertIndexEntry(index, row + table->column_offsets[index->column_index], new_row);
+    }
+    
+    return 0;
+}
+
+// Give every row a plan returns a new version with one column changed
+// Runs as one statement; value is in the column's storage format, NULL
+// sets SQL NULL. Returns the number of rows updated.
+int updatePlanRows(Database* db, Table* table, Query* query, QueryPlanNode* plan, int column_index,
+                   const unsigned char* value) {
+    int implicit_id = beginStatement(db, query);
+    if (implicit_id < 0) {
+        return -1;
+    }
+    
+    RowId* row_ids = NULL;
+    int count = collectPlanRows(plan, &row_ids);
+    int failed = count < 0;
+    
+    pthread_mutex_lock(&db->mutex);
+    for (int i = 0; i < count && !failed; i++) {
+        failed = updateRowVersion(table, row_ids[i], query->snapshot.transaction, column_index, value) != 0;
+    }
+    pthread_mutex_unlock(&db->mutex);
+    
+    free(row_ids);
+    if (endStatement(db, query, implicit_id, failed) != 0) {
+        return -1;
+    }
+    return count;
+}
+
+// Execute UPDATE table SET column_name = value WHERE ...
+// value is a literal as in WHERE conditions, or NULL for SQL NULL. Each
+// matching row gets a new version; the old one is ended when the transaction
+// commits. ORDER BY is not supported. Returns the number of rows updated.
+int executeUpdateQuery(Database* db, Query* query, const char* column_name, const char* value) {
+    if (!db || !query || !column_name || query->type != QUERY_UPDATE || query->sort_column[0]) {
+        return -1;
+    }
+    
+    Table* table = findTable(db, query->table_name);
+    int column_index = table ? findColumn(table, column_name) : -1;
+    if (column_index < 0 || (!value && table->columns[column_index].is_not_null) ||
+        bindWhereConditions(table, query) != 0) {
+        return -1;
+    }
+    
+    unsigned char encoded[MAX_FIELD_SIZE];
+    if (value) {
+        encodeLiteral(&table->columns[column_index], value, encoded);
+    }
+    
+    QueryOptimizer optimizer;
+    QueryPlanNode* plan = optimizeQuery(db, table, query, &optimizer);
+    int count = plan ? updatePlanRows(db, table, query, plan, column_index, value ? encoded : NULL) : -1;
+    freeQueryPlan(plan);
+    return count;
+}
+
+// Supersede every row a plan returns, as one statement
+// Deleting only records the versions in the write set; commit ends them.
+// Returns the number of rows deleted.
+int deletePlanRows(Database* db, Table* table, Query* query, QueryPlanNode* plan) {
+    int implicit_id = beginStatement(db, query);
+    if (implicit_id < 0) {
+        return -1;
+    }
+    
+    RowId* row_ids = NULL;
+    int count = collectPlanRows(plan, &row_ids);
+    int failed = count < 0;
+    
+    pthread_mutex_lock(&db->mutex);
+    for (int i = 0; i < count && !failed; i++) {
+        failed = recordWrite(query->snapshot.transaction, table, row_ids[i], 1) != 0 ||
+                 logSupersede(table, query->snapshot.transaction, row_ids[i]) != 0;
+    }
+    pthread_mutex_unlock(&db->mutex);
+    
+    free(row_ids);
+    if (endStatement(db, query, implicit_id, failed) != 0) {
+        return -1;
+    }
+    return count;
+}
+
+// Execute DELETE FROM table WHERE ...
+// ORDER BY is not supported. Returns the number of rows deleted.
+int executeDeleteQuery(Database* db, Query* query) {
+    if (!db || !query || query->type != QUERY_DELETE || query->sort_column[0]) {
+        return -1;
+    }
+    
+    Table* table = findTable(db, query->table_name);
+    if (!table || bindWhereConditions(table, query) != 0) {
+        return -1;
+    }
+    
+    QueryOptimizer optimizer;
+    QueryPlanNode* plan = optimizeQuery(db, table, query, &optimizer);
+    int count = plan ? deletePlanRows(db, table, query, plan) : -1;
+    freeQueryPlan(plan);
+    return count;
+}
+
+// =============================================================================
+// CONNECTION POOL IMPLEMENTATION
+// =============================================================================
+
+// Initialize connection pool
+// Every slot starts closed on the free list; connections open when first taken.
+ConnectionPool* initConnectionPool(int max_connections) {
+    if (max_connections <= 0 || max_connections > MAX_CONNECTIONS) {
+        return NULL;
+    }
+    
+    ConnectionPool* pool = aligned_alloc(64, sizeof(ConnectionPool));
+    if (!pool) return NULL;
+    
+    memset(pool, 0, sizeof(ConnectionPool));
+    pool->max_connections = max_connections;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->available, NULL);
+    
+    // Chain the slots so that slot 0 is on top
+    for (int i = 0; i < max_connections; i++) {
+        pool->connections[i].connection_id = i + 1;
+        pool->connections[i].transaction_id = -1;
+        pool->connections[i].next_free = i + 1 < max_connections ? i + 2 : 0;
+    }
+    pool->free_head = 1;
+    
+    return pool;
+}
+
+// Free connection pool
+void freeConnectionPool(ConnectionPool* pool) {
+    if (!pool) return;
+    
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->available);
+    free(pool);
+}
+
+// Pop a slot off the free list; -1 if it is empty
+// The head carries a tag that every update bumps, so a slot that is popped
+// and pushed back between our read and our compare-and-swap fails it (ABA).
+int popFreeSlot(ConnectionPool* pool) {
+    unsigned long long head = __atomic_load_n(&pool->free_head, __ATOMIC_SEQ_CST);
+    
+    while (1) {
+        int slot = (int)(head & 0xFFFFFFFFULL) - 1;
+        if (slot < 0) {
+            return -1;
+        }
+        
+        unsigned long long next = (unsigned)__atomic_load_n(&pool->connections[slot].next_free, __ATOMIC_RELAXED);
+        unsigned long long replacement = (((head >> 32) + 1) << 32) | next;
+        if (__atomic_compare_exchange_n(&pool->free_head, &head, replacement, 1,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+            return slot;
+        }
+    }
+}
+
+// Push a slot onto the free list
+void pushFreeSlot(ConnectionPool* pool, int slot) {
+    unsigned long long head = __atomic_load_n(&pool->free_head, __ATOMIC_RELAXED);
+    unsigned long long replacement;
+    
+    do {
+        __atomic_store_n(&pool->connections[slot].next_free, (int)(head & 0xFFFFFFFFULL), __ATOMIC_RELAXED);
+        replacement = (((head >> 32) + 1) << 32) | (unsigned long long)(slot + 1);
+    } while (!__atomic_compare_exchange_n(&pool->free_head, &head, replacement, 1,
+                                          __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+}
+
+// Block until a slot is returned or timeout_ms passes; -1 on timeout
+// A waiter registers before its last look at the free list and returners
+// check for waiters after pushing, so a return cannot slip by unnoticed.
+int waitForFreeSlot(ConnectionPool* pool, int timeout_ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+    deadline.tv_nsec %= 1000000000L;
+    
+    pthread_mutex_lock(&pool->mutex);
+    __atomic_add_fetch(&pool->waiters, 1, __ATOMIC_SEQ_CST);
+    pool->waits++;
+    
+    int slot;
+    while ((slot = popFreeSlot(pool)) < 0) {
+        if (pthread_cond_timedwait(&pool->available, &pool->mutex, &deadline) != 0) {
+            slot = popFreeSlot(pool);
+            break;
+        }
+    }
+    
+    __atomic_sub_fetch(&pool->waiters, 1, __ATOMIC_SEQ_CST);
+    if (slot < 0) {
+        pool->timeouts++;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return slot;
+}
+
+// Take a connection out of the pool
+// An idle connection to the same database is reused as is; a slot the
+// reaper closed, or one open to another database, is opened again. Waits
+// up to timeout_ms for a return when every slot is in use; 0 fails at once.
+DatabaseConnection* acquireConnection(ConnectionPool* pool, const char* database_name, int timeout_ms) {
+    if (!pool || !database_name) {
+        return NULL;
+    }
+    
+    int slot = popFreeSlot(pool);
+    if (slot < 0 && timeout_ms > 0) {
+        slot = waitForFreeSlot(pool, timeout_ms);
+    }
+    if (slot < 0) {
+        return NULL; // No available connections
+    }
+    
+    DatabaseConnection* connection = &pool->connections[slot];
+    int state;
+    do {
+        // A slot being reaped turns CLOSED shortly
+        state = __atomic_load_n(&connection->state, __ATOMIC_ACQUIRE);
+    } while (state == CONNECTION_CLOSING ||
+             !__atomic_compare_exchange_n(&connection->state, &state, CONNECTION_IN_USE, 0,
+                                          __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+    
+    time_t now = time(NULL);
+    if (state == CONNECTION_CLOSED || strcmp(connection->database_name, database_name) != 0) {
+        if (state == CONNECTION_CLOSED) {
+            __atomic_add_fetch(&pool->open_count, 1, __ATOMIC_RELAXED);
+        }
+        strncpy(connection->database_name, database_name, sizeof(connection->database_name) - 1);
+        connection->is_connected = 1;
+        connection->connect_time = now;
+        __atomic_add_fetch(&pool->opened, 1, __ATOMIC_RELAXED);
+    }
+    
+    connection->transaction_id = -1;
+    connection->auto_commit = 1;
+    __atomic_store_n(&connection->last_activity, now, __ATOMIC_RELAXED);
+    return connection;
+}
+
+// Get connection from pool without waiting
+DatabaseConnection* getConnection(ConnectionPool* pool, const char* database_name) {
+    return acquireConnection(pool, database_name, 0);
+}
+
+// Return connection to pool
+int returnConnection(ConnectionPool* pool, DatabaseConnection* connection) {
+    if (!pool || !connection) {
+        return -1;
+    }
+    
+    connection->transaction_id = -1;
+    __atomic_store_n(&connection->last_activity, time(NULL), __ATOMIC_RELAXED);
+    
+    int state = CONNECTION_IN_USE;
+    if (!__atomic_compare_exchange_n(&connection->state, &state, CONNECTION_IDLE, 0,
+                                     __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        return -1; // Not taken from the pool, or returned twice
+    }
+    
+    pushFreeSlot(pool, (int)(connection - pool->connections));
+    
+    if (__atomic_load_n(&pool->waiters, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&pool->mutex);
+        pthread_cond_signal(&pool->available);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+    return 0;
+}
+
+// Close connections idle for at least max_idle_seconds
+// Closed slots stay on the free list and are reopened when next taken, so
+// the list itself is never edited. Returns the number closed.
+int reapIdleConnections(ConnectionPool* pool, int max_idle_seconds) {
+    if (!pool) {
+        return -1;
+    }
+    
+    time_t now = time(NULL);
+    int closed = 0;
+    
+    for (int i = 0; i < pool->max_connections; i++) {
+        DatabaseConnection* connection = &pool->connections[i];
+        int state = CONNECTION_IDLE;
+        
+        if (now - __atomic_load_n(&connection->last_activity, __ATOMIC_RELAXED) < max_idle_seconds ||
+            !__atomic_compare_exchange_n(&connection->state, &state, CONNECTION_CLOSING, 0,
+                                         __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            continue;
+        }
+        
+        // It may have been taken and returned since last_activity was read
+        if (now - __atomic_load_n(&connection->last_activity, __ATOMIC_RELAXED) < max_idle_seconds) {
+            __atomic_store_n(&connection->state, CONNECTION_IDLE, __ATOMIC_RELEASE);
+            continue;
+        }
+        
+        connection->is_connected = 0;
+        __atomic_store_n(&connection->state, CONNECTION_CLOSED, __ATOMIC_RELEASE);
+        __atomic_sub_fetch(&pool->open_count, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&pool->reaped, 1, __ATOMIC_RELAXED);
+        closed++;
+    }
+    
+    return closed;
+}
+
+// Count connections currently taken from the pool
+int countActiveConnections(ConnectionPool* pool) {
+    int active = 0;
+    for (int i = 0; pool && i < pool->max_connections; i++) {
+        active += __atomic_load_n(&pool->connections[i].state, __ATOMIC_RELAXED) == CONNECTION_IN_USE;
+    }
+    return active;
+}
+
+// =============================================================================
+// SQL PARSER IMPLEMENTATION
+// =============================================================================
+
+// Initialize lexer
+void initLexer(SQLLexer* lexer, const char* input) {
+    if (!lexer || !input) return;
+    
+    memset(lexer, 0, sizeof(SQLLexer));
+    lexer->input = input;
+    lexer->position = 0;
+    lexer->line = 1;
+    lexer->column = 1;
+}
+
+// Get next character
+char getNextChar(SQLLexer* lexer) {
+    if (!lexer || !lexer->input || lexer->input[lexer->position] == '\0') {
+        return '\0';
+    }
+    
+    char c = lexer->input[lexer->position++];
+    
+    if (c == '\n') {
+        lexer->line++;
+        lexer->column = 1;
+    } else {
+        lexer->column++;
+    }
+    
+    return c;
+}
+
+// Peek next character
+char peekNextChar(SQLLexer* lexer) {
+    if (!lexer || !lexer->input || lexer->input[lexer->position] == '\0') {
+        return '\0';
+    }
+    
+    return lexer->input[lexer->position];
+}
+
+// Skip whitespace
+void skipWhitespace(SQLLexer* lexer) {
+    char c = peekNextChar(lexer);
+    while (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+        getNextChar(lexer);
+        c = peekNextChar(lexer);
+    }
+}
+
+// Reserved words; matched without regard to case
+const char* sql_keywords[] = {
+    "SELECT", "FROM", "WHERE", "AND", "ORDER", "BY", "ASC", "DESC", "LIMIT", "OFFSET",
+    "INSERT", "INTO", "VALUES", "UPDATE", "SET", "DELETE", "NULL", "TRUE", "FALSE", "LIKE",
+    "JOIN", "INNER", "ON"
+};
+
+// Check whether a word is a reserved word
+int isSQLKeyword(const char* word) {
+    for (int i = 0; i < (int)(sizeof(sql_keywords) / sizeof(sql_keywords[0])); i++) {
+        if (strcasecmp(word, sql_keywords[i]) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Tokenize identifier or keyword
+void tokenizeIdentifier(SQLLexer* lexer, SQLToken* token) {
+    char buffer[MAX_FIELD_SIZE];
+    int buffer_pos = 0;
+    
+    char c = peekNextChar(lexer);
+    while ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || 
+           (c >= '0' && c <= '9') || c == '_') {
+        c = getNextChar(lexer);
+        if (buffer_pos < MAX_FIELD_SIZE - 1) buffer[buffer_pos++] = c;
+        c = peekNextChar(lexer);
+    }
+    
+    buffer[buffer_pos] = '\0';
+    
+    token->type = isSQLKeyword(buffer) ? TOKEN_KEYWORD : TOKEN_IDENTIFIER;
+    strncpy(token->value, buffer, sizeof(token->value) - 1);
+    token->line = lexer->line;
+    token->column = lexer->column - buffer_pos;
+}
+
+// Tokenize string
+void tokenizeString(SQLLexer* lexer, SQLToken* token) {
+    char buffer[MAX_FIELD_SIZE];
+    int buffer_pos = 0;
+    
+    getNextChar(lexer); // Skip opening quote
+    
+    char c = peekNextChar(lexer);
+    while (c != '\0' && c != '\'') {
+        if (c == '\\') {
+            getNextChar(lexer); // Skip escape character
+            if (peekNextChar(lexer) == '\0') break;
+        }
+        c = getNextChar(lexer);
+        if (buffer_pos < MAX_FIELD_SIZE - 1) buffer[buffer_pos++] = c;
+        c = peekNextChar(lexer);
+    }
+    
+    getNextChar(lexer); // Skip closing quote
+    
+    buffer[buffer_pos] = '\0';
+    
+    token->type = TOKEN_STRING;
+    strncpy(token->value, buffer, sizeof(token->value) - 1);
+    token->line = lexer->line;
+    token->column = lexer->column - buffer_pos;
+}
+
+// Get next token
+int getNextToken(SQLLexer* lexer, SQLToken* token) {
+    if (!lexer || !token) {
+        return -1;
+    }
+    
+    skipWhitespace(lexer);
+    
+    char c = peekNextChar(lexer);
+    if (c == '\0') {
+        token->type = TOKEN_EOF;
+        token->value[0] = '\0';
+        return 0;
+    }
+    
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_') {
+        tokenizeIdentifier(lexer, token);
+    } else if (c == '\'') {
+        tokenizeString(lexer, token);
+    } else if (c >= '0' && c <= '9') {
+        // Tokenize number
+        char buffer[MAX_FIELD_SIZE];
+        int buffer_pos = 0;
+        
+        while ((c >= '0' && c <= '9') || c == '.') {
+            c = getNextChar(lexer);
+            if (buffer_pos < MAX_FIELD_SIZE - 1) buffer[buffer_pos++] = c;
+            c = peekNextChar(lexer);
+        }
+        
+        buffer[buffer_pos] = '\0';
+        
+        token->type = TOKEN_NUMBER;
+        strncpy(token->value, buffer, sizeof(token->value) - 1);
+        token->line = lexer->line;
+        token->column = lexer->column - buffer_pos;
+    } else {
+        // Operator or punctuation: <=, >=, <> and != are one token
+        char op[3] = {c, '\0', '\0'};
+        getNextChar(lexer);
+        
+        char next = peekNextChar(lexer);
+        if ((next == '=' && (c == '<' || c == '>' || c == '!')) || (c == '<' && next == '>')) {
+            op[1] = getNextChar(lexer);
+        }
+        
+        token->type = strchr("(),;", c) ? TOKEN_PUNCTUATION : TOKEN_OPERATOR;
+        strncpy(token->value, op, sizeof(token->value) - 1);
+        token->line = lexer->line;
+        token->column = lexer->column - (int)strlen(op);
+    }
+    
+    return 0;
+}
+
+// Start a parser on the first token of the input
+void initParser(SQLParser* parser, const char* input) {
+    memset(parser, 0, sizeof(SQLParser));
+    initLexer(&parser->lexer, input);
+    getNextToken(&parser->lexer, &parser->current_token);
+    getNextToken(&parser->lexer, &parser->lookahead_token);
+}
+
+// Move to the next token
+void advanceParser(SQLParser* parser) {
+    parser->current_token = parser->lookahead_token;
+    getNextToken(&parser->lexer, &parser->lookahead_token);
+}
+
+// Record the first syntax error; returns -1
+// Long lexemes are cut to SQL_ERROR_LEXEME_LENGTH so the message fits.
+int parserError(SQLParser* parser, const char* expected) {
+    if (!parser->error) {
+        SQLToken* token = &parser->current_token;
+        parser->error = 1;
+        snprintf(parser->error_message, sizeof(parser->error_message),
+                 "Expected %s at line %d, column %d near '%.*s'", expected, token->line, token->column,
+                 SQL_ERROR_LEXEME_LENGTH, token->type == TOKEN_EOF ? "end of input" : token->value);
+    }
+    return -1;
+}
+
+// Check whether the current token is a keyword
+int atKeyword(SQLParser* parser, const char* keyword) {
+    return parser->current_token.type == TOKEN_KEYWORD &&
+           strcasecmp(parser->current_token.value, keyword) == 0;
+}
+
+// Check whether the current token is an operator or punctuation symbol
+int atSymbol(SQLParser* parser, const char* symbol) {
+    SQLToken* token = &parser->current_token;
+    return (token->type == TOKEN_OPERATOR || token->type == TOKEN_PUNCTUATION) &&
+           strcmp(token->value, symbol) == 0;
+}
+
+// Consume a keyword
+int expectKeyword(SQLParser* parser, const char* keyword) {
+    if (!atKeyword(parser, keyword)) {
+        return parserError(parser, keyword);
+    }
+    advanceParser(parser);
+    return 0;
+}
+
+// Consume a symbol
+int expectSymbol(SQLParser* parser, const char* symbol) {
+    if (!atSymbol(parser, symbol)) {
+        return parserError(parser, symbol);
+    }
+    advanceParser(parser);
+    return 0;
+}
+
+// Consume an identifier into name (MAX_FIELD_SIZE bytes)
+int parseIdentifier(SQLParser* parser, char* name, const char* expected) {
+    if (parser->current_token.type != TOKEN_IDENTIFIER) {
+        return parserError(parser, expected);
+    }
+    
+    strncpy(name, parser->current_token.value, MAX_FIELD_SIZE - 1);
+    name[MAX_FIELD_SIZE - 1] = '\0';
+    advanceParser(parser);
+    return 0;
+}
+
+// Consume a column name, optionally qualified as table.column
+int parseColumnName(SQLParser* parser, char* name, const char* expected) {
+    if (parseIdentifier(parser, name, expected) != 0) {
+        return -1;
+    }
+    if (!atSymbol(parser, ".")) {
+        return 0;
+    }
+    advanceParser(parser);
+    
+    char column[MAX_FIELD_SIZE];
+    if (parseIdentifier(parser, column, "a column name") != 0) {
+        return -1;
+    }
+    
+    size_t length = strlen(name);
+    if (length + 1 + strlen(column) >= MAX_FIELD_SIZE) {
+        return parserError(parser, "a shorter column name");
+    }
+    name[length] = '.';
+    strcpy(name + length + 1, column);
+    return 0;
+}
+
+// Register a ? placeholder for the value slot it stands in
+int addParameter(SQLParser* parser, ParsedStatement* statement, int kind, int index) {
+    if (statement->parameter_count >= MAX_PARAMETERS) {
+        return parserError(parser, "fewer parameters");
+    }
+    
+    StatementParameter* parameter = &statement->parameters[statement->parameter_count++];
+    parameter->kind = kind;
+    parameter->index = index;
+    return 0;
+}
+
+// Parse a literal or ? into a value slot (MAX_FIELD_SIZE bytes)
+// NULL is accepted only when is_null is given; TRUE and FALSE become 1 and 0.
+int parseValue(SQLParser* parser, ParsedStatement* statement, int kind, int index, char* value, int* is_null) {
+    SQLToken* token = &parser->current_token;
+    value[0] = '\0';
+    if (is_null) *is_null = 0;
+    
+    if (atSymbol(parser, "?")) {
+        if (addParameter(parser, statement, kind, index) != 0) return -1;
+    } else if (token->type == TOKEN_NUMBER || token->type == TOKEN_STRING) {
+        snprintf(value, MAX_FIELD_SIZE, "%.*s", MAX_FIELD_SIZE - 1, token->value);
+    } else if (atSymbol(parser, "-") && parser->lookahead_token.type == TOKEN_NUMBER) {
+        advanceParser(parser);
+        snprintf(value, MAX_FIELD_SIZE, "-%.*s", MAX_FIELD_SIZE - 2, token->value);
+    } else if (atKeyword(parser, "TRUE") || atKeyword(parser, "FALSE")) {
+        strcpy(value, atKeyword(parser, "TRUE") ? "1" : "0");
+    } else if (atKeyword(parser, "NULL") && is_null) {
+        *is_null = 1;
+    } else {
+        return parserError(parser, "a value");
+    }
+    
+    advanceParser(parser);
+    return 0;
+}
+
+// Parse a LIMIT or OFFSET row count: a number or ?
+int parseRowCount(SQLParser* parser, ParsedStatement* statement, int kind, int* count) {
+    if (atSymbol(parser, "?")) {
+        *count = 0; // Set from the binding at execution
+        if (addParameter(parser, statement, kind, 0) != 0) return -1;
+    } else if (parser->current_token.type == TOKEN_NUMBER) {
+        *count = atoi(parser->current_token.value);
+    } else {
+        return parserError(parser, "a row count");
+    }
+    
+    advanceParser(parser);
+    return 0;
+}
+
+// Parse a comparison operator
+int parseComparison(SQLParser* parser, Operator* op) {
+    const char* symbols[] = {"=", "!=", "<>", "<", "<=", ">", ">="};
+    const Operator operators[] = {OP_EQUAL, OP_NOT_EQUAL, OP_NOT_EQUAL, OP_LESS_THAN,
+                                  OP_LESS_EQUAL, OP_GREATER_THAN, OP_GREATER_EQUAL};
+    
+    for (int i = 0; i < (int)(sizeof(symbols) / sizeof(symbols[0])); i++) {
+        if (atSymbol(parser, symbols[i])) {
+            *op = operators[i];
+            advanceParser(parser);
+            return 0;
+        }
+    }
+    
+    if (atKeyword(parser, "LIKE")) {
+        *op = OP_LIKE;
+        advanceParser(parser);
+        return 0;
+    }
+    
+    return parserError(parser, "a comparison operator");
+}
+
+// Parse [WHERE column op value [AND column op value ...]]
+int parseWhereClause(SQLParser* parser, ParsedStatement* statement) {
+    Query* query = &statement->query;
+    if (!atKeyword(parser, "WHERE")) {
+        return 0;
+    }
+    advanceParser(parser);
+    
+    while (1) {
+        char column[MAX_FIELD_SIZE];
+        Operator op;
+        int index = query->where_condition_count;
+        
+        if (index >= MAX_COLUMNS) {
+            return parserError(parser, "fewer conditions");
+        }
+        if (parseColumnName(parser, column, "a column name") != 0 || parseComparison(parser, &op) != 0) {
+            return -1;
+        }
+        
+        addWhereCondition(query, column, op, "");
+        if (parseValue(parser, statement, PARAMETER_WHERE, index,
+                       query->where_conditions[index].value, NULL) != 0) {
+            return -1;
+        }
+        
+        if (!atKeyword(parser, "AND")) {
+            return 0;
+        }
+        advanceParser(parser);
+    }
+}
+
+// Parse a comma-separated column list into the query's selected columns
+int parseColumnList(SQLParser* parser, Query* query) {
+    while (1) {
+        char column[MAX_FIELD_SIZE];
+        if (parseColumnName(parser, column, "a column name") != 0) {
+            return -1;
+        }
+        if (addSelectedColumn(query, column) != 0) {
+            return parserError(parser, "fewer columns");
+        }
+        
+        if (!atSymbol(parser, ",")) {
+            return 0;
+        }
+        advanceParser(parser);
+    }
+}
+
+// SELECT * | column, ... FROM table [[INNER] JOIN table ON column = column]
+//        [WHERE ...] [ORDER BY column [ASC | DESC]] [LIMIT count [OFFSET count]]
+// Columns may be qualified as table.column, which a JOIN needs for names
+// that both tables use.
+int parseSelect(SQLParser* parser, ParsedStatement* statement) {
+    Query* query = &statement->query;
+    
+    if (atSymbol(parser, "*")) {
+        advanceParser(parser);
+    } else if (parseColumnList(parser, query) != 0) {
+        return -1;
+    }
+    
+    if (expectKeyword(parser, "FROM") != 0 ||
+        parseIdentifier(parser, query->table_name, "a table name") != 0) {
+        return -1;
+    }
+    
+    if (atKeyword(parser, "INNER") || atKeyword(parser, "JOIN")) {
+        if (atKeyword(parser, "INNER")) {
+            advanceParser(parser);
+        }
+        if (expectKeyword(parser, "JOIN") != 0 ||
+            parseIdentifier(parser, query->join_table, "a table name") != 0 ||
+            expectKeyword(parser, "ON") != 0 ||
+            parseColumnName(parser, query->join_columns[0], "a column name") != 0 ||
+            expectSymbol(parser, "=") != 0 ||
+            parseColumnName(parser, query->join_columns[1], "a column name") != 0) {
+            return -1;
+        }
+    }
+    
+    if (parseWhereClause(parser, statement) != 0) {
+        return -1;
+    }
+    
+    if (atKeyword(parser, "ORDER")) {
+        advanceParser(parser);
+        if (expectKeyword(parser, "BY") != 0 ||
+            parseColumnName(parser, query->sort_column, "a column name") != 0) {
+            return -1;
+        }
+        
+        if (atKeyword(parser, "DESC")) {
+            query->sort_ascending = 0;
+            advanceParser(parser);
+        } else if (atKeyword(parser, "ASC")) {
+            advanceParser(parser);
+        }
+    }
+    
+    // OFFSET only follows LIMIT, so a plan built for one binding always has
+    // the LIMIT node that later bindings need
+    if (atKeyword(parser, "LIMIT")) {
+        advanceParser(parser);
+        if (parseRowCount(parser, statement, PARAMETER_LIMIT, &query->limit) != 0) {
+            return -1;
+        }
+        
+        if (atKeyword(parser, "OFFSET")) {
+            advanceParser(parser);
+            return parseRowCount(parser, statement, PARAMETER_OFFSET, &query->offset);
+        }
+    }
+    
+    return 0;
+}
+
+// INSERT INTO table [(column, ...)] VALUES (value, ...)
+int parseInsert(SQLParser* parser, ParsedStatement* statement) {
+    Query* query = &statement->query;
+    
+    if (expectKeyword(parser, "INTO") != 0 ||
+        parseIdentifier(parser, query->table_name, "a table name") != 0) {
+        return -1;
+    }
+    
+    if (atSymbol(parser, "(")) {
+        advanceParser(parser);
+        if (parseColumnList(parser, query) != 0 || expectSymbol(parser, ")") != 0) {
+            return -1;
+        }
+    }
+    
+    if (expectKeyword(parser, "VALUES") != 0 || expectSymbol(parser, "(") != 0) {
+        return -1;
+    }
+    
+    while (1) {
+        int index = statement->value_count;
+        if (index >= MAX_COLUMNS) {
+            return parserError(parser, "fewer values");
+        }
+        if (parseValue(parser, statement, PARAMETER_VALUE, index, statement->values[index],
+                       &statement->value_is_null[index]) != 0) {
+            return -1;
+        }
+        statement->value_count++;
+        
+        if (!atSymbol(parser, ",")) {
+            return expectSymbol(parser, ")");
+        }
+        advanceParser(parser);
+    }
+}
+
+// UPDATE table SET column = value [WHERE ...]
+int parseUpdate(SQLParser* parser, ParsedStatement* statement) {
+    Query* query = &statement->query;
+    char column[MAX_FIELD_SIZE];
+    
+    if (parseIdentifier(parser, query->table_name, "a table name") != 0 ||
+        expectKeyword(parser, "SET") != 0 ||
+        parseIdentifier(parser, column, "a column name") != 0 ||
+        expectSymbol(parser, "=") != 0) {
+        return -1;
+    }
+    
+    addSelectedColumn(query, column);
+    if (parseValue(parser, statement, PARAMETER_VALUE, 0, statement->values[0],
+                   &statement->value_is_null[0]) != 0) {
+        return -1;
+    }
+    statement->value_count = 1;
+    
+    return parseWhereClause(parser, statement);
+}
+
+// DELETE FROM table [WHERE ...]
+int parseDelete(SQLParser* parser, ParsedStatement* statement) {
+    Query* query = &statement->query;
+    
+    if (expectKeyword(parser, "FROM") != 0 ||
+        parseIdentifier(parser, query->table_name, "a table name") != 0) {
+        return -1;
+    }
+    
+    return parseWhereClause(parser, statement);
+}
+
+// Resolve the table and column names of a parsed statement
+// SELECT gets its projection, INSERT and UPDATE the columns their values
+// go to; WHERE columns are bound as for any query. A JOIN's output columns
+// are the first table's followed by the joined table's.
+int resolveStatement(Database* db, ParsedStatement* statement, char* message, size_t size) {
+    Query* query = &statement->query;
+    Table* table = findTable(db, query->table_name);
+    if (!table) {
+        snprintf(message, size, "No such table: %s", query->table_name);
+        return -1;
+    }
+    statement->table_id = table->table_id;
+    
+    Table* joined = NULL;
+    if (query->join_table[0]) {
+        joined = findTable(db, query->join_table);
+        if (!joined) {
+            snprintf(message, size, "No such table: %s", query->join_table);
+            return -1;
+        }
+        statement->join_table_id = joined->table_id;
+        
+        if (bindJoinConditions(db, table, joined, query) != 0) {
+            snprintf(message, size, "Cannot join %s and %s on %s = %s: columns are missing, "
+                     "ambiguous, of different types, or too many", table->name, joined->name,
+                     query->join_columns[0], query->join_columns[1]);
+            return -1;
+        }
+    } else if (bindWhereConditions(table, query) != 0) {
+        snprintf(message, size, "No such column in WHERE on table %s", table->name);
+        return -1;
+    }
+    if (query->sort_column[0] && findOutputColumn(db, query, query->sort_column) < 0) {
+        snprintf(message, size, joined ? "No such column, or ambiguous in the JOIN: %s" : "No such column: %s",
+                 query->sort_column);
+        return -1;
+    }
+    
+    int* targets = query->type == QUERY_SELECT ? statement->projection : statement->value_columns;
+    for (int i = 0; i < query->selected_column_count; i++) {
+        targets[i] = query->type == QUERY_SELECT ? findOutputColumn(db, query, query->selected_columns[i].name) :
+                                                   findColumn(table, query->selected_columns[i].name);
+        if (targets[i] < 0) {
+            snprintf(message, size, joined ? "No such column, or ambiguous in the JOIN: %s" : "No such column: %s",
+                     query->selected_columns[i].name);
+            return -1;
+        }
+    }
+    
+    if (query->type == QUERY_SELECT) {
+        statement->projection_count = query->selected_column_count;
+        if (statement->projection_count == 0) {
+            int column_count = table->column_count + (joined ? joined->column_count : 0);
+            for (int i = 0; i < column_count; i++) {
+                statement->projection[i] = i;
+            }
+            statement->projection_count = column_count;
+        }
+    } else if (query->type == QUERY_INSERT) {
+        // Without a column list the values fill the columns in order
+        int expected = query->selected_column_count ? query->selected_column_count : table->column_count;
+        if (statement->value_count != expected &&
+            (query->selected_column_count || statement->value_count > expected)) {
+            snprintf(message, size, "%d values for %d columns", statement->value_count, expected);
+            return -1;
+        }
+        for (int i = query->selected_column_count; i < statement->value_count; i++) {
+            statement->value_columns[i] = i;
+        }
+    }
+    
+    return 0;
+}
+
+// Parse one statement and resolve it against the schema
+// Returns 0, or -1 with a message in error (256 bytes; may be NULL).
+int parseStatement(Database* db, const char* sql, ParsedStatement* statement, char* error) {
+    SQLParser parser;
+    initParser(&parser, sql);
+    
+    QueryType type = QUERY_SELECT;
+    if (atKeyword(&parser, "SELECT")) {
+        type = QUERY_SELECT;
+    } else if (atKeyword(&parser, "INSERT")) {
+        type = QUERY_INSERT;
+    } else if (atKeyword(&parser, "UPDATE")) {
+        type = QUERY_UPDATE;
+    } else if (atKeyword(&parser, "DELETE")) {
+        type = QUERY_DELETE;
+    } else {
+        parserError(&parser, "SELECT, INSERT, UPDATE or DELETE");
+    }
+    
+    if (!parser.error) {
+        // initQuery() clears the query; the rest of the statement follows it
+        initQuery(&statement->query, type);
+        memset((char*)statement + offsetof(ParsedStatement, table_id), 0,
+               sizeof(ParsedStatement) - offsetof(ParsedStatement, table_id));
+        advanceParser(&parser);
+        
+        switch (type) {
+            case QUERY_SELECT: parseSelect(&parser, statement); break;
+            case QUERY_INSERT: parseInsert(&parser, statement); break;
+            case QUERY_UPDATE: parseUpdate(&parser, statement); break;
+            default: parseDelete(&parser, statement); break;
+        }
+        
+        if (atSymbol(&parser, ";")) {
+            advanceParser(&parser);
+        }
+        if (parser.current_token.type != TOKEN_EOF) {
+            parserError(&parser, "end of statement");
+        }
+    }
+    
+    if (!parser.error && resolveStatement(db, statement, parser.error_message,
+                                          sizeof(parser.error_message)) != 0) {
+        parser.error = 1;
+    }
+    
+    if (parser.error) {
+        if (error) snprintf(error, 256, "%s", parser.error_message);
+        return -1;
+    }
+    return 0;
+}
+
+// =============================================================================
+// PREPARED STATEMENT IMPLEMENTATION
+// =============================================================================
+
+// Normalize SQL text into a plan cache key
+// Whitespace outside string literals collapses to single spaces, and the
+// ends and a trailing ';' are trimmed; the text is not lexed. Returns the
+// length, or -1 if it does not fit in size bytes.
+int normalizeSQL(const char* sql, char* normalized, int size) {
+    int length = 0;
+    int in_string = 0;
+    int pending_space = 0;
+    
+    for (const char* p = sql; *p; p++) {
+        char c = *p;
+        if (!in_string && (c == ' ' || c == '\t' || c == '\n' || c == '\r')) {
+            pending_space = length > 0;
+            continue;
+        }
+        
+        if (length + 3 >= size) {
+            return -1; // Room for a space, an escape pair and the terminator
+        }
+        if (pending_space) {
+            normalized[length++] = ' ';
+            pending_space = 0;
+        }
+        
+        normalized[length++] = c;
+        if (in_string && c == '\\' && p[1]) {
+            normalized[length++] = *++p;
+        } else if (c == '\'') {
+            in_string = !in_string;
+        }
+    }
+    
+    if (!in_string && length > 0 && normalized[length - 1] == ';') {
+        length--;
+        if (length > 0 && normalized[length - 1] == ' ') length--;
+    }
+    
+    normalized[length] = '\0';
+    return length;
+}
+
+// Create an empty plan cache
+PlanCache* initPlanCache() {
+    PlanCache* cache = malloc(sizeof(PlanCache));
+    if (!cache) return NULL;
+    
+    memset(cache, 0, sizeof(PlanCache));
+    pthread_mutex_init(&cache->mutex, NULL);
+    return cache;
+}
+
+// Drop a reference to a cache entry; the last one frees it
+// Called with the cache mutex held.
+void unreferenceCachedStatement(CachedStatement* entry) {
+    if (--entry->references > 0) {
+        return;
+    }
+    
+    freeQueryPlan(entry->plan);
+    free(entry);
+}
+
+// Take an entry out of the cache along with the cache's reference
+// Handles still using it keep it alive.
+void unlinkCachedStatement(PlanCache* cache, CachedStatement* entry) {
+    CachedStatement** link = &cache->buckets[entry->hash & (PLAN_CACHE_BUCKETS - 1)];
+    while (*link != entry) {
+        link = &(*link)->next;
+    }
+    
+    *link = entry->next;
+    cache->entry_count--;
+    unreferenceCachedStatement(entry);
+}
+
+// Free a plan cache and the entries in it
+void freePlanCache(PlanCache* cache) {
+    if (!cache) return;
+    
+    for (int b = 0; b < PLAN_CACHE_BUCKETS; b++) {
+        while (cache->buckets[b]) {
+            unlinkCachedStatement(cache, cache->buckets[b]);
+        }
+    }
+    
+    pthread_mutex_destroy(&cache->mutex);
+    free(cache);
+}
+
+// Check that no DDL touched the schema since an entry was parsed
+int isStatementCurrent(Database* db, CachedStatement* entry) {
+    Table* table = &db->tables[entry->statement.table_id];
+    Table* joined = &db->tables[entry->statement.join_table_id];
+    return entry->schema_version == __atomic_load_n(&db->schema_version, __ATOMIC_ACQUIRE) &&
+           entry->table_version == __atomic_load_n(&table->schema_version, __ATOMIC_ACQUIRE) &&
+           (!entry->statement.query.join_table[0] ||
+            entry->join_table_version == __atomic_load_n(&joined->schema_version, __ATOMIC_ACQUIRE));
+}
+
+// Find the current entry for normalized text, dropping a stale one
+// Called with the cache mutex held; takes a reference for the caller.
+CachedStatement* findCachedStatement(Database* db, const char* sql, unsigned long long hash) {
+    PlanCache* cache = db->plan_cache;
+    
+    for (CachedStatement* entry = cache->buckets[hash & (PLAN_CACHE_BUCKETS - 1)]; entry; entry = entry->next) {
+        if (entry->hash != hash || strcmp(entry->sql, sql) != 0) {
+            continue;
+        }
+        
+        if (!isStatementCurrent(db, entry)) {
+            unlinkCachedStatement(cache, entry);
+            cache->invalidations++;
+            return NULL;
+        }
+        
+        entry->references++;
+        entry->last_used = ++cache->clock;
+        return entry;
+    }
+    
+    return NULL;
+}
+
+// Evict the least recently used entry
+void evictCachedStatement(PlanCache* cache) {
+    CachedStatement* victim = NULL;
+    
+    for (int b = 0; b < PLAN_CACHE_BUCKETS; b++) {
+        for (CachedStatement* entry = cache->buckets[b]; entry; entry = entry->next) {
+            if (!victim || entry->last_used < victim->last_used) {
+                victim = entry;
+            }
+        }
+    }
+    
+    if (victim) {
+        unlinkCachedStatement(cache, victim);
+        cache->evictions++;
+    }
+}
+
+// Look normalized text up in the plan cache, parsing it on a miss
+// Returns the entry with a reference held for the caller, or NULL with a
+// message in error (may be NULL).
+CachedStatement* acquireCachedStatement(Database* db, const char* sql, char* error) {
+    PlanCache* cache = db->plan_cache;
+    unsigned long long hash = hashText((const unsigned char*)sql, (int)strlen(sql));
+    
+    pthread_mutex_lock(&cache->mutex);
+    CachedStatement* entry = findCachedStatement(db, sql, hash);
+    if (entry) {
+        cache->hits++;
+    } else {
+        cache->misses++;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+    
+    if (entry) {
+        return entry;
+    }
+    
+    // Parse outside the latch. The schema version is read first, so DDL that
+    // runs during the parse leaves the entry stale rather than wrong.
+    entry = malloc(sizeof(CachedStatement));
+    if (!entry) {
+        return NULL;
+    }
+    
+    entry->schema_version = __atomic_load_n(&db->schema_version, __ATOMIC_ACQUIRE);
+    if (parseStatement(db, sql, &entry->statement, error) != 0) {
+        free(entry);
+        return NULL;
+    }
+    
+    Table* table = &db->tables[entry->statement.table_id];
+    Table* joined = &db->tables[entry->statement.join_table_id];
+    entry->table_version = __atomic_load_n(&table->schema_version, __ATOMIC_ACQUIRE);
+    entry->join_table_version = __atomic_load_n(&joined->schema_version, __ATOMIC_ACQUIRE);
+    strcpy(entry->sql, sql);
+    entry->hash = hash;
+    entry->plan = NULL;
+    entry->references = 2; // The cache's and the caller's
+    
+    pthread_mutex_lock(&cache->mutex);
+    CachedStatement* existing = findCachedStatement(db, sql, hash);
+    if (existing) {
+        free(entry); // Another thread parsed the same text first
+        entry = existing;
+    } else {
+        if (cache->entry_count >= PLAN_CACHE_CAPACITY) {
+            evictCachedStatement(cache);
+        }
+        
+        CachedStatement** bucket = &cache->buckets[hash & (PLAN_CACHE_BUCKETS - 1)];
+        entry->last_used = ++cache->clock;
+        entry->next = *bucket;
+        *bucket = entry;
+        cache->entry_count++;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+    
+    return entry;
+}
+
+// Give back a reference taken by acquireCachedStatement()
+void releaseCachedStatement(PlanCache* cache, CachedStatement* entry) {
+    pthread_mutex_lock(&cache->mutex);
+    unreferenceCachedStatement(entry);
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+// Copy a plan tree for another query; iterator state is not shared
+QueryPlanNode* clonePlan(QueryPlanNode* node, Query* query) {
+    QueryPlanNode* copy = malloc(sizeof(QueryPlanNode));
+    if (!copy) return NULL;
+    
+    memcpy(copy, node, sizeof(QueryPlanNode));
+    copy->query = query;
+    copy->range.low = NULL; // Ranges point into the query's literals
+    copy->range.high = NULL;
+    copy->sort = NULL;
+    
+    for (int i = 0; i < node->child_count; i++) {
+        copy->children[i] = clonePlan(node->children[i], query);
+        if (!copy->children[i]) {
+            copy->child_count = i;
+            freeQueryPlan(copy);
+            return NULL;
+        }
+    }
+    
+    return copy;
+}
+
+// Prepare a statement with ? placeholders
+// Text seen before skips lexing, parsing and resolution; its plan is reused
+// as well once any handle has executed it. Returns NULL on failure with a
+// message in error (256 bytes; may be NULL).
+PreparedStatement* prepareStatement(Database* db, const char* sql, char* error) {
+    char key[MAX_QUERY_SIZE];
+    
+    if (error) error[0] = '\0';
+    if (!db || !sql || !db->plan_cache) {
+        return NULL;
+    }
+    
+    if (normalizeSQL(sql, key, sizeof(key)) < 0) {
+        if (error) snprintf(error, 256, "Statement longer than %d bytes", MAX_QUERY_SIZE - 1);
+        return NULL;
+    }
+    
+    CachedStatement* cached = acquireCachedStatement(db, key, error);
+    if (!cached) {
+        return NULL;
+    }
+    
+    PreparedStatement* statement = malloc(sizeof(PreparedStatement));
+    if (!statement) {
+        releaseCachedStatement(db->plan_cache, cached);
+        return NULL;
+    }
+    
+    statement->db = db;
+    statement->cached = cached;
+    memcpy(&statement->statement, &cached->statement, sizeof(ParsedStatement));
+    for (int i = 0; i < MAX_PARAMETERS; i++) {
+        statement->parameter_values[i][0] = '\0';
+        statement->parameter_is_null[i] = 1;
+    }
+    statement->transaction_id = 0;
+    statement->plan = NULL;
+    statement->running = 0;
+    statement->implicit_id = 0;
+    statement->row = NULL;
+    statement->last_insert_id = 0;
+    return statement;
+}
+
+// Value slot of the parameter at a 1-based position, or NULL
+char* parameterSlot(PreparedStatement* statement, int position) {
+    if (!statement || position < 1 || position > statement->statement.parameter_count) {
+        return NULL;
+    }
+    
+    statement->parameter_is_null[position - 1] = 0;
+    return statement->parameter_values[position - 1];
+}
+
+// Bind text to a parameter
+int bindText(PreparedStatement* statement, int position, const char* value) {
+    char* slot = value ? parameterSlot(statement, position) : NULL;
+    if (!slot) {
+        return -1;
+    }
+    
+    strncpy(slot, value, MAX_FIELD_SIZE - 1);
+    slot[MAX_FIELD_SIZE - 1] = '\0';
+    return 0;
+}
+
+// Bind an integer to a parameter
+int bindInt(PreparedStatement* statement, int position, int value) {
+    char* slot = parameterSlot(statement, position);
+    if (!slot) {
+        return -1;
+    }
+    
+    snprintf(slot, MAX_FIELD_SIZE, "%d", value);
+    return 0;
+}
+
+// Bind a floating-point number to a parameter
+int bindDouble(PreparedStatement* statement, int position, double value) {
+    char* slot = parameterSlot(statement, position);
+    if (!slot) {
+        return -1;
+    }
+    
+    snprintf(slot, MAX_FIELD_SIZE, "%.17g", value);
+    return 0;
+}
+
+// Bind SQL NULL to a parameter (INSERT and SET values only)
+int bindNull(PreparedStatement* statement, int position) {
+    if (!parameterSlot(statement, position)) {
+        return -1;
+    }
+    
+    statement->parameter_is_null[position - 1] = 1;
+    return 0;
+}
+
+// Run later executions inside an explicit transaction; 0 runs each
+// execution as its own transaction
+int bindTransaction(PreparedStatement* statement, int transaction_id) {
+    if (!statement) {
+        return -1;
+    }
+    
+    statement->transaction_id = transaction_id;
+    return 0;
+}
+
+// Copy the bound values into the statement's query
+// WHERE literals are encoded in their column's format. NULL is accepted
+// only for INSERT and SET values.
+int applyParameters(PreparedStatement* statement, Table* table) {
+    ParsedStatement* parsed = &statement->statement;
+    Query* query = &parsed->query;
+    query->transaction_id = statement->transaction_id;
+    
+    for (int i = 0; i < parsed->parameter_count; i++) {
+        StatementParameter* parameter = &parsed->parameters[i];
+        const char* value = statement->parameter_values[i];
+        int is_null = statement->parameter_is_null[i];
+        
+        if (parameter->kind == PARAMETER_VALUE) {
+            strcpy(parsed->values[parameter->index], value);
+            parsed->value_is_null[parameter->index] = is_null;
+            continue;
+        }
+        
+        if (is_null) {
+            return -1;
+        }
+        
+        if (parameter->kind == PARAMETER_WHERE) {
+            WhereCondition* condition = &query->where_conditions[parameter->index];
+            Table* column_table = condition->join_side ? &statement->db->tables[parsed->join_table_id] : table;
+            strcpy(condition->value, value);
+            condition->value_size = encodeLiteral(&column_table->columns[condition->column_index],
+                                                  condition->value, condition->encoded_value);
+        } else if (parameter->kind == PARAMETER_LIMIT) {
+            query->limit = atoi(value) < 0 ? -1 : atoi(value);
+        } else {
+            query->offset = atoi(value) < 0 ? 0 : atoi(value);
+        }
+    }
+    
+    return 0;
+}
+
+// Give a handle its plan: a clone of the cached one, or a new plan that
+// then becomes the cached one
+// The literals of the first execution choose the plan; later executions
+// keep its shape and only rebuild index ranges from their own values.
+int loadStatementPlan(PreparedStatement* statement, Table* table) {
+    PlanCache* cache = statement->db->plan_cache;
+    CachedStatement* cached = statement->cached;
+    Query* query = &statement->statement.query;
+    
+    pthread_mutex_lock(&cache->mutex);
+    if (cached->plan) {
+        statement->plan = clonePlan(cached->plan, query);
+    }
+    pthread_mutex_unlock(&cache->mutex);
+    
+    if (statement->plan) {
+        return 0;
+    }
+    
+    // Join plans carry per-execution input queries; each handle plans its own
+    QueryOptimizer optimizer;
+    if (query->join_table[0]) {
+        Table* joined = &statement->db->tables[statement->statement.join_table_id];
+        statement->plan = optimizeJoinQuery(statement->db, table, joined, query, &optimizer);
+        return statement->plan ? 0 : -1;
+    }
+    
+    statement->plan = optimizeQuery(statement->db, table, query, &optimizer);
+    if (!statement->plan) {
+        return -1;
+    }
+    
+    pthread_mutex_lock(&cache->mutex);
+    if (!cached->plan) {
+        cached->plan = clonePlan(statement->plan, &cached->statement.query);
+    }
+    pthread_mutex_unlock(&cache->mutex);
+    return 0;
+}
+
+// Parse a handle's text again after DDL made its cache entry stale
+// Bound values are kept.
+int reprepareStatement(PreparedStatement* statement) {
+    CachedStatement* cached = acquireCachedStatement(statement->db, statement->cached->sql, NULL);
+    if (!cached) {
+        return -1;
+    }
+    
+    releaseCachedStatement(statement->db->plan_cache, statement->cached);
+    statement->cached = cached;
+    memcpy(&statement->statement, &cached->statement, sizeof(ParsedStatement));
+    freeQueryPlan(statement->plan);
+    statement->plan = NULL;
+    return 0;
+}
+
+// Insert the row an INSERT statement's values describe
+int insertStatementRow(PreparedStatement* statement, Table* table) {
+    ParsedStatement* parsed = &statement->statement;
+    Record* record = createRecord(table);
+    if (!record) {
+        return -1;
+    }
+    
+    int failed = 0;
+    for (int i = 0; i < parsed->value_count && !failed; i++) {
+        Column* column = &table->columns[parsed->value_columns[i]];
+        
+        if (parsed->value_is_null[i]) {
+            failed = setFieldNull(record, table, column->name) != 0;
+        } else {
+            unsigned char encoded[MAX_FIELD_SIZE];
+            encodeLiteral(column, parsed->values[i], encoded);
+            failed = setFieldValue(record, table, column->name, encoded) != 0;
+        }
+    }
+    
+    int id = failed ? -1 : executeInsertQuery(statement->db, &parsed->query, record);
+    freeRecord(table, record);
+    if (id < 0) {
+        return -1;
+    }
+    
+    statement->last_insert_id = id;
+    return 1;
+}
+
+// Stop a running SELECT and end its implicit transaction; bindings stay
+void resetStatement(PreparedStatement* statement) {
+    if (!statement || !statement->running) {
+        return;
+    }
+    
+    endStatement(statement->db, &statement->statement.query, statement->implicit_id, 0);
+    statement->running = 0;
+    statement->row = NULL;
+}
+
+// Execute a prepared statement with its current bindings
+// SELECT opens its plan and returns 0; stepStatement() then returns the
+// rows. INSERT, UPDATE and DELETE run to completion and return the number
+// of rows written. A handle whose cache entry went stale through DDL is
+// parsed again first. Returns -1 on failure.
+int executeStatement(PreparedStatement* statement) {
+    if (!statement) {
+        return -1;
+    }
+    resetStatement(statement);
+    
+    Database* db = statement->db;
+    if (!isStatementCurrent(db, statement->cached) && reprepareStatement(statement) != 0) {
+        return -1;
+    }
+    
+    ParsedStatement* parsed = &statement->statement;
+    Query* query = &parsed->query;
+    Table* table = &db->tables[parsed->table_id];
+    if (applyParameters(statement, table) != 0) {
+        return -1;
+    }
+    
+    if (query->type == QUERY_INSERT) {
+        return insertStatementRow(statement, table);
+    }
+    
+    if (!statement->plan && loadStatementPlan(statement, table) != 0) {
+        return -1;
+    }
+    refreshPlanRanges(statement->plan);
+    
+    if (query->type == QUERY_UPDATE) {
+        int column_index = parsed->value_columns[0];
+        unsigned char encoded[MAX_FIELD_SIZE];
+        
+        if (parsed->value_is_null[0]) {
+            return table->columns[column_index].is_not_null ? -1 :
+                   updatePlanRows(db, table, query, statement->plan, column_index, NULL);
+        }
+        encodeLiteral(&table->columns[column_index], parsed->values[0], encoded);
+        return updatePlanRows(db, table, query, statement->plan, column_index, encoded);
+    }
+    
+    if (query->type == QUERY_DELETE) {
+        return deletePlanRows(db, table, query, statement->plan);
+    }
+    
+    int implicit_id = beginStatement(db, query);
+    if (implicit_id < 0) {
+        return -1;
+    }
+    if (openPlanNode(statement->plan) != 0) {
+        endStatement(db, query, implicit_id, 1);
+        return -1;
+    }
+    
+    statement->implicit_id = implicit_id;
+    statement->running = 1;
+    return 0;
+}
+
+// Move a running SELECT to its next row
+// Returns 1 with a row, 0 when the rows are exhausted (the statement then
+// ends) and -1 if no SELECT is running.
+int stepStatement(PreparedStatement* statement) {
+    if (!statement || !statement->running) {
+        return -1;
+    }
+    
+    statement->row = nextPlanRow(statement->plan);
+    if (statement->row) {
+        return 1;
+    }
+    
+    resetStatement(statement);
+    return 0;
+}
+
+// Field of the current row in select-list order; NULL for SQL NULL
+// The pointer is valid until the next step and may be unaligned.
+const void* statementColumn(PreparedStatement* statement, int column) {
+    if (!statement || !statement->row || column < 0 || column >= statement->statement.projection_count) {
+        return NULL;
+    }
+    
+    Table* table = statement->plan->table; // The table, or a join's output layout
+    int column_index = statement->statement.projection[column];
+    if (isFieldNull(statement->row, column_index)) {
+        return NULL;
+    }
+    
+    return statement->row + table->column_offsets[column_index];
+}
+
+// Free a prepared statement
+void finalizeStatement(PreparedStatement* statement) {
+    if (!statement) return;
+    
+    resetStatement(statement);
+    freeQueryPlan(statement->plan);
+    releaseCachedStatement(statement->db->plan_cache, statement->cached);
+    free(statement);
+}
+
+// =============================================================================
+// DEMONSTRATION FUNCTIONS
+// =============================================================================
+
+void demonstrateDatabaseBasics() {
+    printf("=== DATABASE BASICS DEMO ===\n");
+    
+    // Initialize database
+    Database* db = malloc(sizeof(Database));
+    if (!db) {
+        printf("Failed to allocate database\n");
+        return;
+    }
+    
+    memset(db, 0, sizeof(Database));
+    strcpy(db->name, "test_db");
+    pthread_mutex_init(&db->mutex, NULL);
+    
+    // Initialize storage
+    db->storage = initStorageManager("./test_db", 4096, 100);
+    if (!db->storage) {
+        printf("Failed to initialize storage\n");
+        free(db);
+        return;
+    }
+    
+    printf("Database initialized: %s\n", db->name);
+    printf("Storage path: %s\n", db->storage->database_path);
+    printf("Page size: %d\n", db->storage->page_size);
+    printf("Cache size: %d\n", db->storage->cache_size);
     
     // Create table
     Column columns[3] = {
-        {"id", DATA_TYPE_INTEGER, sizeof(int), 1, 1, 0, ""},
-        {"name", DATA_TYPE_TEXT, 100, 0, 0, 0, ""},
+        {"id", DATA_TYPE_INTEGER, sizeof(int), 1, 1, 0, ""},
+        {"name", DATA_TYPE_TEXT, 100, 0, 0, 0, ""},
+        {"age", DATA_TYPE_INTEGER, sizeof(int), 0, 0, 0, ""}
+    };
+    
+    if (createTable(db, "users", columns, 3) == 0) {
+        printf("Table 'users' created successfully\n");
+        printf("Columns: %d\n", db->tables[0].column_count);
+        
+        for (int i = 0; i < db->tables[0].column_count; i++) {
+            printf("  %s (%s)\n", db->tables[0].columns[i].name,
+                   db->tables[0].columns[i].type == DATA_TYPE_INTEGER ? "INTEGER" :
+                   db->tables[0].columns[i].type == DATA_TYPE_TEXT ? "TEXT" : "OTHER");
+        }
+    } else {
+        printf("Failed to create table\n");
+    }
+    
+    // Clean up
+    closeStorageManager(db->storage);
+    pthread_mutex_destroy(&db->mutex);
+    free(db);
+}
+
+void demonstrateRecordManagement() {
+    printf("\n=== RECORD MANAGEMENT DEMO ===\n");
+    
+    // Create a test table
+    Table table;
+    memset(&table, 0, sizeof(Table));
+    strcpy(table.name, "test_table");
+    table.column_count = 3;
+    
+    table.columns[0] = (Column){"id", DATA_TYPE_INTEGER, sizeof(int), 1, 1, 0, ""};
+    table.columns[1] = (Column){"name", DATA_TYPE_TEXT, 50, 0, 0, 0, ""};
+    table.columns[2] = (Column){"age", DATA_TYPE_INTEGER, sizeof(int), 0, 0, 0, ""};
+    
+    // Create record
+    Record* record = createRecord(&table);
+    if (record) {
+        printf("Record created with ID: %d\n", record->id);
+        
+        // Set field values
+        int id = record->id;
+        char* name = "John Doe";
+        int age = 25;
+        
+        setFieldValue(record, &table, "id", &id);
+        setFieldValue(record, &table, "name", name);
+        setFieldValue(record, &table, "age", &age);
+        
+        printf("Field values set:\n");
+        printf("  ID: %d\n", *(int*)getFieldValue(record, &table, "id"));
+        printf("  Name: %s\n", (char*)getFieldValue(record, &table, "name"));
+        printf("  Age: %d\n", *(int*)getFieldValue(record, &table, "age"));
+        
+        // Update record
+        setFieldValue(record, &table, "age", &(int){26});
+        printf("Updated age to: %d\n", *(int*)getFieldValue(record, &table, "age"));
+        printf("Updated at: %s", ctime(&record->updated_at));
+        
+        // Free record
+        freeRecord(&table, record);
+    } else {
+        printf("Failed to create record\n");
+    }
+}
+
+void demonstrateIndexing() {
+    printf("\n=== INDEXING DEMO ===\n");
+    
+    removeStorageFiles("./index_db");
+    Database* db = initDatabase("index_db", "./index_db");
+    if (!db) {
+        printf("Failed to initialize database\n");
+        return;
+    }
+    
+    Column columns[3] = {
+        {"id", DATA_TYPE_INTEGER, sizeof(int), 1, 1, 1, ""},
+        {"name", DATA_TYPE_TEXT, 32, 0, 0, 0, ""},
+        {"age", DATA_TYPE_INTEGER, sizeof(int), 0, 0, 0, ""}
+    };
+    createTable(db, "users", columns, 3);
+    Table* table = findTable(db, "users");
+    
+    // Unique index on an empty table is maintained by every INSERT
+    createIndex(table, "idx_id", "id", 1);
+    
+    Query insert;
+    initQuery(&insert, QUERY_INSERT);
+    strcpy(insert.table_name, "users");
+    
+    Record* record = createRecord(table);
+    for (int i = 1; i <= 5000; i++) {
+        char name[32];
+        int age = 18 + i % 60;
+        snprintf(name, sizeof(name), "user_%d", i % 1000);
+        
+        setFieldValue(record, table, "id", &i);
+        setFieldValue(record, table, "name", name);
+        setFieldValue(record, table, "age", &age);
+        executeInsertQuery(db, &insert, record);
+    }
+    
+    Index* id_index = findIndex(table, "idx_id");
+    printf("Inserted %d rows into %d heap pages (%d rows/page)\n",
+           table->record_count, table->heap_page_count, table->rows_per_page);
+    printf("Index 'idx_id': %d keys, height %d, %d pages\n",
+           id_index->key_count, id_index->height, id_index->page_count);
+    
+    // Unique enforcement
+    int duplicate_id = 42;
+    setFieldValue(record, table, "id", &duplicate_id);
+    printf("Insert duplicate id 42: %s\n",
+           executeInsertQuery(db, &insert, record) < 0 ? "rejected" : "accepted");
+    
+    // Bulk build from existing rows
+    if (createIndex(table, "idx_name", "name", 0) == 0) {
+        Index* name_index = findIndex(table, "idx_name");
+        printf("Index 'idx_name' bulk-built: %d keys, height %d, %d pages\n",
+               name_index->key_count, name_index->height, name_index->page_count);
+    }
+    printf("Unique index on duplicated 'name': %s\n",
+           createIndex(table, "idx_name_unique", "name", 1) == 0 ? "created" : "rejected");
+    
+    // Point and range lookups
+    RowId row_ids[16];
+    int found_count = searchIndex(findIndex(table, "idx_name"), "user_42", row_ids, 16);
+    printf("Search for 'user_42' found %d rows:", found_count);
+    for (int i = 0; i < found_count; i++) {
+        printf(" %d", row_ids[i]);
+    }
+    printf("\n");
+    
+    int low = 100, high = 104;
+    found_count = searchIndexRange(id_index, &low, 1, &high, 1, row_ids, 16);
+    printf("Range 100 <= id <= 104 found %d rows\n", found_count);
+    
+    // SELECT uses the name index and filters age on the fetched rows
+    Query select;
+    initQuery(&select, QUERY_SELECT);
+    strcpy(select.table_name, "users");
+    addWhereCondition(&select, "name", OP_EQUAL, "user_42");
+    addWhereCondition(&select, "age", OP_GREATER_THAN, "30");
+    
+    ResultSet* result = executeSelectQuery(db, &select);
+    if (result) {
+        printf("SELECT * FROM users WHERE name = 'user_42' AND age > 30:\n");
+        for (int i = 0; i < result->row_count; i++) {
+            printf("  id %d, name %s, age %d\n", *(int*)result->rows[i][0],
+                   (char*)result->rows[i][1], *(int*)result->rows[i][2]);
+        }
+        freeResultSet(result);
+    }
+    
+    freeRecord(table, record);
+    freeDatabase(db);
+    removeStorageFiles("./index_db");
+}
+
+// Milliseconds of CPU time since start
+double elapsedMilliseconds(clock_t start) {
+    return (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+// Run a SELECT repeatedly; returns average milliseconds and the row count
+double timeSelectQuery(Database* db, Query* query, int repeat, int* row_count) {
+    clock_t start = clock();
+    
+    for (int i = 0; i < repeat; i++) {
+        ResultSet* result = executeSelectQuery(db, query);
+        *row_count = result ? result->row_count : -1;
+        freeResultSet(result);
+    }
+    
+    return elapsedMilliseconds(start) / repeat;
+}
+
+void demonstrateIndexBenchmark() {
+    printf("\n=== B+TREE INDEX BENCHMARK ===\n");
+    
+    const int row_count = 1000000;
+    const int batch_size = 1000;
+    
+    removeStorageFiles("./bench_db");
+    Database* db = initDatabase("bench_db", "./bench_db");
+    if (!db) {
+        printf("Failed to initialize database\n");
+        return;
+    }
+    
+    Column columns[3] = {
+        {"id", DATA_TYPE_INTEGER, sizeof(int), 1, 1, 1, ""},
+        {"name", DATA_TYPE_TEXT, 24, 0, 0, 0, ""},
         {"age", DATA_TYPE_INTEGER, sizeof(int), 0, 0, 0, ""}
     };
+    createTable(db, "customers", columns, 3);
+    Table* table = findTable(db, "customers");
     
-    if (createTable(db, "users", columns, 3) == 0) {
-        printf("Table 'users' created successfully\n");
-        printf("Columns: %d\n", db->tables[0].column_count);
+    // Load the heap in batches, then bulk-build indexes over it
+    Record* batch[1000];
+    for (int i = 0; i < batch_size; i++) {
+        batch[i] = createRecord(table);
+    }
+    
+    clock_t start = clock();
+    for (int loaded = 0; loaded < row_count; loaded += batch_size) {
+        for (int i = 0; i < batch_size; i++) {
+            int id = loaded + i + 1;
+            int age = 18 + (int)((long long)id * 7919 % 80);
+            char name[24];
+            snprintf(name, sizeof(name), "customer_%d", id);
+            
+            setFieldValue(batch[i], table, "id", &id);
+            setFieldValue(batch[i], table, "name", name);
+            setFieldValue(batch[i], table, "age", &age);
+            batch[i]->id = table->next_record_id++;
+        }
+        appendRows(table, batch, batch_size);
+    }
+    printf("Loaded %d rows into %d pages in %.0f ms\n",
+           table->record_count, table->heap_page_count, elapsedMilliseconds(start));
+    
+    for (int i = 0; i < batch_size; i++) {
+        freeRecord(table, batch[i]);
+    }
+    
+    start = clock();
+    createIndex(table, "idx_id", "id", 1);
+    createIndex(table, "idx_age", "age", 0);
+    printf("Bulk-built idx_id (height %d, %d pages) and idx_age (height %d, %d pages) in %.0f ms\n",
+           table->indexes[0].height, table->indexes[0].page_count,
+           table->indexes[1].height, table->indexes[1].page_count, elapsedMilliseconds(start));
+    
+    // Each query runs with its index and then as a forced full scan
+    struct {
+        const char* label;
+        int condition_count;
+        const char* columns[2];
+        Operator operators[2];
+        const char* values[2];
+    } benchmarks[] = {
+        {"id = 777777", 1, {"id"}, {OP_EQUAL}, {"777777"}},
+        {"id BETWEEN 500000 AND 500099", 2, {"id", "id"},
+         {OP_GREATER_EQUAL, OP_LESS_EQUAL}, {"500000", "500099"}},
+        {"id > 995000", 1, {"id"}, {OP_GREATER_THAN}, {"995000"}},
+        {"age = 42 AND id <= 100000", 2, {"age", "id"},
+         {OP_EQUAL, OP_LESS_EQUAL}, {"42", "100000"}}
+    };
+    
+    printf("%-30s %6s %12s %12s %9s\n", "WHERE", "rows", "index ms", "scan ms", "speedup");
+    for (int b = 0; b < 4; b++) {
+        Query query;
+        initQuery(&query, QUERY_SELECT);
+        strcpy(query.table_name, "customers");
+        for (int c = 0; c < benchmarks[b].condition_count; c++) {
+            addWhereCondition(&query, benchmarks[b].columns[c],
+                              benchmarks[b].operators[c], benchmarks[b].values[c]);
+        }
         
-        for (int i = 0; i < db->tables[0].column_count; i++) {
-            printf("  %s (%s)\n", db->tables[0].columns[i].name,
-                   db->tables[0].columns[i].type == DATA_TYPE_INTEGER ? "INTEGER" :
-                   db->tables[0].columns[i].type == DATA_TYPE_TEXT ? "TEXT" : "OTHER");
+        int indexed_rows, scanned_rows;
+        query.use_indexes = USE_INDEXES_ALWAYS;
+        double indexed_ms = timeSelectQuery(db, &query, 100, &indexed_rows);
+        query.use_indexes = USE_INDEXES_NEVER;
+        double scan_ms = timeSelectQuery(db, &query, 3, &scanned_rows);
+        
+        printf("%-30s %6d %12.3f %12.2f %8.0fx%s\n", benchmarks[b].label, indexed_rows,
+               indexed_ms, scan_ms, indexed_ms > 0 ? scan_ms / indexed_ms : 0.0,
+               indexed_rows == scanned_rows ? "" : "  (row count mismatch!)");
+    }
+    
+    freeDatabase(db);
+    removeStorageFiles("./bench_db");
+}
+
+// Pick the next page for the buffer pool workload
+// 10% of accesses sweep the working set sequentially (a scan); the rest go
+// 80% to a hot fifth of the pages and 20% anywhere in the working set.
+int nextWorkloadPage(int access, int working_pages, int* scan_position) {
+    if (access % 10 == 0) {
+        *scan_position = (*scan_position + 1) % working_pages;
+        return *scan_position;
+    }
+    
+    int hot_pages = working_pages / 5 > 0 ? working_pages / 5 : 1;
+    return rand() % 100 < 80 ? rand() % hot_pages : rand() % working_pages;
+}
+
+void demonstrateBufferPool() {
+    printf("\n=== BUFFER POOL DEMO ===\n");
+    
+    const int pool_frames = 256;
+    const int accesses = 200000;
+    const int file_pages = 4 * pool_frames;
+    
+    // Create the pages on disk without a cache
+    removeStorageFiles("./pool_db");
+    StorageManager* storage = initStorageManager("./pool_db", PAGE_DATA_SIZE, 0);
+    if (!storage || !storage->data_file) {
+        printf("Failed to initialize storage\n");
+        closeStorageManager(storage);
+        return;
+    }
+    
+    Page page;
+    for (int i = 0; i < file_pages; i++) {
+        allocatePage(storage, PAGE_TYPE_DATA, &page);
+        writePage(storage, page.page_id, &page);
+    }
+    printf("Data file: %d pages, buffer pool: %d frames\n", file_pages, pool_frames);
+    
+    // Pin a page, modify it in place and let the background writer persist it
+    BufferPool* pool = initBufferPool(storage, pool_frames, EVICTION_CLOCK, 10);
+    Page* pinned = pinPage(pool, 7);
+    pinned->record_count = 42;
+    unpinPage(pool, 7, 1);
+    
+    pthread_mutex_lock(&pool->mutex);
+    printf("Page 7 modified while pinned: %d dirty frame(s)\n", pool->dirty_count);
+    pthread_mutex_unlock(&pool->mutex);
+    
+    usleep(50000);
+    diskReadPage(storage, 7, &page);
+    
+    pthread_mutex_lock(&pool->mutex);
+    printf("After background write-back: %d dirty, on-disk record_count = %d\n",
+           pool->dirty_count, page.record_count);
+    pthread_mutex_unlock(&pool->mutex);
+    freeBufferPool(pool);
+    
+    // Baseline: every read goes to the file
+    srand(42);
+    int scan_position = 0;
+    clock_t start = clock();
+    for (int a = 0; a < accesses; a++) {
+        readPage(storage, nextWorkloadPage(a, file_pages, &scan_position), &page);
+    }
+    printf("%-6s %-8s %9s %9s %13s %11s\n", "Policy", "Working", "Hit rate", "Misses", "Accesses/sec", "Write-backs");
+    printf("%-6s %-8s %9s %9d %13.0f %11s\n", "none", "4.0x", "-", accesses,
+           accesses / (elapsedMilliseconds(start) / 1000.0), "-");
+    
+    // Clock and LRU-2 at working sets of half, equal and four times the pool
+    EvictionPolicy policies[] = {EVICTION_CLOCK, EVICTION_LRU_K};
+    const char* policy_names[] = {"clock", "LRU-2"};
+    double scales[] = {0.5, 1.0, 4.0};
+    
+    for (int p = 0; p < 2; p++) {
+        for (int w = 0; w < 3; w++) {
+            int working_pages = (int)(pool_frames * scales[w]);
+            
+            pool = initBufferPool(storage, pool_frames, policies[p], 10);
+            storage->page_cache = pool;
+            storage->cache_enabled = 1;
+            
+            // Warm the pool with one pass, then measure
+            for (int i = 0; i < working_pages; i++) {
+                readPage(storage, i, &page);
+            }
+            resetBufferPoolStats(pool);
+            
+            srand(42);
+            scan_position = 0;
+            start = clock();
+            for (int a = 0; a < accesses; a++) {
+                int page_id = nextWorkloadPage(a, working_pages, &scan_position);
+                
+                if (a % 20 == 1) {
+                    // 5% of accesses update the page in place
+                    Page* frame_page = pinPage(pool, page_id);
+                    if (frame_page) {
+                        frame_page->record_count++;
+                        unpinPage(pool, page_id, 1);
+                    }
+                } else {
+                    readPage(storage, page_id, &page);
+                }
+            }
+            double seconds = elapsedMilliseconds(start) / 1000.0;
+            
+            pthread_mutex_lock(&pool->mutex);
+            long long write_backs = pool->dirty_evictions + pool->background_writes;
+            pthread_mutex_unlock(&pool->mutex);
+            
+            char working[16];
+            snprintf(working, sizeof(working), "%.1fx", scales[w]);
+            printf("%-6s %-8s %8.1f%% %9lld %13.0f %11lld\n", policy_names[p], working,
+                   bufferPoolHitRate(pool) * 100.0, pool->misses, accesses / seconds, write_backs);
+            
+            storage->page_cache = NULL;
+            storage->cache_enabled = 0;
+            freeBufferPool(pool);
         }
-    } else {
-        printf("Failed to create table\n");
     }
     
-    // Clean up
-    free(db->storage);
-    pthread_mutex_destroy(&db->mutex);
-    free(db);
+    closeStorageManager(storage);
+    removeStorageFiles("./pool_db");
 }
 
-void demonstrateRecordManagement() {
-    printf("\n=== RECORD MANAGEMENT DEMO ===\n");
+// Run a COUNT query repeatedly; returns average milliseconds and the count
+double timeCountQuery(Database* db, Query* query, int repeat, int* row_count) {
+    clock_t start = clock();
     
-    // Create a test table
-    Table table;
-    memset(&table, 0, sizeof(Table));
-    strcpy(table.name, "test_table");
-    table.column_count = 3;
+    for (int i = 0; i < repeat; i++) {
+        *row_count = executeCountQuery(db, query);
+    }
     
-    table.columns[0] = (Column){"id", DATA_TYPE_INTEGER, sizeof(int), 1, 1, 0, ""};
-    table.columns[1] = (Column){"name", DATA_TYPE_TEXT, 50, 0, 0, 0, ""};
-    table.columns[2] = (Column){"age", DATA_TYPE_INTEGER, sizeof(int), 0, 0, 0, ""};
+    return elapsedMilliseconds(start) / repeat;
+}
+
+void demonstrateQueryPlanner() {
+    printf("\n=== COST-BASED QUERY PLANNER DEMO ===\n");
     
-    // Create record
-    Record* record = createRecord(&table);
-    if (record) {
-        printf("Record created with ID: %d\n", record->id);
+    const int row_count = 300000;
+    const int batch_size = 1000;
+    
+    removeStorageFiles("./plan_db");
+    Database* db = initDatabase("plan_db", "./plan_db");
+    if (!db) {
+        printf("Failed to initialize database\n");
+        return;
+    }
+    
+    Column columns[3] = {
+        {"id", DATA_TYPE_INTEGER, sizeof(int), 1, 1, 1, ""},
+        {"name", DATA_TYPE_TEXT, 24, 0, 0, 0, ""},
+        {"age", DATA_TYPE_INTEGER, sizeof(int), 0, 0, 0, ""}
+    };
+    createTable(db, "people", columns, 3);
+    Table* table = findTable(db, "people");
+    
+    // id follows insertion order; age is random, so its index is uncorrelated
+    Record* batch[1000];
+    for (int i = 0; i < batch_size; i++) {
+        batch[i] = createRecord(table);
+    }
+    
+    srand(7);
+    for (int loaded = 0; loaded < row_count; loaded += batch_size) {
+        for (int i = 0; i < batch_size; i++) {
+            int id = loaded + i + 1;
+            int age = 18 + rand() % 80;
+            char name[24];
+            snprintf(name, sizeof(name), "person_%d", id % 50000);
+            
+            setFieldValue(batch[i], table, "id", &id);
+            setFieldValue(batch[i], table, "name", name);
+            setFieldValue(batch[i], table, "age", &age);
+            batch[i]->id = table->next_record_id++;
+        }
+        appendRows(table, batch, batch_size);
+    }
+    
+    for (int i = 0; i < batch_size; i++) {
+        freeRecord(table, batch[i]);
+    }
+    
+    createIndex(table, "idx_id", "id", 1);
+    createIndex(table, "idx_age", "age", 0);
+    
+    clock_t start = clock();
+    analyzeTable(table);
+    printf("Analyzed %d rows in %d pages in %.0f ms\n",
+           table->statistics.row_count, table->statistics.page_count, elapsedMilliseconds(start));
+    for (int c = 0; c < table->column_count; c++) {
+        ColumnStatistics* stats = &table->statistics.columns[c];
+        printf("  %-5s distinct=%-7d correlation=%5.2f", table->columns[c].name,
+               stats->distinct_count, stats->correlation);
+        if (stats->has_histogram) {
+            printf("  range=[%.0f, %.0f]", stats->histogram[0], stats->histogram[HISTOGRAM_BUCKETS]);
+        }
+        printf("\n");
+    }
+    
+    // Each query runs with the planner's choice and with the other access
+    // path forced, to check that the cheaper estimate is also faster
+    struct {
+        const char* label;
+        int condition_count;
+        const char* columns[2];
+        Operator operators[2];
+        const char* values[2];
+    } queries[] = {
+        {"id = 123456", 1, {"id"}, {OP_EQUAL}, {"123456"}},
+        {"id BETWEEN 1000 AND 61000", 2, {"id", "id"},
+         {OP_GREATER_EQUAL, OP_LESS_EQUAL}, {"1000", "61000"}},
+        {"age = 42 AND name = 'person_7'", 2, {"age", "name"},
+         {OP_EQUAL, OP_EQUAL}, {"42", "person_7"}},
+        {"age < 20", 1, {"age"}, {OP_LESS_THAN}, {"20"}},
+        {"age >= 30", 1, {"age"}, {OP_GREATER_EQUAL}, {"30"}}
+    };
+    int query_count = sizeof(queries) / sizeof(queries[0]);
+    
+    printf("\n%-32s %-12s %9s %8s %10s %10s\n",
+           "WHERE", "plan", "estimated", "actual", "chosen ms", "other ms");
+    for (int q = 0; q < query_count; q++) {
+        Query query;
+        initQuery(&query, QUERY_SELECT);
+        strcpy(query.table_name, "people");
+        for (int c = 0; c < queries[q].condition_count; c++) {
+            addWhereCondition(&query, queries[q].columns[c],
+                              queries[q].operators[c], queries[q].values[c]);
+        }
         
-        // Set field values
-        int id = record->id;
-        char* name = "John Doe";
-        int age = 25;
+        QueryOptimizer optimizer;
+        bindWhereConditions(table, &query);
+        QueryPlanNode* plan = optimizeQuery(db, table, &query, &optimizer);
+        int used_index = plan->node_type == PLAN_INDEX_SCAN;
+        int estimated = plan->estimated_rows;
+        freeQueryPlan(plan);
         
-        setFieldValue(record, &table, "id", &id);
-        setFieldValue(record, &table, "name", name);
-        setFieldValue(record, &table, "age", &age);
+        int chosen_rows, other_rows;
+        double chosen_ms = timeCountQuery(db, &query, 5, &chosen_rows);
+        query.use_indexes = used_index ? USE_INDEXES_NEVER : USE_INDEXES_ALWAYS;
+        double other_ms = timeCountQuery(db, &query, 5, &other_rows);
         
-        printf("Field values set:\n");
-        printf("  ID: %d\n", *(int*)getFieldValue(record, &table, "id"));
-        printf("  Name: %s\n", (char*)getFieldValue(record, &table, "name"));
-        printf("  Age: %d\n", *(int*)getFieldValue(record, &table, "age"));
+        printf("%-32s %-12s %9d %8d %10.2f %10.2f%s\n", queries[q].label,
+               used_index ? "index scan" : "seq scan", estimated, chosen_rows, chosen_ms, other_ms,
+               chosen_rows == other_rows ? "" : "  (row count mismatch!)");
+    }
+    
+    // EXPLAIN ANALYZE for a query that needs the whole pipeline
+    Query query;
+    initQuery(&query, QUERY_SELECT);
+    strcpy(query.table_name, "people");
+    addWhereCondition(&query, "id", OP_LESS_EQUAL, "5000");
+    addWhereCondition(&query, "age", OP_GREATER_EQUAL, "90");
+    strcpy(query.sort_column, "age");
+    query.sort_ascending = 0;
+    query.limit = 5;
+    
+    char explain[2048];
+    if (explainQuery(db, &query, 1, explain, sizeof(explain)) == 0) {
+        printf("\nEXPLAIN ANALYZE SELECT * FROM people WHERE id <= 5000 AND age >= 90\n"
+               "                ORDER BY age DESC LIMIT 5\n%s", explain);
+    }
+    
+    // An ascending scan of the sort column's index makes the SORT unnecessary
+    initQuery(&query, QUERY_SELECT);
+    strcpy(query.table_name, "people");
+    addWhereCondition(&query, "id", OP_GREATER_THAN, "299990");
+    strcpy(query.sort_column, "id");
+    query.sort_ascending = 1;
+    
+    if (explainQuery(db, &query, 1, explain, sizeof(explain)) == 0) {
+        printf("\nEXPLAIN ANALYZE SELECT * FROM people WHERE id > 299990 ORDER BY id\n%s", explain);
+    }
+    
+    freeDatabase(db);
+    removeStorageFiles("./plan_db");
+}
+
+// Run an aggregate query repeatedly; returns average milliseconds
+double timeAggregateQuery(Database* db, Query* query, const char* column_name, int repeat,
+                          AggregateResult* result) {
+    clock_t start = clock();
+    
+    for (int i = 0; i < repeat; i++) {
+        executeAggregateQuery(db, query, column_name, result);
+    }
+    
+    return elapsedMilliseconds(start) / repeat;
+}
+
+void demonstrateColumnStore() {
+    printf("\n=== COLUMN STORE AND VECTORIZED SCAN DEMO ===\n");
+    
+    const int row_count = 10000000;
+    const int batch_size = 1000;
+    
+    removeStorageFiles("./column_db");
+    Database* db = initDatabase("column_db", "./column_db");
+    if (!db) {
+        printf("Failed to initialize database\n");
+        return;
+    }
+    
+    Column columns[5] = {
+        {"id", DATA_TYPE_INTEGER, sizeof(int), 1, 1, 1, ""},
+        {"category", DATA_TYPE_INTEGER, sizeof(int), 0, 1, 0, ""},
+        {"quantity", DATA_TYPE_INTEGER, sizeof(int), 0, 1, 0, ""},
+        {"price", DATA_TYPE_FLOAT, sizeof(double), 0, 0, 0, ""},
+        {"region", DATA_TYPE_TEXT, 12, 0, 0, 0, ""}
+    };
+    createTable(db, "sales", columns, 5);
+    Table* table = findTable(db, "sales");
+    
+    Record* batch[1000];
+    for (int i = 0; i < batch_size; i++) {
+        batch[i] = createRecord(table);
+    }
+    
+    // Every 100th price is NULL
+    const char* regions[4] = {"north", "south", "east", "west"};
+    clock_t start = clock();
+    srand(11);
+    for (int loaded = 0; loaded < row_count; loaded += batch_size) {
+        for (int i = 0; i < batch_size; i++) {
+            int id = loaded + i + 1;
+            int category = rand() % 100;
+            int quantity = 1 + rand() % 100;
+            double price = (rand() % 100000) / 100.0;
+            
+            setFieldValue(batch[i], table, "id", &id);
+            setFieldValue(batch[i], table, "category", &category);
+            setFieldValue(batch[i], table, "quantity", &quantity);
+            if (id % 100 == 0) {
+                setFieldNull(batch[i], table, "price");
+            } else {
+                setFieldValue(batch[i], table, "price", &price);
+            }
+            setFieldValue(batch[i], table, "region", regions[rand() % 4]);
+            batch[i]->id = table->next_record_id++;
+        }
+        appendRows(table, batch, batch_size);
+    }
+    printf("Loaded %d rows into %d heap pages in %.0f ms\n",
+           table->record_count, table->heap_page_count, elapsedMilliseconds(start));
+    
+    for (int i = 0; i < batch_size; i++) {
+        freeRecord(table, batch[i]);
+    }
+    
+    start = clock();
+    enableColumnStore(table);
+    printf("Built column store (%d rows, %.0f MB) in %.0f ms\n", table->column_store->row_count,
+           (double)table->column_store->capacity * (table->row_size - ROW_HEADER_SIZE) / (1024 * 1024),
+           elapsedMilliseconds(start));
+    
+    // Each query runs over the heap rows and over the column store
+    struct {
+        const char* label;
+        const char* aggregate; // Column to aggregate; NULL for COUNT(*)
+        int condition_count;
+        const char* columns[3];
+        Operator operators[3];
+        const char* values[3];
+    } queries[] = {
+        {"COUNT(*) WHERE category = 7", NULL, 1, {"category"}, {OP_EQUAL}, {"7"}},
+        {"SUM(price) WHERE quantity > 50", "price", 1, {"quantity"}, {OP_GREATER_THAN}, {"50"}},
+        {"SUM(quantity) WHERE category < 10 AND price >= 500", "quantity", 2,
+         {"category", "price"}, {OP_LESS_THAN, OP_GREATER_EQUAL}, {"10", "500"}},
+        {"COUNT(price), MAX(price)", "price", 0, {NULL}, {OP_EQUAL}, {NULL}},
+        {"COUNT(*) WHERE region = 'east' AND quantity <= 5", NULL, 2,
+         {"region", "quantity"}, {OP_EQUAL, OP_LESS_EQUAL}, {"east", "5"}}
+    };
+    int query_count = sizeof(queries) / sizeof(queries[0]);
+    
+    printf("\n%-52s %10s %10s %8s  %s\n", "Query", "rows ms", "column ms", "speedup", "result");
+    for (int q = 0; q < query_count; q++) {
+        Query query;
+        initQuery(&query, QUERY_SELECT);
+        strcpy(query.table_name, "sales");
+        for (int c = 0; c < queries[q].condition_count; c++) {
+            addWhereCondition(&query, queries[q].columns[c], queries[q].operators[c], queries[q].values[c]);
+        }
         
-        // Update record
-        time_t now = time(NULL);
-        setFieldValue(record, &table, "age", &(int){26});
-        printf("Updated age to: %d\n", *(int*)getFieldValue(record, &table, "age"));
-        printf("Updated at: %s", ctime(&record->updated_at));
+        AggregateResult row_result, column_result;
+        query.use_column_store = 0;
+        double row_ms = timeAggregateQuery(db, &query, queries[q].aggregate, 1, &row_result);
+        query.use_column_store = 1;
+        double column_ms = timeAggregateQuery(db, &query, queries[q].aggregate, 5, &column_result);
         
-        // Free record
-        freeRecord(&table, record);
-    } else {
-        printf("Failed to create record\n");
+        char result_text[64];
+        if (q == 3) {
+            snprintf(result_text, sizeof(result_text), "%lld, %.2f", column_result.count, column_result.max);
+        } else if (queries[q].aggregate) {
+            snprintf(result_text, sizeof(result_text), "%.2f", column_result.sum);
+        } else {
+            snprintf(result_text, sizeof(result_text), "%lld", column_result.rows);
+        }
+        
+        int same = row_result.rows == column_result.rows && row_result.count == column_result.count &&
+                   row_result.sum == column_result.sum && row_result.max == column_result.max;
+        printf("%-52s %10.1f %10.1f %7.0fx  %s%s\n", queries[q].label, row_ms, column_ms,
+               column_ms > 0 ? row_ms / column_ms : 0.0, result_text, same ? "" : "  (mismatch!)");
+    }
+    
+    // A filter query returns rows, so the column scan rebuilds each match
+    Query query;
+    initQuery(&query, QUERY_SELECT);
+    strcpy(query.table_name, "sales");
+    addWhereCondition(&query, "category", OP_EQUAL, "3");
+    addWhereCondition(&query, "quantity", OP_EQUAL, "99");
+    addWhereCondition(&query, "region", OP_EQUAL, "north");
+    
+    int row_rows, column_rows;
+    query.use_column_store = 0;
+    double row_ms = timeSelectQuery(db, &query, 1, &row_rows);
+    query.use_column_store = 1;
+    double column_ms = timeSelectQuery(db, &query, 5, &column_rows);
+    printf("%-52s %10.1f %10.1f %7.0fx  %d rows%s\n", "SELECT * WHERE category = 3 AND quantity = 99 ...",
+           row_ms, column_ms, column_ms > 0 ? row_ms / column_ms : 0.0, column_rows,
+           row_rows == column_rows ? "" : "  (mismatch!)");
+    
+    char explain[1024];
+    if (explainQuery(db, &query, 0, explain, sizeof(explain)) == 0) {
+        printf("\nEXPLAIN SELECT * FROM sales WHERE category = 3 AND quantity = 99 AND region = 'north'\n%s",
+               explain);
     }
+    
+    freeDatabase(db);
+    removeStorageFiles("./column_db");
 }
 
-void demonstrateIndexing() {
-    printf("\n=== INDEXING DEMO ===\n");
+void demonstrateQueryProcessing() {
+    printf("\n=== QUERY PROCESSING DEMO ===\n");
     
-    // Create a test table with records
-    Table table;
-    memset(&table, 0, sizeof(Table));
-    strcpy(table.name, "test_table");
-    table.column_count = 2;
-    table.record_count = 5;
+    // Create a test query
+    Query query;
+    initQuery(&query, QUERY_SELECT);
     
-    table.columns[0] = (Column){"id", DATA_TYPE_INTEGER, sizeof(int), 1, 1, 0, ""};
-    table.columns[1] = (Column){"name", DATA_TYPE_TEXT, 50, 0, 0, 0, ""};
+    strcpy(query.table_name, "users");
+    
+    // Add selected columns
+    addSelectedColumn(&query, "id");
+    addSelectedColumn(&query, "name");
+    addSelectedColumn(&query, "age");
+    
+    // Add WHERE conditions
+    addWhereCondition(&query, "age", OP_GREATER_THAN, "18");
+    addWhereCondition(&query, "name", OP_EQUAL, "John");
+    
+    // Set limit and offset
+    query.limit = 10;
+    query.offset = 0;
+    
+    printf("Query created:\n");
+    printf("Type: SELECT\n");
+    printf("Table: %s\n", query.table_name);
+    printf("Selected columns: %d\n", query.selected_column_count);
+    for (int i = 0; i < query.selected_column_count; i++) {
+        printf("  %s\n", query.selected_columns[i].name);
+    }
+    printf("WHERE conditions: %d\n", query.where_condition_count);
+    for (int i = 0; i < query.where_condition_count; i++) {
+        printf("  %s %s %s\n", query.where_conditions[i].column_name,
+               operatorSymbol(query.where_conditions[i].operator),
+               query.where_conditions[i].value);
+    }
+    printf("Limit: %d\n", query.limit);
+    printf("Offset: %d\n", query.offset);
+}
+
+// Read one account's balance; transaction_id 0 reads in a transaction of its own
+int readBalance(Database* db, int transaction_id, int account_id) {
+    char key[32];
+    Query query;
+    initQuery(&query, QUERY_SELECT);
+    strcpy(query.table_name, "accounts");
+    addSelectedColumn(&query, "balance");
+    snprintf(key, sizeof(key), "%d", account_id);
+    addWhereCondition(&query, "id", OP_EQUAL, key);
+    query.transaction_id = transaction_id;
+    
+    ResultSet* result = executeSelectQuery(db, &query);
+    int balance = result && result->row_count > 0 ? *(int*)result->rows[0][0] : -1;
+    freeResultSet(result);
+    return balance;
+}
+
+// Set one account's balance; returns the rows updated or -1
+int writeBalance(Database* db, int transaction_id, int account_id, int balance) {
+    char key[32], value[32];
+    Query query;
+    initQuery(&query, QUERY_UPDATE);
+    strcpy(query.table_name, "accounts");
+    snprintf(key, sizeof(key), "%d", account_id);
+    snprintf(value, sizeof(value), "%d", balance);
+    addWhereCondition(&query, "id", OP_EQUAL, key);
+    query.transaction_id = transaction_id;
+    
+    return executeUpdateQuery(db, &query, "balance", value);
+}
+
+// Count accounts visible to a transaction (0 = a transaction of its own)
+int countAccounts(Database* db, int transaction_id) {
+    Query query;
+    initQuery(&query, QUERY_SELECT);
+    strcpy(query.table_name, "accounts");
+    query.transaction_id = transaction_id;
+    return executeCountQuery(db, &query);
+}
+
+// Create the accounts table used by the transaction demos
+// Rows are bulk-loaded, so they are visible to every snapshot.
+Table* createAccountsTable(Database* db, int account_count) {
+    Column columns[3] = {
+        {"id", DATA_TYPE_INTEGER, sizeof(int), 1, 1, 1, ""},
+        {"owner", DATA_TYPE_TEXT, 32, 0, 1, 0, ""},
+        {"balance", DATA_TYPE_INTEGER, sizeof(int), 0, 1, 0, ""}
+    };
+    if (createTable(db, "accounts", columns, 3) != 0) {
+        return NULL;
+    }
+    
+    Table* table = findTable(db, "accounts");
+    Record* record = createRecord(table);
+    for (int i = 1; i <= account_count; i++) {
+        char owner[32];
+        int balance = 100;
+        snprintf(owner, sizeof(owner), "owner%d", i);
+        setFieldValue(record, table, "id", &i);
+        setFieldValue(record, table, "owner", owner);
+        setFieldValue(record, table, "balance", &balance);
+        record->id = table->next_record_id++;
+        appendRows(table, &record, 1);
+    }
+    freeRecord(table, record);
+    
+    createIndex(table, "idx_accounts_id", "id", 1);
+    analyzeTable(table);
+    return table;
+}
+
+void demonstrateTransactions() {
+    printf("\n=== MVCC TRANSACTIONS DEMO ===\n");
+    
+    removeStorageFiles("./mvcc_db");
+    Database* db = initDatabase("mvcc_db", "./mvcc_db");
+    if (!db) {
+        printf("Failed to initialize database\n");
+        return;
+    }
+    
+    Table* table = createAccountsTable(db, 5);
+    if (!table) {
+        printf("Failed to create accounts table\n");
+        freeDatabase(db);
+        return;
+    }
+    TransactionManager* manager = db->transaction_manager;
+    printf("Created accounts 1-5 with balance 100\n");
+    
+    // A snapshot keeps reading the database as of its first statement
+    int reader = beginTransaction(db);
+    printf("\nT%d reads account 1: %d\n", reader, readBalance(db, reader, 1));
+    writeBalance(db, 0, 1, 150);
+    printf("Autocommit UPDATE sets account 1 to 150\n");
+    printf("T%d reads account 1 again: %d (its snapshot)\n", reader, readBalance(db, reader, 1));
+    printf("A new statement reads account 1: %d\n", readBalance(db, 0, 1));
+    commitTransaction(db, reader);
+    
+    // Two writers of one row: the first to commit wins
+    int first = beginTransaction(db);
+    int second = beginTransaction(db);
+    writeBalance(db, first, 2, 250);
+    writeBalance(db, second, 2, 300);
+    printf("\nT%d and T%d both update account 2 (250 and 300)\n", first, second);
+    printf("T%d commit: %s\n", first, commitTransaction(db, first) == 0 ? "ok" : "conflict");
+    printf("T%d commit: %s\n", second, commitTransaction(db, second) == 0 ? "ok" : "conflict, rolled back");
+    printf("Account 2 is now %d\n", readBalance(db, 0, 2));
+    
+    // Uncommitted deletes are private until commit
+    int deleter = beginTransaction(db);
+    Query query;
+    initQuery(&query, QUERY_DELETE);
+    strcpy(query.table_name, "accounts");
+    addWhereCondition(&query, "id", OP_GREATER_EQUAL, "4");
+    query.transaction_id = deleter;
+    int deleted = executeDeleteQuery(db, &query);
+    printf("\nT%d deletes %d accounts: it sees %d, others see %d\n", deleter, deleted,
+           countAccounts(db, deleter), countAccounts(db, 0));
+    rollbackTransaction(db, deleter);
+    printf("After rollback everyone sees %d\n", countAccounts(db, 0));
+    
+    // Unique keys are checked against current versions
+    Record* record = createRecord(table);
+    int duplicate_id = 1;
+    setFieldValue(record, table, "id", &duplicate_id);
+    setFieldValue(record, table, "owner", "duplicate");
+    initQuery(&query, QUERY_INSERT);
+    strcpy(query.table_name, "accounts");
+    printf("\nINSERT with an existing id: %s\n",
+           executeInsertQuery(db, &query, record) < 0 ? "rejected (unique index)" : "accepted");
+    freeRecord(table, record);
+    
+    // Old versions wait for every snapshot that could read them to finish
+    printf("\nHeap rows: %d, versions waiting for GC: %d\n", table->heap_row_count, manager->garbage_count);
+    int reclaimed = collectGarbage(db);
+    printf("collectGarbage() reclaimed %d versions; %d slots free for reuse\n",
+           reclaimed, table->free_row_count);
+    writeBalance(db, 0, 3, 175);
+    printf("UPDATE of account 3 reused a slot: heap rows still %d\n", table->heap_row_count);
+    printf("Commits: %lld, conflicts: %lld, rollbacks: %lld\n",
+           manager->commits, manager->conflicts, manager->rollbacks);
+    
+    freeDatabase(db);
+    removeStorageFiles("./mvcc_db");
+}
+
+// Current time in milliseconds on a monotonic clock
+double monotonicMilliseconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+}
+
+// One thread of the mixed read/write benchmark
+typedef struct {
+    Database* db;
+    int account_count;
+    int read_percent;
+    pthread_mutex_t* global_lock; // Non-NULL: serialize every operation
+    int* stop;
+    unsigned int seed;
+    long long reads;
+    long long updates;
+    long long aborts;
+} BenchmarkWorker;
+
+// Run point reads and single-row updates until told to stop
+void* runBenchmarkWorker(void* arg) {
+    BenchmarkWorker* worker = (BenchmarkWorker*)arg;
+    
+    while (!__atomic_load_n(worker->stop, __ATOMIC_ACQUIRE)) {
+        int account = 1 + rand_r(&worker->seed) % worker->account_count;
+        int is_read = rand_r(&worker->seed) % 100 < worker->read_percent;
+        
+        if (worker->global_lock) pthread_mutex_lock(worker->global_lock);
+        if (is_read) {
+            readBalance(worker->db, 0, account);
+            worker->reads++;
+        } else if (writeBalance(worker->db, 0, account, rand_r(&worker->seed) % 1000) == 1) {
+            worker->updates++;
+        } else {
+            worker->aborts++;
+        }
+        if (worker->global_lock) pthread_mutex_unlock(worker->global_lock);
+    }
+    
+    return NULL;
+}
+
+// Run the benchmark for duration_ms on thread_count threads; returns ops/sec
+double runMixedBenchmark(Database* db, int account_count, int thread_count, int read_percent,
+                         int serialized, int duration_ms, long long* aborts) {
+    pthread_t threads[32];
+    BenchmarkWorker workers[32];
+    pthread_mutex_t global_lock = PTHREAD_MUTEX_INITIALIZER;
+    int stop = 0;
+    
+    for (int t = 0; t < thread_count; t++) {
+        memset(&workers[t], 0, sizeof(BenchmarkWorker));
+        workers[t].db = db;
+        workers[t].account_count = account_count;
+        workers[t].read_percent = read_percent;
+        workers[t].global_lock = serialized ? &global_lock : NULL;
+        workers[t].stop = &stop;
+        workers[t].seed = 1234 + t;
+    }
+    
+    double start = monotonicMilliseconds();
+    for (int t = 0; t < thread_count; t++) {
+        pthread_create(&threads[t], NULL, runBenchmarkWorker, &workers[t]);
+    }
+    usleep(duration_ms * 1000);
+    __atomic_store_n(&stop, 1, __ATOMIC_RELEASE);
+    
+    long long operations = 0;
+    *aborts = 0;
+    for (int t = 0; t < thread_count; t++) {
+        pthread_join(threads[t], NULL);
+        operations += workers[t].reads + workers[t].updates + workers[t].aborts;
+        *aborts += workers[t].aborts;
+    }
+    
+    return operations / ((monotonicMilliseconds() - start) / 1000.0);
+}
+
+void demonstrateMVCCBenchmark() {
+    printf("\n=== MVCC READ/WRITE THROUGHPUT BENCHMARK ===\n");
+    
+    const int account_count = 1000;
+    const int duration_ms = 300;
+    const int thread_counts[] = {1, 2, 4, 8, 16, 32};
+    
+    removeStorageFiles("./mvcc_bench_db");
+    Database* db = initDatabase("mvcc_bench_db", "./mvcc_bench_db");
+    if (!db || !createAccountsTable(db, account_count)) {
+        printf("Failed to initialize database\n");
+        freeDatabase(db);
+        return;
+    }
     
-    // Create index
-    if (createIndex(&table, "idx_name", "name", 0) == 0) {
-        printf("Index 'idx_name' created successfully\n");
-        printf("Column: %d\n", table.indexes[0].column_index);
-        printf("Unique: %s\n", table.indexes[0].is_unique ? "Yes" : "No");
-        printf("Key count: %d\n", table.indexes[0].key_count);
+    printf("%d accounts, 80%% point reads / 20%% autocommit updates, %d ms per run\n",
+           account_count, duration_ms);
+    printf("Serialized = one global lock around every statement, as before MVCC\n");
+    printf("Online CPUs: %ld\n\n", sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%8s %16s %16s %10s %10s\n", "threads", "serialized op/s", "MVCC op/s", "speedup", "aborts");
+    
+    for (int i = 0; i < (int)(sizeof(thread_counts) / sizeof(thread_counts[0])); i++) {
+        long long serialized_aborts, mvcc_aborts;
+        double serialized = runMixedBenchmark(db, account_count, thread_counts[i], 80, 1, duration_ms,
+                                              &serialized_aborts);
+        double mvcc = runMixedBenchmark(db, account_count, thread_counts[i], 80, 0, duration_ms,
+                                        &mvcc_aborts);
         
-        // Search index
-        int result_ids[MAX_RECORDS];
-        int found_count = searchIndex(&table.indexes[0], "John", result_ids, MAX_RECORDS);
-        
-        printf("Search for 'John' found %d records\n", found_count);
-        for (int i = 0; i < found_count; i++) {
-            printf("  Record ID: %d\n", result_ids[i]);
-        }
-    } else {
-        printf("Failed to create index\n");
+        printf("%8d %16.0f %16.0f %9.2fx %10lld\n", thread_counts[i], serialized, mvcc,
+               serialized > 0 ? mvcc / serialized : 0.0, mvcc_aborts);
     }
+    
+    TransactionManager* manager = db->transaction_manager;
+    Table* table = findTable(db, "accounts");
+    printf("\nCommits: %lld, write conflicts: %lld, versions reclaimed: %lld\n",
+           manager->commits, manager->conflicts, manager->reclaimed);
+    printf("Heap rows after all runs: %d (%d accounts; freed slots are reused)\n",
+           table->heap_row_count, account_count);
+    
+    freeDatabase(db);
+    removeStorageFiles("./mvcc_bench_db");
 }
 
-void demonstrateQueryProcessing() {
-    printf("\n=== QUERY PROCESSING DEMO ===\n");
+// Drop a database the way a crash would
+// Dirty buffer pool pages and log records that were never synced are lost.
+void crashDatabase(Database* db) {
+    BufferPool* pool = db->storage->page_cache;
+    if (pool) {
+        pthread_mutex_lock(&pool->mutex);
+        for (int i = 0; i < pool->used_frames; i++) {
+            pool->frames[i].dirty = 0;
+        }
+        pool->dirty_count = 0;
+        pthread_mutex_unlock(&pool->mutex);
+    }
     
-    // Create a test query
-    Query query;
-    initQuery(&query, QUERY_SELECT);
+    WriteAheadLog* wal = db->storage->wal;
+    if (wal) {
+        pthread_mutex_lock(&wal->mutex);
+        wal->buffer_used = 0;
+        wal->next_lsn = wal->flushed_lsn;
+        pthread_mutex_unlock(&wal->mutex);
+    }
     
-    strcpy(query.table_name, "users");
+    freeDatabase(db);
+}
+
+// Reopen a database and report how long recovery took
+Database* reopenDatabase(const char* name, const char* path, double* recovery_ms) {
+    double start = monotonicMilliseconds();
+    Database* db = initDatabase(name, path);
+    *recovery_ms = monotonicMilliseconds() - start;
+    return db;
+}
+
+// Log `updates` balance changes, 100 per transaction, then crash and recover
+// Balances are checked against what was committed before the crash.
+void measureRecovery(int account_count, int updates, int checkpoint_before_crash) {
+    removeStorageFiles("./wal_recovery_db");
+    Database* db = initDatabase("wal_recovery_db", "./wal_recovery_db");
+    if (!db || !createAccountsTable(db, account_count) || enableWriteAheadLog(db, 1) != 0) {
+        printf("Failed to initialize database\n");
+        freeDatabase(db);
+        return;
+    }
+    db->storage->wal->checkpoint_bytes = 0; // Let the log grow
     
-    // Add selected columns
-    addSelectedColumn(&query, "id");
-    addSelectedColumn(&query, "name");
-    addSelectedColumn(&query, "age");
+    int* balances = malloc((account_count + 1) * sizeof(int));
+    for (int i = 1; i <= account_count; i++) {
+        balances[i] = 100;
+    }
     
-    // Add WHERE conditions
-    addWhereCondition(&query, "age", OP_GREATER_THAN, "18");
-    addWhereCondition(&query, "name", OP_EQUAL, "John");
+    unsigned int seed = 42;
+    for (int done = 0; done < updates; done += 100) {
+        int transaction_id = beginTransaction(db);
+        for (int i = 0; i < 100; i++) {
+            int account = 1 + rand_r(&seed) % account_count;
+            balances[account] = rand_r(&seed) % 1000;
+            writeBalance(db, transaction_id, account, balances[account]);
+        }
+        commitTransaction(db, transaction_id);
+        
+        if (checkpoint_before_crash && done + 100 == updates - 1000) {
+            checkpointDatabase(db);
+        }
+    }
     
-    // Set limit and offset
-    query.limit = 10;
-    query.offset = 0;
+    long long log_bytes = logSize(db->storage->wal);
+    crashDatabase(db);
     
-    printf("Query created:\n");
-    printf("Type: SELECT\n");
-    printf("Table: %s\n", query.table_name);
-    printf("Selected columns: %d\n", query.selected_column_count);
-    for (int i = 0; i < query.selected_column_count; i++) {
-        printf("  %s\n", query.selected_columns[i].name);
+    double recovery_ms;
+    db = reopenDatabase("wal_recovery_db", "./wal_recovery_db", &recovery_ms);
+    if (!db) {
+        printf("Recovery failed\n");
+        free(balances);
+        return;
     }
-    printf("WHERE conditions: %d\n", query.where_condition_count);
-    for (int i = 0; i < query.where_condition_count; i++) {
-        printf("  %s %s %s\n", "column_name", // Simplified
-               query.where_conditions[i].operator == OP_EQUAL ? "=" :
-               query.where_conditions[i].operator == OP_GREATER_THAN ? ">" : "OTHER",
-               query.where_conditions[i].value);
+    
+    int mismatches = 0;
+    for (int i = 1; i <= account_count; i++) {
+        mismatches += readBalance(db, 0, i) != balances[i];
     }
-    printf("Limit: %d\n", query.limit);
-    printf("Offset: %d\n", query.offset);
+    
+    printf("%8d %11s %10.1f MB %10d %12.1f %11d\n", updates, checkpoint_before_crash ? "yes" : "no",
+           log_bytes / (1024.0 * 1024.0), db->storage->wal->replayed_records, recovery_ms, mismatches);
+    
+    free(balances);
+    freeDatabase(db);
+    removeStorageFiles("./wal_recovery_db");
 }
 
-void demonstrateTransactions() {
-    printf("\n=== TRANSACTIONS DEMO ===\n");
+void demonstrateWriteAheadLog() {
+    printf("\n=== WRITE-AHEAD LOG AND RECOVERY DEMO ===\n");
+    
+    removeStorageFiles("./wal_db");
+    Database* db = initDatabase("wal_db", "./wal_db");
+    if (!db || !createAccountsTable(db, 100) || enableWriteAheadLog(db, 1) != 0) {
+        printf("Failed to initialize database\n");
+        freeDatabase(db);
+        return;
+    }
+    printf("100 accounts with balance 100, write-ahead log enabled\n");
     
-    // Initialize transaction manager
-    TransactionManager* manager = initTransactionManager();
-    if (!manager) {
-        printf("Failed to initialize transaction manager\n");
+    writeBalance(db, 0, 1, 500);
+    int open_transaction = beginTransaction(db);
+    writeBalance(db, open_transaction, 2, 900);
+    
+    Table* table = findTable(db, "accounts");
+    Record* record = createRecord(table);
+    int new_id = 101, new_balance = 250;
+    setFieldValue(record, table, "id", &new_id);
+    setFieldValue(record, table, "owner", "owner101");
+    setFieldValue(record, table, "balance", &new_balance);
+    
+    Query query;
+    initQuery(&query, QUERY_INSERT);
+    strcpy(query.table_name, "accounts");
+    executeInsertQuery(db, &query, record);
+    freeRecord(table, record);
+    
+    initQuery(&query, QUERY_DELETE);
+    strcpy(query.table_name, "accounts");
+    addWhereCondition(&query, "id", OP_EQUAL, "3");
+    executeDeleteQuery(db, &query);
+    
+    printf("Committed: account 1 = 500, INSERT account 101, DELETE account 3\n");
+    printf("T%d sets account 2 = 900 and is still open at the crash\n", open_transaction);
+    crashDatabase(db);
+    
+    double recovery_ms;
+    db = reopenDatabase("wal_db", "./wal_db", &recovery_ms);
+    if (!db) {
+        printf("Recovery failed\n");
         return;
     }
     
-    printf("Transaction manager initialized\n");
+    WriteAheadLog* wal = db->storage->wal;
+    printf("\nRecovered in %.1f ms: %d log records replayed, %d transactions redone, %d rolled back\n",
+           recovery_ms, wal->replayed_records, wal->redone_transactions, wal->undone_transactions);
+    printf("Account 1: %d, account 2: %d, account 3: %s, account 101: %d, accounts: %d\n",
+           readBalance(db, 0, 1), readBalance(db, 0, 2),
+           readBalance(db, 0, 3) < 0 ? "deleted" : "present", readBalance(db, 0, 101), countAccounts(db, 0));
+    freeDatabase(db);
+    removeStorageFiles("./wal_db");
+    
+    // Commit throughput with and without group commit
+    const int account_count = 1000;
+    const int duration_ms = 300;
+    const int thread_counts[] = {1, 4, 16, 32};
+    
+    removeStorageFiles("./wal_bench_db");
+    db = initDatabase("wal_bench_db", "./wal_bench_db");
+    if (!db || !createAccountsTable(db, account_count) || enableWriteAheadLog(db, 1) != 0) {
+        printf("Failed to initialize database\n");
+        freeDatabase(db);
+        return;
+    }
+    wal = db->storage->wal;
     
-    // Begin transaction
-    int transaction_id = 1;
-    if (beginTransaction(NULL, transaction_id) == 0) {
-        printf("Transaction %d started\n", transaction_id);
+    printf("\nAutocommit single-row updates, %d ms per run, each commit waits for fdatasync()\n",
+           duration_ms);
+    printf("%8s %18s %18s %10s %16s\n", "threads", "no group commit/s", "group commit/s", "speedup",
+           "commits per sync");
+    
+    for (int i = 0; i < (int)(sizeof(thread_counts) / sizeof(thread_counts[0])); i++) {
+        long long aborts;
+        wal->group_commit = 0;
+        double single = runMixedBenchmark(db, account_count, thread_counts[i], 0, 0, duration_ms, &aborts);
         
-        // Simulate some operations
-        printf("Performing operations...\n");
+        wal->group_commit = 1;
+        long long commits_before = wal->commit_records, syncs_before = wal->syncs;
+        double grouped = runMixedBenchmark(db, account_count, thread_counts[i], 0, 0, duration_ms, &aborts);
+        long long syncs = wal->syncs - syncs_before;
         
-        // Commit transaction
-        if (commitTransaction(NULL, transaction_id) == 0) {
-            printf("Transaction %d committed\n", transaction_id);
-        } else {
-            printf("Failed to commit transaction\n");
+        printf("%8d %18.0f %18.0f %9.2fx %16.1f\n", thread_counts[i], single, grouped,
+               single > 0 ? grouped / single : 0.0,
+               syncs > 0 ? (double)(wal->commit_records - commits_before) / syncs : 0.0);
+    }
+    printf("Checkpoints taken during the runs: %lld\n", wal->checkpoints - 1);
+    
+    freeDatabase(db);
+    removeStorageFiles("./wal_bench_db");
+    
+    // Recovery time grows with the log; a checkpoint bounds it
+    printf("\nRecovery time against log size (1000 accounts, 100 updates per transaction)\n");
+    printf("%8s %11s %13s %10s %12s %11s\n", "updates", "checkpoint", "log size", "records", "recovery ms",
+           "mismatches");
+    measureRecovery(account_count, 2000, 0);
+    measureRecovery(account_count, 20000, 0);
+    measureRecovery(account_count, 200000, 0);
+    measureRecovery(account_count, 200000, 1);
+}
+
+// One thread of the connection pool contention benchmark
+typedef struct {
+    ConnectionPool* pool;
+    int locked;        // Use the old mutex-and-scan pool instead
+    int iterations;
+    double* latencies; // Microseconds per acquire
+    int count;
+    int failures;
+} PoolWorker;
+
+// Old acquire path: one mutex around a linear scan for a free slot
+DatabaseConnection* scanForConnection(ConnectionPool* pool, const char* database_name) {
+    DatabaseConnection* connection = NULL;
+    
+    pthread_mutex_lock(&pool->mutex);
+    for (int i = 0; i < pool->max_connections; i++) {
+        if (pool->connections[i].state != CONNECTION_IN_USE) {
+            connection = &pool->connections[i];
+            connection->state = CONNECTION_IN_USE;
+            strncpy(connection->database_name, database_name, sizeof(connection->database_name) - 1);
+            connection->is_connected = 1;
+            connection->last_activity = time(NULL);
+            break;
         }
-    } else {
-        printf("Failed to begin transaction\n");
     }
+    pthread_mutex_unlock(&pool->mutex);
     
-    // Test rollback
-    transaction_id = 2;
-    if (beginTransaction(NULL, transaction_id) == 0) {
-        printf("Transaction %d started\n", transaction_id);
+    return connection;
+}
+
+// Old return path
+void returnScannedConnection(ConnectionPool* pool, DatabaseConnection* connection) {
+    pthread_mutex_lock(&pool->mutex);
+    connection->state = CONNECTION_IDLE;
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+// Take and return connections, timing each acquire
+void* runPoolWorker(void* arg) {
+    PoolWorker* worker = (PoolWorker*)arg;
+    volatile unsigned int sink = 0;
+    
+    for (int i = 0; i < worker->iterations; i++) {
+        double start = monotonicMilliseconds();
+        DatabaseConnection* connection;
         
-        // Simulate some operations
-        printf("Performing operations...\n");
+        if (worker->locked) {
+            // The old pool fails when full; callers retried
+            while (!(connection = scanForConnection(worker->pool, "bench_db"))) {
+                sched_yield();
+            }
+        } else {
+            connection = acquireConnection(worker->pool, "bench_db", 1000);
+        }
+        worker->latencies[worker->count++] = (monotonicMilliseconds() - start) * 1000.0;
+        
+        if (!connection) {
+            worker->failures++;
+            continue;
+        }
+        
+        // A short statement's worth of work while holding the connection
+        for (int k = 0; k < 200; k++) {
+            sink += k * connection->connection_id;
+        }
         
-        // Rollback transaction
-        if (rollbackTransaction(NULL, transaction_id) == 0) {
-            printf("Transaction %d rolled back\n", transaction_id);
+        if (worker->locked) {
+            returnScannedConnection(worker->pool, connection);
         } else {
-            printf("Failed to rollback transaction\n");
+            returnConnection(worker->pool, connection);
         }
-    } else {
-        printf("Failed to begin transaction\n");
     }
     
-    free(manager);
+    return NULL;
+}
+
+// Run total_acquires acquire/return pairs across thread_count threads
+// Fills percentiles (p50, p99, p99.9, max in microseconds); returns acquires/sec.
+double runPoolBenchmark(int pool_size, int thread_count, int total_acquires, int locked,
+                        double* percentiles, int* failures) {
+    ConnectionPool* pool = initConnectionPool(pool_size);
+    pthread_t threads[64];
+    PoolWorker workers[64];
+    int per_thread = total_acquires / thread_count;
+    double* latencies = malloc((size_t)per_thread * thread_count * sizeof(double));
+    
+    if (!pool || !latencies) {
+        freeConnectionPool(pool);
+        free(latencies);
+        return 0.0;
+    }
+    
+    for (int t = 0; t < thread_count; t++) {
+        memset(&workers[t], 0, sizeof(PoolWorker));
+        workers[t].pool = pool;
+        workers[t].locked = locked;
+        workers[t].iterations = per_thread;
+        workers[t].latencies = latencies + (size_t)t * per_thread;
+    }
+    
+    double start = monotonicMilliseconds();
+    for (int t = 0; t < thread_count; t++) {
+        pthread_create(&threads[t], NULL, runPoolWorker, &workers[t]);
+    }
+    
+    int count = 0;
+    *failures = 0;
+    for (int t = 0; t < thread_count; t++) {
+        pthread_join(threads[t], NULL);
+        count += workers[t].count;
+        *failures += workers[t].failures;
+    }
+    double seconds = (monotonicMilliseconds() - start) / 1000.0;
+    
+    qsort(latencies, count, sizeof(double), compareDoubles);
+    percentiles[0] = latencies[count / 2];
+    percentiles[1] = latencies[(int)(count * 0.99)];
+    percentiles[2] = latencies[(int)(count * 0.999)];
+    percentiles[3] = latencies[count - 1];
+    
+    free(latencies);
+    freeConnectionPool(pool);
+    return count / seconds;
 }
 
 void demonstrateConnectionPool() {
@@ -1463,6 +10330,7 @@ void demonstrateConnectionPool() {
         printf("  Connection 1: ID %d, DB %s\n", conn1->connection_id, conn1->database_name);
         printf("  Connection 2: ID %d, DB %s\n", conn2->connection_id, conn2->database_name);
         printf("  Connection 3: ID %d, DB %s\n", conn3->connection_id, conn3->database_name);
+        printf("Active connections: %d, open: %d\n", countActiveConnections(pool), pool->open_count);
         
         // Return connections
         returnConnection(pool, conn1);
@@ -1470,12 +10338,75 @@ void demonstrateConnectionPool() {
         returnConnection(pool, conn3);
         
         printf("Returned 3 connections\n");
-        printf("Active connections: %d\n", pool->connection_count);
+        printf("Active connections: %d, open: %d\n", countActiveConnections(pool), pool->open_count);
+        printf("Returning connection 1 again: %s\n",
+               returnConnection(pool, conn1) == 0 ? "accepted" : "rejected");
     } else {
         printf("Failed to get connections\n");
     }
     
-    free(pool);
+    // Bounded wait on an exhausted pool
+    DatabaseConnection* held[5];
+    int held_count = 0;
+    while (held_count < 5 && (held[held_count] = getConnection(pool, "test_db"))) {
+        held_count++;
+    }
+    
+    double start = monotonicMilliseconds();
+    DatabaseConnection* extra = acquireConnection(pool, "test_db", 50);
+    printf("\nAll %d connections taken; acquire with 50 ms timeout: %s after %.1f ms\n",
+           held_count, extra ? "got one" : "timed out", monotonicMilliseconds() - start);
+    
+    for (int i = 0; i < held_count; i++) {
+        returnConnection(pool, held[i]);
+    }
+    
+    // Idle reaping: age two connections past the limit
+    __atomic_store_n(&held[0]->last_activity, time(NULL) - 120, __ATOMIC_RELAXED);
+    __atomic_store_n(&held[1]->last_activity, time(NULL) - 120, __ATOMIC_RELAXED);
+    int reaped = reapIdleConnections(pool, 60);
+    printf("Reaped %d connections idle for 60+ seconds; open: %d\n", reaped, pool->open_count);
+    
+    DatabaseConnection* reopened[5];
+    for (int i = 0; i < 5; i++) {
+        reopened[i] = getConnection(pool, "test_db");
+    }
+    printf("Took all 5 again: open %d, connections opened in total: %lld\n",
+           pool->open_count, pool->opened);
+    for (int i = 0; i < 5; i++) {
+        returnConnection(pool, reopened[i]);
+    }
+    printf("Waits: %lld, timeouts: %lld, reaped: %lld\n", pool->waits, pool->timeouts, pool->reaped);
+    
+    freeConnectionPool(pool);
+}
+
+void demonstrateConnectionPoolBenchmark() {
+    printf("\n=== CONNECTION POOL CONTENTION BENCHMARK ===\n");
+    
+    const int pool_size = 32;
+    const int total_acquires = 200000;
+    const int thread_counts[] = {1, 4, 16, 64};
+    
+    printf("%d connections, %d acquire/return pairs per run, latency in microseconds\n",
+           pool_size, total_acquires);
+    printf("Locked = mutex around a linear scan, retried when full, as before\n");
+    printf("Online CPUs: %ld\n\n", sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%8s %-10s %12s %8s %8s %8s %10s %8s\n",
+           "threads", "pool", "acquires/s", "p50", "p99", "p99.9", "max", "failed");
+    
+    for (int i = 0; i < (int)(sizeof(thread_counts) / sizeof(thread_counts[0])); i++) {
+        for (int locked = 1; locked >= 0; locked--) {
+            double percentiles[4];
+            int failures;
+            double rate = runPoolBenchmark(pool_size, thread_counts[i], total_acquires, locked,
+                                           percentiles, &failures);
+            
+            printf("%8d %-10s %12.0f %8.2f %8.2f %8.2f %10.2f %8d\n", thread_counts[i],
+                   locked ? "locked" : "lock-free", rate, percentiles[0], percentiles[1],
+                   percentiles[2], percentiles[3], failures);
+        }
+    }
 }
 
 void demonstrateSQLParsing() {
@@ -1507,6 +10438,611 @@ void demonstrateSQLParsing() {
     printf("Total tokens: %d\n", token_count);
 }
 
+// Read an integer column of a prepared statement's current row
+int statementInt(PreparedStatement* statement, int column) {
+    const void* field = statementColumn(statement, column);
+    int value = 0;
+    if (field) memcpy(&value, field, sizeof(int));
+    return value;
+}
+
+// Run point lookups by account id one way; returns queries per second
+// mode 0: new SQL text per lookup; 1: Query API, planned per call;
+// 2: SQL text from a small repeated set; 3: one prepared statement
+double runLookupBenchmark(Database* db, int mode, int account_count, int lookups, int* found) {
+    PreparedStatement* prepared = mode == 3 ?
+        prepareStatement(db, "SELECT owner, balance FROM accounts WHERE id = ?", NULL) : NULL;
+    double start = monotonicMilliseconds();
+    *found = 0;
+    
+    for (int i = 0; i < lookups; i++) {
+        int id = 1 + (int)((i * 7919LL) % account_count);
+        
+        if (mode == 1) {
+            *found += readBalance(db, 0, id) >= 0;
+            continue;
+        }
+        
+        PreparedStatement* statement = prepared;
+        if (mode != 3) {
+            char sql[128];
+            snprintf(sql, sizeof(sql), "SELECT owner, balance FROM accounts WHERE id = %d",
+                     mode == 0 ? id : 1 + i % 64);
+            statement = prepareStatement(db, sql, NULL);
+        } else {
+            bindInt(statement, 1, id);
+        }
+        
+        if (executeStatement(statement) == 0) {
+            while (stepStatement(statement) == 1) {
+                (*found)++;
+            }
+        }
+        
+        if (statement != prepared) {
+            finalizeStatement(statement);
+        }
+    }
+    
+    double elapsed = monotonicMilliseconds() - start;
+    finalizeStatement(prepared);
+    return elapsed > 0 ? lookups * 1000.0 / elapsed : 0.0;
+}
+
+void demonstratePreparedStatements() {
+    printf("\n=== PREPARED STATEMENTS AND PLAN CACHE DEMO ===\n");
+    
+    const int account_count = 10000;
+    removeStorageFiles("./prepared_db");
+    Database* db = initDatabase("prepared_db", "./prepared_db");
+    if (!db || !createAccountsTable(db, account_count)) {
+        printf("Failed to initialize database\n");
+        freeDatabase(db);
+        return;
+    }
+    
+    char error[256];
+    PreparedStatement* insert = prepareStatement(db,
+        "INSERT INTO accounts (id, owner, balance) VALUES (?, ?, ?)", error);
+    PreparedStatement* update = prepareStatement(db, "UPDATE accounts SET balance = ? WHERE id = ?", error);
+    PreparedStatement* lookup = prepareStatement(db,
+        "SELECT owner, balance FROM accounts WHERE id >= ? ORDER BY id LIMIT ?", error);
+    if (!insert || !update || !lookup) {
+        printf("Prepare failed: %s\n", error);
+        finalizeStatement(insert);
+        finalizeStatement(update);
+        finalizeStatement(lookup);
+        freeDatabase(db);
+        return;
+    }
+    
+    for (int i = 1; i <= 3; i++) {
+        char owner[32];
+        snprintf(owner, sizeof(owner), "new%d", i);
+        bindInt(insert, 1, account_count + i);
+        bindText(insert, 2, owner);
+        bindInt(insert, 3, i * 10);
+        executeStatement(insert);
+    }
+    bindInt(update, 1, 777);
+    bindInt(update, 2, account_count + 2);
+    printf("INSERT ... VALUES (?, ?, ?) x3, UPDATE ... SET balance = ? WHERE id = ?: %d row\n",
+           executeStatement(update));
+    
+    bindInt(lookup, 1, account_count);
+    bindInt(lookup, 2, 4);
+    if (executeStatement(lookup) == 0) {
+        while (stepStatement(lookup) == 1) {
+            printf("  %s: %d\n", (const char*)statementColumn(lookup, 0), statementInt(lookup, 1));
+        }
+    }
+    
+    if (!prepareStatement(db, "SELECT owner FROM accounts WHERE id = = 1", error)) {
+        printf("Syntax error reported: %s\n", error);
+    }
+    finalizeStatement(insert);
+    finalizeStatement(update);
+    finalizeStatement(lookup);
+    
+    // Point lookup throughput
+    const int lookups = 20000;
+    const char* modes[] = {"ad-hoc SQL, new text each time", "Query API, planned per call",
+                           "repeated SQL text, cache hit", "prepared, bind + execute"};
+    double rates[4];
+    
+    printf("\nPoint lookups by primary key: %d accounts, %d queries per run\n", account_count, lookups);
+    printf("%-32s %12s %10s %8s\n", "mode", "queries/s", "vs ad-hoc", "found");
+    for (int mode = 0; mode < 4; mode++) {
+        int found;
+        rates[mode] = runLookupBenchmark(db, mode, account_count, lookups, &found);
+        printf("%-32s %12.0f %9.2fx %8d\n", modes[mode], rates[mode],
+               rates[0] > 0 ? rates[mode] / rates[0] : 0.0, found);
+    }
+    
+    PlanCache* cache = db->plan_cache;
+    printf("Plan cache: %d entries, %lld hits, %lld misses, %lld evictions\n",
+           cache->entry_count, cache->hits, cache->misses, cache->evictions);
+    
+    // DDL invalidates cached plans; handles re-prepare on their next execution
+    Table* table = findTable(db, "accounts");
+    PreparedStatement* by_owner = prepareStatement(db, "SELECT id FROM accounts WHERE owner = ?", NULL);
+    char plan[1024];
+    double start;
+    
+    printf("\nSELECT id FROM accounts WHERE owner = ?\n");
+    for (int pass = 0; pass < 2 && by_owner; pass++) {
+        if (pass == 1) {
+            createIndex(table, "idx_accounts_owner", "owner", 0);
+            printf("CREATE INDEX idx_accounts_owner ON accounts (owner)\n");
+        }
+        
+        bindText(by_owner, 1, "owner5000");
+        start = monotonicMilliseconds();
+        int id = executeStatement(by_owner) == 0 && stepStatement(by_owner) == 1 ? statementInt(by_owner, 0) : -1;
+        double ms = monotonicMilliseconds() - start;
+        resetStatement(by_owner);
+        
+        plan[0] = '\0';
+        explainPlanNode(by_owner->plan, 0, 0, plan, sizeof(plan));
+        printf("  id %d in %.3f ms, plan: %s", id, ms, plan);
+    }
+    finalizeStatement(by_owner);
+    printf("Entries invalidated by DDL: %lld\n", cache->invalidations);
+    
+    freeDatabase(db);
+    removeStorageFiles("./prepared_db");
+}
+
+// Load TPC-H-like customer, orders and lineitem tables
+// Scale factor 1.0 would be 150,000 customers, 1.5M orders and about 6M
+// line items. Orders and line items are stored in key order, as TPC-H's
+// generator writes them; order dates and customers are random.
+Database* loadJoinTables(const char* name, const char* path, double scale_factor) {
+    removeStorageFiles(path);
+    Database* db = initDatabase(name, path);
+    if (!db) return NULL;
+    
+    Column customer_columns[3] = {
+        {"c_custkey", DATA_TYPE_INTEGER, sizeof(int), 1, 1, 1, ""},
+        {"c_name", DATA_TYPE_TEXT, 24, 0, 0, 0, ""},
+        {"c_nationkey", DATA_TYPE_INTEGER, sizeof(int), 0, 0, 0, ""}
+    };
+    Column order_columns[4] = {
+        {"o_orderkey", DATA_TYPE_INTEGER, sizeof(int), 1, 1, 1, ""},
+        {"o_custkey", DATA_TYPE_INTEGER, sizeof(int), 0, 0, 0, ""},
+        {"o_orderdate", DATA_TYPE_INTEGER, sizeof(int), 0, 0, 0, ""},
+        {"o_totalprice", DATA_TYPE_FLOAT, sizeof(double), 0, 0, 0, ""}
+    };
+    Column lineitem_columns[4] = {
+        {"l_orderkey", DATA_TYPE_INTEGER, sizeof(int), 0, 0, 0, ""},
+        {"l_linenumber", DATA_TYPE_INTEGER, sizeof(int), 0, 0, 0, ""},
+        {"l_quantity", DATA_TYPE_INTEGER, sizeof(int), 0, 0, 0, ""},
+        {"l_extendedprice", DATA_TYPE_FLOAT, sizeof(double), 0, 0, 0, ""}
+    };
+    createTable(db, "customer", customer_columns, 3);
+    createTable(db, "orders", order_columns, 4);
+    createTable(db, "lineitem", lineitem_columns, 4);
+    Table* customer = findTable(db, "customer");
+    Table* orders = findTable(db, "orders");
+    Table* lineitem = findTable(db, "lineitem");
+    
+    int customer_count = (int)(150000 * scale_factor);
+    int order_count = customer_count * 10;
+    Record* record = createRecord(customer);
+    srand(42);
+    
+    for (int key = 1; key <= customer_count; key++) {
+        int nation = rand() % 25;
+        char customer_name[24];
+        snprintf(customer_name, sizeof(customer_name), "Customer#%09d", key);
+        
+        setFieldValue(record, customer, "c_custkey", &key);
+        setFieldValue(record, customer, "c_name", customer_name);
+        setFieldValue(record, customer, "c_nationkey", &nation);
+        record->id = customer->next_record_id++;
+        appendRows(customer, &record, 1);
+    }
+    freeRecord(customer, record);
+    
+    Record* order = createRecord(orders);
+    Record* items[7];
+    for (int i = 0; i < 7; i++) {
+        items[i] = createRecord(lineitem);
+    }
+    
+    for (int key = 1; key <= order_count; key++) {
+        int customer_key = 1 + rand() % customer_count;
+        int order_date = rand() % 2406; // Days since 1992-01-01
+        int item_count = 1 + rand() % 7;
+        double total = 0.0;
+        
+        for (int i = 0; i < item_count; i++) {
+            int line = i + 1;
+            int quantity = 1 + rand() % 50;
+            double price = quantity * (900.0 + rand() % 1000);
+            total += price;
+            
+            setFieldValue(items[i], lineitem, "l_orderkey", &key);
+            setFieldValue(items[i], lineitem, "l_linenumber", &line);
+            setFieldValue(items[i], lineitem, "l_quantity", &quantity);
+            setFieldValue(items[i], lineitem, "l_extendedprice", &price);
+            items[i]->id = lineitem->next_record_id++;
+        }
+        appendRows(lineitem, items, item_count);
+        
+        setFieldValue(order, orders, "o_orderkey", &key);
+        setFieldValue(order, orders, "o_custkey", &customer_key);
+        setFieldValue(order, orders, "o_orderdate", &order_date);
+        setFieldValue(order, orders, "o_totalprice", &total);
+        order->id = orders->next_record_id++;
+        appendRows(orders, &order, 1);
+    }
+    
+    freeRecord(orders, order);
+    for (int i = 0; i < 7; i++) {
+        freeRecord(lineitem, items[i]);
+    }
+    
+    createIndex(customer, "idx_c_custkey", "c_custkey", 1);
+    createIndex(orders, "idx_o_orderkey", "o_orderkey", 1);
+    createIndex(lineitem, "idx_l_orderkey", "l_orderkey", 0);
+    analyzeTable(customer);
+    analyzeTable(orders);
+    analyzeTable(lineitem);
+    return db;
+}
+
+// Join the way application code did before JOIN: step through the outer
+// rows and run a prepared lookup on the inner table for each
+// Returns the number of joined rows and adds the inner column to sum.
+long long nestedLoopJoin(Database* db, const char* outer_sql, const char* inner_sql, double* sum) {
+    PreparedStatement* outer = prepareStatement(db, outer_sql, NULL);
+    PreparedStatement* inner = prepareStatement(db, inner_sql, NULL);
+    long long rows = 0;
+    *sum = 0.0;
+    
+    if (outer && inner && executeStatement(outer) == 0) {
+        while (stepStatement(outer) == 1) {
+            bindInt(inner, 1, statementInt(outer, 0));
+            if (executeStatement(inner) != 0) continue;
+            
+            while (stepStatement(inner) == 1) {
+                double value;
+                memcpy(&value, statementColumn(inner, 0), sizeof(double));
+                *sum += value;
+                rows++;
+            }
+        }
+    }
+    
+    finalizeStatement(outer);
+    finalizeStatement(inner);
+    return rows;
+}
+
+void demonstrateJoins() {
+    printf("\n=== HASH JOIN AND SORT-MERGE JOIN DEMO ===\n");
+    
+    Database* db = loadJoinTables("join_db", "./join_db", 0.01);
+    if (!db) {
+        printf("Failed to initialize database\n");
+        return;
+    }
+    
+    // The planner picks the join by estimated cost
+    const char* statements[] = {
+        "SELECT c_name, o_orderkey FROM customer JOIN orders ON c_custkey = o_custkey "
+        "WHERE c_nationkey = 7 AND o_orderdate < 100 ORDER BY o_orderkey LIMIT 3",
+        "SELECT o_orderkey, l_extendedprice FROM orders JOIN lineitem ON o_orderkey = l_orderkey "
+        "WHERE l_quantity = 50 LIMIT 3"
+    };
+    char error[256];
+    char plan[2048];
+    
+    for (int s = 0; s < 2; s++) {
+        PreparedStatement* statement = prepareStatement(db, statements[s], error);
+        if (!statement) {
+            printf("Prepare failed: %s\n", error);
+            continue;
+        }
+        
+        printf("\n%s\n", statements[s]);
+        if (executeStatement(statement) == 0) {
+            while (stepStatement(statement) == 1) {
+                const void* first = statementColumn(statement, 0);
+                double price;
+                if (s == 0) {
+                    printf("  %s  order %d\n", (const char*)first, statementInt(statement, 1));
+                } else {
+                    memcpy(&price, statementColumn(statement, 1), sizeof(double));
+                    printf("  order %d  %.2f\n", statementInt(statement, 0), price);
+                }
+            }
+        }
+        
+        plan[0] = '\0';
+        explainPlanNode(statement->plan, 0, 1, plan, sizeof(plan));
+        printf("%s", plan);
+        finalizeStatement(statement);
+    }
+    
+    if (!prepareStatement(db, "SELECT * FROM orders JOIN lineitem ON o_orderkey = l_quantity2", error)) {
+        printf("\nBad JOIN reported: %s\n", error);
+    }
+    
+    freeDatabase(db);
+    removeStorageFiles("./join_db");
+}
+
+// Time one join query with the planner's choice or a forced method
+double timeJoinQuery(Database* db, Query* query, int method, size_t work_memory, const char* sum_column,
+                     AggregateResult* result, char* plan, size_t plan_size) {
+    query->join_method = method;
+    query->work_memory = work_memory;
+    
+    double start = monotonicMilliseconds();
+    executeAggregateQuery(db, query, sum_column, result);
+    double ms = monotonicMilliseconds() - start;
+    
+    explainQuery(db, query, 0, plan, plan_size);
+    return ms;
+}
+
+void demonstrateJoinBenchmark() {
+    printf("\n=== JOIN BENCHMARK (TPC-H-LIKE) ===\n");
+    
+    const double scale_factors[] = {0.01, 0.05};
+    
+    for (int f = 0; f < 2; f++) {
+        double load_start = monotonicMilliseconds();
+        Database* db = loadJoinTables("join_bench_db", "./join_bench_db", scale_factors[f]);
+        if (!db) {
+            printf("Failed to initialize database\n");
+            return;
+        }
+        
+        printf("\nScale factor %.2f: %d customers, %d orders, %d line items (loaded in %.0f ms)\n",
+               scale_factors[f], findTable(db, "customer")->record_count,
+               findTable(db, "orders")->record_count, findTable(db, "lineitem")->record_count,
+               monotonicMilliseconds() - load_start);
+        
+        struct {
+            const char* label;
+            const char* left;
+            const char* right;
+            const char* on[2];
+            const char* where_column;
+            Operator where_operator;
+            const char* where_value;
+            const char* sum_column;
+            const char* outer_sql; // The same join as application code
+            const char* inner_sql;
+        } queries[] = {
+            {"orders x lineitem, all rows", "orders", "lineitem", {"o_orderkey", "l_orderkey"},
+             NULL, OP_EQUAL, NULL, "l_extendedprice",
+             "SELECT o_orderkey FROM orders",
+             "SELECT l_extendedprice FROM lineitem WHERE l_orderkey = ?"},
+            {"orders x lineitem, date < 240", "orders", "lineitem", {"o_orderkey", "l_orderkey"},
+             "o_orderdate", OP_LESS_THAN, "240", "l_extendedprice",
+             "SELECT o_orderkey FROM orders WHERE o_orderdate < 240",
+             "SELECT l_extendedprice FROM lineitem WHERE l_orderkey = ?"},
+            {"customer x orders, nation = 7", "customer", "orders", {"c_custkey", "o_custkey"},
+             "c_nationkey", OP_EQUAL, "7", "o_totalprice",
+             "SELECT c_custkey FROM customer WHERE c_nationkey = 7",
+             "SELECT o_totalprice FROM orders WHERE o_custkey = ?"}
+        };
+        
+        const char* methods[] = {"planner", "hash", "merge", "hash, 256 KB"};
+        const int method_hints[] = {JOIN_METHOD_COST, JOIN_METHOD_HASH, JOIN_METHOD_MERGE, JOIN_METHOD_HASH};
+        const size_t budgets[] = {DEFAULT_WORK_MEMORY, DEFAULT_WORK_MEMORY, DEFAULT_WORK_MEMORY, 256 * 1024};
+        
+        printf("%-30s %-14s %10s %10s %-12s\n", "query", "method", "rows", "ms", "plan");
+        for (int q = 0; q < 3; q++) {
+            Query query;
+            initQuery(&query, QUERY_SELECT);
+            strcpy(query.table_name, queries[q].left);
+            setJoin(&query, queries[q].right, queries[q].on[0], queries[q].on[1]);
+            if (queries[q].where_column) {
+                addWhereCondition(&query, queries[q].where_column, queries[q].where_operator,
+                                  queries[q].where_value);
+            }
+            
+            double first_sum = 0.0;
+            long long first_rows = -1;
+            int mismatches = 0;
+            
+            for (int m = 0; m < 4; m++) {
+                AggregateResult result;
+                char plan[2048];
+                double ms = timeJoinQuery(db, &query, method_hints[m], budgets[m], queries[q].sum_column,
+                                          &result, plan, sizeof(plan));
+                
+                const char* chosen = strstr(plan, "Hash Join") ? "hash join" : "merge join";
+                printf("%-30s %-14s %10lld %10.1f %-12s\n", m == 0 ? queries[q].label : "", methods[m],
+                       result.rows, ms, chosen);
+                
+                // The small budget forces Grace partitioning; EXPLAIN ANALYZE shows how much
+                if (budgets[m] < DEFAULT_WORK_MEMORY) {
+                    explainQuery(db, &query, 1, plan, sizeof(plan));
+                    const char* spilled = strstr(plan, "Spilled:");
+                    if (spilled) {
+                        printf("%-30s   %.*s\n", "", (int)strcspn(spilled, "\n"), spilled);
+                    }
+                }
+                
+                if (first_rows < 0) {
+                    first_rows = result.rows;
+                    first_sum = result.sum;
+                } else if (result.rows != first_rows || fabs(result.sum - first_sum) > 1e-6 * fabs(first_sum)) {
+                    mismatches++;
+                }
+            }
+            
+            double sum;
+            double start = monotonicMilliseconds();
+            long long rows = nestedLoopJoin(db, queries[q].outer_sql, queries[q].inner_sql, &sum);
+            printf("%-30s %-14s %10lld %10.1f\n", "", "app loop", rows, monotonicMilliseconds() - start);
+            if (rows != first_rows || fabs(sum - first_sum) > 1e-6 * fabs(first_sum)) {
+                mismatches++;
+            }
+            if (mismatches > 0) {
+                printf("  %d methods disagree on rows or SUM!\n", mismatches);
+            }
+        }
+        
+        freeDatabase(db);
+        removeStorageFiles("./join_bench_db");
+    }
+}
+
+// Sort node of a plan, or NULL
+QueryPlanNode* findSortNode(QueryPlanNode* node) {
+    if (node->node_type == PLAN_SORT) return node;
+    return node->child_count > 0 ? findSortNode(node->children[0]) : NULL;
+}
+
+void demonstrateSortBenchmark() {
+    printf("\n=== EXTERNAL SORT AND STREAMING CURSOR BENCHMARK ===\n");
+    
+    const int sizes[] = {1000000, 4000000, 16000000};
+    
+    for (int s = 0; s < 3; s++) {
+        removeStorageFiles("./sort_db");
+        Database* db = initDatabase("sort_db", "./sort_db");
+        if (!db) {
+            printf("Failed to initialize database\n");
+            return;
+        }
+        
+        Column columns[3] = {
+            {"id", DATA_TYPE_INTEGER, sizeof(int), 1, 1, 1, ""},
+            {"score", DATA_TYPE_INTEGER, sizeof(int), 0, 0, 0, ""},
+            {"tag", DATA_TYPE_TEXT, 12, 0, 0, 0, ""}
+        };
+        createTable(db, "events", columns, 3);
+        Table* table = findTable(db, "events");
+        
+        Record* batch[1000];
+        for (int i = 0; i < 1000; i++) {
+            batch[i] = createRecord(table);
+        }
+        
+        double load_start = monotonicMilliseconds();
+        srand(1234);
+        for (int loaded = 0; loaded < sizes[s]; loaded += 1000) {
+            for (int i = 0; i < 1000; i++) {
+                int id = loaded + i;
+                int score = rand();
+                char tag[12];
+                snprintf(tag, sizeof(tag), "event%d", id % 1000);
+                
+                setFieldValue(batch[i], table, "id", &id);
+                setFieldValue(batch[i], table, "score", &score);
+                setFieldValue(batch[i], table, "tag", tag);
+                batch[i]->id = table->next_record_id++;
+            }
+            appendRows(table, batch, 1000);
+        }
+        for (int i = 0; i < 1000; i++) {
+            freeRecord(table, batch[i]);
+        }
+        
+        printf("\n%d rows of %d bytes (loaded in %.0f ms)\n", sizes[s], table->row_size,
+               monotonicMilliseconds() - load_start);
+        printf("%-34s %12s %10s %12s %8s %9s\n", "query", "first row ms", "total ms", "sort memory", "runs", "in order");
+        
+        struct {
+            const char* label;
+            const char* sort_column;
+            int limit;
+            size_t work_memory;
+        } runs[] = {
+            {"no ORDER BY (streams)", "", -1, DEFAULT_WORK_MEMORY},
+            {"ORDER BY score LIMIT 10", "score", 10, DEFAULT_WORK_MEMORY},
+            {"ORDER BY score, 4 MB budget", "score", -1, DEFAULT_WORK_MEMORY},
+            {"ORDER BY score, all in memory", "score", -1, (size_t)1 << 40}
+        };
+        
+        for (int r = 0; r < 4; r++) {
+            // Sorting everything in memory needs rows x (row + pointer) bytes
+            if (runs[r].work_memory > DEFAULT_WORK_MEMORY && sizes[s] > 4000000) {
+                printf("%-34s %12s %10s %12s\n", runs[r].label, "-", "-", "skipped");
+                continue;
+            }
+            
+            Query query;
+            initQuery(&query, QUERY_SELECT);
+            strcpy(query.table_name, "events");
+            strcpy(query.sort_column, runs[r].sort_column);
+            query.limit = runs[r].limit;
+            query.work_memory = runs[r].work_memory;
+            
+            double start = monotonicMilliseconds();
+            double first_row = -1.0;
+            long long rows = 0;
+            long long out_of_order = 0;
+            int previous = INT_MIN;
+            
+            ResultCursor* cursor = openCursor(db, &query);
+            while (cursor && fetchCursor(cursor) == 1) {
+                if (first_row < 0) {
+                    first_row = monotonicMilliseconds() - start;
+                }
+                
+                int score;
+                memcpy(&score, cursorColumn(cursor, 1), sizeof(int));
+                if (runs[r].sort_column[0] && score < previous) {
+                    out_of_order++;
+                }
+                previous = score;
+                rows++;
+            }
+            double total = monotonicMilliseconds() - start;
+            
+            QueryPlanNode* sort_node = cursor ? findSortNode(cursor->plan) : NULL;
+            char memory[32] = "-";
+            char disk[16] = "-";
+            if (sort_node && sort_node->sort->ready) {
+                snprintf(memory, sizeof(memory), "%zu kB", (sort_node->sort->memory_used + 1023) / 1024);
+                if (sort_node->sort->method == SORT_METHOD_EXTERNAL) {
+                    snprintf(disk, sizeof(disk), "%d", sort_node->sort->runs_written);
+                }
+            }
+            closeCursor(cursor);
+            
+            printf("%-34s %12.2f %10.0f %12s %8s %9s\n", runs[r].label, first_row, total, memory, disk,
+                   out_of_order == 0 ? "yes" : "NO");
+            if (rows != (runs[r].limit >= 0 ? runs[r].limit : sizes[s])) {
+                printf("  Returned %lld rows!\n", rows);
+            }
+        }
+        
+        // The smallest table also shows the plans with what the sorts did
+        if (s == 0) {
+            Query query;
+            initQuery(&query, QUERY_SELECT);
+            strcpy(query.table_name, "events");
+            strcpy(query.sort_column, "score");
+            query.sort_ascending = 0;
+            query.limit = 5;
+            query.offset = 100;
+            
+            char plan[2048];
+            printf("\nEXPLAIN ANALYZE, top-N and external sort:\n");
+            explainQuery(db, &query, 1, plan, sizeof(plan));
+            printf("%s", plan);
+            
+            query.limit = -1;
+            query.offset = 0;
+            explainQuery(db, &query, 1, plan, sizeof(plan));
+            printf("%s", plan);
+        }
+        
+        freeDatabase(db);
+        removeStorageFiles("./sort_db");
+    }
+}
+
 void demonstrateSQLiteIntegration() {
     printf("\n=== SQLITE INTEGRATION DEMO ===\n");
     
@@ -1588,23 +11124,40 @@ int main() {
     demonstrateDatabaseBasics();
     demonstrateRecordManagement();
     demonstrateIndexing();
+    demonstrateIndexBenchmark();
+    demonstrateBufferPool();
+    demonstrateQueryPlanner();
+    demonstrateColumnStore();
     demonstrateQueryProcessing();
     demonstrateTransactions();
+    demonstrateMVCCBenchmark();
+    demonstrateWriteAheadLog();
     demonstrateConnectionPool();
+    demonstrateConnectionPoolBenchmark();
     demonstrateSQLParsing();
+    demonstratePreparedStatements();
+    demonstrateJoins();
+    demonstrateJoinBenchmark();
+    demonstrateSortBenchmark();
     demonstrateSQLiteIntegration();
     
     printf("\nAll advanced database programming examples demonstrated!\n");
     printf("Key features implemented:\n");
     printf("- Database engine with storage management\n");
     printf("- Table and record management with data types\n");
-    printf("- Indexing for fast data retrieval\n");
+    printf("- B+tree indexes in 4 KB pages with range scans and bulk build\n");
     printf("- Query processor with SQL-like syntax\n");
-    printf("- Transaction management with ACID properties\n");
-    printf("- Connection pooling for performance\n");
+    printf("- Cost-based planner with statistics, pull-based iterators and EXPLAIN\n");
+    printf("- Optional column store with SIMD batch predicates and selection vectors\n");
+    printf("- MVCC snapshot isolation with first-committer-wins and version GC\n");
+    printf("- Write-ahead log with group commit, checkpoints and crash recovery\n");
+    printf("- Lock-free connection pool with bounded waits and idle reaping\n");
     printf("- SQL parser for query processing\n");
+    printf("- Prepared statements with ? parameters and a plan cache invalidated by DDL\n");
+    printf("- Hash joins that spill to disk and sort-merge joins, chosen by cost\n");
+    printf("- Streaming cursors, top-N ORDER BY ... LIMIT and external merge sort\n");
     printf("- SQLite integration for real-world usage\n");
-    printf("- Page-based storage with caching\n");
+    printf("- Buffer pool with pin/unpin, clock/LRU-K eviction and write-back\n");
     printf("- Multi-threading with mutex protection\n");
     
     return 0;
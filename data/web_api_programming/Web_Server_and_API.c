@@ -6,6 +6,10 @@
 #include <time.h>
 #include <process.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #pragma comment(lib, "ws2_32.lib")
 
 // =============================================================================
@@ -16,6 +20,9 @@
 #define BUFFER_SIZE 4096
 #define MAX_CONNECTIONS 10
 #define MAX_ROUTES 50
+#define MAX_ROUTE_PARAMS 8
+#define MAX_HEADERS 20
+#define MAX_PATH_LENGTH 256
 
 // HTTP Methods
 typedef enum {
@@ -28,6 +35,21 @@ typedef enum {
     HTTP_HEAD
 } HttpMethod;
 
+#define HTTP_METHOD_COUNT 7
+
+// Path parameter captured by the router
+// The value points into the request path and is not NUL-terminated.
+typedef struct {
+    const char* name;
+    const char* value;
+    int value_length;
+} RouteParam;
+
+typedef struct {
+    RouteParam items[MAX_ROUTE_PARAMS];
+    int count;
+} RouteParams;
+
 // HTTP Status Codes
 typedef enum {
     HTTP_OK = 200,
@@ -39,16 +61,28 @@ typedef enum {
     HTTP_INTERNAL_SERVER_ERROR = 500
 } HttpStatus;
 
+// Request header
+// Name and value point into the receive buffer, where the parser
+// NUL-terminates them in place.
+typedef struct {
+    const char* name;
+    int name_length;
+    const char* value;
+    int value_length;
+} HttpHeader;
+
 // HTTP Request structure
+// path, query, headers and body point into the receive buffer.
 typedef struct {
     HttpMethod method;
-    char path[256];
-    char query[256];
-    char headers[20][256];
+    const char* path;
+    const char* query;
+    HttpHeader headers[MAX_HEADERS];
     int header_count;
-    char body[BUFFER_SIZE];
+    const char* body;
     int body_length;
     char version[16];
+    RouteParams params;
 } HttpRequest;
 
 // HTTP Response structure
@@ -61,6 +95,46 @@ typedef struct {
     char version[16];
 } HttpResponse;
 
+// Byte range of a request, counted from the request's first byte
+// Offsets rather than pointers stay valid when an unfinished request is
+// moved to the front of its buffer.
+typedef struct {
+    int offset;
+    int length;
+} HttpSlice;
+
+// Parser states
+typedef enum {
+    PARSE_REQUEST_LINE = 0,
+    PARSE_HEADERS = 1,
+    PARSE_BODY = 2,             // Content-Length body
+    PARSE_CHUNK_SIZE = 3,
+    PARSE_CHUNK_DATA = 4,
+    PARSE_CHUNK_END = 5,        // CRLF after chunk data
+    PARSE_TRAILERS = 6,
+    PARSE_COMPLETE = 7
+} HttpParseState;
+
+// Resumable HTTP/1.1 request parser
+// Fed the same request again as more of it arrives, it picks up where it
+// stopped instead of scanning from the start.
+typedef struct {
+    HttpParseState state;
+    int position;               // First byte not yet consumed
+    int scanned;                // Bytes after position already searched for '\n'
+    HttpSlice method;
+    HttpSlice target;
+    int minor_version;          // HTTP/1.x
+    HttpSlice header_names[MAX_HEADERS];
+    HttpSlice header_values[MAX_HEADERS];
+    int header_count;
+    long content_length;        // -1 without a Content-Length header
+    int chunked;
+    long chunk_remaining;
+    int body_offset;
+    int body_length;            // Chunked bodies: bytes decoded so far
+} HttpParser;
+
 // Route handler function type
 typedef void (*RouteHandler)(HttpRequest* request, HttpResponse* response);
 
@@ -71,11 +145,27 @@ typedef struct {
     RouteHandler handler;
 } Route;
 
+// Radix tree node
+// Each edge holds the static text its routes share; ":name" matches one
+// path segment and "*name" the rest of the path.
+typedef struct RouteNode {
+    char* prefix;
+    int prefix_length;
+    char* indices;              // First byte of each static child
+    struct RouteNode** children;
+    int child_count;
+    struct RouteNode* param_child;
+    struct RouteNode* wildcard_child;
+    char name[32];
+    Route* routes[HTTP_METHOD_COUNT];
+} RouteNode;
+
 // Web server structure
 typedef struct {
     SOCKET server_socket;
     Route routes[MAX_ROUTES];
     int route_count;
+    RouteNode* route_tree;
     int is_running;
 } WebServer;
 
@@ -155,11 +245,13 @@ const char* getMimeType(const char* filename) {
 // Initialize HTTP request
 void initHttpRequest(HttpRequest* request) {
     request->method = HTTP_GET;
-    strcpy(request->path, "/");
-    strcpy(request->query, "");
+    request->path = "/";
+    request->query = "";
     request->header_count = 0;
+    request->body = "";
     request->body_length = 0;
     strcpy(request->version, "HTTP/1.1");
+    request->params.count = 0;
 }
 
 // Initialize HTTP response
@@ -170,68 +262,378 @@ void initHttpResponse(HttpResponse* response) {
     strcpy(response->version, "HTTP/1.1");
 }
 
+// Parse HTTP method from a name that need not be NUL-terminated
+HttpMethod parseHttpMethodName(const char* name, int length) {
+    switch (length) {
+        case 3:
+            if (memcmp(name, "GET", 3) == 0) return HTTP_GET;
+            if (memcmp(name, "PUT", 3) == 0) return HTTP_PUT;
+            break;
+        case 4:
+            if (memcmp(name, "POST", 4) == 0) return HTTP_POST;
+            if (memcmp(name, "HEAD", 4) == 0) return HTTP_HEAD;
+            break;
+        case 5:
+            if (memcmp(name, "PATCH", 5) == 0) return HTTP_PATCH;
+            break;
+        case 6:
+            if (memcmp(name, "DELETE", 6) == 0) return HTTP_DELETE;
+            break;
+        case 7:
+            if (memcmp(name, "OPTIONS", 7) == 0) return HTTP_OPTIONS;
+            break;
+    }
+    return HTTP_GET; // Default
+}
+
 // Parse HTTP method
 HttpMethod parseHttpMethod(const char* method) {
-    if (strcmp(method, "GET") == 0) return HTTP_GET;
-    if (strcmp(method, "POST") == 0) return HTTP_POST;
-    if (strcmp(method, "PUT") == 0) return HTTP_PUT;
-    if (strcmp(method, "DELETE") == 0) return HTTP_DELETE;
-    if (strcmp(method, "PATCH") == 0) return HTTP_PATCH;
-    if (strcmp(method, "OPTIONS") == 0) return HTTP_OPTIONS;
-    if (strcmp(method, "HEAD") == 0) return HTTP_HEAD;
+    return parseHttpMethodName(method, strlen(method));
+}
+
+// Find the first c in [p, end), or NULL
+// SSE2 compares sixteen bytes at a time; the tail is checked bytewise.
+static char* scanForByte(char* p, const char* end, char c) {
+#if defined(__SSE2__)
+    __m128i target = _mm_set1_epi8(c);
+    while (end - p >= 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)p);
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, target));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#endif
     
-    return HTTP_GET; // Default
+    for (; p < end; p++) {
+        if (*p == c) return p;
+    }
+    return NULL;
 }
 
-// Parse HTTP request
-int parseHttpRequest(const char* raw_request, HttpRequest* request) {
-    char request_copy[BUFFER_SIZE];
-    strcpy(request_copy, raw_request);
+// Compare length bytes with a lowercase ASCII name, ignoring case
+// strncasecmp() is POSIX only; winsock builds have _strnicmp() instead.
+static int equalsIgnoringCase(const char* text, const char* lowercase, int length) {
+    for (int i = 0; i < length; i++) {
+        char c = text[i];
+        if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+        if (c != lowercase[i]) return 0;
+    }
+    return 1;
+}
+
+// Start parsing a new request
+void initHttpParser(HttpParser* parser) {
+    parser->state = PARSE_REQUEST_LINE;
+    parser->position = 0;
+    parser->scanned = 0;
+    parser->header_count = 0;
+    parser->content_length = -1;
+    parser->chunked = 0;
+    parser->chunk_remaining = 0;
+    parser->body_offset = 0;
+    parser->body_length = 0;
+}
+
+// Find the end of the line at the parse position
+// Returns the line length without its line ending and sets *next to the
+// offset after it, or returns -1 while the line is still arriving. The
+// bytes searched so far are remembered so they are not searched again.
+static int nextHttpLine(HttpParser* parser, char* data, int length, int* next) {
+    char* start = data + parser->position;
+    char* newline = scanForByte(start + parser->scanned, data + length, '\n');
+    if (!newline) {
+        parser->scanned = length - parser->position;
+        return -1;
+    }
     
-    // Parse request line
-    char* line = strtok(request_copy, "\r\n");
-    if (!line) return 0;
+    parser->scanned = 0;
+    *next = newline + 1 - data;
+    int line_length = newline - start;
+    if (line_length > 0 && start[line_length - 1] == '\r') {
+        line_length--;
+    }
+    return line_length;
+}
+
+// Parse "METHOD target HTTP/1.x"
+static int parseRequestLine(HttpParser* parser, char* data, int line_length) {
+    char* line = data + parser->position;
+    char* end = line + line_length;
+    
+    char* space = scanForByte(line, end, ' ');
+    if (!space || space == line) {
+        return -1;
+    }
+    parser->method.offset = parser->position;
+    parser->method.length = space - line;
+    
+    char* target = space + 1;
+    space = scanForByte(target, end, ' ');
+    if (!space || space == target) {
+        return -1;
+    }
+    parser->target.offset = target - data;
+    parser->target.length = space - target;
+    
+    char* version = space + 1;
+    if (end - version != 8 || memcmp(version, "HTTP/1.", 7) != 0 ||
+        (version[7] != '0' && version[7] != '1')) {
+        return -1;
+    }
+    parser->minor_version = version[7] - '0';
+    return 0;
+}
+
+// Parse one "Name: value" line and note the headers that frame the body
+// The colon and the end of the value are overwritten with NUL so both
+// can be used as C strings where they lie.
+static int parseHeaderLine(HttpParser* parser, char* data, int line_length) {
+    char* line = data + parser->position;
+    char* end = line + line_length;
+    
+    // Obsolete line folding is rejected rather than unfolded
+    if (line[0] == ' ' || line[0] == '\t' || parser->header_count >= MAX_HEADERS) {
+        return -1;
+    }
+    
+    char* colon = scanForByte(line, end, ':');
+    if (!colon || colon == line || colon[-1] == ' ' || colon[-1] == '\t') {
+        return -1;
+    }
+    
+    char* value = colon + 1;
+    while (value < end && (*value == ' ' || *value == '\t')) value++;
+    while (end > value && (end[-1] == ' ' || end[-1] == '\t')) end--;
+    
+    int name_length = colon - line;
+    int value_length = end - value;
+    
+    if (name_length == 14 && equalsIgnoringCase(line, "content-length", 14)) {
+        long content_length = 0;
+        if (value_length == 0) {
+            return -1;
+        }
+        for (char* digit = value; digit < end; digit++) {
+            if (*digit < '0' || *digit > '9') {
+                return -1;
+            }
+            content_length = content_length * 10 + (*digit - '0');
+            if (content_length > BUFFER_SIZE - 1) {
+                return -1; // Too large to buffer
+            }
+        }
+        if (parser->content_length >= 0 && parser->content_length != content_length) {
+            return -1;
+        }
+        parser->content_length = content_length;
+    } else if (name_length == 17 && equalsIgnoringCase(line, "transfer-encoding", 17)) {
+        // Only a plain "chunked" coding is understood
+        if (value_length != 7 || !equalsIgnoringCase(value, "chunked", 7)) {
+            return -1;
+        }
+        parser->chunked = 1;
+    }
+    
+    parser->header_names[parser->header_count].offset = parser->position;
+    parser->header_names[parser->header_count].length = name_length;
+    parser->header_values[parser->header_count].offset = value - data;
+    parser->header_values[parser->header_count].length = value_length;
+    parser->header_count++;
+    
+    *colon = '\0';
+    *end = '\0';
+    return 0;
+}
+
+// Parse the hexadecimal size at the start of a chunk, or -1
+// Chunk extensions after the size are ignored.
+static long parseChunkSize(const char* line, int line_length) {
+    long size = 0;
+    int digits = 0;
+    
+    for (; digits < line_length; digits++) {
+        char c = line[digits];
+        int value;
+        if (c >= '0' && c <= '9') value = c - '0';
+        else if (c >= 'a' && c <= 'f') value = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') value = c - 'A' + 10;
+        else break;
+        
+        if (digits >= 8) {
+            return -1;
+        }
+        size = size * 16 + value;
+    }
+    
+    if (digits == 0 || (digits < line_length && line[digits] != ';' &&
+                        line[digits] != ' ' && line[digits] != '\t')) {
+        return -1;
+    }
+    return size;
+}
+
+// Continue parsing a request whose first length bytes are in data
+// Returns the request's total length once it is complete, 0 while more
+// is needed and -1 if it is malformed. Pipelined requests that follow
+// are left alone. A chunked body is decoded in place, so data must be
+// writable; it may move between calls as long as its contents do not.
+int parseHttpIncremental(HttpParser* parser, char* data, int length) {
+    while (parser->state != PARSE_COMPLETE) {
+        int next = 0;
+        int line_length;
+        
+        switch (parser->state) {
+            case PARSE_REQUEST_LINE:
+                line_length = nextHttpLine(parser, data, length, &next);
+                if (line_length < 0) return 0;
+                
+                // Empty lines before a request are ignored
+                if (line_length > 0) {
+                    if (parseRequestLine(parser, data, line_length) < 0) return -1;
+                    parser->state = PARSE_HEADERS;
+                }
+                parser->position = next;
+                break;
+                
+            case PARSE_HEADERS:
+                line_length = nextHttpLine(parser, data, length, &next);
+                if (line_length < 0) return 0;
+                
+                if (line_length > 0) {
+                    if (parseHeaderLine(parser, data, line_length) < 0) return -1;
+                    parser->position = next;
+                    break;
+                }
+                
+                // Blank line: the body, if any, follows
+                parser->position = next;
+                parser->body_offset = next;
+                if (parser->chunked && parser->content_length >= 0) {
+                    return -1; // Ambiguous framing
+                }
+                if (parser->chunked) {
+                    parser->state = PARSE_CHUNK_SIZE;
+                } else if (parser->content_length > 0) {
+                    parser->state = PARSE_BODY;
+                } else {
+                    parser->state = PARSE_COMPLETE;
+                }
+                break;
+                
+            case PARSE_BODY:
+                if (length - parser->position < parser->content_length) return 0;
+                parser->body_length = parser->content_length;
+                parser->position += parser->content_length;
+                parser->state = PARSE_COMPLETE;
+                break;
+                
+            case PARSE_CHUNK_SIZE: {
+                line_length = nextHttpLine(parser, data, length, &next);
+                if (line_length < 0) return 0;
+                
+                long size = parseChunkSize(data + parser->position, line_length);
+                if (size < 0 || parser->body_length + size > BUFFER_SIZE - 1) return -1;
+                parser->chunk_remaining = size;
+                parser->position = next;
+                parser->state = size > 0 ? PARSE_CHUNK_DATA : PARSE_TRAILERS;
+                break;
+            }
+                
+            case PARSE_CHUNK_DATA: {
+                // Move the data down over the size lines before it, so the
+                // decoded body ends up contiguous after the headers
+                int available = length - parser->position;
+                int count = available < parser->chunk_remaining ? available : (int)parser->chunk_remaining;
+                memmove(data + parser->body_offset + parser->body_length, data + parser->position, count);
+                parser->body_length += count;
+                parser->position += count;
+                parser->chunk_remaining -= count;
+                
+                if (parser->chunk_remaining > 0) return 0;
+                parser->state = PARSE_CHUNK_END;
+                break;
+            }
+                
+            case PARSE_CHUNK_END:
+                line_length = nextHttpLine(parser, data, length, &next);
+                if (line_length < 0) return 0;
+                if (line_length != 0) return -1;
+                parser->position = next;
+                parser->state = PARSE_CHUNK_SIZE;
+                break;
+                
+            case PARSE_TRAILERS:
+                // Trailer fields are read past but not kept
+                line_length = nextHttpLine(parser, data, length, &next);
+                if (line_length < 0) return 0;
+                parser->position = next;
+                if (line_length == 0) {
+                    parser->state = PARSE_COMPLETE;
+                }
+                break;
+                
+            default:
+                return -1;
+        }
+    }
     
-    char method[16], path[256], version[16];
-    if (sscanf(line, "%s %s %s", method, path, version) != 3) {
+    return parser->position;
+}
+
+// Fill in a request from a completed parse of data
+// Path, query, headers and body are terminated in place, so data needs
+// one spare byte after the request and must outlive it.
+int fillHttpRequest(const HttpParser* parser, char* data, HttpRequest* request) {
+    char* target = data + parser->target.offset;
+    int target_length = parser->target.length;
+    if (target_length >= MAX_PATH_LENGTH) {
         return 0;
     }
     
-    request->method = parseHttpMethod(method);
-    strcpy(request->version, version);
+    request->method = parseHttpMethodName(data + parser->method.offset, parser->method.length);
+    strcpy(request->version, parser->minor_version == 0 ? "HTTP/1.0" : "HTTP/1.1");
     
     // Parse path and query
-    char* query_start = strchr(path, '?');
+    target[target_length] = '\0';
+    char* query_start = memchr(target, '?', target_length);
     if (query_start) {
         *query_start = '\0';
-        strcpy(request->path, path);
-        strcpy(request->query, query_start + 1);
+        request->query = query_start + 1;
     } else {
-        strcpy(request->path, path);
-        strcpy(request->query, "");
+        request->query = "";
     }
+    request->path = target;
     
-    // Parse headers
-    request->header_count = 0;
-    while ((line = strtok(NULL, "\r\n")) != NULL && strlen(line) > 0) {
-        if (request->header_count < 20) {
-            strcpy(request->headers[request->header_count++], line);
-        }
+    for (int i = 0; i < parser->header_count; i++) {
+        request->headers[i].name = data + parser->header_names[i].offset;
+        request->headers[i].name_length = parser->header_names[i].length;
+        request->headers[i].value = data + parser->header_values[i].offset;
+        request->headers[i].value_length = parser->header_values[i].length;
     }
+    request->header_count = parser->header_count;
     
     // Parse body
-    char* body_start = strstr(raw_request, "\r\n\r\n");
-    if (body_start) {
-        body_start += 4;
-        request->body_length = strlen(body_start);
-        if (request->body_length < BUFFER_SIZE) {
-            strcpy(request->body, body_start);
-        }
-    }
+    request->body = data + parser->body_offset;
+    request->body_length = parser->body_length;
+    data[parser->body_offset + parser->body_length] = '\0';
+    request->params.count = 0;
     
     return 1;
 }
 
+// Parse HTTP request
+// raw_request must hold one complete request; see fillHttpRequest.
+int parseHttpRequest(char* raw_request, int length, HttpRequest* request) {
+    HttpParser parser;
+    initHttpParser(&parser);
+    if (parseHttpIncremental(&parser, raw_request, length) <= 0) {
+        return 0;
+    }
+    return fillHttpRequest(&parser, raw_request, request);
+}
+
 // Set response status
 void setResponseStatus(HttpResponse* response, HttpStatus status) {
     response->status = status;
@@ -305,26 +707,261 @@ void formatHttpResponse(HttpResponse* response, char* output) {
 // ROUTING SYSTEM
 // =============================================================================
 
+// Create a tree node matching the given static text
+static RouteNode* createRouteNode(const char* prefix, int length) {
+    RouteNode* node = calloc(1, sizeof(RouteNode));
+    if (!node) return NULL;
+    
+    node->prefix = malloc(length + 1);
+    if (!node->prefix) {
+        free(node);
+        return NULL;
+    }
+    memcpy(node->prefix, prefix, length);
+    node->prefix[length] = '\0';
+    node->prefix_length = length;
+    return node;
+}
+
+// Free a tree node and everything below it
+static void freeRouteNode(RouteNode* node) {
+    if (!node) return;
+    
+    for (int i = 0; i < node->child_count; i++) {
+        freeRouteNode(node->children[i]);
+    }
+    freeRouteNode(node->param_child);
+    freeRouteNode(node->wildcard_child);
+    free(node->children);
+    free(node->indices);
+    free(node->prefix);
+    free(node);
+}
+
+// Append a static child to a node
+static int addRouteChild(RouteNode* node, RouteNode* child) {
+    RouteNode** children = realloc(node->children, (node->child_count + 1) * sizeof(RouteNode*));
+    if (!children) return -1;
+    node->children = children;
+    
+    char* indices = realloc(node->indices, node->child_count + 1);
+    if (!indices) return -1;
+    node->indices = indices;
+    
+    node->children[node->child_count] = child;
+    node->indices[node->child_count] = child->prefix[0];
+    node->child_count++;
+    return 0;
+}
+
+// Split a node's prefix so that it ends after 'at' bytes
+// Everything the node matched beyond that moves into a new child, which
+// keeps the node itself in place for its parent.
+static int splitRouteNode(RouteNode* node, int at) {
+    RouteNode* tail = createRouteNode(node->prefix + at, node->prefix_length - at);
+    if (!tail) return -1;
+    
+    tail->indices = node->indices;
+    tail->children = node->children;
+    tail->child_count = node->child_count;
+    tail->param_child = node->param_child;
+    tail->wildcard_child = node->wildcard_child;
+    memcpy(tail->routes, node->routes, sizeof(node->routes));
+    
+    node->indices = NULL;
+    node->children = NULL;
+    node->child_count = 0;
+    node->param_child = NULL;
+    node->wildcard_child = NULL;
+    memset(node->routes, 0, sizeof(node->routes));
+    node->prefix[at] = '\0';
+    node->prefix_length = at;
+    
+    if (addRouteChild(node, tail) < 0) {
+        // Undo so the tree stays as it was
+        node->prefix[at] = tail->prefix[0];
+        node->prefix_length += tail->prefix_length;
+        node->indices = tail->indices;
+        node->children = tail->children;
+        node->child_count = tail->child_count;
+        node->param_child = tail->param_child;
+        node->wildcard_child = tail->wildcard_child;
+        memcpy(node->routes, tail->routes, sizeof(node->routes));
+        free(tail->prefix);
+        free(tail);
+        return -1;
+    }
+    return 0;
+}
+
+// Walk static text down from a node, adding and splitting edges as needed
+static RouteNode* insertStaticPath(RouteNode* node, const char* text, int length) {
+    while (length > 0) {
+        char* slot = node->indices ? memchr(node->indices, text[0], node->child_count) : NULL;
+        if (!slot) {
+            RouteNode* child = createRouteNode(text, length);
+            if (!child) return NULL;
+            if (addRouteChild(node, child) < 0) {
+                freeRouteNode(child);
+                return NULL;
+            }
+            return child;
+        }
+        
+        RouteNode* child = node->children[slot - node->indices];
+        int common = 1;
+        while (common < child->prefix_length && common < length && child->prefix[common] == text[common]) {
+            common++;
+        }
+        if (common < child->prefix_length && splitRouteNode(child, common) < 0) {
+            return NULL;
+        }
+        
+        node = child;
+        text += common;
+        length -= common;
+    }
+    return node;
+}
+
+// Find or add the param or wildcard child of a node
+// Two routes may not give the same position different names.
+static RouteNode* insertParamNode(RouteNode** slot, const char* name, int length) {
+    if (length >= (int)sizeof((*slot)->name)) return NULL;
+    
+    if (*slot) {
+        if ((int)strlen((*slot)->name) != length || strncmp((*slot)->name, name, length) != 0) {
+            return NULL;
+        }
+        return *slot;
+    }
+    
+    RouteNode* node = createRouteNode("", 0);
+    if (!node) return NULL;
+    memcpy(node->name, name, length);
+    node->name[length] = '\0';
+    *slot = node;
+    return node;
+}
+
 // Add route to server
-void addRoute(HttpMethod method, const char* path, RouteHandler handler) {
-    if (server.route_count < MAX_ROUTES) {
-        server.routes[server.route_count].method = method;
-        strcpy(server.routes[server.route_count].path, path);
-        server.routes[server.route_count].handler = handler;
-        server.route_count++;
+// Returns -1 if the path is malformed or already has a handler for the method.
+int addRoute(HttpMethod method, const char* path, RouteHandler handler) {
+    if (server.route_count >= MAX_ROUTES || path[0] != '/' ||
+        strlen(path) >= sizeof(server.routes[0].path)) {
+        return -1;
+    }
+    if (!server.route_tree) {
+        server.route_tree = createRouteNode("", 0);
+        if (!server.route_tree) return -1;
+    }
+    
+    // Split the path into static runs, ":name" segments and a final "*name"
+    RouteNode* node = server.route_tree;
+    const char* p = path;
+    while (*p) {
+        const char* start = p;
+        while (*p && !((*p == ':' || *p == '*') && p > path && p[-1] == '/')) {
+            p++;
+        }
+        if (p > start) {
+            node = insertStaticPath(node, start, p - start);
+            if (!node) return -1;
+        }
+        if (!*p) break;
+        
+        char kind = *p++;
+        const char* name = p;
+        while (*p && *p != '/') {
+            p++;
+        }
+        if (kind == ':') {
+            if (p == name) return -1;
+            node = insertParamNode(&node->param_child, name, p - name);
+        } else {
+            if (*p) return -1;
+            node = insertParamNode(&node->wildcard_child, name, p - name);
+        }
+        if (!node) return -1;
     }
+    
+    if (node->routes[method]) return -1;
+    
+    Route* route = &server.routes[server.route_count];
+    route->method = method;
+    strcpy(route->path, path);
+    route->handler = handler;
+    node->routes[method] = route;
+    server.route_count++;
+    return 0;
 }
 
-// Find matching route
-Route* findRoute(HttpMethod method, const char* path) {
-    for (int i = 0; i < server.route_count; i++) {
-        if (server.routes[i].method == method && strcmp(server.routes[i].path, path) == 0) {
-            return &server.routes[i];
+// Match the rest of a path below a node whose own prefix already matched
+// Tries a static edge, then a parameter, then a wildcard, backing out of
+// branches that dead-end.
+static Route* matchRouteNode(RouteNode* node, const char* path, int length, HttpMethod method, RouteParams* params) {
+    if (length == 0) {
+        if (node->routes[method]) return node->routes[method];
+    } else {
+        char* slot = node->indices ? memchr(node->indices, path[0], node->child_count) : NULL;
+        if (slot) {
+            RouteNode* child = node->children[slot - node->indices];
+            if (child->prefix_length <= length && memcmp(child->prefix, path, child->prefix_length) == 0) {
+                Route* route = matchRouteNode(child, path + child->prefix_length,
+                                              length - child->prefix_length, method, params);
+                if (route) return route;
+            }
         }
+        
+        if (node->param_child && params->count < MAX_ROUTE_PARAMS) {
+            const char* end = memchr(path, '/', length);
+            int segment = end ? end - path : length;
+            if (segment > 0) {
+                RouteParam* param = &params->items[params->count++];
+                param->name = node->param_child->name;
+                param->value = path;
+                param->value_length = segment;
+                
+                Route* route = matchRouteNode(node->param_child, path + segment, length - segment, method, params);
+                if (route) return route;
+                params->count--;
+            }
+        }
+    }
+    
+    if (node->wildcard_child && node->wildcard_child->routes[method] && params->count < MAX_ROUTE_PARAMS) {
+        RouteParam* param = &params->items[params->count++];
+        param->name = node->wildcard_child->name;
+        param->value = path;
+        param->value_length = length;
+        return node->wildcard_child->routes[method];
     }
     return NULL;
 }
 
+// Find matching route
+// Captured parameters are written to params, which may be NULL.
+Route* findRoute(HttpMethod method, const char* path, RouteParams* params) {
+    RouteParams scratch;
+    if (!params) params = &scratch;
+    params->count = 0;
+    
+    if (!server.route_tree || method < 0 || method >= HTTP_METHOD_COUNT) return NULL;
+    return matchRouteNode(server.route_tree, path, strlen(path), method, params);
+}
+
+// Get a route parameter as an integer
+// Returns default_value if the route captured no such parameter.
+int getRouteParamInt(HttpRequest* request, const char* name, int default_value) {
+    for (int i = 0; i < request->params.count; i++) {
+        if (strcmp(request->params.items[i].name, name) == 0) {
+            // The value ends at '/' or the end of the path, where atoi stops
+            return atoi(request->params.items[i].value);
+        }
+    }
+    return default_value;
+}
+
 // =============================================================================
 // API ENDPOINTS
 // =============================================================================
@@ -401,14 +1038,8 @@ void usersHandler(HttpRequest* request, HttpResponse* response) {
 
 // User by ID handler
 void userByIdHandler(HttpRequest* request, HttpResponse* response) {
-    // Extract user ID from path (simplified)
-    int user_id = 1; // Default
-    
-    // In a real implementation, parse the path to get the ID
-    char* id_start = strstr(request->path, "/users/");
-    if (id_start) {
-        user_id = atoi(id_start + 7);
-    }
+    // ID captured by the ":id" segment of the route
+    int user_id = getRouteParamInt(request, "id", 1);
     
     char json[256];
     if (user_id >= 1 && user_id <= 3) {
@@ -529,6 +1160,8 @@ int initWebServer() {
         return 0;
     }
     
+    freeRouteNode(server.route_tree);
+    server.route_tree = NULL;
     server.route_count = 0;
     server.is_running = 0;
     
@@ -537,13 +1170,24 @@ int initWebServer() {
 }
 
 // Handle client request
+// A request may arrive over several reads; the parser picks up where the
+// previous read left it instead of rescanning the buffer.
 void handleClient(SOCKET client_socket) {
     char buffer[BUFFER_SIZE];
-    int bytes_received = recv(client_socket, buffer, BUFFER_SIZE - 1, 0);
-    
-    if (bytes_received > 0) {
-        buffer[bytes_received] = '\0';
+    int received = 0;
+    int request_length = 0;
+    HttpParser parser;
+    
+    initHttpParser(&parser);
+    while (request_length == 0 && received < BUFFER_SIZE - 1) {
+        int bytes_received = recv(client_socket, buffer + received, BUFFER_SIZE - 1 - received, 0);
+        if (bytes_received <= 0) break;
         
+        received += bytes_received;
+        request_length = parseHttpIncremental(&parser, buffer, received);
+    }
+    
+    if (received > 0) {
         HttpRequest request;
         HttpResponse response;
         
@@ -551,12 +1195,12 @@ void handleClient(SOCKET client_socket) {
         initHttpResponse(&response);
         
         // Parse request
-        if (parseHttpRequest(buffer, &request)) {
+        if (request_length > 0 && fillHttpRequest(&parser, buffer, &request)) {
             printf("[%s] %s %s\n", getCurrentTimestamp(), 
                    (request.method == HTTP_GET) ? "GET" : "POST", request.path);
             
             // Find matching route
-            Route* route = findRoute(request.method, request.path);
+            Route* route = findRoute(request.method, request.path, &request.params);
             
             if (route) {
                 route->handler(&request, &response);
@@ -597,7 +1241,7 @@ void startWebServer() {
     addRoute(HTTP_GET, "/api/time", timeHandler);
     addRoute(HTTP_GET, "/api/hello", helloHandler);
     addRoute(HTTP_GET, "/api/users", usersHandler);
-    addRoute(HTTP_GET, "/api/users/", userByIdHandler);
+    addRoute(HTTP_GET, "/api/users/:id", userByIdHandler);
     addRoute(HTTP_GET, "/echo", echoHandler);
     addRoute(HTTP_POST, "/echo", echoHandler);
     
@@ -684,13 +1328,8 @@ void getUsersApi(HttpRequest* request, HttpResponse* response) {
 
 // GET user by ID
 void getUserByIdApi(HttpRequest* request, HttpResponse* response) {
-    int user_id = 1; // Default
-    
-    // Parse ID from path (simplified)
-    char* id_start = strstr(request->path, "/api/users/");
-    if (id_start) {
-        user_id = atoi(id_start + 11);
-    }
+    // ID captured by the ":id" segment of the route
+    int user_id = getRouteParamInt(request, "id", 1);
     
     // Find user
     User* user = NULL;
@@ -776,13 +1415,8 @@ void createUserApi(HttpRequest* request, HttpResponse* response) {
 
 // PUT update user
 void updateUserApi(HttpRequest* request, HttpResponse* response) {
-    int user_id = 1; // Default
-    
-    // Parse ID from path
-    char* id_start = strstr(request->path, "/api/users/");
-    if (id_start) {
-        user_id = atoi(id_start + 11);
-    }
+    // ID captured by the ":id" segment of the route
+    int user_id = getRouteParamInt(request, "id", 1);
     
     // Find user
     User* user = NULL;
@@ -842,13 +1476,8 @@ void updateUserApi(HttpRequest* request, HttpResponse* response) {
 
 // DELETE user
 void deleteUserApi(HttpRequest* request, HttpResponse* response) {
-    int user_id = 1; // Default
-    
-    // Parse ID from path
-    char* id_start = strstr(request->path, "/api/users/");
-    if (id_start) {
-        user_id = atoi(id_start + 11);
-    }
+    // ID captured by the ":id" segment of the route
+    int user_id = getRouteParamInt(request, "id", 1);
     
     // Find and deactivate user
     for (int i = 0; i < user_count; i++) {
@@ -906,10 +1535,10 @@ void demonstrateRestAPI() {
     
     // Add REST API routes
     addRoute(HTTP_GET, "/api/users", getUsersApi);
-    addRoute(HTTP_GET, "/api/users/", getUserByIdApi);
+    addRoute(HTTP_GET, "/api/users/:id", getUserByIdApi);
     addRoute(HTTP_POST, "/api/users", createUserApi);
-    addRoute(HTTP_PUT, "/api/users/", updateUserApi);
-    addRoute(HTTP_DELETE, "/api/users/", deleteUserApi);
+    addRoute(HTTP_PUT, "/api/users/:id", updateUserApi);
+    addRoute(HTTP_DELETE, "/api/users/:id", deleteUserApi);
     
     printf("REST API configured with endpoints:\n");
     printf("- GET /api/users - Get all users\n");
@@ -931,7 +1560,7 @@ void demonstrateRequestHandling() {
     printf("=== REQUEST HANDLING DEMO ===\n");
     
     // Sample HTTP request
-    const char* sample_request = 
+    char sample_request[] = 
         "GET /api/hello?name=World HTTP/1.1\r\n"
         "Host: localhost:8080\r\n"
         "User-Agent: curl/7.68.0\r\n"
@@ -947,7 +1576,7 @@ void demonstrateRequestHandling() {
     initHttpRequest(&request);
     initHttpResponse(&response);
     
-    if (parseHttpRequest(sample_request, &request)) {
+    if (parseHttpRequest(sample_request, strlen(sample_request), &request)) {
         printf("Parsed Request:\n");
         printf("Method: %d\n", request.method);
         printf("Path: %s\n", request.path);
@@ -955,7 +1584,7 @@ void demonstrateRequestHandling() {
         printf("Headers: %d\n", request.header_count);
         
         for (int i = 0; i < request.header_count; i++) {
-            printf("  %s\n", request.headers[i]);
+            printf("  %s: %s\n", request.headers[i].name, request.headers[i].value);
         }
         
         // Handle request
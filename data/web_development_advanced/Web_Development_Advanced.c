@@ -3,6 +3,14 @@
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <errno.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 // =============================================================================
 // ADVANCED WEB DEVELOPMENT
@@ -15,6 +23,8 @@
 #define MAX_CONNECTIONS 1000
 #define DEFAULT_PORT 8080
 #define BUFFER_SIZE 4096
+#define MAX_ROUTE_PARAMS 8
+#define MAX_REQUEST_HEADERS 64
 
 // =============================================================================
 // HTTP PROTOCOL IMPLEMENTATION
@@ -33,6 +43,8 @@ typedef enum {
     HTTP_TRACE = 8
 } HttpMethod;
 
+#define HTTP_METHOD_COUNT 9
+
 // HTTP status codes
 typedef enum {
     STATUS_200_OK = 200,
@@ -61,17 +73,42 @@ typedef struct {
     char value[1024];
 } HttpHeader;
 
+// Path parameter captured by the router
+// The value points into the request path and is not NUL-terminated.
+typedef struct {
+    const char* name;
+    const char* value;
+    int value_length;
+} RouteParam;
+
+typedef struct {
+    RouteParam items[MAX_ROUTE_PARAMS];
+    int count;
+} RouteParams;
+
+// Request header
+// Name and value point into the receive buffer, where the parser
+// NUL-terminates them in place.
+typedef struct {
+    const char* name;
+    int name_length;
+    const char* value;
+    int value_length;
+} HttpRequestHeader;
+
 // HTTP request structure
+// path, query_string and body point into the receive buffer.
 typedef struct {
     HttpMethod method;
     char url[MAX_URL_LENGTH];
     HttpVersion version;
-    HttpHeader headers[MAX_HEADER_SIZE];
+    HttpRequestHeader headers[MAX_REQUEST_HEADERS];
     int header_count;
-    char* body;
+    const char* body;           // Not NUL-terminated
     int body_length;
     char* query_string;
     char* path;
+    RouteParams params;
 } HttpRequest;
 
 // HTTP response structure
@@ -85,6 +122,46 @@ typedef struct {
     char* status_message;
 } HttpResponse;
 
+// Byte range of a request, counted from the request's first byte
+// Offsets rather than pointers stay valid when an unfinished request is
+// moved to the front of its buffer.
+typedef struct {
+    int offset;
+    int length;
+} HttpSlice;
+
+// Parser states
+typedef enum {
+    PARSE_REQUEST_LINE = 0,
+    PARSE_HEADERS = 1,
+    PARSE_BODY = 2,             // Content-Length body
+    PARSE_CHUNK_SIZE = 3,
+    PARSE_CHUNK_DATA = 4,
+    PARSE_CHUNK_END = 5,        // CRLF after chunk data
+    PARSE_TRAILERS = 6,
+    PARSE_COMPLETE = 7
+} HttpParseState;
+
+// Resumable HTTP/1.1 request parser
+// Fed the same request again as more of it arrives, it picks up where it
+// stopped instead of scanning from the start.
+typedef struct {
+    HttpParseState state;
+    int position;               // First byte not yet consumed
+    int scanned;                // Bytes after position already searched for '\n'
+    HttpSlice method;
+    HttpSlice target;
+    int minor_version;          // HTTP/1.x
+    HttpSlice header_names[MAX_REQUEST_HEADERS];
+    HttpSlice header_values[MAX_REQUEST_HEADERS];
+    int header_count;
+    long content_length;        // -1 without a Content-Length header
+    int chunked;
+    long chunk_remaining;
+    int body_offset;
+    int body_length;            // Chunked bodies: bytes decoded so far
+} HttpParser;
+
 // =============================================================================
 // WEB SERVER ARCHITECTURE
 // =============================================================================
@@ -103,6 +180,8 @@ typedef struct {
     ConnectionState state;
     char buffer[BUFFER_SIZE];
     int buffer_pos;
+    HttpParser parser;          // Progress through the request at the front of buffer
+    int request_length;         // Bytes of buffer used by the current request
     HttpRequest* request;
     HttpResponse* response;
     time_t last_activity;
@@ -137,10 +216,26 @@ typedef struct Route {
     struct Route* next;
 } Route;
 
+// Radix tree node
+// Each edge holds the static text its routes share; ":name" matches one
+// path segment and "*name" the rest of the path.
+typedef struct RouteNode {
+    char* prefix;
+    int prefix_length;
+    char* indices;              // First byte of each static child
+    struct RouteNode** children;
+    int child_count;
+    struct RouteNode* param_child;
+    struct RouteNode* wildcard_child;
+    char name[32];
+    Route* routes[HTTP_METHOD_COUNT];
+} RouteNode;
+
 // Router structure
 typedef struct {
     Route* routes;
     int route_count;
+    RouteNode* root;
 } Router;
 
 // =============================================================================
@@ -299,6 +394,17 @@ const char* getHttpMethodString(HttpMethod method) {
     }
 }
 
+// Get HTTP method from a name that need not be NUL-terminated
+HttpMethod getHttpMethodName(const char* name, int length) {
+    for (int method = HTTP_GET; method <= HTTP_TRACE; method++) {
+        const char* method_str = getHttpMethodString(method);
+        if ((int)strlen(method_str) == length && memcmp(method_str, name, length) == 0) {
+            return method;
+        }
+    }
+    return HTTP_GET; // Default
+}
+
 // Get status message
 const char* getStatusMessage(HttpStatus status) {
     switch (status) {
@@ -317,89 +423,344 @@ const char* getStatusMessage(HttpStatus status) {
     }
 }
 
-// Parse HTTP request
-HttpRequest* parseHttpRequest(const char* raw_request) {
-    HttpRequest* request = malloc(sizeof(HttpRequest));
-    if (!request) return NULL;
+// Find the first c in [p, end), or NULL
+// SSE2 compares sixteen bytes at a time; the tail is checked bytewise.
+static char* scanForByte(char* p, const char* end, char c) {
+#if defined(__SSE2__)
+    __m128i target = _mm_set1_epi8(c);
+    while (end - p >= 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)p);
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, target));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#endif
     
-    memset(request, 0, sizeof(HttpRequest));
+    for (; p < end; p++) {
+        if (*p == c) return p;
+    }
+    return NULL;
+}
+
+// Start parsing a new request
+void initHttpParser(HttpParser* parser) {
+    parser->state = PARSE_REQUEST_LINE;
+    parser->position = 0;
+    parser->scanned = 0;
+    parser->header_count = 0;
+    parser->content_length = -1;
+    parser->chunked = 0;
+    parser->chunk_remaining = 0;
+    parser->body_offset = 0;
+    parser->body_length = 0;
+}
+
+// Find the end of the line at the parse position
+// Returns the line length without its line ending and sets *next to the
+// offset after it, or returns -1 while the line is still arriving. The
+// bytes searched so far are remembered so they are not searched again.
+static int nextHttpLine(HttpParser* parser, char* data, int length, int* next) {
+    char* start = data + parser->position;
+    char* newline = scanForByte(start + parser->scanned, data + length, '\n');
+    if (!newline) {
+        parser->scanned = length - parser->position;
+        return -1;
+    }
     
-    // Parse request line
-    char request_line[1024];
-    const char* line_end = strstr(raw_request, "\r\n");
-    if (!line_end) {
-        free(request);
-        return NULL;
+    parser->scanned = 0;
+    *next = newline + 1 - data;
+    int line_length = newline - start;
+    if (line_length > 0 && start[line_length - 1] == '\r') {
+        line_length--;
     }
+    return line_length;
+}
+
+// Parse "METHOD target HTTP/1.x"
+static int parseRequestLine(HttpParser* parser, char* data, int line_length) {
+    char* line = data + parser->position;
+    char* end = line + line_length;
     
-    int line_length = line_end - raw_request;
-    strncpy(request_line, raw_request, line_length);
-    request_line[line_length] = '\0';
+    char* space = scanForByte(line, end, ' ');
+    if (!space || space == line) {
+        return -1;
+    }
+    parser->method.offset = parser->position;
+    parser->method.length = space - line;
     
-    // Parse method, URL, and version
-    char method_str[16], url_str[MAX_URL_LENGTH], version_str[16];
-    sscanf(request_line, "%s %s %s", method_str, url_str, version_str);
+    char* target = space + 1;
+    space = scanForByte(target, end, ' ');
+    if (!space || space == target) {
+        return -1;
+    }
+    parser->target.offset = target - data;
+    parser->target.length = space - target;
     
-    request->method = getHttpMethod(method_str);
-    strncpy(request->url, url_str, sizeof(request->url) - 1);
+    char* version = space + 1;
+    if (end - version != 8 || memcmp(version, "HTTP/1.", 7) != 0 ||
+        (version[7] != '0' && version[7] != '1')) {
+        return -1;
+    }
+    parser->minor_version = version[7] - '0';
+    return 0;
+}
+
+// Parse one "Name: value" line and note the headers that frame the body
+// The colon and the end of the value are overwritten with NUL so both
+// can be used as C strings where they lie.
+static int parseHeaderLine(HttpParser* parser, char* data, int line_length) {
+    char* line = data + parser->position;
+    char* end = line + line_length;
     
-    if (strcmp(version_str, "HTTP/1.0") == 0) {
-        request->version = HTTP_1_0;
-    } else if (strcmp(version_str, "HTTP/1.1") == 0) {
-        request->version = HTTP_1_1;
-    } else {
-        request->version = HTTP_1_1; // Default
+    // Obsolete line folding is rejected rather than unfolded
+    if (line[0] == ' ' || line[0] == '\t' || parser->header_count >= MAX_REQUEST_HEADERS) {
+        return -1;
     }
     
-    // Parse path and query string
-    char* query_start = strchr(url_str, '?');
-    if (query_start) {
-        *query_start = '\0';
-        request->query_string = strdup(query_start + 1);
+    char* colon = scanForByte(line, end, ':');
+    if (!colon || colon == line || colon[-1] == ' ' || colon[-1] == '\t') {
+        return -1;
     }
-    request->path = strdup(url_str);
     
-    // Parse headers
-    const char* header_start = line_end + 2;
-    const char* header_end = strstr(header_start, "\r\n\r\n");
+    char* value = colon + 1;
+    while (value < end && (*value == ' ' || *value == '\t')) value++;
+    while (end > value && (end[-1] == ' ' || end[-1] == '\t')) end--;
     
-    if (header_end) {
-        const char* current = header_start;
+    int name_length = colon - line;
+    int value_length = end - value;
+    
+    if (name_length == 14 && strncasecmp(line, "Content-Length", 14) == 0) {
+        long content_length = 0;
+        if (value_length == 0) {
+            return -1;
+        }
+        for (char* digit = value; digit < end; digit++) {
+            if (*digit < '0' || *digit > '9') {
+                return -1;
+            }
+            content_length = content_length * 10 + (*digit - '0');
+            if (content_length > MAX_BODY_SIZE) {
+                return -1; // Too large to buffer
+            }
+        }
+        if (parser->content_length >= 0 && parser->content_length != content_length) {
+            return -1;
+        }
+        parser->content_length = content_length;
+    } else if (name_length == 17 && strncasecmp(line, "Transfer-Encoding", 17) == 0) {
+        // Only a plain "chunked" coding is understood
+        if (value_length != 7 || strncasecmp(value, "chunked", 7) != 0) {
+            return -1;
+        }
+        parser->chunked = 1;
+    }
+    
+    parser->header_names[parser->header_count].offset = parser->position;
+    parser->header_names[parser->header_count].length = name_length;
+    parser->header_values[parser->header_count].offset = value - data;
+    parser->header_values[parser->header_count].length = value_length;
+    parser->header_count++;
+    
+    *colon = '\0';
+    *end = '\0';
+    return 0;
+}
+
+// Parse the hexadecimal size at the start of a chunk, or -1
+// Chunk extensions after the size are ignored.
+static long parseChunkSize(const char* line, int line_length) {
+    long size = 0;
+    int digits = 0;
+    
+    for (; digits < line_length; digits++) {
+        char c = line[digits];
+        int value;
+        if (c >= '0' && c <= '9') value = c - '0';
+        else if (c >= 'a' && c <= 'f') value = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') value = c - 'A' + 10;
+        else break;
+        
+        if (digits >= 8) {
+            return -1;
+        }
+        size = size * 16 + value;
+    }
+    
+    if (digits == 0 || (digits < line_length && line[digits] != ';' &&
+                        line[digits] != ' ' && line[digits] != '\t')) {
+        return -1;
+    }
+    return size;
+}
+
+// Continue parsing a request whose first length bytes are in data
+// Returns the request's total length once it is complete, 0 while more
+// is needed and -1 if it is malformed. Pipelined requests that follow
+// are left alone. A chunked body is decoded in place, so data must be
+// writable; it may move between calls as long as its contents do not.
+int parseHttpIncremental(HttpParser* parser, char* data, int length) {
+    while (parser->state != PARSE_COMPLETE) {
+        int next = 0;
+        int line_length;
         
-        while (current < header_end && request->header_count < MAX_HEADER_SIZE) {
-            const char* colon = strchr(current, ':');
-            if (colon) {
-                HttpHeader* header = &request->headers[request->header_count];
+        switch (parser->state) {
+            case PARSE_REQUEST_LINE:
+                line_length = nextHttpLine(parser, data, length, &next);
+                if (line_length < 0) return 0;
+                
+                // Empty lines before a request are ignored
+                if (line_length > 0) {
+                    if (parseRequestLine(parser, data, line_length) < 0) return -1;
+                    parser->state = PARSE_HEADERS;
+                }
+                parser->position = next;
+                break;
                 
-                int name_length = colon - current;
-                strncpy(header->name, current, name_length);
-                header->name[name_length] = '\0';
+            case PARSE_HEADERS:
+                line_length = nextHttpLine(parser, data, length, &next);
+                if (line_length < 0) return 0;
                 
-                const char* value_start = colon + 1;
-                while (*value_start == ' ') value_start++;
+                if (line_length > 0) {
+                    if (parseHeaderLine(parser, data, line_length) < 0) return -1;
+                    parser->position = next;
+                    break;
+                }
                 
-                const char* value_end = strstr(value_start, "\r\n");
-                if (value_end) {
-                    int value_length = value_end - value_start;
-                    strncpy(header->value, value_start, value_length);
-                    header->value[value_length] = '\0';
+                // Blank line: the body, if any, follows
+                parser->position = next;
+                parser->body_offset = next;
+                if (parser->chunked && parser->content_length >= 0) {
+                    return -1; // Ambiguous framing
+                }
+                if (parser->chunked) {
+                    parser->state = PARSE_CHUNK_SIZE;
+                } else if (parser->content_length > 0) {
+                    parser->state = PARSE_BODY;
+                } else {
+                    parser->state = PARSE_COMPLETE;
                 }
+                break;
                 
-                request->header_count++;
-                current = value_end + 2;
-            } else {
+            case PARSE_BODY:
+                if (length - parser->position < parser->content_length) return 0;
+                parser->body_length = parser->content_length;
+                parser->position += parser->content_length;
+                parser->state = PARSE_COMPLETE;
+                break;
+                
+            case PARSE_CHUNK_SIZE: {
+                line_length = nextHttpLine(parser, data, length, &next);
+                if (line_length < 0) return 0;
+                
+                long size = parseChunkSize(data + parser->position, line_length);
+                if (size < 0 || parser->body_length + size > MAX_BODY_SIZE) return -1;
+                parser->chunk_remaining = size;
+                parser->position = next;
+                parser->state = size > 0 ? PARSE_CHUNK_DATA : PARSE_TRAILERS;
                 break;
             }
-        }
-        
-        // Parse body if present
-        const char* body_start = header_end + 4;
-        if (strlen(body_start) > 0) {
-            request->body_length = strlen(body_start);
-            request->body = strdup(body_start);
+                
+            case PARSE_CHUNK_DATA: {
+                // Move the data down over the size lines before it, so the
+                // decoded body ends up contiguous after the headers
+                int available = length - parser->position;
+                int count = available < parser->chunk_remaining ? available : (int)parser->chunk_remaining;
+                memmove(data + parser->body_offset + parser->body_length, data + parser->position, count);
+                parser->body_length += count;
+                parser->position += count;
+                parser->chunk_remaining -= count;
+                
+                if (parser->chunk_remaining > 0) return 0;
+                parser->state = PARSE_CHUNK_END;
+                break;
+            }
+                
+            case PARSE_CHUNK_END:
+                line_length = nextHttpLine(parser, data, length, &next);
+                if (line_length < 0) return 0;
+                if (line_length != 0) return -1;
+                parser->position = next;
+                parser->state = PARSE_CHUNK_SIZE;
+                break;
+                
+            case PARSE_TRAILERS:
+                // Trailer fields are read past but not kept
+                line_length = nextHttpLine(parser, data, length, &next);
+                if (line_length < 0) return 0;
+                parser->position = next;
+                if (line_length == 0) {
+                    parser->state = PARSE_COMPLETE;
+                }
+                break;
+                
+            default:
+                return -1;
         }
     }
     
+    return parser->position;
+}
+
+// Fill in a request from a completed parse of data
+// The URL is copied; path, query string, headers and body point into
+// data, which must outlive the request.
+int fillHttpRequest(const HttpParser* parser, char* data, HttpRequest* request) {
+    char* target = data + parser->target.offset;
+    int target_length = parser->target.length;
+    if (target_length >= MAX_URL_LENGTH) {
+        return -1;
+    }
+    
+    request->method = getHttpMethodName(data + parser->method.offset, parser->method.length);
+    request->version = parser->minor_version == 0 ? HTTP_1_0 : HTTP_1_1;
+    memcpy(request->url, target, target_length);
+    request->url[target_length] = '\0';
+    
+    // Path and query string are terminated where they lie
+    target[target_length] = '\0';
+    char* query = memchr(target, '?', target_length);
+    if (query) {
+        *query = '\0';
+        request->query_string = query + 1;
+    } else {
+        request->query_string = NULL;
+    }
+    request->path = target;
+    
+    for (int i = 0; i < parser->header_count; i++) {
+        request->headers[i].name = data + parser->header_names[i].offset;
+        request->headers[i].name_length = parser->header_names[i].length;
+        request->headers[i].value = data + parser->header_values[i].offset;
+        request->headers[i].value_length = parser->header_values[i].length;
+    }
+    request->header_count = parser->header_count;
+    
+    request->body = parser->body_length > 0 ? data + parser->body_offset : NULL;
+    request->body_length = parser->body_length;
+    request->params.count = 0;
+    return 0;
+}
+
+// Parse HTTP request
+// raw_request must hold one complete request and stay alive, unchanged
+// except by the parser, for as long as the returned request is used.
+HttpRequest* parseHttpRequest(char* raw_request, int length) {
+    HttpParser parser;
+    initHttpParser(&parser);
+    if (parseHttpIncremental(&parser, raw_request, length) <= 0) {
+        return NULL;
+    }
+    
+    HttpRequest* request = malloc(sizeof(HttpRequest));
+    if (!request) return NULL;
+    
+    memset(request, 0, sizeof(HttpRequest));
+    if (fillHttpRequest(&parser, raw_request, request) < 0) {
+        free(request);
+        return NULL;
+    }
     return request;
 }
 
@@ -503,6 +864,7 @@ Connection* createConnection(int socket_fd) {
     conn->state = CONN_IDLE;
     conn->last_activity = time(NULL);
     conn->keep_alive = 1;
+    initHttpParser(&conn->parser);
     
     return conn;
 }
@@ -532,34 +894,46 @@ void handleHttpRequest(WebServer* server, Connection* conn) {
 }
 
 // Read from connection
+// Bytes go straight into the connection buffer, and the parser resumes
+// where the last read left it. A request already waiting behind the one
+// just answered is picked up without another read.
 int readFromConnection(Connection* conn) {
-    char buffer[BUFFER_SIZE];
-    int bytes_read = read(conn->socket_fd, buffer, BUFFER_SIZE - 1);
-    
-    if (bytes_read > 0) {
-        buffer[bytes_read] = '\0';
-        
-        // Append to connection buffer
-        int remaining_space = BUFFER_SIZE - conn->buffer_pos - 1;
-        int bytes_to_copy = (bytes_read < remaining_space) ? bytes_read : remaining_space;
-        
-        memcpy(conn->buffer + conn->buffer_pos, buffer, bytes_to_copy);
-        conn->buffer_pos += bytes_to_copy;
-        conn->buffer[conn->buffer_pos] = '\0';
-        
-        // Check if we have a complete request
-        if (strstr(conn->buffer, "\r\n\r\n")) {
-            conn->request = parseHttpRequest(conn->buffer);
-            conn->state = CONN_WRITING;
+    int bytes_read = 0;
+    int space = BUFFER_SIZE - 1 - conn->buffer_pos;
+    
+    if (space > 0) {
+        bytes_read = read(conn->socket_fd, conn->buffer + conn->buffer_pos, space);
+        if (bytes_read > 0) {
+            conn->buffer_pos += bytes_read;
+            conn->last_activity = time(NULL);
+        } else if (bytes_read == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            // Connection closed by client, or an error
+            conn->state = CONN_CLOSING;
+            return bytes_read;
         }
-        
-        conn->last_activity = time(NULL);
-    } else if (bytes_read == 0) {
-        // Connection closed by client
-        conn->state = CONN_CLOSING;
-    } else {
-        // Error
+    }
+    
+    if (conn->buffer_pos == 0) {
+        return bytes_read;
+    }
+    
+    int length = parseHttpIncremental(&conn->parser, conn->buffer, conn->buffer_pos);
+    if (length == 0 && space <= 0) {
+        length = -1; // Request too large to buffer
+    }
+    
+    if (length < 0) {
         conn->state = CONN_CLOSING;
+    } else if (length > 0) {
+        conn->request = malloc(sizeof(HttpRequest));
+        if (!conn->request || fillHttpRequest(&conn->parser, conn->buffer, conn->request) < 0) {
+            free(conn->request);
+            conn->request = NULL;
+            conn->state = CONN_CLOSING;
+            return bytes_read;
+        }
+        conn->request_length = length;
+        conn->state = CONN_WRITING;
     }
     
     return bytes_read;
@@ -589,9 +963,11 @@ int writeToConnection(Connection* conn) {
             conn->response = NULL;
         }
         
-        // Reset buffer
-        conn->buffer_pos = 0;
-        conn->buffer[0] = '\0';
+        // Keep any pipelined requests that followed this one
+        memmove(conn->buffer, conn->buffer + conn->request_length, conn->buffer_pos - conn->request_length);
+        conn->buffer_pos -= conn->request_length;
+        conn->request_length = 0;
+        initHttpParser(&conn->parser);
         
         conn->last_activity = time(NULL);
     } else {
@@ -680,26 +1056,221 @@ void runWebServer(WebServer* server) {
 // ROUTING SYSTEM IMPLEMENTATION
 // =============================================================================
 
+// Create a tree node matching the given static text
+static RouteNode* createRouteNode(const char* prefix, int length) {
+    RouteNode* node = calloc(1, sizeof(RouteNode));
+    if (!node) return NULL;
+    
+    node->prefix = malloc(length + 1);
+    if (!node->prefix) {
+        free(node);
+        return NULL;
+    }
+    memcpy(node->prefix, prefix, length);
+    node->prefix[length] = '\0';
+    node->prefix_length = length;
+    return node;
+}
+
+// Free a tree node and everything below it
+static void freeRouteNode(RouteNode* node) {
+    if (!node) return;
+    
+    for (int i = 0; i < node->child_count; i++) {
+        freeRouteNode(node->children[i]);
+    }
+    freeRouteNode(node->param_child);
+    freeRouteNode(node->wildcard_child);
+    free(node->children);
+    free(node->indices);
+    free(node->prefix);
+    free(node);
+}
+
+// Append a static child to a node
+static int addRouteChild(RouteNode* node, RouteNode* child) {
+    RouteNode** children = realloc(node->children, (node->child_count + 1) * sizeof(RouteNode*));
+    if (!children) return -1;
+    node->children = children;
+    
+    char* indices = realloc(node->indices, node->child_count + 1);
+    if (!indices) return -1;
+    node->indices = indices;
+    
+    node->children[node->child_count] = child;
+    node->indices[node->child_count] = child->prefix[0];
+    node->child_count++;
+    return 0;
+}
+
+// Split a node's prefix so that it ends after 'at' bytes
+// Everything the node matched beyond that moves into a new child, which
+// keeps the node itself in place for its parent.
+static int splitRouteNode(RouteNode* node, int at) {
+    RouteNode* tail = createRouteNode(node->prefix + at, node->prefix_length - at);
+    if (!tail) return -1;
+    
+    tail->indices = node->indices;
+    tail->children = node->children;
+    tail->child_count = node->child_count;
+    tail->param_child = node->param_child;
+    tail->wildcard_child = node->wildcard_child;
+    memcpy(tail->routes, node->routes, sizeof(node->routes));
+    
+    node->indices = NULL;
+    node->children = NULL;
+    node->child_count = 0;
+    node->param_child = NULL;
+    node->wildcard_child = NULL;
+    memset(node->routes, 0, sizeof(node->routes));
+    node->prefix[at] = '\0';
+    node->prefix_length = at;
+    
+    if (addRouteChild(node, tail) < 0) {
+        // Undo so the tree stays as it was
+        node->prefix[at] = tail->prefix[0];
+        node->prefix_length += tail->prefix_length;
+        node->indices = tail->indices;
+        node->children = tail->children;
+        node->child_count = tail->child_count;
+        node->param_child = tail->param_child;
+        node->wildcard_child = tail->wildcard_child;
+        memcpy(node->routes, tail->routes, sizeof(node->routes));
+        free(tail->prefix);
+        free(tail);
+        return -1;
+    }
+    return 0;
+}
+
+// Walk static text down from a node, adding and splitting edges as needed
+static RouteNode* insertStaticPath(RouteNode* node, const char* text, int length) {
+    while (length > 0) {
+        char* slot = node->indices ? memchr(node->indices, text[0], node->child_count) : NULL;
+        if (!slot) {
+            RouteNode* child = createRouteNode(text, length);
+            if (!child) return NULL;
+            if (addRouteChild(node, child) < 0) {
+                freeRouteNode(child);
+                return NULL;
+            }
+            return child;
+        }
+        
+        RouteNode* child = node->children[slot - node->indices];
+        int common = 1;
+        while (common < child->prefix_length && common < length && child->prefix[common] == text[common]) {
+            common++;
+        }
+        if (common < child->prefix_length && splitRouteNode(child, common) < 0) {
+            return NULL;
+        }
+        
+        node = child;
+        text += common;
+        length -= common;
+    }
+    return node;
+}
+
+// Find or add the param or wildcard child of a node
+// Two routes may not give the same position different names.
+static RouteNode* insertParamNode(RouteNode** slot, const char* name, int length) {
+    if (length >= (int)sizeof((*slot)->name)) return NULL;
+    
+    if (*slot) {
+        if ((int)strlen((*slot)->name) != length || strncmp((*slot)->name, name, length) != 0) {
+            return NULL;
+        }
+        return *slot;
+    }
+    
+    RouteNode* node = createRouteNode("", 0);
+    if (!node) return NULL;
+    memcpy(node->name, name, length);
+    node->name[length] = '\0';
+    *slot = node;
+    return node;
+}
+
 // Create router
 Router* createRouter() {
     Router* router = malloc(sizeof(Router));
     if (!router) return NULL;
     
     memset(router, 0, sizeof(Router));
+    router->root = createRouteNode("", 0);
+    if (!router->root) {
+        free(router);
+        return NULL;
+    }
     return router;
 }
 
+// Free router, its routes and its tree
+void freeRouter(Router* router) {
+    if (!router) return;
+    
+    Route* current = router->routes;
+    while (current) {
+        Route* next = current->next;
+        free(current);
+        current = next;
+    }
+    freeRouteNode(router->root);
+    free(router);
+}
+
 // Add route
-void addRoute(Router* router, const char* path, HttpMethod method, RouteHandler handler) {
+// Returns -1 if the path is malformed or already has a handler for the method.
+int addRoute(Router* router, const char* path, HttpMethod method, RouteHandler handler) {
+    if (path[0] != '/' || strlen(path) >= sizeof(router->routes->path) ||
+        method < 0 || method >= HTTP_METHOD_COUNT) {
+        return -1;
+    }
+    
+    // Split the path into static runs, ":name" segments and a final "*name"
+    RouteNode* node = router->root;
+    const char* p = path;
+    while (*p) {
+        const char* start = p;
+        while (*p && !((*p == ':' || *p == '*') && p > path && p[-1] == '/')) {
+            p++;
+        }
+        if (p > start) {
+            node = insertStaticPath(node, start, p - start);
+            if (!node) return -1;
+        }
+        if (!*p) break;
+        
+        char kind = *p++;
+        const char* name = p;
+        while (*p && *p != '/') {
+            p++;
+        }
+        if (kind == ':') {
+            if (p == name) return -1;
+            node = insertParamNode(&node->param_child, name, p - name);
+        } else {
+            if (*p) return -1;
+            node = insertParamNode(&node->wildcard_child, name, p - name);
+        }
+        if (!node) return -1;
+    }
+    
+    if (node->routes[method]) return -1;
+    
     Route* route = malloc(sizeof(Route));
-    if (!route) return;
+    if (!route) return -1;
     
+    memset(route, 0, sizeof(Route));
     strncpy(route->path, path, sizeof(route->path) - 1);
     route->method = method;
     route->handler = handler;
     route->next = NULL;
+    node->routes[method] = route;
     
-    // Add to linked list
+    // Keep the list too so routes can be listed in registration order
     if (!router->routes) {
         router->routes = route;
     } else {
@@ -711,19 +1282,71 @@ void addRoute(Router* router, const char* path, HttpMethod method, RouteHandler
     }
     
     router->route_count++;
+    return 0;
 }
 
-// Find route
-Route* findRoute(Router* router, const char* path, HttpMethod method) {
-    Route* current = router->routes;
-    
-    while (current) {
-        if (current->method == method && strcmp(current->path, path) == 0) {
-            return current;
+// Match the rest of a path below a node whose own prefix already matched
+// Tries a static edge, then a parameter, then a wildcard, backing out of
+// branches that dead-end.
+static Route* matchRouteNode(RouteNode* node, const char* path, int length, HttpMethod method, RouteParams* params) {
+    if (length == 0) {
+        if (node->routes[method]) return node->routes[method];
+    } else {
+        char* slot = node->indices ? memchr(node->indices, path[0], node->child_count) : NULL;
+        if (slot) {
+            RouteNode* child = node->children[slot - node->indices];
+            if (child->prefix_length <= length && memcmp(child->prefix, path, child->prefix_length) == 0) {
+                Route* route = matchRouteNode(child, path + child->prefix_length,
+                                              length - child->prefix_length, method, params);
+                if (route) return route;
+            }
+        }
+        
+        if (node->param_child && params->count < MAX_ROUTE_PARAMS) {
+            const char* end = memchr(path, '/', length);
+            int segment = end ? end - path : length;
+            if (segment > 0) {
+                RouteParam* param = &params->items[params->count++];
+                param->name = node->param_child->name;
+                param->value = path;
+                param->value_length = segment;
+                
+                Route* route = matchRouteNode(node->param_child, path + segment, length - segment, method, params);
+                if (route) return route;
+                params->count--;
+            }
         }
-        current = current->next;
     }
     
+    if (node->wildcard_child && node->wildcard_child->routes[method] && params->count < MAX_ROUTE_PARAMS) {
+        RouteParam* param = &params->items[params->count++];
+        param->name = node->wildcard_child->name;
+        param->value = path;
+        param->value_length = length;
+        return node->wildcard_child->routes[method];
+    }
+    return NULL;
+}
+
+// Find route
+// Captured parameters are written to params, which may be NULL.
+Route* findRoute(Router* router, const char* path, HttpMethod method, RouteParams* params) {
+    RouteParams scratch;
+    if (!params) params = &scratch;
+    params->count = 0;
+    
+    if (method < 0 || method >= HTTP_METHOD_COUNT) return NULL;
+    return matchRouteNode(router->root, path, strlen(path), method, params);
+}
+
+// Look up a parameter captured for the request's route
+const char* getRouteParam(HttpRequest* request, const char* name, int* length) {
+    for (int i = 0; i < request->params.count; i++) {
+        if (strcmp(request->params.items[i].name, name) == 0) {
+            if (length) *length = request->params.items[i].value_length;
+            return request->params.items[i].value;
+        }
+    }
     return NULL;
 }
 
@@ -951,9 +1574,16 @@ void apiHandler(HttpRequest* request, HttpResponse* response) {
 // File serving handler
 void fileHandler(HttpRequest* request, HttpResponse* response) {
     // Simplified file serving - in production, you'd want proper file handling
-    const char* file_path = request->path + 1; // Remove leading '/'
+    // The "*path" wildcard captures the file name; without a route it is
+    // the request path minus its leading '/'
+    int file_length;
+    const char* file_path = getRouteParam(request, "path", &file_length);
+    if (!file_path) {
+        file_path = request->path + 1;
+        file_length = strlen(file_path);
+    }
     
-    if (strcmp(file_path, "") == 0 || strcmp(file_path, "index.html") == 0) {
+    if (file_length == 0 || (file_length == 10 && strncmp(file_path, "index.html", 10) == 0)) {
         const char* content = "<html><body><h1>Index Page</h1><p>Welcome to the index page!</p></body></html>";
         setResponseBody(response, content, strlen(content));
     } else {
@@ -971,18 +1601,19 @@ void demonstrateHttpProtocol() {
     printf("=== HTTP PROTOCOL DEMO ===\n");
     
     // Sample HTTP request
-    const char* raw_request = "GET /api/users?limit=10 HTTP/1.1\r\n"
-                            "Host: localhost:8080\r\n"
-                            "User-Agent: Mozilla/5.0\r\n"
-                            "Accept: application/json\r\n"
-                            "Content-Type: application/json\r\n"
-                            "\r\n"
-                            "{\"name\": \"John\", \"age\": 30}";
+    char raw_request[] = "GET /api/users?limit=10 HTTP/1.1\r\n"
+                         "Host: localhost:8080\r\n"
+                         "User-Agent: Mozilla/5.0\r\n"
+                         "Accept: application/json\r\n"
+                         "Content-Type: application/json\r\n"
+                         "Content-Length: 27\r\n"
+                         "\r\n"
+                         "{\"name\": \"John\", \"age\": 30}";
     
     printf("Raw HTTP Request:\n%s\n", raw_request);
     
-    // Parse request
-    HttpRequest* request = parseHttpRequest(raw_request);
+    // Parse request; the parser terminates strings inside raw_request
+    HttpRequest* request = parseHttpRequest(raw_request, strlen(raw_request));
     if (request) {
         printf("Parsed Request:\n");
         printf("  Method: %s\n", getHttpMethodString(request->method));
@@ -995,7 +1626,11 @@ void demonstrateHttpProtocol() {
             printf("    %s: %s\n", request->headers[i].name, request->headers[i].value);
         }
         
-        printf("  Body: %s\n", request->body ? request->body : "None");
+        if (request->body) {
+            printf("  Body: %.*s\n", request->body_length, request->body);
+        } else {
+            printf("  Body: None\n");
+        }
         
         free(request);
     }
@@ -1021,7 +1656,14 @@ void demonstrateRouting() {
     // Add routes
     addRoute(router, "/", HTTP_GET, homeHandler);
     addRoute(router, "/api", HTTP_GET, apiHandler);
-    addRoute(router, "/files/*", HTTP_GET, fileHandler);
+    addRoute(router, "/files/*path", HTTP_GET, fileHandler);
+    addRoute(router, "/api/users/:id", HTTP_GET, apiHandler);
+    addRoute(router, "/api/users/:id/posts/:post", HTTP_GET, apiHandler);
+    
+    // The same parameter position cannot have two names
+    if (addRoute(router, "/api/users/:name", HTTP_PUT, apiHandler) < 0) {
+        printf("Rejected PUT /api/users/:name (conflicts with :id)\n");
+    }
     
     printf("Router created with %d routes:\n", router->route_count);
     
@@ -1033,13 +1675,25 @@ void demonstrateRouting() {
     }
     
     // Test route matching
-    Route* found = findRoute(router, "/", HTTP_GET);
+    Route* found = findRoute(router, "/", HTTP_GET, NULL);
     printf("\nFound route for GET /: %s\n", found ? "Yes" : "No");
     
-    found = findRoute(router, "/api", HTTP_POST);
+    found = findRoute(router, "/api", HTTP_POST, NULL);
     printf("Found route for POST /api: %s\n", found ? "Yes" : "No");
     
-    free(router);
+    // Parameters are slices of the path, not copies
+    const char* paths[] = {"/api/users/42", "/api/users/42/posts/7", "/files/docs/index.html"};
+    for (int i = 0; i < 3; i++) {
+        RouteParams params;
+        found = findRoute(router, paths[i], HTTP_GET, &params);
+        printf("GET %s -> %s", paths[i], found ? found->path : "none");
+        for (int j = 0; j < params.count; j++) {
+            printf(" [%s=%.*s]", params.items[j].name, params.items[j].value_length, params.items[j].value);
+        }
+        printf("\n");
+    }
+    
+    freeRouter(router);
 }
 
 void demonstrateSessions() {